@@ -0,0 +1,47 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+// Timing helpers for the benchmark executables. Numbers are only
+// meaningful from an optimised build (-DCMAKE_BUILD_TYPE=Release).
+namespace bench {
+
+// Best of `repeats` runs of f, in milliseconds
+template <typename F>
+double bestMillis(int repeats, F&& f) {
+    double best = 1e300;
+    for (int i = 0; i < repeats; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+// Folds a result into a volatile so the work producing it is not optimised
+// away
+inline volatile size_t sink = 0;
+template <typename T>
+void keep(const T& value) {
+    sink = sink + static_cast<size_t>(value);
+}
+
+inline double megabytesPerSecond(size_t bytes, double millis) {
+    return millis > 0 ? bytes / (millis * 1000.0) : 0.0;
+}
+
+inline void header(const std::string& title, const char* fast, const char* slow) {
+    std::printf("%-28s %12s %12s\n", title.c_str(), fast, slow);
+}
+
+// One row: the name and two timings with their ratio
+inline void report(const std::string& name, const char* unit, double fast, double slow) {
+    std::printf("%-28s %12.3f %12.3f %s %8.1fx\n", name.c_str(), fast, slow, unit, fast > 0 ? slow / fast : 0.0);
+}
+
+} // namespace bench
@@ -0,0 +1,48 @@
+// The protocol layer's JSON strings against nlohmann::json on multi-MB
+// messages: a didOpen carrying a whole document, which protocol::parse
+// lifts out of the DOM parse, and large string values escaped for output.
+#include "bench.h"
+#include "interpreter/simd_string.h"
+#include "protocol/json_string.h"
+#include "protocol/json_writer.h"
+#include <iostream>
+#include <string>
+
+using json = nlohmann::json;
+
+int main() {
+    const int repeats = 5;
+    std::string document;
+    for (int line = 10; document.size() < (4u << 20); line += 10) {
+        document += std::to_string(line) + " PRINT \"Hello, \"; X$; TAB(4); \"done\"\n";
+    }
+    // Program output: mostly plain text with a tab or newline now and then
+    std::string output;
+    while (output.size() < (4u << 20)) {
+        output += "Result\t" + std::to_string(output.size()) + " of the run, \"quoted\" and done\n";
+    }
+    json open = {{"jsonrpc", "2.0"},
+                 {"method", "textDocument/didOpen"},
+                 {"params", {{"textDocument", {{"uri", "file:///big.bas"}, {"languageId", "basic"}, {"version", 1},
+                                               {"text", document}}}}}};
+    std::string frame = open.dump();
+
+    if (protocol::parse(frame) != json::parse(frame) || protocol::serialize(output) != json(output).dump()) {
+        std::cerr << "protocol and nlohmann results differ" << std::endl;
+        return 1;
+    }
+
+    char title[64];
+    std::snprintf(title, sizeof(title), "%.1f MB, %s kernels", frame.size() / 1048576.0, basic::simd::kernelName());
+    bench::header(title, "protocol", "nlohmann");
+    bench::report("parse didOpen", "ms",
+                  bench::bestMillis(repeats, [&] { bench::keep(protocol::parse(frame).size()); }),
+                  bench::bestMillis(repeats, [&] { bench::keep(json::parse(frame).size()); }));
+    bench::report("escape document", "ms",
+                  bench::bestMillis(repeats, [&] { bench::keep(protocol::serialize(document).size()); }),
+                  bench::bestMillis(repeats, [&] { bench::keep(json(document).dump().size()); }));
+    bench::report("escape output", "ms",
+                  bench::bestMillis(repeats, [&] { bench::keep(protocol::serialize(output).size()); }),
+                  bench::bestMillis(repeats, [&] { bench::keep(json(output).dump().size()); }));
+    return 0;
+}
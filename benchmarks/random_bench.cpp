@@ -0,0 +1,36 @@
+// RNDFILL's Random::fill() against one-at-a-time generation with
+// Random::nextDouble() and with the standard library engines.
+#include "bench.h"
+#include "interpreter/random.h"
+#include "interpreter/simd_string.h"
+#include <random>
+#include <vector>
+
+int main() {
+    const size_t count = 10000000;
+    const int repeats = 5;
+    std::vector<double> out(count);
+
+    basic::Random random(42);
+    double fill = bench::bestMillis(repeats, [&] { random.fill(out.data(), count); });
+    double scalar = bench::bestMillis(repeats, [&] {
+        for (double& value : out) value = random.nextDouble();
+    });
+
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    std::mt19937 mt(42);
+    double mt32 = bench::bestMillis(repeats, [&] {
+        for (double& value : out) value = distribution(mt);
+    });
+    std::mt19937_64 mt64(42);
+    double mt64Millis = bench::bestMillis(repeats, [&] {
+        for (double& value : out) value = distribution(mt64);
+    });
+    bench::keep(out[count / 2] * 1000);
+
+    bench::header(std::string("10M doubles, ") + basic::simd::kernelName() + " kernels", "fill()", "other");
+    bench::report("Random::nextDouble()", "ms", fill, scalar);
+    bench::report("std::mt19937 + uniform", "ms", fill, mt32);
+    bench::report("std::mt19937_64 + uniform", "ms", fill, mt64Millis);
+    return 0;
+}
@@ -0,0 +1,180 @@
+// Throughput of the simd_string kernels against byte-at-a-time loops, and of
+// the string builtins against the BASIC loops a program would otherwise run.
+#include "bench.h"
+#include "interpreter/basic_interpreter.h"
+#include "interpreter/output.h"
+#include "interpreter/simd_string.h"
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace simd = basic::simd;
+
+namespace {
+
+size_t scalarFind(std::string_view text, std::string_view needle) {
+    for (size_t i = 0; i + needle.size() <= text.size(); ++i) {
+        if (std::memcmp(text.data() + i, needle.data(), needle.size()) == 0) return i;
+    }
+    return simd::npos;
+}
+
+void scalarToUpper(char* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        if (data[i] >= 'a' && data[i] <= 'z') data[i] = static_cast<char>(data[i] - 'a' + 'A');
+    }
+}
+
+size_t scalarSkipSpace(std::string_view text) {
+    size_t i = 0;
+    while (i < text.size() && (text[i] == ' ' || text[i] == '\t' || text[i] == '\r' || text[i] == '\n')) ++i;
+    return i;
+}
+
+int scalarCompareIgnoreCase(std::string_view a, std::string_view b) {
+    auto lower = [](char c) { return static_cast<unsigned char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c); };
+    for (size_t i = 0; i < a.size() && i < b.size(); ++i) {
+        if (lower(a[i]) != lower(b[i])) return lower(a[i]) < lower(b[i]) ? -1 : 1;
+    }
+    return a.size() < b.size() ? -1 : (a.size() > b.size() ? 1 : 0);
+}
+
+void benchmarkKernels() {
+    const size_t size = 1 << 20;
+    std::string text;
+    while (text.size() < size) text += "The quick brown fox jumps over the lazy dog. ";
+    text.resize(size - 6);
+    text += "needle";
+    std::string spaces(size, ' ');
+    spaces.back() = 'x';
+    std::string mixedCase = text;
+    simd::toUpper(&mixedCase[0], mixedCase.size() / 2);
+    const int repeats = 20;
+
+    bench::header(std::string("1 MiB, ") + simd::kernelName() + " kernels", "simd", "scalar");
+    bench::report("find (match at end)", "ms",
+                  bench::bestMillis(repeats, [&] { bench::keep(simd::find(text, "needle")); }),
+                  bench::bestMillis(repeats, [&] { bench::keep(scalarFind(text, "needle")); }));
+    std::string buffer = text;
+    bench::report("toUpper", "ms",
+                  bench::bestMillis(repeats, [&] { buffer = text; simd::toUpper(&buffer[0], buffer.size()); }),
+                  bench::bestMillis(repeats, [&] { buffer = text; scalarToUpper(&buffer[0], buffer.size()); }));
+    bench::report("skipSpace", "ms",
+                  bench::bestMillis(repeats, [&] { bench::keep(simd::skipSpace(spaces)); }),
+                  bench::bestMillis(repeats, [&] { bench::keep(scalarSkipSpace(spaces)); }));
+    bench::report("compareIgnoreCase (equal)", "ms",
+                  bench::bestMillis(repeats, [&] { bench::keep(simd::compareIgnoreCase(text, mixedCase) + 1); }),
+                  bench::bestMillis(repeats, [&] { bench::keep(scalarCompareIgnoreCase(text, mixedCase) + 1); }));
+}
+
+// Numbers the statements from 10 in steps of 10
+std::string numbered(const std::vector<std::string>& statements) {
+    std::string program;
+    for (size_t i = 0; i < statements.size(); ++i) {
+        program += std::to_string((i + 1) * 10) + " " + statements[i] + "\n";
+    }
+    return program;
+}
+
+double runMillis(const std::vector<std::string>& statements) {
+    basic::BasicInterpreter interpreter;
+    interpreter.setOutputSink(std::make_unique<basic::BufferOutputSink>());
+    if (!interpreter.loadProgram(numbered(statements))) {
+        std::cerr << interpreter.getLastError() << std::endl;
+        return 0;
+    }
+    return bench::bestMillis(1, [&] {
+        if (!interpreter.execute()) std::cerr << interpreter.getLastError() << std::endl;
+    });
+}
+
+// Time per pass of `work`, repeated `passes` times after the shared setup.
+// FOR loop bodies only assign strings: the interpreter takes an integer
+// statement result inside a loop as a jump target.
+double perPassMillis(const std::vector<std::string>& work, int passes) {
+    std::vector<std::string> setup = {
+        "T$ = \"Hello World, \"",          // 3334 bytes with the needle at the end
+        "FOR I = 1 TO 8", "T$ = T$ + T$", "NEXT I",
+        "T$ = T$ + \"needle\"",
+        "V$ = T$ + \"\"",
+        "L$ = \"abcdefghijklmnopqrstuvwxyz\"",
+        "H$ = \"ABCDEFGHIJKLMNOPQRSTUVWXYZ\"",
+        "S$ = \"    \"",                   // 2 KiB of spaces either side
+        "FOR I = 1 TO 9", "S$ = S$ + S$", "NEXT I",
+        "W$ = S$ + T$ + S$",
+    };
+    std::vector<std::string> program = setup;
+    program.push_back("FOR K = 1 TO " + std::to_string(passes));
+    program.insert(program.end(), work.begin(), work.end());
+    program.push_back("NEXT K");
+    double best = 1e300;
+    for (int i = 0; i < 3; ++i) {
+        best = std::min(best, runMillis(program) - runMillis(setup));
+    }
+    return std::max(best, 0.0) / passes;
+}
+
+void benchmarkBuiltins() {
+    struct Case {
+        const char* name;
+        std::vector<std::string> builtin;
+        std::vector<std::string> loop;
+    };
+    std::vector<Case> cases = {
+        {"INSTR (3.3 KB)",
+         {"P$ = STR(INSTR(T$, \"needle\"))"},
+         {"FOR I = 1 TO LEN(T$) - 5",
+          "IF MID(T$, I, 6) <> \"needle\" THEN LET Z$ = \"\" ELSE LET P$ = STR(I)",
+          "NEXT I"}},
+        {"UCASE (3.3 KB)",
+         {"U$ = UCASE(T$)"},
+         {"U$ = \"\"",
+          "FOR I = 1 TO LEN(T$)",
+          "C$ = MID(T$, I, 1)",
+          "U$ = U$ + MID(C$ + H$, INSTR(L$, C$) + 1, 1)",
+          "NEXT I"}},
+        {"TRIM (7.4 KB)",
+         {"B$ = TRIM(W$)"},
+         {"A$ = \"\"",
+          "FOR I = 1 TO LEN(W$)",
+          "IF LEN(A$) < 1 THEN IF MID(W$, I, 1) <> \" \" THEN LET A$ = MID(W$, I, LEN(W$))",
+          "NEXT I",
+          "B$ = \"\"",
+          "FOR I = LEN(A$) TO 1 STEP 0 - 1",
+          "IF LEN(B$) < 1 THEN IF MID(A$, I, 1) <> \" \" THEN LET B$ = LEFT(A$, I)",
+          "NEXT I"}},
+        {"REPLACE (3.3 KB)",
+         {"R$ = REPLACE(T$, \",\", \";\")"},
+         {"R$ = \"\"",
+          "FOR I = 1 TO LEN(T$)",
+          "IF MID(T$, I, 1) <> \",\" THEN LET R$ = R$ + MID(T$, I, 1) ELSE LET R$ = R$ + \";\"",
+          "NEXT I"}},
+        {"STRCOMP (3.3 KB, equal)",
+         {"D$ = STR(STRCOMP(T$, V$))"},
+         {"D$ = \"\"",
+          "FOR I = 1 TO LEN(T$)",
+          "IF LEN(D$) < 1 THEN IF MID(T$, I, 1) <> MID(V$, I, 1) THEN LET D$ = MID(T$, I, 1)",
+          "NEXT I"}},
+    };
+
+    std::cout << std::endl;
+    bench::header("BASIC, per call", "builtin", "BASIC loop");
+    for (const Case& c : cases) {
+        bench::report(c.name, "us", perPassMillis(c.builtin, 2000) * 1000, perPassMillis(c.loop, 3) * 1000);
+    }
+}
+
+} // namespace
+
+int main() {
+    benchmarkKernels();
+    // Where AVX2 is in use, the SSE2 kernels too
+    if (std::string(simd::kernelName()) == "avx2") {
+        simd::setAvx2(false);
+        benchmarkKernels();
+        simd::setAvx2(true);
+    }
+    benchmarkBuiltins();
+    return 0;
+}
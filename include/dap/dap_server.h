@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <memory>
 #include <functional>
@@ -12,6 +13,8 @@
 #include <fstream>
 #include <sstream>
 #include <nlohmann/json.hpp>
+#include "interpreter/debug_hook.h"
+#include "protocol/dap_protocol.h"
 
 #ifdef _WIN32
 #include <winsock2.h>
@@ -24,6 +27,12 @@
 #include <unistd.h>
 #endif
 
+namespace basic {
+class BasicInterpreter;
+class Program;
+class TraceReader;
+}
+
 namespace dap {
 
 using json = nlohmann::json;
@@ -35,37 +44,6 @@ enum class DAPMessageType {
     EVENT
 };
 
-// DAP request types
-enum class DAPRequestType {
-    INITIALIZE,
-    LAUNCH,
-    ATTACH,
-    DISCONNECT,
-    TERMINATE,
-    RESTART,
-    SETBREAKPOINTS,
-    SETFUNCTIONBREAKPOINTS,
-    SETEXCEPTIONBREAKPOINTS,
-    CONTINUE,
-    NEXT,
-    STEPIN,
-    STEPOUT,
-    PAUSE,
-    STACKTRACE,
-    SCOPES,
-    VARIABLES,
-    EVALUATE,
-    SETVARIABLE,
-    SOURCE,
-    THREADS,
-    MODULES,
-    LOADEDSOURCES,
-    EXCEPTIONINFO,
-    READMEMORY,
-    WRITEMEMORY,
-    DISASSEMBLE
-};
-
 // DAP event types
 enum class DAPEventType {
     INITIALIZED,
@@ -97,140 +75,21 @@ struct DAPMessage {
     DAPMessage(DAPMessageType t, const std::string& cmd) : type(t), command(cmd) {}
 };
 
-// Breakpoint information
-struct Breakpoint {
-    int id;
-    bool verified;
-    std::string message;
-    int line;
-    int column;
-    std::string source;
-    
-    Breakpoint(int i = 0) : id(i), verified(false), line(0), column(0) {}
-    
-    json toJson() const {
-        json j = {
-            {"id", id},
-            {"verified", verified},
-            {"line", line}
-        };
-        if (!message.empty()) j["message"] = message;
-        if (!source.empty()) j["source"] = source;
-        if (column > 0) j["column"] = column;
-        return j;
-    }
-};
-
-// Stack frame information
-struct StackFrame {
-    int id;
-    std::string name;
-    json source;
-    int line;
-    int column;
-    int endLine;
-    int endColumn;
-    
-    StackFrame(int i = 0) : id(i), line(0), column(0), endLine(0), endColumn(0) {}
-    
-    json toJson() const {
-        json j = {
-            {"id", id},
-            {"name", name},
-            {"line", line},
-            {"column", column}
-        };
-        if (!source.empty()) j["source"] = source;
-        if (endLine > 0) j["endLine"] = endLine;
-        if (endColumn > 0) j["endColumn"] = endColumn;
-        return j;
-    }
-};
-
-// Variable information
-struct Variable {
-    std::string name;
-    std::string value;
-    std::string type;
-    std::string kind;
-    int variablesReference;
-    int indexedVariables;
-    int namedVariables;
-    
-    Variable(const std::string& n = "") : name(n), variablesReference(0), indexedVariables(0), namedVariables(0) {}
-    
-    json toJson() const {
-        json j = {
-            {"name", name},
-            {"value", value},
-            {"variablesReference", variablesReference}
-        };
-        if (!type.empty()) j["type"] = type;
-        if (!kind.empty()) j["kind"] = kind;
-        if (indexedVariables > 0) j["indexedVariables"] = indexedVariables;
-        if (namedVariables > 0) j["namedVariables"] = namedVariables;
-        return j;
-    }
-};
-
-// Scope information
-struct Scope {
-    std::string name;
-    std::string presentationHint;
-    int variablesReference;
-    int namedVariables;
-    int indexedVariables;
-    bool expensive;
-    
-    Scope(const std::string& n = "") : name(n), variablesReference(0), namedVariables(0), indexedVariables(0), expensive(false) {}
-    
-    json toJson() const {
-        return json{
-            {"name", name},
-            {"presentationHint", presentationHint},
-            {"variablesReference", variablesReference},
-            {"namedVariables", namedVariables},
-            {"indexedVariables", indexedVariables},
-            {"expensive", expensive}
-        };
-    }
-};
-
-// Thread information
-struct Thread {
-    int id;
-    std::string name;
-    
-    Thread(int i = 0) : id(i) {}
-    
-    json toJson() const {
-        return json{{"id", id}, {"name", name}};
-    }
-};
-
-// Source information
-struct Source {
-    std::string name;
-    std::string path;
-    int sourceReference;
-    
-    Source(const std::string& n = "") : name(n), sourceReference(0) {}
-    
-    json toJson() const {
-        json j = {{"name", name}};
-        if (!path.empty()) j["path"] = path;
-        if (sourceReference > 0) j["sourceReference"] = sourceReference;
-        return j;
-    }
-};
-
 // DAP Server class
-class DAPServer {
+class DAPServer : public basic::DebugHook {
 public:
     DAPServer();
     ~DAPServer();
     void setLogging(bool enabled);
 
+    // Interpreter being debugged; the server installs itself as its debug hook
+    void setInterpreter(basic::BasicInterpreter* interpreter);
+
+    // basic::DebugHook
+    bool isAttached() const override;
+    void onStatement(int line) override;
+    void onOutput(const std::string& text) override;
+
     // Main server methods
     void start(bool enableLogging);  // Start with stdin/stdout communication
     void start(int port, bool enableLogging);  // Start with network support on specified port
@@ -249,7 +108,7 @@ public:
     json handleDisconnect(const json& arguments);
     json handleTerminate(const json& arguments);
     json handleRestart(const json& arguments);
-    json handleSetBreakpoints(const json& arguments);
+    SetBreakpointsResponse handleSetBreakpoints(const SetBreakpointsArguments& arguments);
     json handleSetFunctionBreakpoints(const json& arguments);
     json handleSetExceptionBreakpoints(const json& arguments);
     json handleContinue(const json& arguments);
@@ -257,21 +116,25 @@ public:
     json handleStepIn(const json& arguments);
     json handleStepOut(const json& arguments);
     json handlePause(const json& arguments);
-    json handleStackTrace(const json& arguments);
-    json handleScopes(const json& arguments);
-    json handleVariables(const json& arguments);
+    StackTraceResponse handleStackTrace(const StackTraceArguments& arguments);
+    ScopesResponse handleScopes(const ScopesArguments& arguments);
+    VariablesResponse handleVariables(const VariablesArguments& arguments);
     json handleEvaluate(const json& arguments);
     json handleSetVariable(const json& arguments);
-    json handleSource(const json& arguments);
-    json handleThreads(const json& arguments);
+    SourceResponse handleSource(const json& arguments);
+    ThreadsResponse handleThreads(const json& arguments);
     json handleModules(const json& arguments);
-    json handleLoadedSources(const json& arguments);
+    LoadedSourcesResponse handleLoadedSources(const json& arguments);
     json handleExceptionInfo(const json& arguments);
     json handleLoadSource(const json &arguments);
     json handleReadMemory(const json &arguments);
     json handleWriteMemory(const json& arguments);
     json handleDisassemble(const json& arguments);
     json handleConfigurationDone(const json& arguments);
+    json handleStepBack(const json& arguments);
+    json handleReverseContinue(const json& arguments);
+    json handleSourceChanged(const json& arguments);
+    VariablesDeltaResponse handleVariablesDelta(const json& arguments);
     
     void NestedEventHandler();
 
@@ -322,6 +185,51 @@ public:
     std::string readFileContent(const std::string& path) const;
 
 private:
+    // variablesReference of the n-th dictionary (in name order) is base + n
+    static constexpr int kDictionaryReferenceBase = 1000;
+
+    VariablesResponse dictionaryVariables(const VariablesArguments& arguments);
+    void appendDictionaries(std::vector<Variable>& variables);
+
+    // Variables generations closed at the last two stops; a scalar written
+    // after previousStop_ changed since the previous stop
+    uint64_t previousStop_ = 0;
+    uint64_t lastStop_ = 0;
+
+    // Replay of a trace recorded with --record (launch argument "trace").
+    // The session then moves through the trace instead of running the
+    // interpreter, in both directions.
+    std::unique_ptr<basic::TraceReader> replay_;
+    size_t replayStep_ = 0;
+
+    bool loadTrace(const std::string& path);
+    void replayMoveTo(size_t step, const std::string& reason);
+    bool isReplayBreakpoint(int line) const;
+    VariablesResponse replayVariables(const VariablesArguments& arguments);
+
+    // Edit-and-continue: a new version of the running source (loadSource
+    // with content, or sourceChanged after the file was saved) is patched
+    // into the paused program instead of needing a restart
+    json applySourceEdit(const std::string& path, const std::string& content);
+
+    // After every stopped event a client asks for threads, stackTrace,
+    // scopes and the first scope's variables. Their bodies are serialized
+    // once, when the session stops, and answered from here until a request
+    // that can change the paused state moves stopGeneration_ on.
+    struct StopSnapshot {
+        uint64_t generation = 0;
+        std::string threads;
+        std::string stackTrace;
+        std::string scopes;
+        std::string locals; // variables of reference 1
+    };
+    StopSnapshot stopSnapshot_;
+    uint64_t stopGeneration_ = 0;
+
+    void captureStopSnapshot();
+    bool answerFromStopSnapshot(const DAPMessage& message, DAPRequestType command);
+
+    basic::BasicInterpreter* interpreter_ = nullptr;
     bool running_;
     bool debugging_;
     bool paused_;
@@ -342,40 +250,54 @@ private:
     bool stepMode_ = false;
     bool runTillStop_ = false;
 
-    // Breakpoints: map from source file to set of line numbers
-    std::map<std::string, std::set<int>> breakpoints_;
-    std::map<int, Breakpoint> breakpointMap_;
+    // Breakpoints by source, keyed by the line the client asked for. Each
+    // one's line is where it actually stops: the next statement at or after
+    // the requested line, or unverified when there is none.
+    std::map<std::string, std::map<int, Breakpoint>> breakpoints_;
+    // Resolved lines of the current source set in the interpreter
+    std::set<int> activeBreakpointLines_;
     int nextBreakpointId_;
 
     // Source management
     std::map<std::string, std::string> sources_;
+    // The current source linked with the files it INCLUDEs; each module is
+    // compiled through basic::ProgramCache, shared with the language server
+    // when it has the same text open
+    std::shared_ptr<const basic::Program> program_;
+    std::shared_ptr<const basic::Program> linkedProgram();
+    // What the lines of path refer to: its module of program_, or the file
+    // compiled on its own
+    std::shared_ptr<const basic::Program> programFor(const std::string& path);
+    std::pair<std::string, int> currentPosition() const;
 
     // Synchronization for stepping and pausing
     std::mutex mutex_;
     std::condition_variable pauseCondition_;
 
-    std::map<std::string, std::function<json(const json&)>> requestHandlers_;
-    
     // Threading
     std::thread messageThread_;
     
-    void setupHandlers();
     DAPMessage createResponse(const json& id, const json& result);
     DAPMessage createErrorResponse(const json& id, int code, const std::string& message);
     void sendEvent(const std::string& event, const json& body);
+    void sendEventBody(const std::string& event, const std::string& body);
     
     // Helper methods
     int nextBreakpointId();
     bool hasBreakpoint(const std::string& source, int line);
-    void updateBreakpointStatus();
+    static void resolveBreakpoint(Breakpoint& breakpoint, int requestedLine, const basic::Program* program);
     bool shouldPauseAt(int line);
     void resume();
     void sendNetwork(const std::string& message);
+    // Writes header and content as one frame
+    void writeFrame(const std::string& content);
+    // A success response to request around an already serialized body
+    void sendResponseBody(const DAPMessage& request, const std::string& body);
+    void respond(const DAPMessage& request, const json& body);
+    // Generated message structs are written without building a json tree
+    template <typename T>
+    void respond(const DAPMessage& request, const T& body);
     void resyncBreakpoints();
 };
 
 } // namespace dap 
-
-namespace basic {
-    void setDAPServer(dap::DAPServer* server);
-}
\ No newline at end of file
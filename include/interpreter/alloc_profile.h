@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace basic {
+
+class Program;
+
+// Allocation totals per program line
+struct LineAllocations {
+    int line = 0;       // 1-based line of the source file
+    size_t count = 0;   // allocations and string stores
+    size_t bytes = 0;   // total bytes they requested
+    size_t peak = 0;    // highest live program memory seen on the line
+};
+
+// Fed by MemoryAccount while a program runs (see --alloc-profile). Every
+// allocation or charged string store is attributed to the source line being
+// executed.
+class AllocationProfile {
+public:
+    void record(int line, size_t bytes, size_t live) {
+        if (line <= 0) return;
+        if (static_cast<size_t>(line) >= lines_.size()) grow(line);
+        LineAllocations& entry = lines_[line];
+        ++entry.count;
+        entry.bytes += bytes;
+        if (live > entry.peak) entry.peak = live;
+    }
+
+    void clear() { lines_.clear(); }
+
+    // Lines that allocated, most bytes first
+    std::vector<LineAllocations> sorted() const;
+
+    // Human-readable table; program (optional) supplies the line text
+    void writeReport(std::ostream& out, const Program* program, size_t maxLines = 20) const;
+
+    // JSON read by the language server to show inlay hints:
+    // {"version":1,"source":"...","lines":[{"line":N,"count":..,"bytes":..,"peak":..}]}
+    void writeHints(std::ostream& out, const std::string& source) const;
+
+private:
+    std::vector<LineAllocations> lines_;
+
+    void grow(int line);
+};
+
+// "12.5 KB" style size for reports and hints
+std::string formatBytes(size_t bytes);
+
+} // namespace basic
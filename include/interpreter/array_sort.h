@@ -0,0 +1,19 @@
+#pragma once
+
+#include "interpreter/basic_interpreter.h"
+
+namespace basic {
+
+struct Array;
+
+// Sorts a one-dimensional array in ascending order. Numeric arrays use an LSD
+// radix sort, string arrays pdqsort on a cached 8-byte prefix. When `payload`
+// is given it is permuted in the same order as `keys`. Equal keys keep their
+// original order. Large arrays are sorted in chunks on several threads;
+// threads = 0 uses one per core, up to eight.
+void sortArray(Array& keys, Array* payload = nullptr, size_t threads = 0);
+
+// Index of the first element equal to `value` in an ascending array, or -1
+int searchArray(const Array& array, const Value& value);
+
+} // namespace basic
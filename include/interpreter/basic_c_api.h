@@ -0,0 +1,91 @@
+#pragma once
+
+/* C interface to the BASIC interpreter for embedding applications.
+ *
+ * Compile a program once with basic_compile(), then run it on as many
+ * contexts as needed. A context belongs to one thread at a time; different
+ * contexts may run concurrently, including on the same program. Contexts
+ * taken from a pool are reset when released, so each acquire starts from a
+ * clean state.
+ *
+ * Functions returning int give 0 on success and -1 on failure; the message
+ * is available from basic_context_error(). Functions returning a pointer
+ * give NULL on failure. No error escapes as a C++ exception, and NULL
+ * arguments are rejected. A NULL context, program or pool makes the call
+ * fail without a message (basic_context_error(NULL) says so); the _free and
+ * _release functions ignore NULL. Strings returned by the library stay
+ * valid until the next call on the same context.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct basic_program basic_program;
+typedef struct basic_context basic_context;
+typedef struct basic_pool basic_pool;
+
+typedef enum basic_value_type {
+    BASIC_NUMBER = 0,
+    BASIC_STRING = 1
+} basic_value_type;
+
+typedef struct basic_value {
+    basic_value_type type;
+    double number;
+    const char* string;
+} basic_value;
+
+/* Host function callable from BASIC. Return 0 and fill *result on success;
+ * a string result is copied before the call returns. A non-zero return
+ * raises a runtime error in the calling program. */
+typedef int (*basic_host_function)(void* user_data, const basic_value* args, int argc,
+                                   basic_value* result);
+
+/* Programs. Returns NULL and fills error (when given) on failure. */
+basic_program* basic_compile(const char* source, char* error, int error_size);
+void basic_program_free(basic_program* program);
+
+/* Stand-alone contexts */
+basic_context* basic_context_new(void);
+void basic_context_free(basic_context* context);
+int basic_context_load(basic_context* context, const basic_program* program);
+int basic_context_run(basic_context* context);
+int basic_context_reset(basic_context* context);
+const char* basic_context_error(const basic_context* context);
+
+/* Memory held by the program; over the limit (0 = none) the run fails
+ * with an out-of-memory error. The limit survives basic_context_reset(). */
+int basic_set_memory_limit(basic_context* context, size_t bytes);
+void basic_memory_usage(const basic_context* context, size_t* live, size_t* peak);
+
+/* Variables */
+int basic_set_number(basic_context* context, const char* name, double value);
+int basic_set_string(basic_context* context, const char* name, const char* value);
+int basic_get(basic_context* context, const char* name, basic_value* value);
+
+/* Host functions; binding a NULL function removes the name */
+int basic_bind_function(basic_context* context, const char* name, basic_host_function function,
+                        void* user_data);
+
+/* Output. After basic_capture_output() PRINT goes to a buffer that
+ * basic_output() returns; basic_context_reset() does not clear it. */
+int basic_capture_output(basic_context* context);
+const char* basic_output(basic_context* context);
+void basic_clear_output(basic_context* context);
+
+/* Pools of contexts running one program. Functions must be bound before
+ * the first acquire. Acquired contexts are given back with
+ * basic_pool_release(), never basic_context_free(). */
+basic_pool* basic_pool_new(const basic_program* program, int capture_output, int max_idle);
+void basic_pool_free(basic_pool* pool);
+int basic_pool_bind_function(basic_pool* pool, const char* name, basic_host_function function,
+                             void* user_data);
+basic_context* basic_pool_acquire(basic_pool* pool);
+void basic_pool_release(basic_pool* pool, basic_context* context);
+
+#ifdef __cplusplus
+}
+#endif
@@ -8,6 +8,8 @@
 #include <variant>
 #include <optional>
 #include <set> // Added for breakpoints
+#include "interpreter/value.h"
+#include "interpreter/host_function.h"
 
 namespace basic {
 
@@ -18,15 +20,20 @@ class Lexer;
 class Runtime;
 class Variables;
 class Functions;
-
-// Value types
-using Value = std::variant<int, double, std::string, bool>;
+class OutputSink;
+class Program;
+class DebugHook;
+class MemoryAccount;
+class AllocationProfile;
+class CoverageMap;
+class TraceRecorder;
 
 // Token types
 enum class TokenType {
     // Keywords
     LET, IF, THEN, ELSE, FOR, TO, STEP, NEXT, WHILE, WEND, DO, LOOP, UNTIL,
-    SUB, END, FUNCTION, RETURN, PRINT, INPUT, READ, DATA, RESTORE, DIM,
+    SUB, END, FUNCTION, RETURN, PRINT, INPUT, READ, DATA, RESTORE, DIM, SORT, BY, DICT,
+    RANDOMIZE, RNDFILL, USING,
     
     // Operators
     PLUS, MINUS, MULTIPLY, DIVIDE, MOD, POWER,
@@ -61,7 +68,8 @@ enum class NodeType {
     NEXT_STATEMENT,
     PRINT_STATEMENT, INPUT_STATEMENT, FUNCTION_CALL, SUB_CALL,
     BINARY_EXPRESSION, UNARY_EXPRESSION, LITERAL, IDENTIFIER,
-    VARIABLE_DECLARATION, ARRAY_ACCESS
+    VARIABLE_DECLARATION, ARRAY_ACCESS, SORT_STATEMENT, DICT_DECLARATION,
+    RANDOMIZE_STATEMENT, RNDFILL_STATEMENT, ARRAY_REFERENCE
 };
 
 // AST Node base class
@@ -83,9 +91,22 @@ public:
     
     // Main execution methods
     bool loadProgram(const std::string& source);
+    // Runs an already compiled program; it can be shared with other interpreters
+    bool loadProgram(std::shared_ptr<const Program> program);
+    std::shared_ptr<const Program> getProgram() const;
+    // Swaps in an edited source while paused, keeping variables, open FOR
+    // loops and the current position. Only the changed lines are compiled.
+    // Fails (see getLastError) if a changed line does not compile, the edit
+    // adds or removes FOR/NEXT, or it rewrites the FOR of a running loop.
+    bool patchProgram(const std::string& source);
     bool execute();
     bool executeLine(const std::string& line);
     
+    // Forgets variables, arrays, loops and RND state so the loaded program can
+    // run again as if on a fresh interpreter. Host functions, the debug hook
+    // and the output sink are kept.
+    void reset();
+    
     // Debugging support
     void setBreakpoint(int line);
     void removeBreakpoint(int line);
@@ -98,10 +119,18 @@ public:
     void setVariable(const std::string& name, const Value& value);
     Value getVariable(const std::string& name);
     std::map<std::string, Value> getAllVariables();
+    const Variables* getVariables() const;
+    Variables* getVariables();
     
     // Function management
     void defineFunction(const std::string& name, const std::string& body);
     Value callFunction(const std::string& name, const std::vector<Value>& args);
+    void bindFunction(const std::string& name, HostFunction function);
+    // Typed registration, e.g. registerFunction("PRICE", [](double, int) -> double {...})
+    template <typename F>
+    void registerFunction(const std::string& name, F function) {
+        bindFunction(name, makeHostFunction(name, std::move(function)));
+    }
     
     // Runtime state
     bool isRunning() const;
@@ -114,15 +143,45 @@ public:
 
     Value evaluateExpression(const std::string& expr);
     void cleanup();
+
+    // Output (PRINT) destination; defaults to a synchronous std::cout writer
+    void setOutputSink(std::unique_ptr<OutputSink> sink);
+    OutputSink* getOutputSink() const;
+    void flushOutput();
+    
+    // Debugger notified of each statement and of all output (may be null)
+    void setDebugHook(DebugHook* hook);
+    
+    // Memory held by the program's arrays, dictionaries, strings and loop
+    // blocks. Going over the limit (0 = none) is a runtime error.
+    struct MemoryUsage {
+        size_t live;
+        size_t peak;
+        size_t limit;
+    };
+    void setMemoryLimit(size_t bytes);
+    MemoryUsage getMemoryUsage() const;
+    // Attributes the program's allocations to source lines (null stops it)
+    void setAllocationProfile(AllocationProfile* profile);
+    // Records executed lines and IF outcomes; the map must have been built
+    // for the loaded program (null stops it)
+    void setCoverage(CoverageMap* coverage);
+    // Records the executed lines and variable writes for replay in the
+    // debugger (null stops it)
+    void setTrace(TraceRecorder* trace);
 private:
+    std::unique_ptr<MemoryAccount> memory_;
     std::unique_ptr<Parser> parser_;
     std::unique_ptr<Lexer> lexer_;
     std::unique_ptr<Runtime> runtime_;
     std::unique_ptr<Variables> variables_;
     std::unique_ptr<Functions> functions_;
+    std::unique_ptr<OutputSink> output_;
+    DebugHook* debugHook_;
+    CoverageMap* coverage_;
+    TraceRecorder* trace_;
     
-    std::string source_;
-    std::vector<std::string> lines_;
+    std::shared_ptr<const Program> program_;
     int currentLine_;
     bool running_;
     std::string lastError_;
@@ -131,6 +190,9 @@ private:
     bool debugging_;
     std::set<int> breakpoints_;
     bool paused_;
+    
+    bool executeProgramLine(size_t index);
+    bool executeStatement(const ASTNode* statement);
 };
 
 } // namespace basic 
\ No newline at end of file
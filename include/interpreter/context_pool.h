@@ -0,0 +1,68 @@
+#pragma once
+
+#include "interpreter/basic_interpreter.h"
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace basic {
+
+class Program;
+
+// Recycles interpreters that all run the same compiled program. A context
+// is reset when it comes back, which only clears what the previous run
+// created, so acquiring one is far cheaper than building and loading a new
+// interpreter. acquire() and lease release may be called from any thread.
+class ContextPool {
+public:
+    // Called once for every new context, e.g. to bind host functions or
+    // install an output sink
+    using Setup = std::function<void(BasicInterpreter&)>;
+
+    // Exclusive use of one context; returns it to the pool when destroyed
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other) noexcept;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease();
+
+        BasicInterpreter* get() const { return context_.get(); }
+        BasicInterpreter* operator->() const { return context_.get(); }
+        BasicInterpreter& operator*() const { return *context_; }
+        explicit operator bool() const { return context_ != nullptr; }
+
+        void release();
+
+    private:
+        friend class ContextPool;
+        Lease(ContextPool* pool, std::unique_ptr<BasicInterpreter> context);
+
+        ContextPool* pool_ = nullptr;
+        std::unique_ptr<BasicInterpreter> context_;
+    };
+
+    explicit ContextPool(std::shared_ptr<const Program> program, Setup setup = nullptr,
+                         size_t maxIdle = 64);
+
+    Lease acquire();
+
+    const std::shared_ptr<const Program>& program() const { return program_; }
+    size_t idleCount() const;
+
+private:
+    std::shared_ptr<const Program> program_;
+    Setup setup_;
+    size_t maxIdle_;
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<BasicInterpreter>> idle_;
+
+    void giveBack(std::unique_ptr<BasicInterpreter> context);
+};
+
+} // namespace basic
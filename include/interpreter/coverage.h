@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace basic {
+
+class Program;
+
+// Statement and IF branch coverage for one compiled program (see
+// --coverage). Every statement line and both outcomes of every IF own one
+// byte, so recording is a single plain store. Maps of the same program from
+// separate runs combine with a bytewise OR.
+class CoverageMap {
+public:
+    explicit CoverageMap(const Program& program);
+
+    void hitLine(size_t index) { lines_[index] = 1; }
+    void hitBranch(int branch, bool taken) { branches_[2 * static_cast<size_t>(branch) + (taken ? 0 : 1)] = 1; }
+
+    // Throws if other was collected for a different program
+    void merge(const CoverageMap& other);
+
+    // Raw map, for merging runs made by separate processes. load() ORs the
+    // file into this map and returns false if it is missing or belongs to
+    // another program.
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+
+    // Reports; sourcePath is the name recorded for the program file
+    void writeLcov(std::ostream& out, const std::string& sourcePath) const;
+    void writeCobertura(std::ostream& out, const std::string& sourcePath) const;
+    // Per-line state for the language server:
+    // {"version":1,"source":"...","lines":[{"line":N,"state":"covered"|"partial"|"uncovered"}]}
+    void writeDecorations(std::ostream& out, const std::string& sourcePath) const;
+
+private:
+    const Program& program_;
+    std::vector<uint8_t> lines_;
+    std::vector<uint8_t> branches_;
+
+    struct Totals {
+        size_t lines = 0;
+        size_t linesHit = 0;
+        size_t branches = 0;
+        size_t branchesHit = 0;
+    };
+    Totals totals() const;
+    // Branch outcomes per program line index: (taken, total)
+    std::vector<std::pair<size_t, size_t>> branchesByLine() const;
+};
+
+} // namespace basic
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+
+namespace basic {
+
+// Splits one delimited record into fields (RFC 4180 quoting). Fields are
+// views into the input line; only quoted fields containing "" escapes are
+// unescaped into an internal buffer. Views stay valid until the next split().
+class FieldSplitter {
+public:
+    explicit FieldSplitter(char delimiter = ',');
+
+    const std::vector<std::string_view>& split(std::string_view line);
+    void setDelimiter(char delimiter) { delimiter_ = delimiter; }
+    char delimiter() const { return delimiter_; }
+
+private:
+    char delimiter_;
+    std::vector<std::string_view> fields_;
+    std::vector<size_t> positions_;
+    std::string scratch_;
+
+    void splitQuoted(std::string_view line);
+};
+
+// Buffered CSV file reader, one record per next(). Quoted fields may span
+// lines. Records that fit in the read buffer are split in place.
+class CsvReader {
+public:
+    explicit CsvReader(const std::string& path, char delimiter = ',');
+
+    bool isOpen() const;
+    bool next();
+    const std::vector<std::string_view>& fields() const { return *fields_; }
+
+private:
+    std::ifstream file_;
+    std::string buffer_;
+    size_t pos_;
+    std::string record_;
+    FieldSplitter splitter_;
+    const std::vector<std::string_view>* fields_;
+
+    bool fillBuffer();
+};
+
+} // namespace basic
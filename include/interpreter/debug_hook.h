@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+
+namespace basic {
+
+// Debugger attached to an interpreter (the DAP server in the main
+// executable). The runtime reports every statement and all program output
+// through it while isAttached() is true.
+class DebugHook {
+public:
+    virtual ~DebugHook() = default;
+
+    virtual bool isAttached() const = 0;
+    virtual void onStatement(int line) = 0;
+    virtual void onOutput(const std::string& text) = 0;
+};
+
+} // namespace basic
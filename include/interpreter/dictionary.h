@@ -0,0 +1,63 @@
+#pragma once
+
+#include "interpreter/basic_interpreter.h"
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+namespace basic {
+
+class MemoryAccount;
+
+// DICT: open-addressing hash table with Robin Hood probing and backward-shift
+// deletion. Keys are strings or numbers (1 and 1.0 are the same key); keys,
+// values and the key hash are stored inline in one flat slot array.
+class Dictionary {
+public:
+    // With an account, the slot table is allocated from it and string keys
+    // and values are charged to it
+    explicit Dictionary(MemoryAccount* memory = nullptr);
+    Dictionary(Dictionary&& other) noexcept;
+    Dictionary(const Dictionary&) = delete;
+    Dictionary& operator=(const Dictionary&) = delete;
+    Dictionary& operator=(Dictionary&&) = delete;
+    ~Dictionary();
+
+    const Value* find(const Value& key) const;
+    void set(const Value& key, const Value& value);
+    bool erase(const Value& key);
+    void clear();
+    size_t size() const { return size_; }
+
+    // Visits entries in slot order
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        for (const Slot& slot : slots_) {
+            if (slot.distance != 0) fn(slot.key, slot.value);
+        }
+    }
+
+private:
+    struct Slot {
+        Value key;
+        Value value;
+        uint32_t hash = 0;
+        uint32_t distance = 0; // probe distance + 1, 0 marks an empty slot
+    };
+
+    std::pmr::vector<Slot> slots_;
+    size_t size_;
+    size_t mask_;
+    MemoryAccount* memory_;
+    size_t stringBytes_;
+
+    static Value normalizeKey(const Value& key);
+    static uint32_t hashKey(const Value& key);
+    size_t findSlot(const Value& key, uint32_t hash) const;
+    void insertNew(Slot slot);
+    void grow();
+    void charge(size_t bytes);
+    void release(size_t bytes);
+};
+
+} // namespace basic
@@ -1,9 +1,12 @@
 #pragma once
 
 #include "interpreter/basic_interpreter.h"
+#include "interpreter/csv_reader.h"
+#include "interpreter/random.h"
 #include <map>
 #include <string>
 #include <vector>
+#include <optional>
 
 namespace basic {
 
@@ -18,12 +21,42 @@ public:
     std::map<std::string, std::string> getAll() const;
     void clear();
     bool exists(const std::string& name) const;
+    bool isBuiltin(const std::string& name) const;
+    // Whether argument `index` of built-in `name` is a whole array or
+    // dictionary, written A(). The parser makes it an ArrayReferenceNode and
+    // the built-in receives its name.
+    static bool takesArray(const std::string& name, size_t index);
+    
+    // Functions supplied by an embedding application. Built-in names cannot
+    // be rebound; bindings survive clear() and reset().
+    void bindHost(const std::string& name, HostFunction function);
+    template <typename F>
+    void registerFunction(const std::string& name, F function) {
+        bindHost(name, makeHostFunction(name, std::move(function)));
+    }
+    // Stable until the binding is replaced; hostGeneration() changes then
+    const HostFunction* findHost(const std::string& name) const;
+    unsigned hostGeneration() const { return hostGeneration_; }
+    bool hasHostFunctions() const { return !hostFunctions_.empty(); }
+    
+    // Back to the state of a fresh interpreter, keeping host functions
+    void reset();
+    
+    // RND state, private to this interpreter
+    Random& getRandom() { return random_; }
+    void randomize();
+    void randomize(const Value& seed);
     
 private:
     std::map<std::string, std::string> functions_;
+    std::map<std::string, HostFunction> hostFunctions_;
+    unsigned hostGeneration_ = 0;
+    FieldSplitter splitter_;
+    Random random_;
+    double lastRandom_;
     
     // Built-in functions
-    Value callBuiltin(const std::string& name, const std::vector<Value>& args);
+    std::optional<Value> callBuiltin(const std::string& name, const std::vector<Value>& args, Variables* variables);
     Value abs(const std::vector<Value>& args);
     Value sin(const std::vector<Value>& args);
     Value cos(const std::vector<Value>& args);
@@ -31,12 +64,34 @@ private:
     Value sqrt(const std::vector<Value>& args);
     Value log(const std::vector<Value>& args);
     Value exp(const std::vector<Value>& args);
+    Value rnd(const std::vector<Value>& args);
     Value len(const std::vector<Value>& args);
     Value mid(const std::vector<Value>& args);
     Value left(const std::vector<Value>& args);
     Value right(const std::vector<Value>& args);
     Value val(const std::vector<Value>& args);
     Value str(const std::vector<Value>& args);
+    Value instr(const std::vector<Value>& args);
+    Value ucase(const std::vector<Value>& args);
+    Value lcase(const std::vector<Value>& args);
+    Value trim(const std::vector<Value>& args, bool left, bool right, const char* function);
+    Value replace(const std::vector<Value>& args);
+    Value strcomp(const std::vector<Value>& args);
+    
+    // Delimited record parsing
+    Value field(const std::vector<Value>& args);
+    Value split(const std::vector<Value>& args, Variables* variables);
+    Value csvread(const std::vector<Value>& args, Variables* variables);
+    
+    // Sorted arrays
+    Value bsearch(const std::vector<Value>& args, Variables* variables);
+    
+    // Dictionaries
+    Value dictSet(const std::vector<Value>& args, Variables* variables);
+    Value dictGet(const std::vector<Value>& args, Variables* variables);
+    Value dictHas(const std::vector<Value>& args, Variables* variables);
+    Value dictDel(const std::vector<Value>& args, Variables* variables);
+    Value dictKeys(const std::vector<Value>& args, Variables* variables);
 };
 
 } // namespace basic 
\ No newline at end of file
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "interpreter/value.h"
+#include <cstddef>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace basic {
+
+namespace host_detail {
+
+// Parameter and result types of a function pointer, lambda or functor
+template <typename F>
+struct Signature : Signature<decltype(&F::operator())> {};
+
+template <typename R, typename... A>
+struct Signature<R (*)(A...)> {
+    using Result = R;
+    using Args = std::tuple<std::decay_t<A>...>;
+};
+
+template <typename C, typename R, typename... A>
+struct Signature<R (C::*)(A...)> : Signature<R (*)(A...)> {};
+
+template <typename C, typename R, typename... A>
+struct Signature<R (C::*)(A...) const> : Signature<R (*)(A...)> {};
+
+[[noreturn]] inline void argumentError(const std::string& name, size_t index, const char* expected) {
+    throw std::runtime_error(name + " argument " + std::to_string(index + 1) + " must be " + expected);
+}
+
+template <typename T>
+struct Arg;
+
+template <>
+struct Arg<double> {
+    static double get(const Value& value, const std::string& name, size_t index) {
+        if (const int* i = std::get_if<int>(&value)) return *i;
+        if (const double* d = std::get_if<double>(&value)) return *d;
+        if (const bool* b = std::get_if<bool>(&value)) return *b ? 1 : 0;
+        argumentError(name, index, "numeric");
+    }
+};
+
+template <>
+struct Arg<float> {
+    static float get(const Value& value, const std::string& name, size_t index) {
+        return static_cast<float>(Arg<double>::get(value, name, index));
+    }
+};
+
+// Truncates like an array subscript
+template <>
+struct Arg<int> {
+    static int get(const Value& value, const std::string& name, size_t index) {
+        if (const int* i = std::get_if<int>(&value)) return *i;
+        if (const double* d = std::get_if<double>(&value)) return static_cast<int>(*d);
+        if (const bool* b = std::get_if<bool>(&value)) return *b ? 1 : 0;
+        argumentError(name, index, "numeric");
+    }
+};
+
+template <>
+struct Arg<bool> {
+    static bool get(const Value& value, const std::string& name, size_t index) {
+        return Arg<double>::get(value, name, index) != 0;
+    }
+};
+
+template <>
+struct Arg<std::string> {
+    static const std::string& get(const Value& value, const std::string& name, size_t index) {
+        if (const std::string* s = std::get_if<std::string>(&value)) return *s;
+        argumentError(name, index, "a string");
+    }
+};
+
+template <>
+struct Arg<Value> {
+    static const Value& get(const Value& value, const std::string&, size_t) { return value; }
+};
+
+template <typename R>
+Value result(R&& value) {
+    using T = std::decay_t<R>;
+    if constexpr (std::is_same_v<T, bool>) return Value{value};
+    else if constexpr (std::is_integral_v<T>) return Value{static_cast<int>(value)};
+    else if constexpr (std::is_floating_point_v<T>) return Value{static_cast<double>(value)};
+    else if constexpr (std::is_convertible_v<T, std::string>) return Value{std::string(std::forward<R>(value))};
+    else return Value{std::forward<R>(value)};
+}
+
+template <typename F, typename Args, size_t... I>
+Value invoke(F& function, const std::string& name, const std::vector<Value>& args,
+             std::index_sequence<I...>) {
+    using R = decltype(function(Arg<std::tuple_element_t<I, Args>>::get(args[I], name, I)...));
+    if constexpr (std::is_void_v<R>) {
+        function(Arg<std::tuple_element_t<I, Args>>::get(args[I], name, I)...);
+        return Value{0};
+    } else {
+        return result(function(Arg<std::tuple_element_t<I, Args>>::get(args[I], name, I)...));
+    }
+}
+
+} // namespace host_detail
+
+// Wraps a typed C++ callable, e.g. [](double price, int qty) { ... }, in a
+// HostFunction. The argument unpacking is generated at compile time; each
+// call only checks the argument count and converts the values in place.
+// Parameters may be double, float, int, bool, std::string or Value (by value
+// or const reference); results may be any of those or void (returns 0).
+// A callable that already takes const std::vector<Value>& is used as is.
+template <typename F>
+HostFunction makeHostFunction(const std::string& name, F function) {
+    if constexpr (std::is_invocable_r_v<Value, F&, const std::vector<Value>&>) {
+        return HostFunction(std::move(function));
+    } else {
+        using Args = typename host_detail::Signature<std::decay_t<F>>::Args;
+        constexpr size_t arity = std::tuple_size_v<Args>;
+        return [name, function = std::move(function)](const std::vector<Value>& args) mutable -> Value {
+            if (args.size() != arity) {
+                throw std::runtime_error(name + " function requires exactly " + std::to_string(arity) +
+                                         (arity == 1 ? " argument" : " arguments"));
+            }
+            return host_detail::invoke<F, Args>(function, name, args, std::make_index_sequence<arity>{});
+        };
+    }
+}
+
+} // namespace basic
@@ -15,8 +15,9 @@ public:
     std::string tokenTypeToString(TokenType type);
 
 private:
-    std::map<std::string, TokenType> keywords_;
-    void setupKeywords();
+    // One read-only table shared by every lexer
+    const std::map<std::string, TokenType>& keywords_;
+    static const std::map<std::string, TokenType>& keywordTable();
 };
 
 } // namespace basic 
\ No newline at end of file
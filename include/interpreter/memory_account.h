@@ -0,0 +1,60 @@
+#pragma once
+
+#include "interpreter/value.h"
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+
+namespace basic {
+
+class AllocationProfile;
+
+// Per-interpreter memory accounting. Containers owned by a running program
+// (array storage, dictionary tables) allocate through this resource, and the
+// heap bytes of stored strings and loop blocks are charged explicitly. An
+// allocation or charge that would take live usage past the limit throws a
+// BASIC runtime error.
+//
+// One interpreter runs on one thread, so the counters have a single writer:
+// they are atomics only so a debugger thread can read them, and updates are
+// plain relaxed loads and stores with no contention.
+class MemoryAccount : public std::pmr::memory_resource {
+public:
+    static constexpr size_t kUnlimited = 0;
+
+    explicit MemoryAccount(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+
+    // 0 removes the limit
+    void setLimit(size_t bytes) { limit_.store(bytes, std::memory_order_relaxed); }
+    size_t limit() const { return limit_.load(std::memory_order_relaxed); }
+    size_t live() const { return live_.load(std::memory_order_relaxed); }
+    size_t peak() const { return peak_.load(std::memory_order_relaxed); }
+    void resetPeak() { peak_.store(live(), std::memory_order_relaxed); }
+
+    void charge(size_t bytes);
+    void release(size_t bytes);
+
+    // Allocation profiling: while a profile is set, every charge is recorded
+    // against the source line last passed to setLine()
+    void setProfile(AllocationProfile* profile) { profile_ = profile; }
+    void setLine(int line) { line_ = line; }
+
+    // Heap bytes charged for a value: a string's length once it outgrows the
+    // small-string storage, otherwise 0. Length rather than capacity, because
+    // moving strings between slots can exchange their buffers.
+    static size_t heapBytes(const Value& value);
+
+private:
+    std::pmr::memory_resource* upstream_;
+    std::atomic<size_t> limit_;
+    std::atomic<size_t> live_;
+    std::atomic<size_t> peak_;
+    AllocationProfile* profile_ = nullptr;
+    int line_ = 0;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
+
+} // namespace basic
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <ostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+namespace basic {
+
+// Destination for PRINT output. Writes may be buffered; flush() blocks until
+// everything written so far has reached the underlying stream or file.
+class OutputSink {
+public:
+    virtual ~OutputSink() = default;
+
+    virtual void write(const char* data, size_t size) = 0;
+    virtual void flush() = 0;
+
+    void write(const std::string& text) { write(text.data(), text.size()); }
+};
+
+// Synchronous writer on top of a std::ostream (the default: std::cout)
+class StreamOutputSink : public OutputSink {
+public:
+    explicit StreamOutputSink(std::ostream& out);
+    explicit StreamOutputSink(std::unique_ptr<std::ostream> out);
+
+    void write(const char* data, size_t size) override;
+    void flush() override;
+
+private:
+    std::unique_ptr<std::ostream> ownedStream_;
+    std::ostream& out_;
+};
+
+// Collects output in memory, for embedding applications that want a run's
+// output as a string
+class BufferOutputSink : public OutputSink {
+public:
+    void write(const char* data, size_t size) override;
+    void flush() override {}
+
+    const std::string& contents() const { return buffer_; }
+    void clear() { buffer_.clear(); }
+
+private:
+    std::string buffer_;
+};
+
+// Portable asynchronous writer. The interpreter fills one page while a
+// background thread writes the other one to the stream.
+class AsyncOutputSink : public OutputSink {
+public:
+    explicit AsyncOutputSink(std::ostream& out, size_t pageSize = 64 * 1024);
+    AsyncOutputSink(std::unique_ptr<std::ostream> out, size_t pageSize = 64 * 1024);
+    ~AsyncOutputSink() override;
+
+    void write(const char* data, size_t size) override;
+    void flush() override;
+
+private:
+    std::unique_ptr<std::ostream> ownedStream_;
+    std::ostream& out_;
+    size_t pageSize_;
+
+    std::vector<char> fillPage_;
+    std::vector<char> writePage_;
+    bool writePending_;
+    bool stopping_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable drained_;
+    std::thread writer_;
+
+    void submitFillPage();
+    void writerLoop();
+};
+
+#ifdef BASIC_HAVE_IO_URING
+// Linux io_uring writer. Full pages are submitted as IORING_OP_WRITE requests
+// and reaped at the next page switch or flush, so the interpreter never waits
+// on the write() syscall itself.
+class IoUringOutputSink : public OutputSink {
+public:
+    ~IoUringOutputSink() override;
+
+    // Returns nullptr when io_uring is unavailable (old kernel, seccomp, ...)
+    static std::unique_ptr<IoUringOutputSink> create(int fd, bool ownsFd, size_t pageSize = 64 * 1024);
+
+    void write(const char* data, size_t size) override;
+    void flush() override;
+
+private:
+    IoUringOutputSink(int fd, bool ownsFd, size_t pageSize);
+    bool setup();
+    void submitFillPage();
+    void waitForPending();
+
+    int fd_;
+    bool ownsFd_;
+    size_t pageSize_;
+
+    std::vector<char> pages_[2];
+    int fillIndex_;
+    size_t pendingSize_;
+    bool pending_;
+
+    // Ring state
+    int ringFd_;
+    void* sqRing_;
+    void* cqRing_;
+    void* sqes_;
+    size_t sqRingSize_;
+    size_t cqRingSize_;
+    size_t sqesSize_;
+    unsigned* sqHead_;
+    unsigned* sqTail_;
+    unsigned* sqMask_;
+    unsigned* sqArray_;
+    unsigned* cqHead_;
+    unsigned* cqTail_;
+    unsigned* cqMask_;
+    void* cqes_;
+};
+#endif
+
+// Opens `path` for writing and returns the fastest writer available:
+// io_uring when compiled in and supported by the kernel, otherwise the
+// thread-based writer. With async == false a plain synchronous writer is used.
+std::unique_ptr<OutputSink> createFileOutputSink(const std::string& path, bool async);
+
+// Same selection for the process standard output
+std::unique_ptr<OutputSink> createStdoutSink(bool async);
+
+} // namespace basic
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "interpreter/basic_interpreter.h"
+#include "interpreter/print_using.h"
 #include <memory>
 #include <vector>
 
@@ -26,17 +27,77 @@ public:
 class LetStatementNode : public ASTNode {
 public:
     std::string variableName;
+    std::vector<std::unique_ptr<ASTNode>> indices; // set for A(I) = ...
     std::unique_ptr<ASTNode> value;
     
     NodeType getType() const override { return NodeType::LET_STATEMENT; }
     std::string toString() const override;
 };
 
+class DimStatementNode : public ASTNode {
+public:
+    struct Declaration {
+        std::string name;
+        std::vector<std::unique_ptr<ASTNode>> bounds;
+    };
+    std::vector<Declaration> declarations;
+    
+    NodeType getType() const override { return NodeType::VARIABLE_DECLARATION; }
+    std::string toString() const override;
+};
+
+class DictStatementNode : public ASTNode {
+public:
+    std::vector<std::string> names;
+    
+    NodeType getType() const override { return NodeType::DICT_DECLARATION; }
+    std::string toString() const override;
+};
+
+// RANDOMIZE [seed]: reseeds RND; without a seed one is taken from the system
+class RandomizeStatementNode : public ASTNode {
+public:
+    std::unique_ptr<ASTNode> seed;
+    
+    NodeType getType() const override { return NodeType::RANDOMIZE_STATEMENT; }
+    std::string toString() const override;
+};
+
+// RNDFILL A(): fills A with uniform [0, 1) values
+class RndFillStatementNode : public ASTNode {
+public:
+    std::string arrayName;
+    
+    NodeType getType() const override { return NodeType::RNDFILL_STATEMENT; }
+    std::string toString() const override;
+};
+
+// SORT A() [BY K()]: sorts A, or sorts K and reorders A alongside it
+class SortStatementNode : public ASTNode {
+public:
+    std::string arrayName;
+    std::string keyArrayName;
+    
+    NodeType getType() const override { return NodeType::SORT_STATEMENT; }
+    std::string toString() const override;
+};
+
+// A() passed whole to a built-in, e.g. SPLIT(R$, A()). Only parsed where
+// Functions::takesArray says the argument is an array or dictionary.
+class ArrayReferenceNode : public ASTNode {
+public:
+    std::string arrayName;
+    
+    NodeType getType() const override { return NodeType::ARRAY_REFERENCE; }
+    std::string toString() const override;
+};
+
 class IfStatementNode : public ASTNode {
 public:
     std::unique_ptr<ASTNode> condition;
     std::unique_ptr<ASTNode> thenStatement;
     std::unique_ptr<ASTNode> elseStatement;
+    int branchIndex = -1; // coverage slot, numbered by Program::compile
     
     NodeType getType() const override { return NodeType::IF_STATEMENT; }
     std::string toString() const override;
@@ -72,6 +133,10 @@ public:
 class PrintStatementNode : public ASTNode {
 public:
     std::vector<std::unique_ptr<ASTNode>> expressions;
+    std::unique_ptr<ASTNode> usingFormat; // PRINT USING fmt$; ...
+    // Compiled at parse time when usingFormat is a string literal, so the
+    // node stays read-only while a shared program runs
+    std::unique_ptr<PrintUsingTemplate> usingTemplate;
     
     NodeType getType() const override { return NodeType::PRINT_STATEMENT; }
     std::string toString() const override;
@@ -151,6 +216,12 @@ private:
     std::unique_ptr<ASTNode> parseWhileStatement();
     std::unique_ptr<ASTNode> parsePrintStatement();
     std::unique_ptr<ASTNode> parseInputStatement();
+    std::unique_ptr<ASTNode> parseDimStatement();
+    std::unique_ptr<ASTNode> parseSortStatement();
+    std::unique_ptr<ASTNode> parseDictStatement();
+    std::unique_ptr<ASTNode> parseRandomizeStatement();
+    std::unique_ptr<ASTNode> parseRndFillStatement();
+    std::string parseArrayReference(const char* statement);
     std::unique_ptr<ASTNode> parseExpression();
     std::unique_ptr<ASTNode> parseTerm();
     std::unique_ptr<ASTNode> parseFactor();
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "interpreter/basic_interpreter.h"
+#include <string>
+#include <vector>
+
+namespace basic {
+
+// Compiled PRINT USING format. The format string is parsed once into literal
+// runs and fields; apply() then writes values straight into the caller's
+// line buffer.
+//
+// Numeric fields: # digit, . decimal point, , thousands separators,
+// leading/trailing + sign, trailing - for negatives, ** asterisk fill, $$
+// floating dollar sign (**$ combines both), ^^^^ (or ^^^^^) after the digits
+// for E+nn (E+nnn) notation, where one leading digit position is kept for
+// the sign unless the field has its own. A value that does not fit is
+// printed in full after a %.
+// String fields: ! first character, & whole string, \  \ fixed width of two
+// plus the number of spaces between the backslashes. _ prints the next
+// character literally.
+class PrintUsingTemplate {
+public:
+    explicit PrintUsingTemplate(const std::string& format);
+
+    const std::string& format() const { return format_; }
+
+    // Fields are reused from the start while values remain; output stops at
+    // the first field after the values run out
+    void apply(const std::vector<Value>& values, std::string& out) const;
+
+private:
+    enum class ItemKind { Literal, Number, FirstChar, WholeString, FixedString };
+
+    struct NumberField {
+        int intDigits = 0;
+        int fracDigits = 0;
+        bool point = false;
+        bool commas = false;
+        bool asteriskFill = false;
+        bool dollar = false;
+        bool leadingSign = false;
+        char trailingSign = 0; // '+', '-' or 0
+        int exponentDigits = 0; // 2 for ^^^^, 3 for ^^^^^
+    };
+
+    struct Item {
+        explicit Item(ItemKind kind) : kind(kind) {}
+
+        ItemKind kind;
+        std::string text;  // Literal
+        int width = 0;     // FixedString
+        NumberField number;
+    };
+
+    std::string format_;
+    std::vector<Item> items_;
+    bool hasFields_;
+
+    size_t parseNumberField(size_t pos, NumberField& field) const;
+    static void writeNumber(const NumberField& field, double value, std::string& out);
+    static void writeExponent(const NumberField& field, double value, int width, std::string& out);
+    static void writeString(const Item& item, const Value& value, std::string& out);
+};
+
+} // namespace basic
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "interpreter/basic_interpreter.h"
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace basic {
+
+// A program lexed and parsed once, line by line. A compiled Program is never
+// modified while it runs, so one instance can be shared by any number of
+// interpreters, including ones running on different threads.
+class Program {
+public:
+    struct Line {
+        std::string text;                   // as written, with its line number
+        std::shared_ptr<ASTNode> statement; // null when there is nothing to run
+        std::string error;                  // set when the line failed to compile
+        std::string include;                // file named by INCLUDE "file", until linked
+    };
+
+    static std::shared_ptr<const Program> compile(const std::string& source);
+
+    // A program split over files. path is the main module; each INCLUDE
+    // "file" line (relative to the file it is in) is followed by that
+    // file's lines. Every module is compiled on its own, in parallel and
+    // through ProgramCache, so relinking after an edit only recompiles the
+    // files whose text changed. An unreadable file or an include cycle
+    // sets error(). Without INCLUDE lines this is the main module itself.
+    using ModuleLoader = std::function<std::optional<std::string>(const std::string& path)>;
+    static std::shared_ptr<const Program> link(const std::string& path, const ModuleLoader& load);
+    static std::optional<std::string> readFile(const std::string& path);
+
+    struct Module {
+        std::string path;
+        std::shared_ptr<const Program> program;
+    };
+    struct Location {
+        size_t module; // index in modules()
+        int line;      // 1-based, in that module
+    };
+    // Files of a linked program, the main module first; empty for one file
+    const std::vector<Module>& modules() const { return modules_; }
+    // Where 1-based line of this program came from
+    Location location(int line) const;
+    // 1-based lines of this program that came from line of modules()[module];
+    // more than one when the module is included more than once
+    std::vector<int> linesOf(size_t module, int line) const;
+    // Index in modules() of path, -1 when it is not one of them
+    int moduleIndex(const std::string& path) const;
+
+    // base edited into source. Lines are matched by a line diff; only the
+    // new or changed ones are compiled, the rest share base's ASTs.
+    struct Patch {
+        std::shared_ptr<const Program> program;
+        // Index in program of each line of base, -1 when the edit replaced it
+        std::vector<int> lineMap;
+        // Indices of the lines of program that were compiled
+        std::vector<size_t> compiled;
+
+        int mapLine(int index) const;
+    };
+    static Patch patch(const std::shared_ptr<const Program>& base, const std::string& source);
+
+    // "10 PRINT X" -> "PRINT X"
+    static std::string stripLineNumber(const std::string& line);
+
+    const std::string& source() const { return source_; }
+    size_t hash() const { return hash_; }
+    const std::vector<Line>& lines() const { return lines_; }
+    size_t size() const { return lines_.size(); }
+    bool empty() const { return lines_.empty(); }
+
+    // Approximate bytes held: the text, the line table and an estimate of
+    // the ASTs from the length of the compiled lines
+    size_t memoryUsage() const { return memoryUsage_; }
+
+    // Load error, the first line the lexer rejected; empty when the program
+    // loaded cleanly
+    const std::string& error() const { return error_; }
+
+    // IF statements in source order; branchLine(i) is the 1-based line of
+    // the IF whose branchIndex is i. In a patched program the IFs of replaced
+    // lines keep their slots with line 0 and new ones are numbered after them.
+    size_t branchCount() const { return branchLines_.size(); }
+    int branchLine(size_t index) const { return branchLines_[index]; }
+
+    // 1-based line of the first statement at or after line, 0 when none
+    // follows. Blank and comment lines have no statement to stop on.
+    int nextStatementLine(int line) const;
+
+private:
+    Program() = default;
+
+    std::string source_;
+    size_t hash_ = 0;
+    std::vector<Line> lines_;
+    std::string error_;
+    std::vector<int> branchLines_;
+    std::vector<int> statementLines_; // ascending, 1-based
+    std::vector<Module> modules_;
+    std::vector<Location> locations_; // per line, when linked
+    size_t memoryUsage_ = 0;
+
+    void indexStatements();
+    void measure();
+    static Line compileLine(Lexer& lexer, Parser& parser, const std::string& text, std::string* lexError = nullptr);
+    void numberBranches(ASTNode* node, int line);
+};
+
+// Compiled programs by source text. Interpreters loading the same source get
+// the same Program, so N concurrent runs of one script hold one copy of its
+// text and ASTs. Entries are weak: a program is freed once its last user
+// lets go. Safe to use from any thread.
+class ProgramCache {
+public:
+    static ProgramCache& shared();
+
+    std::shared_ptr<const Program> get(const std::string& source);
+
+    // Programs currently alive in the cache
+    size_t size();
+    void clear();
+
+private:
+    std::mutex mutex_;
+    std::unordered_multimap<size_t, std::weak_ptr<const Program>> entries_;
+    size_t sweepAt_ = 64;
+
+    void sweep();
+};
+
+} // namespace basic
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace basic {
+
+// xoshiro256** generator behind RND, RANDOMIZE and RNDFILL. Each interpreter
+// owns one, so runs are independent and reproducible from their seed.
+class Random {
+public:
+    static constexpr uint64_t kDefaultSeed = 0x5eed5eed5eed5eedull;
+
+    explicit Random(uint64_t seed = kDefaultSeed);
+
+    void seed(uint64_t seed);
+    uint64_t next();
+    // Uniform in [0, 1)
+    double nextDouble();
+
+    // Bulk uniform [0, 1) values from four interleaved streams (2^128 steps
+    // apart), generated two or four at a time with SSE2/AVX2. The output is
+    // the same on every target.
+    void fill(double* out, size_t count);
+
+    // A generator whose nextDouble() continues bulk stream `index` (0-3) from
+    // where it is now, i.e. the values fill() would write to index,
+    // index + 4, ...
+    Random stream(size_t index) const;
+
+private:
+    uint64_t state_[4];
+    uint64_t lanes_[4][4]; // lanes_[word][stream]
+
+    void startStreams();
+    static void jump(uint64_t state[4]);
+};
+
+} // namespace basic
@@ -2,21 +2,28 @@
 
 #include "interpreter/basic_interpreter.h"
 #include <memory>
+#include <unordered_map>
 
 namespace basic {
 
-// Global functions for DAP integration
-void setInterpreter(BasicInterpreter* interpreter);
-BasicInterpreter* getInterpreter();
-
 // Helper function to convert Value to string for DAP
 std::string valueToString(const Value& value);
 
 // Forward declarations
 class Variables;
 class Functions;
+class OutputSink;
+class DebugHook;
+class MemoryAccount;
+class CoverageMap;
+class PrintUsingTemplate;
 class ProgramNode;
 class LetStatementNode;
+class DimStatementNode;
+class SortStatementNode;
+class DictStatementNode;
+class RandomizeStatementNode;
+class RndFillStatementNode;
 class IfStatementNode;
 class ForStatementNode;
 class NextStatementNode;
@@ -45,12 +52,50 @@ class Runtime {
 public:
     std::vector< std::unique_ptr<RuntimeBlock> > block;
     Runtime();
+    ~Runtime();
     
     Value execute(const ASTNode* node, Variables* variables, Functions* functions);
+    void setOutput(OutputSink* output) { output_ = output; }
+    void setDebugHook(DebugHook* debugHook) { debugHook_ = debugHook; }
+    // Loop blocks are charged to this account
+    void setMemoryAccount(MemoryAccount* memory) { memory_ = memory; }
+    // IF outcomes are recorded here while set
+    void setCoverage(CoverageMap* coverage) { coverage_ = coverage; }
+    
+    // Drops loop state between runs; clearCaches() also forgets per-statement
+    // caches and must be called when the program changes and before running
+    // a one-off statement (its AST may reuse a freed node's address)
+    void reset();
+    void clearCaches();
     
 private:
+    OutputSink* output_ = nullptr;
+    DebugHook* debugHook_ = nullptr;
+    MemoryAccount* memory_ = nullptr;
+    CoverageMap* coverage_ = nullptr;
+    std::string printBuffer_;
+    // Templates for PRINT USING with a computed format, by statement
+    std::unordered_map<const PrintStatementNode*, std::unique_ptr<PrintUsingTemplate>> usingCache_;
+    // Host function each call site resolved to (null: not a host call),
+    // valid while the Functions generation matches
+    struct HostCallSite {
+        const HostFunction* function;
+        unsigned generation;
+    };
+    std::unordered_map<const FunctionCallNode*, HostCallSite> hostCalls_;
+
+    void writeOutput(const std::string& text);
+    void pushBlock(std::unique_ptr<RuntimeBlock> entry);
+    void popBlock();
+    Value executePrintUsing(const PrintStatementNode* node, Variables* variables, Functions* functions);
+
     Value executeProgram(const ProgramNode* node, Variables* variables, Functions* functions);
     Value executeLetStatement(const LetStatementNode* node, Variables* variables, Functions* functions);
+    Value executeDimStatement(const DimStatementNode* node, Variables* variables, Functions* functions);
+    Value executeRandomizeStatement(const RandomizeStatementNode* node, Variables* variables, Functions* functions);
+    Value executeRndFillStatement(const RndFillStatementNode* node, Variables* variables, Functions* functions);
+    Value executeDictStatement(const DictStatementNode* node, Variables* variables, Functions* functions);
+    Value executeSortStatement(const SortStatementNode* node, Variables* variables, Functions* functions);
     Value executeIfStatement(const IfStatementNode* node, Variables* variables, Functions* functions);
     Value executeForStatement(const ForStatementNode* node, Variables* variables, Functions* functions);
     Value executeNextStatement(const NextStatementNode* node, Variables* variables, Functions* functions);
@@ -58,12 +103,14 @@ private:
     Value executePrintStatement(const PrintStatementNode* node, Variables* variables, Functions* functions);
     Value executeInputStatement(const InputStatementNode* node, Variables* variables, Functions* functions);
     Value executeFunctionCall(const FunctionCallNode* node, Variables* variables, Functions* functions);
+    const HostFunction* resolveHostCall(const FunctionCallNode* node, Functions* functions);
     Value executeBinaryExpression(const BinaryExpressionNode* node, Variables* variables, Functions* functions);
     Value executeUnaryExpression(const UnaryExpressionNode* node, Variables* variables, Functions* functions);
     Value executeLiteral(const LiteralNode* node, Variables* variables, Functions* functions);
     Value executeIdentifier(const IdentifierNode* node, Variables* variables, Functions* functions);
     
     // Helper methods
+    std::vector<int> evaluateIndices(const std::vector<std::unique_ptr<ASTNode>>& nodes, Variables* variables, Functions* functions);
     bool isTruthy(const Value& value);
     bool isEqual(const Value& a, const Value& b);
     bool isLessThan(const Value& a, const Value& b);
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+namespace basic {
+namespace simd {
+
+constexpr size_t npos = std::string_view::npos;
+
+// Byte scanning kernels. They process 32 (AVX2) or 16 (SSE2) bytes per step
+// and fall back to a scalar loop on other targets and for the tail. On
+// x86-64 the AVX2 kernels are used when the CPU has AVX2.
+
+// Position of the first `c` in `text` at or after `from`, or npos
+size_t findByte(std::string_view text, char c, size_t from = 0);
+
+// Position of the first byte equal to `a` or `b` at or after `from`, or npos
+size_t findEither(std::string_view text, char a, char b, size_t from = 0);
+
+// Position of the first byte at or after `from` that a JSON string must
+// escape: a quote, a backslash or a control character below 0x20. npos if
+// there is none
+size_t findJsonEscape(std::string_view text, size_t from = 0);
+
+// Position of the first byte >= 0x80 at or after `from`, or npos
+size_t findNonAscii(std::string_view text, size_t from = 0);
+
+// Appends the position of every `c` in `text` to `positions`
+void findAll(std::string_view text, char c, std::vector<size_t>& positions);
+
+// Substring search: position of the first `needle` in `text` at or after
+// `from`, or npos. Candidates are found by matching the first and last
+// needle bytes in parallel and verified with memcmp.
+size_t find(std::string_view text, std::string_view needle, size_t from = 0);
+
+// In-place ASCII case conversion; bytes >= 0x80 are left untouched
+void toUpper(char* data, size_t size);
+void toLower(char* data, size_t size);
+
+// Index of the first / one past the last byte that is not a space, tab,
+// CR or LF
+size_t skipSpace(std::string_view text);
+size_t trimSpaceEnd(std::string_view text);
+
+// Three-way comparisons returning <0, 0 or >0
+int compare(std::string_view a, std::string_view b);
+int compareIgnoreCase(std::string_view a, std::string_view b);
+
+// Kernel set in use: "avx2", "sse2" or "scalar"
+const char* kernelName();
+
+// Turns the AVX2 kernels off, or back on where the CPU has them, to compare
+// kernel sets. Returns whether they are in use afterwards.
+bool setAvx2(bool enabled);
+
+} // namespace simd
+} // namespace basic
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace basic {
+
+// Wall-clock timeline of the interpreter and protocol servers (see
+// --timeline), exported in the Chrome trace-event format that
+// chrome://tracing and Perfetto load.
+//
+// Each thread appends complete events to its own buffer; only the thread
+// that owns a buffer writes to it, so recording takes no lock. Events are
+// kept only between start() and stop(). Building with
+// BASIC_ENABLE_TIMELINE=OFF removes the scopes from the code entirely.
+class Timeline {
+public:
+    static void start();
+    static void stop();
+    static bool enabled();
+    // False when compiled out
+    static bool available();
+
+    // Label for the calling thread in the exported file
+    static void nameThread(const std::string& name);
+
+    // Writes every event recorded so far as {"traceEvents":[...]}
+    static void writeChromeTrace(std::ostream& out);
+    static size_t droppedEvents();
+};
+
+#ifdef BASIC_HAVE_TIMELINE
+
+// Records [construction, destruction) as one event named `name`, which must
+// be a string literal. `detail` (e.g. a request name) is copied, truncated
+// to fit the event.
+class TimelineScope {
+public:
+    explicit TimelineScope(const char* name, const char* detail = nullptr);
+    TimelineScope(const char* name, const std::string& detail) : TimelineScope(name, detail.c_str()) {}
+    ~TimelineScope();
+    TimelineScope(const TimelineScope&) = delete;
+    TimelineScope& operator=(const TimelineScope&) = delete;
+
+    static constexpr size_t kDetailSize = 40;
+
+private:
+    const char* name_;
+    uint64_t start_; // 0 when the timeline was off at construction
+    char detail_[kDetailSize];
+};
+
+#define BASIC_TIMELINE_CONCAT2(a, b) a##b
+#define BASIC_TIMELINE_CONCAT(a, b) BASIC_TIMELINE_CONCAT2(a, b)
+#define BASIC_TIMELINE_SCOPE(...) \
+    ::basic::TimelineScope BASIC_TIMELINE_CONCAT(timelineScope_, __LINE__)(__VA_ARGS__)
+
+#else
+
+#define BASIC_TIMELINE_SCOPE(...) ((void)0)
+
+#endif
+
+} // namespace basic
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "interpreter/value.h"
+#include "interpreter/variables.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace basic {
+
+class OutputSink;
+
+// Execution trace written by --record: the sequence of executed program lines
+// and every write to scalar variables and arrays. Events are varint encoded;
+// a statement whose line is near the previous one costs one byte. A keyframe
+// with the full variable state is written every keyframeInterval statements
+// (and never more often than the deltas since the last one outweigh it), so a
+// reader can reconstruct any point by decoding from the nearest keyframe.
+// Dictionaries are not recorded.
+//
+// The stream goes through an asynchronous file sink, so the disk writes
+// happen off the interpreter thread.
+class TraceRecorder {
+public:
+    // Throws if path cannot be opened
+    TraceRecorder(const std::string& path, const std::string& sourcePath, const std::string& source,
+                  size_t keyframeInterval = 4096);
+    ~TraceRecorder();
+    TraceRecorder(const TraceRecorder&) = delete;
+    TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+    // Called before each program line runs (line is 1-based)
+    void statement(int line, const Variables& variables);
+
+    void set(const std::string& name, const Value& value);
+    void setElement(const std::string& name, size_t offset, const Value& value);
+    void dim(const std::string& name, const std::vector<int>& dims);
+    // Whole array after a bulk write (SPLIT, CSVREAD, KEYS, RNDFILL, SORT)
+    void array(const std::string& name, const Array& array);
+    void clear();
+
+    // Records how the run ended and flushes the file
+    void finish(bool ok, const std::string& error);
+
+    size_t steps() const { return steps_; }
+    size_t bytes() const { return written_ + buffer_.size(); }
+
+private:
+    std::unique_ptr<OutputSink> sink_;
+    std::string buffer_;
+    std::unordered_map<std::string, uint64_t> names_;
+    size_t keyframeInterval_;
+    size_t steps_;
+    size_t written_;
+    int lastLine_;
+    size_t lastKeyframeStep_;
+    size_t lastKeyframeEnd_;
+    size_t lastKeyframeBytes_;
+    bool finished_;
+
+    uint64_t nameId(const std::string& name);
+    void keyframe(const Variables& variables);
+    void drain(bool force);
+};
+
+// Random access to a recorded trace. Positions run from 0 (before the first
+// statement) to steps(), the state after the last statement.
+class TraceReader {
+public:
+    // Throws if the file is missing or not a trace
+    explicit TraceReader(const std::string& path);
+
+    struct State {
+        size_t step = 0;
+        int line = 0;
+        std::map<std::string, Value> variables;
+        std::map<std::string, Array> arrays;
+    };
+
+    const std::string& sourcePath() const { return sourcePath_; }
+    const std::string& source() const { return source_; }
+    size_t steps() const { return steps_; }
+    // False when the program stopped on an error (or the trace was cut off)
+    bool ok() const { return ok_; }
+    const std::string& error() const { return error_; }
+
+    // State before statement `step` runs; the reference stays valid until
+    // the next call
+    const State& seek(size_t step);
+
+    // Nearest position after (forward) or before `from` whose line matches
+    std::optional<size_t> find(size_t from, bool forward, const std::function<bool(int line)>& match);
+
+private:
+    struct Keyframe {
+        size_t step;
+        size_t offset;
+    };
+    struct Cursor {
+        size_t pos;
+        size_t step;
+        int line;
+    };
+
+    std::string data_;
+    std::string sourcePath_;
+    std::string source_;
+    std::vector<std::string> names_;
+    std::vector<Keyframe> keyframes_;
+    size_t steps_;
+    bool ok_;
+    bool finished_;
+    std::string error_;
+
+    State state_;
+    Cursor cursor_;
+    bool cursorValid_;
+
+    // Decodes one event at cursor.pos into state (or skips it when state is
+    // null). Returns false at the end of the stream.
+    bool decode(Cursor& cursor, State* state);
+    size_t keyframeBefore(size_t step) const;
+    Cursor loadKeyframe(size_t index, State* state);
+};
+
+} // namespace basic
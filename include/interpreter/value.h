@@ -0,0 +1,16 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace basic {
+
+// Value types
+using Value = std::variant<int, double, std::string, bool>;
+
+// Function implemented by the embedding application, callable from BASIC
+using HostFunction = std::function<Value(const std::vector<Value>&)>;
+
+} // namespace basic
@@ -1,14 +1,37 @@
 #pragma once
 
 #include "interpreter/basic_interpreter.h"
+#include "interpreter/dictionary.h"
 #include <map>
+#include <memory_resource>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 namespace basic {
 
+class MemoryAccount;
+class TraceRecorder;
+
+// DIM array: row-major storage, each dimension indexed 0..bound
+struct Array {
+    Array() = default;
+    explicit Array(std::pmr::memory_resource* memory) : data(memory) {}
+
+    std::vector<int> dims;
+    std::pmr::vector<Value> data;
+    size_t stringBytes = 0; // string bytes charged for data
+
+    size_t offset(const std::vector<int>& indices) const;
+};
+
 class Variables {
 public:
-    Variables();
+    // Arrays, dictionaries and stored strings are charged to memory if given
+    explicit Variables(MemoryAccount* memory = nullptr);
+    ~Variables();
+    Variables(const Variables&) = delete;
+    Variables& operator=(const Variables&) = delete;
     
     void set(const std::string& name, const Value& value);
     Value get(const std::string& name) const;
@@ -16,8 +39,57 @@ public:
     void clear();
     bool exists(const std::string& name) const;
     
+    // Arrays
+    void dim(const std::string& name, const std::vector<int>& bounds);
+    bool hasArray(const std::string& name) const;
+    Array* getArray(const std::string& name);
+    Array& getOrCreateArray(const std::string& name);
+    Value getElement(const std::string& name, const std::vector<int>& indices) const;
+    void setElement(const std::string& name, const std::vector<int>& indices, const Value& value);
+    const std::map<std::string, Array>& getAllArrays() const;
+    // Bulk writers (SPLIT, CSVREAD, KEYS, RNDFILL) fill array.data directly
+    // and call this afterwards to bring its string charge up to date. Over
+    // the memory limit it empties the long strings before throwing.
+    void recount(Array& array);
+    // Writers that cannot change the string charge (SORT, numeric RNDFILL)
+    // call this instead; it only reports the new contents to the trace
+    void arrayChanged(const Array& array);
+    
+    // Scalar and array writes are recorded here while set (see --record)
+    void setTrace(TraceRecorder* trace) { trace_ = trace; }
+
+    // Change tracking for the debugger. A scalar write stamps its variable
+    // with the current generation, a single store. advanceGeneration()
+    // closes the current one (at each stop) and returns it; changedSince(g)
+    // lists the scalars written after g was closed.
+    uint64_t generation() const { return generation_; }
+    uint64_t advanceGeneration() { return generation_++; }
+    std::map<std::string, Value> changedSince(uint64_t generation) const;
+    bool changedSince(const std::string& name, uint64_t generation) const;
+    // Generation of the last clear(); variables may have disappeared since
+    uint64_t clearedAt() const { return clearedAt_; }
+    
+    // Dictionaries
+    void declareDict(const std::string& name);
+    Dictionary* getDict(const std::string& name);
+    const std::map<std::string, Dictionary>& getAllDicts() const;
+    
 private:
-    std::map<std::string, Value> variables_;
+    struct Scalar {
+        Value value;
+        uint64_t changed = 0; // generation of the last write
+    };
+    std::map<std::string, Scalar> variables_;
+    std::map<std::string, Array> arrays_;
+    std::map<std::string, Dictionary> dicts_;
+    MemoryAccount* memory_;
+    TraceRecorder* trace_;
+    size_t stringBytes_; // charged for scalar variables
+    uint64_t generation_ = 1;
+    uint64_t clearedAt_ = 0;
+    
+    void charge(size_t bytes);
+    void release(size_t bytes);
 };
 
 } // namespace basic 
\ No newline at end of file
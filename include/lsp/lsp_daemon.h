@@ -0,0 +1,38 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+namespace lsp {
+
+// One long-lived language server (--lsp-daemon) listening on a Unix socket.
+// Every connected editor window is a client of the same Workspace, so a
+// document and its compiled program are analyzed once however many windows
+// have it open. The daemon exits after idleTimeout with no client connected.
+// Not available on Windows.
+class LSPDaemon {
+public:
+    LSPDaemon(const std::string& socketPath, std::chrono::seconds idleTimeout, size_t memoryBudget);
+    ~LSPDaemon();
+    LSPDaemon(const LSPDaemon&) = delete;
+    LSPDaemon& operator=(const LSPDaemon&) = delete;
+
+    // Serves clients until the idle timeout or until running turns false.
+    // Throws if the socket cannot be bound or another daemon is listening.
+    void run(const bool& running);
+
+    // The stdio shim (--lsp-connect) an editor starts in place of
+    // --lsp-only: relays stdin/stdout to the daemon, starting one by running
+    // `self` if nothing listens on socketPath. Returns the exit status.
+    static int connectStdio(const std::string& socketPath, const std::string& self,
+                            std::chrono::seconds idleTimeout, size_t memoryBudget, const bool& running);
+
+private:
+    std::string socketPath_;
+    std::chrono::seconds idleTimeout_;
+    size_t memoryBudget_;
+    int listenFd_;
+};
+
+} // namespace lsp
@@ -3,9 +3,19 @@
 #include <string>
 #include <memory>
 #include <functional>
-#include <map>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <set>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 #include <nlohmann/json.hpp>
+#include "protocol/lsp_protocol.h"
+
+namespace basic {
+class Program;
+}
 
 namespace lsp {
 
@@ -19,30 +29,6 @@ enum class MessageType {
     NOTIFICATION
 };
 
-// LSP request types
-enum class RequestType {
-    INITIALIZE,
-    SHUTDOWN,
-    TEXTDOCUMENT_COMPLETION,
-    TEXTDOCUMENT_HOVER,
-    TEXTDOCUMENT_DEFINITION,
-    TEXTDOCUMENT_REFERENCES,
-    TEXTDOCUMENT_SIGNATUREHELP,
-    TEXTDOCUMENT_DOCUMENTSYMBOL,
-    TEXTDOCUMENT_FORMATTING,
-    WORKSPACE_SYMBOL
-};
-
-// LSP notification types
-enum class NotificationType {
-    INITIALIZED,
-    TEXTDOCUMENT_DIDOPEN,
-    TEXTDOCUMENT_DIDCHANGE,
-    TEXTDOCUMENT_DIDCLOSE,
-    TEXTDOCUMENT_DIDSAVE,
-    WORKSPACE_DIDCHANGECONFIGURATION
-};
-
 // LSP message structure
 struct LSPMessage {
     MessageType type;
@@ -56,112 +42,82 @@ struct LSPMessage {
     LSPMessage(MessageType t, const std::string& m) : type(t), method(m) {}
 };
 
-// Position in document
-struct Position {
-    int line;
-    int character;
-    
-    Position(int l = 0, int c = 0) : line(l), character(c) {}
-    
-    json toJson() const {
-        return json{{"line", line}, {"character", character}};
-    }
-    
-    static Position fromJson(const json& j) {
-        return Position(j["line"], j["character"]);
-    }
-};
-
-// Range in document
-struct Range {
-    Position start;
-    Position end;
-    
-    Range(const Position& s = Position(), const Position& e = Position()) 
-        : start(s), end(e) {}
-    
-    json toJson() const {
-        return json{{"start", start.toJson()}, {"end", end.toJson()}};
-    }
-    
-    static Range fromJson(const json& j) {
-        return Range(Position::fromJson(j["start"]), Position::fromJson(j["end"]));
-    }
-};
-
-// Location in document
-struct Location {
-    std::string uri;
-    Range range;
-    
-    Location(const std::string& u = "", const Range& r = Range()) : uri(u), range(r) {}
-    
-    json toJson() const {
-        return json{{"uri", uri}, {"range", range.toJson()}};
-    }
-};
-
-// Completion item
-struct CompletionItem {
-    std::string label;
-    std::string detail;
-    std::string documentation;
-    std::string kind;
-    
-    CompletionItem(const std::string& l = "") : label(l) {}
-    
-    json toJson() const {
-        json j = {{"label", label}};
-        if (!detail.empty()) j["detail"] = detail;
-        if (!documentation.empty()) j["documentation"] = documentation;
-        if (!kind.empty()) j["kind"] = kind;
-        return j;
-    }
-};
-
-// Hover information
-struct Hover {
-    std::string contents;
-    Range range;
-    
-    Hover(const std::string& c = "") : contents(c) {}
-    
-    json toJson() const {
-        return json{{"contents", contents}, {"range", range.toJson()}};
-    }
-};
+// Open documents and their compiled programs. The daemon (lsp_daemon.h)
+// gives all its clients one workspace; a document opened by several of them
+// stays open until the last one closes it.
+//
+// Memory is bounded by a budget. Over it, the least recently used closed
+// documents are forgotten first, then the compiled programs of cold open
+// documents, which are recompiled from their text when next needed. URIs
+// are stored once and referred to by id.
+class Workspace {
+public:
+    using DocumentId = uint32_t;
+    static constexpr size_t kDefaultMemoryBudget = 64 * 1024 * 1024;
+
+    explicit Workspace(size_t memoryBudget = kDefaultMemoryBudget);
+
+    // The id stays valid until the document is closed
+    DocumentId open(const std::string& uri, const std::string& content);
+    void update(const std::string& uri, const std::string& content);
+    // True when that was the last client with the document open
+    bool close(DocumentId id);
+    std::optional<DocumentId> id(const std::string& uri) const;
+
+    // Empty / null unless the document is open
+    std::string text(const std::string& uri) const;
+    std::shared_ptr<const basic::Program> program(const std::string& uri);
+    std::vector<std::string> uris() const;
+
+    struct MemoryStats {
+        size_t budget = 0;
+        size_t used = 0;
+        size_t openDocuments = 0;
+        size_t closedDocuments = 0; // kept compiled in case they reopen
+        size_t compiledDocuments = 0;
+        size_t evictions = 0;
+        size_t recompiles = 0;
+    };
+    MemoryStats memoryStats() const;
+    void setMemoryBudget(size_t bytes);
 
-// Document symbol
-struct DocumentSymbol {
-    std::string name;
-    std::string detail;
-    std::string kind;
-    Range range;
-    Range selectionRange;
-    std::vector<DocumentSymbol> children;
-    
-    DocumentSymbol(const std::string& n = "") : name(n) {}
-    
-    json toJson() const {
-        json j = {
-            {"name", name},
-            {"kind", kind},
-            {"range", range.toJson()},
-            {"selectionRange", selectionRange.toJson()}
-        };
-        if (!detail.empty()) j["detail"] = detail;
-        if (!children.empty()) j["children"] = json::array();
-        for (const auto& child : children) {
-            j["children"].push_back(child.toJson());
-        }
-        return j;
-    }
+private:
+    struct Document {
+        std::string uri;
+        // Only while program is null; otherwise the text is program->source()
+        std::string text;
+        // Compiled through basic::ProgramCache. Holding it keeps the cache
+        // entry alive, so a DAP launch of the same text in this process
+        // reuses it instead of lexing and parsing again.
+        std::shared_ptr<const basic::Program> program;
+        int openCount = 0;
+        uint64_t lastUsed = 0;
+        bool live = false;
+    };
+    // Indexed by id; a deque so the views in ids_ stay valid
+    std::deque<Document> documents_;
+    std::unordered_map<std::string_view, DocumentId> ids_;
+    std::vector<DocumentId> freeIds_;
+    size_t budget_;
+    uint64_t clock_ = 0;
+    size_t evictions_ = 0;
+    size_t recompiles_ = 0;
+
+    Document* find(const std::string& uri);
+    const Document* find(const std::string& uri) const;
+    void setText(Document& document, const std::string& content);
+    void forget(Document& document);
+    static size_t cost(const Document& document);
+    size_t used() const;
+    void enforceBudget(const Document* keep);
 };
 
 // LSP Server class
 class LSPServer {
 public:
     LSPServer();
+    // One client of a shared workspace
+    explicit LSPServer(std::shared_ptr<Workspace> workspace);
     ~LSPServer();
     
     // Main server methods
@@ -172,25 +128,35 @@ public:
     // Message handling
     void sendMessage(const LSPMessage& message);
     LSPMessage receiveMessage();
+    // A request whose handler throws is answered with an internal error (-32603)
     void processMessage(const LSPMessage& message);
+    // JSON body of one message, without the Content-Length header
+    static LSPMessage parseMessage(const std::string& content);
+    // Where framed messages go instead of stdout
+    void setWriter(std::function<void(const std::string&)> writer);
+    // Closes every document this client opened
+    void releaseDocuments();
     
     // Request handlers
     json handleInitialize(const json& params);
     json handleShutdown(const json& params);
-    json handleCompletion(const json& params);
-    json handleHover(const json& params);
-    json handleDefinition(const json& params);
-    json handleReferences(const json& params);
+    CompletionList handleCompletion(const TextDocumentPositionParams& params);
+    Hover handleHover(const TextDocumentPositionParams& params);
+    std::vector<Location> handleDefinition(const TextDocumentPositionParams& params);
+    std::vector<Location> handleReferences(const TextDocumentPositionParams& params);
     json handleSignatureHelp(const json& params);
-    json handleDocumentSymbol(const json& params);
-    json handleFormatting(const json& params);
+    std::vector<DocumentSymbol> handleDocumentSymbol(const DocumentSymbolParams& params);
+    std::vector<TextEdit> handleFormatting(const json& params);
     json handleWorkspaceSymbol(const json& params);
+    json handleInlayHint(const json& params);
+    json handleCoverage(const json& params);
+    json handleMemoryStats(const json& params);
     
     // Notification handlers
     void handleInitialized(const json& params);
-    void handleDidOpen(const json& params);
-    void handleDidChange(const json& params);
-    void handleDidClose(const json& params);
+    void handleDidOpen(const DidOpenTextDocumentParams& params);
+    void handleDidChange(const DidChangeTextDocumentParams& params);
+    void handleDidClose(const DidCloseTextDocumentParams& params);
     void handleDidSave(const json& params);
     void handleDidChangeConfiguration(const json& params);
     
@@ -198,7 +164,10 @@ public:
     void addDocument(const std::string& uri, const std::string& content);
     void updateDocument(const std::string& uri, const std::string& content);
     void removeDocument(const std::string& uri);
+    void publishDiagnostics(const std::string& uri);
     std::string getDocument(const std::string& uri) const;
+    // file:// URI to a local path, with %XX escapes decoded
+    static std::string uriToPath(const std::string& uri);
     
     // Language features
     std::vector<CompletionItem> getCompletions(const std::string& uri, const Position& position);
@@ -209,11 +178,15 @@ public:
 
 private:
     bool running_;
-    std::map<std::string, std::string> documents_;
-    std::map<std::string, std::function<json(const json&)>> requestHandlers_;
-    std::map<std::string, std::function<void(const json&)>> notificationHandlers_;
-    
-    void setupHandlers();
+    std::shared_ptr<Workspace> workspace_;
+    std::set<Workspace::DocumentId> opened_;
+    std::function<void(const std::string&)> writer_;
+    
+    // Typed results are written straight from the struct, without a json tree
+    template <typename T>
+    void sendResult(const json& id, const T& result);
+    void sendFramed(const std::string& content);
+    void dispatch(const LSPMessage& message);
     LSPMessage createResponse(const json& id, const json& result);
     LSPMessage createErrorResponse(const json& id, int code, const std::string& message);
     void sendNotification(const std::string& method, const json& params);
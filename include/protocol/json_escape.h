@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace protocol {
+
+// JSON string bodies, without the quotes. Both scan with the basic::simd
+// kernels and copy the runs between escapes whole, which is most of a
+// document or of program output. Part of the basic library, so the
+// interpreter's own JSON reports escape the same way as the servers.
+void appendEscaped(std::string& out, std::string_view text);
+// False if escaped has a bad escape, a raw control character or invalid
+// UTF-8; out is then left partly written
+bool unescape(std::string_view escaped, std::string& out);
+
+} // namespace protocol
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "protocol/json_escape.h"
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <nlohmann/json.hpp>
+
+namespace protocol {
+
+// String values at least this long are unescaped by parse() itself
+constexpr size_t kLiftedStringSize = 4096;
+
+// One message body, like nlohmann::json::parse. Long string values (whole
+// documents in didOpen/didChange, loadSource content) are found and decoded
+// with the kernels above and moved into the tree afterwards, so the DOM
+// parser only reads the structure around them. Throws
+// nlohmann::json::parse_error for malformed input.
+nlohmann::json parse(std::string_view content);
+
+} // namespace protocol
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace protocol {
+
+// Appends JSON text directly, for the message structs generated from
+// protocol/*.protocol, instead of building a nlohmann::json tree first and
+// dumping it. Members come out in the order they are written.
+class JsonWriter {
+public:
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+    void key(std::string_view name);
+
+    void value(bool flag);
+    void value(int number);
+    void value(long long number);
+    void value(unsigned long long number);
+    void value(unsigned long number) { value(static_cast<unsigned long long>(number)); }
+    void value(long number) { value(static_cast<long long>(number)); }
+    void value(double number);
+    void value(std::string_view text);
+    void value(const char* text) { value(std::string_view(text)); }
+    void value(const std::string& text) { value(std::string_view(text)); }
+    // Already-built trees, written as they are
+    void value(const nlohmann::json& tree);
+    // Text that is already JSON
+    void raw(std::string_view text);
+
+    // Generated structs
+    template <typename T>
+    auto value(const T& object) -> decltype(object.write(*this), void()) {
+        object.write(*this);
+    }
+
+    template <typename T>
+    void value(const std::vector<T>& items) {
+        beginArray();
+        for (const auto& item : items) {
+            value(item);
+        }
+        endArray();
+    }
+
+    template <typename T>
+    void field(std::string_view name, const T& item) {
+        key(name);
+        value(item);
+    }
+
+    const std::string& str() const { return out_; }
+    std::string take() { return std::move(out_); }
+
+private:
+    std::string out_;
+    // Per open object or array: whether nothing was written in it yet
+    std::vector<bool> empty_;
+    bool afterKey_ = false;
+
+    void separate();
+};
+
+template <typename T>
+std::string serialize(const T& message) {
+    JsonWriter writer;
+    writer.value(message);
+    return writer.take();
+}
+
+} // namespace protocol
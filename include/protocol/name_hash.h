@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace protocol {
+
+// FNV-1a from a seed. protocol_gen searches for the seed that gives every
+// name of a dispatch table its own slot, so a lookup is one hash and one
+// string compare.
+constexpr uint32_t hashName(std::string_view name, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed;
+    for (char c : name) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Slot of name in a table of 2^bits entries; the top bits, which depend on
+// every character
+constexpr uint32_t hashSlot(std::string_view name, uint32_t seed, unsigned bits) {
+    return hashName(name, seed) >> (32 - bits);
+}
+
+} // namespace protocol
@@ -1,20 +1,40 @@
 #include "dap/dap_server.h"
 #include "interpreter/runtime.h"
+#include "interpreter/variables.h"
+#include "interpreter/basic_interpreter.h"
+#include "interpreter/program.h"
+#include "interpreter/trace.h"
+#include "interpreter/timeline.h"
+#include "protocol/json_string.h"
 #include <iostream>
 #include <sstream>
 #include <thread>
 #include <chrono>
 #include "dap/dap_server.h"
 
+#ifndef _WIN32
+#include <sys/ioctl.h>
+#endif
+
 namespace dap {
 
+#ifdef _WIN32
+using SocketByteCount = u_long;
+#else
+// FIONREAD writes an int on POSIX
+using SocketByteCount = int;
+
+static int ioctlsocket(int socket, unsigned long request, SocketByteCount* argument) {
+    return ioctl(socket, request, argument);
+}
+#endif
+
 DAPServer::DAPServer()
     : running_(false), debugging_(false), paused_(false),
     currentThread_(1), currentLine_(0),
     serverSocket_(-1), clientSocket_(-1), useNetwork_(false), port_(4711),
     enableLogging_(false), stepMode_(false), nextBreakpointId_(1), checkConnection_(false) , runTillStop_(false)
 {
-    setupHandlers();
 }
 
 DAPServer::~DAPServer()
@@ -132,7 +152,30 @@ bool DAPServer::isRunning() const {
     return running_;
 }
 
+void DAPServer::setInterpreter(basic::BasicInterpreter* interpreter) {
+    if (interpreter_) {
+        interpreter_->setDebugHook(nullptr);
+    }
+    interpreter_ = interpreter;
+    if (interpreter_) {
+        interpreter_->setDebugHook(this);
+    }
+}
+
+bool DAPServer::isAttached() const {
+    return isRunning();
+}
+
+void DAPServer::onStatement(int line) {
+    checkForStep(line);
+}
+
+void DAPServer::onOutput(const std::string& text) {
+    sendOutputEvent("stdout", text);
+}
+
 void DAPServer::sendMessage(const DAPMessage& message) {
+    BASIC_TIMELINE_SCOPE("dap send", message.command);
     json response;
     
     if (message.type == DAPMessageType::RESPONSE) {
@@ -160,26 +203,28 @@ void DAPServer::sendMessage(const DAPMessage& message) {
     }
     
     std::string content = response.dump();
-    std::string header = "Content-Length: " + std::to_string(content.length()) + "\r\n\r\n";
     if (enableLogging_) {
-        std::cerr << "[DAP] Sending: " << response.dump() << std::endl;
+        std::cerr << "[DAP] Sending: " << content << std::endl;
     }
+    writeFrame(content);
+}
+
+void DAPServer::writeFrame(const std::string& content) {
+    std::string header = "Content-Length: " + std::to_string(content.size()) + "\r\n\r\n";
     if (useNetwork_ && clientSocket_ >= 0) {
-        // Send over network
-        send(clientSocket_, header.c_str(), header.length(), 0);
-        send(clientSocket_, content.c_str(), content.length(), 0);
+        sendNetwork(header + content);
     } else {
-        // Send to stdout
         std::cout << header << content << std::flush;
     }
 }
 
 DAPMessage DAPServer::receiveMessage() {
+    BASIC_TIMELINE_SCOPE("dap receive");
     static std::string socketBuffer;
 
     if (runTillStop_) {
         runTillStop_ = false;
-        basic::BasicInterpreter* interpreter = basic::getInterpreter();
+        basic::BasicInterpreter* interpreter = interpreter_;
         interpreter->continueExecution();
         currentLine_ = interpreter->getCurrentLine();
         sendStoppedEvent("step", currentThread_, currentLine_);
@@ -232,7 +277,7 @@ DAPMessage DAPServer::receiveMessage() {
         socketBuffer.erase(0, contentLength);
 
         try {
-            json j = json::parse(content);
+            json j = protocol::parse(content);
             if (enableLogging_) {
                 std::cerr << "[DAP] Received: " << j.dump() << std::endl;
             }
@@ -288,7 +333,7 @@ DAPMessage DAPServer::receiveMessage() {
         content.resize(contentLength);
         std::cin.read(&content[0], contentLength);
         try {
-            json j = json::parse(content);
+            json j = protocol::parse(content);
             if (enableLogging_) {
                 std::cerr << "[DAP] Received: " << j.dump() << std::endl;
             }
@@ -328,13 +373,52 @@ DAPMessage DAPServer::receiveMessage() {
 }
 
 void DAPServer::processMessage(const DAPMessage& message) {
-    if (message.type == DAPMessageType::REQUEST) {
-        auto handler = requestHandlers_.find(message.command);
-        if (handler != requestHandlers_.end()) {
-            json result = handler->second(message.arguments);
-            sendMessage(createResponse(message.id, result));
-        }
-        else if (!message.command.empty()) {
+    BASIC_TIMELINE_SCOPE("dap process", message.command);
+    if (message.type != DAPMessageType::REQUEST) {
+        return;
+    }
+    DAPRequestType command = toDAPRequestType(message.command);
+    if (answerFromStopSnapshot(message, command)) {
+        return;
+    }
+    const json& arguments = message.arguments;
+    switch (command) {
+    case DAPRequestType::INITIALIZE: respond(message, handleInitialize(arguments)); break;
+    case DAPRequestType::LAUNCH: respond(message, handleLaunch(arguments)); break;
+    case DAPRequestType::ATTACH: respond(message, handleAttach(arguments)); break;
+    case DAPRequestType::DISCONNECT: respond(message, handleDisconnect(arguments)); break;
+    case DAPRequestType::TERMINATE: respond(message, handleTerminate(arguments)); break;
+    case DAPRequestType::RESTART: respond(message, handleRestart(arguments)); break;
+    case DAPRequestType::SETBREAKPOINTS:
+        respond(message, handleSetBreakpoints(SetBreakpointsArguments::fromJson(arguments)));
+        break;
+    case DAPRequestType::SETFUNCTIONBREAKPOINTS: respond(message, handleSetFunctionBreakpoints(arguments)); break;
+    case DAPRequestType::SETEXCEPTIONBREAKPOINTS: respond(message, handleSetExceptionBreakpoints(arguments)); break;
+    case DAPRequestType::CONTINUE: respond(message, handleContinue(arguments)); break;
+    case DAPRequestType::NEXT: respond(message, handleNext(arguments)); break;
+    case DAPRequestType::STEPIN: respond(message, handleStepIn(arguments)); break;
+    case DAPRequestType::STEPOUT: respond(message, handleStepOut(arguments)); break;
+    case DAPRequestType::PAUSE: respond(message, handlePause(arguments)); break;
+    case DAPRequestType::STACKTRACE:
+        respond(message, handleStackTrace(StackTraceArguments::fromJson(arguments)));
+        break;
+    case DAPRequestType::SCOPES: respond(message, handleScopes(ScopesArguments::fromJson(arguments))); break;
+    case DAPRequestType::VARIABLES: respond(message, handleVariables(VariablesArguments::fromJson(arguments))); break;
+    case DAPRequestType::EVALUATE: respond(message, handleEvaluate(arguments)); break;
+    case DAPRequestType::SETVARIABLE: respond(message, handleSetVariable(arguments)); break;
+    case DAPRequestType::SOURCE: respond(message, handleSource(arguments)); break;
+    case DAPRequestType::THREADS: respond(message, handleThreads(arguments)); break;
+    case DAPRequestType::MODULES: respond(message, handleModules(arguments)); break;
+    case DAPRequestType::LOADEDSOURCES: respond(message, handleLoadedSources(arguments)); break;
+    case DAPRequestType::EXCEPTIONINFO: respond(message, handleExceptionInfo(arguments)); break;
+    case DAPRequestType::LOADSOURCE: respond(message, handleLoadSource(arguments)); break;
+    case DAPRequestType::CONFIGURATIONDONEREQUEST: respond(message, handleConfigurationDone(arguments)); break;
+    case DAPRequestType::STEPBACK: respond(message, handleStepBack(arguments)); break;
+    case DAPRequestType::REVERSECONTINUE: respond(message, handleReverseContinue(arguments)); break;
+    case DAPRequestType::SOURCECHANGED: respond(message, handleSourceChanged(arguments)); break;
+    case DAPRequestType::VARIABLESDELTA: respond(message, handleVariablesDelta(arguments)); break;
+    case DAPRequestType::UNKNOWN:
+        if (!message.command.empty()) {
             sendMessage(createErrorResponse(message.id, -32601, "Method not found"));
         } else if(checkConnection_) {
             // Restart the socket server
@@ -342,39 +426,10 @@ void DAPServer::processMessage(const DAPMessage& message) {
             stop();
             start(port_, enableLogging_);
         }
+        break;
     }
 }
 
-void DAPServer::setupHandlers() {
-    // Request handlers
-    requestHandlers_["initialize"] = [this](const json& args) { return handleInitialize(args); };
-    requestHandlers_["launch"] = [this](const json& args) { return handleLaunch(args); };
-    requestHandlers_["attach"] = [this](const json& args) { return handleAttach(args); };
-    requestHandlers_["disconnect"] = [this](const json& args) { return handleDisconnect(args); };
-    requestHandlers_["terminate"] = [this](const json& args) { return handleTerminate(args); };
-    requestHandlers_["restart"] = [this](const json& args) { return handleRestart(args); };
-    requestHandlers_["setBreakpoints"] = [this](const json& args) { return handleSetBreakpoints(args); };
-    requestHandlers_["setFunctionBreakpoints"] = [this](const json& args) { return handleSetFunctionBreakpoints(args); };
-    requestHandlers_["setExceptionBreakpoints"] = [this](const json& args) { return handleSetExceptionBreakpoints(args); };
-    requestHandlers_["continue"] = [this](const json& args) { return handleContinue(args); };
-    requestHandlers_["next"] = [this](const json& args) { return handleNext(args); };
-    requestHandlers_["stepIn"] = [this](const json& args) { return handleStepIn(args); };
-    requestHandlers_["stepOut"] = [this](const json& args) { return handleStepOut(args); };
-    requestHandlers_["pause"] = [this](const json& args) { return handlePause(args); };
-    requestHandlers_["stackTrace"] = [this](const json& args) { return handleStackTrace(args); };
-    requestHandlers_["scopes"] = [this](const json& args) { return handleScopes(args); };
-    requestHandlers_["variables"] = [this](const json& args) { return handleVariables(args); };
-    requestHandlers_["evaluate"] = [this](const json& args) { return handleEvaluate(args); };
-    requestHandlers_["setVariable"] = [this](const json& args) { return handleSetVariable(args); };
-    requestHandlers_["source"] = [this](const json& args) { return handleSource(args); };
-    requestHandlers_["threads"] = [this](const json& args) { return handleThreads(args); };
-    requestHandlers_["modules"] = [this](const json& args) { return handleModules(args); };
-    requestHandlers_["loadedSources"] = [this](const json& args) { return handleLoadedSources(args); };
-    requestHandlers_["exceptionInfo"] = [this](const json& args) { return handleExceptionInfo(args); };
-    requestHandlers_["loadSource"] = [this](const json& args) { return handleLoadSource(args); };
-    requestHandlers_["configurationDoneRequest"] = [this](const json& args) { return handleConfigurationDone(args); };
-}
-
 json DAPServer::handleInitialize(const json& arguments) {
     json capabilities = {
         {"supportsConfigurationDoneRequest", true},
@@ -384,7 +439,7 @@ json DAPServer::handleInitialize(const json& arguments) {
         {"supportsEvaluateForHovers", true},
  //     {"exceptionBreakpointFilters", json::array()},
  //      {"supportsSetBreakpoints", true},
-        {"supportsStepBack", false},
+        {"supportsStepBack", true},
         {"supportsSetVariable", true},
         {"supportsRestartFrame", false},
         {"supportsGotoTargetsRequest", false},
@@ -421,6 +476,12 @@ json DAPServer::handleLaunch(const json& arguments) {
     std::cerr << "DAP: Launch request received" << std::endl;
     std::cerr << "DAP: Arguments: " << arguments.dump() << std::endl;
 
+    replay_.reset();
+    replayStep_ = 0;
+    if (arguments.contains("trace") && arguments["trace"].is_string()) {
+        loadTrace(arguments["trace"]);
+    }
+
     // If "program" is a string, treat it as a filename and load its content
     if (arguments.contains("program") && arguments["program"].is_string()) {
         std::string programPath = arguments["program"];
@@ -456,13 +517,28 @@ json DAPServer::handleLaunch(const json& arguments) {
         }
     }
 
-    std::string content = getSource(currentSource_);
-    if (!content.empty()) {
+    if (replay_ && getSource(currentSource_).empty()) {
+        // The trace carries the source it was recorded from
+        addSource(replay_->sourcePath(), replay_->source());
+    }
+
+    // Linked afresh so included files edited since the last run are picked
+    // up; the previous link keeps the unchanged modules cached meanwhile
+    auto previous = std::move(program_);
+    program_.reset();
+    if (replay_) {
+        currentLine_ = replay_->seek(0).line;
+    } else if (auto program = linkedProgram()) {
         // Load the program into basic interpretter
-        basic::BasicInterpreter* interpreter = basic::getInterpreter();
-        interpreter->loadProgram(content);
+        basic::BasicInterpreter* interpreter = interpreter_;
+        if (!interpreter->loadProgram(program)) {
+            sendOutputEvent("stderr", interpreter->getLastError() + "\n");
+        }
         interpreter->pause();
+        previousStop_ = lastStop_ = 0;
     }
+    // Breakpoints set before the launch resolve against the loaded program
+    resyncBreakpoints();
 
     sendInitializedEvent();
 
@@ -479,13 +555,16 @@ void DAPServer::NestedEventHandler()
 {
     if (useNetwork_ && clientSocket_ >= 0) {
         for (;; ) {
-            unsigned long bytesAvailable = 0;
+            SocketByteCount bytesAvailable = 0;
             int result = ioctlsocket(clientSocket_, FIONREAD, &bytesAvailable);
-            if (result == 0) {
+            if (result == 0 && bytesAvailable == 0) {
+                BASIC_TIMELINE_SCOPE("dap poll sleep");
                 std::this_thread::sleep_for(std::chrono::milliseconds(100));
                 result = ioctlsocket(clientSocket_, FIONREAD, &bytesAvailable);
             }
-            if (result > 0) {
+            // ioctlsocket returns 0 on success on every platform; the count
+            // says whether a message is waiting
+            if (result == 0 && bytesAvailable > 0) {
                 try {
                     DAPMessage message = receiveMessage();
                     if (message.type != DAPMessageType::EVENT) {
@@ -519,16 +598,71 @@ bool case_insensitive_compare(const std::string& s1, const std::string& s2) {
                       });
 }
 
+// Re-resolves the current source's breakpoints against its program and
+// sets or removes only the interpreter lines that changed
 void DAPServer::resyncBreakpoints() {
-    basic::BasicInterpreter* interpreter = basic::getInterpreter();
-    interpreter->clearBreakpoints();
-    for (const auto& [source, lines] : breakpoints_) {
-        if (case_insensitive_compare(source, currentSource_)) {
-            for (int line : lines) {
+    auto linked = linkedProgram();
+    std::set<int> lines;
+    for (auto& [source, sourceBreakpoints] : breakpoints_) {
+        // Included files are modules of the running program
+        int module = case_insensitive_compare(source, currentSource_) ? 0 : -1;
+        if (module < 0 && linked) {
+            module = linked->moduleIndex(source);
+        }
+        if (module < 0) {
+            continue;
+        }
+        auto program = programFor(source);
+        for (auto& [requestedLine, breakpoint] : sourceBreakpoints) {
+            int line = breakpoint.line;
+            bool verified = breakpoint.verified;
+            resolveBreakpoint(breakpoint, requestedLine, program.get());
+            if (breakpoint.line != line || breakpoint.verified != verified) {
+                sendBreakpointEvent("changed", breakpoint);
+            }
+            if (breakpoint.verified && linked) {
+                for (int line : linked->linesOf(static_cast<size_t>(module), breakpoint.line)) {
+                    lines.insert(line);
+                }
+            }
+        }
+    }
+
+    basic::BasicInterpreter* interpreter = interpreter_;
+    if (interpreter) {
+        for (int line : activeBreakpointLines_) {
+            if (!lines.count(line)) {
+                interpreter->removeBreakpoint(line);
+            }
+        }
+        for (int line : lines) {
+            if (!activeBreakpointLines_.count(line)) {
                 interpreter->setBreakpoint(line);
-            }   
+            }
         }
     }
+    activeBreakpointLines_ = std::move(lines);
+}
+
+void DAPServer::resolveBreakpoint(Breakpoint& breakpoint, int requestedLine, const basic::Program* program) {
+    breakpoint.line = requestedLine;
+    breakpoint.verified = true;
+    breakpoint.message.clear();
+    if (!program) {
+        return;
+    }
+    if (requestedLine < 1 || requestedLine > static_cast<int>(program->size())) {
+        breakpoint.verified = false;
+        breakpoint.message = "Line " + std::to_string(requestedLine) + " is outside the program";
+        return;
+    }
+    int line = program->nextStatementLine(requestedLine);
+    if (line == 0) {
+        breakpoint.verified = false;
+        breakpoint.message = "No statement at or after line " + std::to_string(requestedLine);
+        return;
+    }
+    breakpoint.line = line;
 }
 
 
@@ -540,12 +674,14 @@ json DAPServer::handleAttach(const json& arguments) {
 }
 
 json DAPServer::handleDisconnect(const json& arguments) {
+    replay_.reset();
     debugging_ = false;
     paused_ = false;
     sources_.erase(currentSource_);
+    program_.reset();
     currentLine_ = 0;
     currentSource_.clear();
-    basic::BasicInterpreter* interpreter = basic::getInterpreter();
+    basic::BasicInterpreter* interpreter = interpreter_;
     interpreter->cleanup();
     return json::object();
 }
@@ -568,24 +704,37 @@ json DAPServer::handleRestart(const json& arguments) {
     return json::object();
 }
 
-json DAPServer::handleSetBreakpoints(const json& arguments) {
-    std::string source = arguments["source"]["path"];
-    json breakpoints = arguments["breakpoints"];
-    json response = json::array();
+SetBreakpointsResponse DAPServer::handleSetBreakpoints(const SetBreakpointsArguments& arguments) {
+    const std::string& source = arguments.source.path;
+    SetBreakpointsResponse response;
     
-    for (const auto& bp : breakpoints) {
-        int line = bp["line"];
-        setBreakpoint(source, line);
-        
-        json breakpoint;
-        breakpoint["id"] = nextBreakpointId_++;
-        breakpoint["verified"] = true;
-        breakpoint["line"] = line;
-        response.push_back(breakpoint);
+    // The request carries the complete set for this source. Only the lines
+    // it adds or drops change; the others keep their ids.
+    std::set<int> requested;
+    for (const auto& bp : arguments.breakpoints) {
+        requested.insert(bp.line);
+    }
+    auto& sourceBreakpoints = breakpoints_[source];
+    for (auto it = sourceBreakpoints.begin(); it != sourceBreakpoints.end();) {
+        it = requested.count(it->first) ? std::next(it) : sourceBreakpoints.erase(it);
+    }
+    auto program = programFor(source);
+    for (int line : requested) {
+        auto [it, added] = sourceBreakpoints.try_emplace(line, Breakpoint(nextBreakpointId_));
+        if (added) {
+            nextBreakpointId_++;
+        }
+        resolveBreakpoint(it->second, line, program.get());
+    }
+    for (const auto& bp : arguments.breakpoints) {
+        response.breakpoints.push_back(sourceBreakpoints.at(bp.line));
+    }
+    if (sourceBreakpoints.empty()) {
+        breakpoints_.erase(source);
     }
     resyncBreakpoints();
     
-    return {{"breakpoints", response}};
+    return response;
 }
 
 json DAPServer::handleSetFunctionBreakpoints(const json& arguments) {
@@ -597,6 +746,11 @@ json DAPServer::handleSetExceptionBreakpoints(const json& arguments) {
 }
 
 json DAPServer::handleContinue(const json& arguments) {
+    if (replay_) {
+        auto hit = replay_->find(replayStep_, true, [this](int line) { return isReplayBreakpoint(line); });
+        replayMoveTo(hit ? *hit : replay_->steps(), hit ? "breakpoint" : "step");
+        return json::object();
+    }
     paused_ = false;
     runTillStop_ = true;
     sendContinuedEvent(currentThread_);
@@ -604,8 +758,12 @@ json DAPServer::handleContinue(const json& arguments) {
 }
 
 json DAPServer::handleNext(const json& arguments) {
+    if (replay_) {
+        replayMoveTo(std::min(replayStep_ + 1, replay_->steps()), "step");
+        return json::object();
+    }
     currentLine_++;
-    basic::BasicInterpreter* interpreter = basic::getInterpreter();
+    basic::BasicInterpreter* interpreter = interpreter_;
     interpreter->step();
     currentLine_ = interpreter->getCurrentLine();
     sendStoppedEvent("step", currentThread_, currentLine_);
@@ -613,6 +771,9 @@ json DAPServer::handleNext(const json& arguments) {
 }
 
 json DAPServer::handleStepIn(const json& arguments) {
+    if (replay_) {
+        return handleNext(arguments);
+    }
     // Simulate stepping into the next statement
     currentLine_++;
     sendStoppedEvent("step", currentThread_, currentLine_);
@@ -620,6 +781,9 @@ json DAPServer::handleStepIn(const json& arguments) {
 }
 
 json DAPServer::handleStepOut(const json& arguments) {
+    if (replay_) {
+        return handleNext(arguments);
+    }
     currentLine_++;
     sendStoppedEvent("step", currentThread_, currentLine_);
     return json::object();
@@ -631,108 +795,197 @@ json DAPServer::handlePause(const json& arguments) {
     return json::object();
 }
 
-json DAPServer::handleStackTrace(const json& arguments) {
-    json stackFrames = json::array();
+StackTraceResponse DAPServer::handleStackTrace(const StackTraceArguments& arguments) {
+    StackTraceResponse response;
     
     StackFrame frame;
     frame.id = 1;
     frame.name = "main";
-    // Set source as an object with name, path, and sourceReference fields
-    frame.source = {
-        {"name", currentSource_},
-        {"path", currentSource_},
-        {"sourceReference", 0}
-    };
-    frame.line = currentLine_;
+    if (replay_) {
+        frame.name += " (step " + std::to_string(replayStep_) + " of " + std::to_string(replay_->steps()) + ")";
+    }
+    auto [source, line] = currentPosition();
+    frame.source.name = source;
+    frame.source.path = source;
+    frame.line = line;
     frame.column = 0;
     
-    stackFrames.push_back(frame.toJson());
-    
-    return {
-        {"stackFrames", stackFrames},
-        {"totalFrames", 1}
-    };
+    response.stackFrames.push_back(frame);
+    response.totalFrames = 1;
+    return response;
 }
 
-json DAPServer::handleScopes(const json& arguments) {
-    json scopes = json::array();
+ScopesResponse DAPServer::handleScopes(const ScopesArguments& arguments) {
+    ScopesResponse response;
     
     Scope locals("Local");
     locals.variablesReference = 1;
     locals.namedVariables = 5;
-    scopes.push_back(locals.toJson());
+    response.scopes.push_back(locals);
     
     Scope globals("Global");
     globals.variablesReference = 2;
     globals.namedVariables = 3;
-    scopes.push_back(globals.toJson());
+    response.scopes.push_back(globals);
     
-    return {{"scopes", scopes}};
+    if (!replay_) {
+        Scope memory("Memory");
+        memory.variablesReference = 3;
+        memory.namedVariables = 3;
+        response.scopes.push_back(memory);
+    }
+    
+    return response;
 }
 
 
-json DAPServer::handleVariables(const json& arguments) {
-    int variablesReference = arguments["variablesReference"];
-    json variables = json::array();
+// Scalars as DAP variables; those written after generation `since` carry
+// the "changed" presentation hint
+static std::vector<Variable> scalarVariables(const std::map<std::string, basic::Value>& scalars,
+                                             const basic::Variables& store, uint64_t since) {
+    std::vector<Variable> variables;
+    for (const auto& [name, value] : scalars) {
+        Variable var(name);
+        var.value = basic::valueToString(value);
+        
+        // Determine type based on the value
+        std::visit([&var](const auto& v) {
+            using T = std::decay_t<decltype(v)>;
+            if constexpr (std::is_same_v<T, int>) var.type = "number";
+            else if constexpr (std::is_same_v<T, double>) var.type = "number";
+            else if constexpr (std::is_same_v<T, std::string>) var.type = "string";
+            else if constexpr (std::is_same_v<T, bool>) var.type = "boolean";
+            else var.type = "unknown";
+        }, value);
+        if (store.changedSince(name, since)) {
+            var.presentationHint.attributes.push_back("changed");
+        }
+        
+        variables.push_back(var);
+    }
+    return variables;
+}
+
+VariablesResponse DAPServer::handleVariables(const VariablesArguments& arguments) {
+    int variablesReference = arguments.variablesReference;
+    VariablesResponse response;
+    std::vector<Variable>& variables = response.variables;
+    
+    if (replay_) {
+        return replayVariables(arguments);
+    }
     
     // Get the interpreter instance
-    basic::BasicInterpreter* interpreter = basic::getInterpreter();
+    basic::BasicInterpreter* interpreter = interpreter_;
     if (!interpreter) {
-        return {{"variables", variables}};
+        return response;
     }
     
     if (variablesReference == 1) {
         // Local variables - get all variables from the interpreter
-        std::map<std::string, basic::Value> allVars = interpreter->getAllVariables();
-        
-        for (const auto& [name, value] : allVars) {
+        variables = scalarVariables(interpreter->getAllVariables(), *interpreter->getVariables(), previousStop_);
+        appendDictionaries(variables);
+    } else if (variablesReference == 3) {
+        // Program memory accounting
+        basic::BasicInterpreter::MemoryUsage usage = interpreter->getMemoryUsage();
+        const std::pair<const char*, size_t> rows[] = {
+            {"live bytes", usage.live}, {"peak bytes", usage.peak}, {"limit bytes", usage.limit}};
+        for (const auto& [name, bytes] : rows) {
             Variable var(name);
-            var.value = basic::valueToString(value);
-            
-            // Determine type based on the value
-            std::visit([&var](const auto& v) {
-                using T = std::decay_t<decltype(v)>;
-                if constexpr (std::is_same_v<T, int>) var.type = "number";
-                else if constexpr (std::is_same_v<T, double>) var.type = "number";
-                else if constexpr (std::is_same_v<T, std::string>) var.type = "string";
-                else if constexpr (std::is_same_v<T, bool>) var.type = "boolean";
-                else var.type = "unknown";
-            }, value);
-            
-            variables.push_back(var.toJson());
+            var.value = usage.limit == 0 && bytes == usage.limit && std::string(name) == "limit bytes"
+                ? "unlimited" : std::to_string(bytes);
+            var.type = "number";
+            variables.push_back(var);
         }
+    } else if (variablesReference >= kDictionaryReferenceBase) {
+        return dictionaryVariables(arguments);
     } else if (variablesReference == 2) {
         // Global variables - for now, same as local variables
         // In a more sophisticated implementation, you might distinguish between local and global scope
-        std::map<std::string, basic::Value> allVars = interpreter->getAllVariables();
-        
-        for (const auto& [name, value] : allVars) {
-            Variable var(name);
-            var.value = basic::valueToString(value);
-            
-            // Determine type based on the value
-            std::visit([&var](const auto& v) {
-                using T = std::decay_t<decltype(v)>;
-                if constexpr (std::is_same_v<T, int>) var.type = "number";
-                else if constexpr (std::is_same_v<T, double>) var.type = "number";
-                else if constexpr (std::is_same_v<T, std::string>) var.type = "string";
-                else if constexpr (std::is_same_v<T, bool>) var.type = "boolean";
-                else var.type = "unknown";
-            }, value);
-            
-            variables.push_back(var.toJson());
-        }
+        variables = scalarVariables(interpreter->getAllVariables(), *interpreter->getVariables(), previousStop_);
+    }
+    
+    return response;
+}
+
+// Dictionaries are expandable; their entries are fetched page by page
+void DAPServer::appendDictionaries(std::vector<Variable>& variables) {
+    int index = 0;
+    for (const auto& [name, dict] : interpreter_->getVariables()->getAllDicts()) {
+        Variable var(name);
+        var.value = "DICT (" + std::to_string(dict.size()) + " entries)";
+        var.type = "dictionary";
+        var.variablesReference = kDictionaryReferenceBase + index++;
+        var.indexedVariables = static_cast<int>(dict.size());
+        variables.push_back(var);
+    }
+}
+
+// Custom request: the Local scalars written since a stop, instead of the
+// whole set. "generation" is one returned by an earlier delta; without it
+// the changes since the previous stop are sent. "reset" means the client
+// must drop what it has, e.g. after a restart cleared the variables.
+// Dictionaries are always included since the runtime writes their entries
+// directly.
+VariablesDeltaResponse DAPServer::handleVariablesDelta(const json& arguments) {
+    VariablesDeltaResponse response;
+    basic::BasicInterpreter* interpreter = interpreter_;
+    if (replay_ || !interpreter) {
+        response.reset = true;
+        return response;
     }
+    const basic::Variables* store = interpreter->getVariables();
+    uint64_t since = arguments.value("generation", previousStop_);
+    response.reset = since >= store->generation() || store->clearedAt() > since;
+    response.variables = scalarVariables(response.reset ? store->getAll() : store->changedSince(since), *store, since);
+    appendDictionaries(response.variables);
+    response.generation = lastStop_;
+    return response;
+}
+
+VariablesResponse DAPServer::dictionaryVariables(const VariablesArguments& arguments) {
+    VariablesResponse response;
+    const auto& dicts = interpreter_->getVariables()->getAllDicts();
+    size_t index = static_cast<size_t>(arguments.variablesReference - kDictionaryReferenceBase);
+    if (index >= dicts.size()) {
+        return response;
+    }
+    const basic::Dictionary& dict = std::next(dicts.begin(), index)->second;
     
-    return {{"variables", variables}};
+    // Only the requested page is formatted
+    size_t start = static_cast<size_t>(std::max(arguments.start, 0));
+    size_t count = static_cast<size_t>(std::max(arguments.count, 0));
+    size_t end = count > 0 ? start + count : dict.size();
+    size_t position = 0;
+    dict.forEach([&](const basic::Value& key, const basic::Value& value) {
+        if (position >= start && position < end) {
+            std::string keyText = basic::valueToString(key);
+            Variable var(std::holds_alternative<std::string>(key) ? "\"" + keyText + "\"" : keyText);
+            var.value = basic::valueToString(value);
+            var.type = std::holds_alternative<std::string>(value) ? "string" : "number";
+            response.variables.push_back(var);
+        }
+        ++position;
+    });
+    return response;
 }
 
 json DAPServer::handleEvaluate(const json& arguments) {
     std::string expression = arguments["expression"];
     json result;
 
+    if (replay_) {
+        // Only recorded values can be shown; nothing is executed
+        const auto& variables = replay_->seek(replayStep_).variables;
+        auto it = variables.find(expression);
+        result["result"] = it != variables.end() ? basic::valueToString(it->second)
+                                                 : "[DAP] Not a variable recorded at this step";
+        result["variablesReference"] = 0;
+        return result;
+    }
+
     // Get the interpreter instance
-    basic::BasicInterpreter* interpreter = basic::getInterpreter();
+    basic::BasicInterpreter* interpreter = interpreter_;
     if (!interpreter) {
         result["result"] = "[DAP] No interpreter instance available.";
         result["type"] = "error";
@@ -775,43 +1028,30 @@ json DAPServer::handleSetVariable(const json& arguments) {
     return result;
 }
 
-json DAPServer::handleSource(const json& arguments) {
+SourceResponse DAPServer::handleSource(const json& arguments) {
     std::string path;
     if (arguments.contains("path")) {
         path = arguments["path"];
     } else if (arguments.contains("source") && arguments["source"].contains("path")) {
         path = arguments["source"]["path"];
     }
-    std::string content = getSource(path); // getSource should return the content for the given path
-    if (!content.empty()) {
-        return {{"content", content}};
-    } else {
-        return {{"content", ""}};
-    }
+    return SourceResponse(getSource(path));
 }
 
-json DAPServer::handleThreads(const json& arguments) {
-    json threads = json::array();
-    
-    Thread mainThread(1);
-    mainThread.name = "Main Thread";
-    threads.push_back(mainThread.toJson());
-    
-    return {{"threads", threads}};
+ThreadsResponse DAPServer::handleThreads(const json& arguments) {
+    ThreadsResponse response;
+    response.threads = getThreads();
+    return response;
 }
 
 json DAPServer::handleModules(const json& arguments) {
     return {{"modules", json::array()}};
 }
 
-json DAPServer::handleLoadedSources(const json& arguments) {
-    json sources = json::array();
-    
-    for (const auto& source : getLoadedSources()) {
-        sources.push_back(source.toJson());
-    }
-    
-    return {{"sources", sources}};
+LoadedSourcesResponse DAPServer::handleLoadedSources(const json& arguments) {
+    LoadedSourcesResponse response;
+    response.sources = getLoadedSources();
+    return response;
 }
 
 json DAPServer::handleExceptionInfo(const json& arguments) {
@@ -821,6 +1061,9 @@ json DAPServer::handleExceptionInfo(const json& arguments) {
 json DAPServer::handleLoadSource(const json& arguments) {
     std::string sourcePath = arguments["path"];
     std::string content = arguments["content"];
+    if (debugging_ && !replay_ && case_insensitive_compare(sourcePath, currentSource_)) {
+        return applySourceEdit(sourcePath, content);
+    }
     addSource(sourcePath, content);
 
     // Optionally send a loadedSource event
@@ -829,10 +1072,145 @@ json DAPServer::handleLoadSource(const json& arguments) {
     return {{"success", true}, {"path", sourcePath}};
 }
 
+// The file was saved: re-read it and patch the running program
+json DAPServer::handleSourceChanged(const json& arguments) {
+    std::string sourcePath = arguments.value("path", currentSource_);
+    if (!debugging_ || replay_ || !case_insensitive_compare(sourcePath, currentSource_)) {
+        return {{"success", false}, {"reason", "Not the source being debugged"}};
+    }
+    return applySourceEdit(sourcePath, readFileContent(sourcePath));
+}
+
+json DAPServer::applySourceEdit(const std::string& path, const std::string& content) {
+    if (content == getSource(path)) {
+        return {{"success", true}, {"path", path}, {"patched", false}};
+    }
+    basic::BasicInterpreter* interpreter = interpreter_;
+    if (!interpreter->patchProgram(content)) {
+        // The session keeps running the old version
+        std::string reason = interpreter->getLastError();
+        sendOutputEvent("stderr", "Edit not applied: " + reason + "\n");
+        return {{"success", false}, {"path", path}, {"reason", reason}};
+    }
+
+    sources_[path] = content;
+    resyncBreakpoints();
+    sendOutputEvent("console", "Applied edit to " + path + "\n");
+    currentLine_ = interpreter->getCurrentLine();
+    sendStoppedEvent("hot patch", currentThread_, currentLine_);
+    return {{"success", true}, {"path", path}, {"patched", true}};
+}
+
 json DAPServer::handleConfigurationDone(const json& arguments) {
     return json::object();
 }
 
+json DAPServer::handleStepBack(const json& arguments) {
+    if (!replay_) {
+        sendOutputEvent("console", "Stepping back needs a trace: record one with --run <file> --record <trace> "
+                                   "and launch with \"trace\": \"<trace>\"\n");
+        sendStoppedEvent("step", currentThread_, currentLine_);
+        return json::object();
+    }
+    replayMoveTo(replayStep_ > 0 ? replayStep_ - 1 : 0, "step");
+    return json::object();
+}
+
+json DAPServer::handleReverseContinue(const json& arguments) {
+    if (!replay_) {
+        return handleStepBack(arguments);
+    }
+    auto hit = replay_->find(replayStep_, false, [this](int line) { return isReplayBreakpoint(line); });
+    replayMoveTo(hit ? *hit : 0, hit ? "breakpoint" : "entry");
+    return json::object();
+}
+
+bool DAPServer::loadTrace(const std::string& path) {
+    try {
+        replay_ = std::make_unique<basic::TraceReader>(path);
+    } catch (const std::exception& e) {
+        sendOutputEvent("stderr", std::string("Cannot replay trace: ") + e.what() + "\n");
+        return false;
+    }
+    sendOutputEvent("console", "Replaying " + std::to_string(replay_->steps()) + " recorded steps from " + path + "\n");
+    return true;
+}
+
+void DAPServer::replayMoveTo(size_t step, const std::string& reason) {
+    replayStep_ = step;
+    currentLine_ = replay_->seek(step).line;
+    if (step == replay_->steps() && !replay_->ok()) {
+        sendOutputEvent("stderr", "Recorded run stopped: " + replay_->error() + "\n");
+        sendStoppedEvent("exception", currentThread_, currentLine_);
+        return;
+    }
+    sendStoppedEvent(reason, currentThread_, currentLine_);
+}
+
+bool DAPServer::isReplayBreakpoint(int line) const {
+    return activeBreakpointLines_.count(line) > 0;
+}
+
+// Scalars and arrays at the current trace step. In replay the references from
+// kDictionaryReferenceBase up are the arrays, paged like dictionaries.
+VariablesResponse DAPServer::replayVariables(const VariablesArguments& arguments) {
+    int variablesReference = arguments.variablesReference;
+    VariablesResponse response;
+    std::vector<Variable>& variables = response.variables;
+    const basic::TraceReader::State& state = replay_->seek(replayStep_);
+    auto typeOf = [](const basic::Value& value) {
+        if (std::holds_alternative<std::string>(value)) return "string";
+        if (std::holds_alternative<bool>(value)) return "boolean";
+        return "number";
+    };
+
+    if (variablesReference == 1 || variablesReference == 2) {
+        for (const auto& [name, value] : state.variables) {
+            Variable var(name);
+            var.value = basic::valueToString(value);
+            var.type = typeOf(value);
+            variables.push_back(var);
+        }
+        int index = 0;
+        for (const auto& [name, array] : state.arrays) {
+            std::string shape;
+            for (int dim : array.dims) {
+                shape += (shape.empty() ? "" : ", ") + std::to_string(dim - 1);
+            }
+            Variable var(name + "()");
+            var.value = "ARRAY (" + shape + ")";
+            var.type = "array";
+            var.variablesReference = kDictionaryReferenceBase + index++;
+            var.indexedVariables = static_cast<int>(array.data.size());
+            variables.push_back(var);
+        }
+    } else if (variablesReference >= kDictionaryReferenceBase) {
+        size_t index = static_cast<size_t>(variablesReference - kDictionaryReferenceBase);
+        if (index < state.arrays.size()) {
+            const basic::Array& array = std::next(state.arrays.begin(), index)->second;
+            size_t start = std::min(static_cast<size_t>(std::max(arguments.start, 0)), array.data.size());
+            size_t count = static_cast<size_t>(std::max(arguments.count, 0));
+            size_t end = count > 0 ? std::min(start + count, array.data.size()) : array.data.size();
+            for (size_t i = start; i < end; ++i) {
+                // Row-major offset back to subscripts
+                std::string subscripts;
+                size_t rest = i;
+                for (size_t d = array.dims.size(); d > 0; --d) {
+                    size_t extent = static_cast<size_t>(array.dims[d - 1]);
+                    std::string part = std::to_string(extent ? rest % extent : 0);
+                    subscripts = subscripts.empty() ? part : part + ", " + subscripts;
+                    rest = extent ? rest / extent : 0;
+                }
+                Variable var("(" + subscripts + ")");
+                var.value = basic::valueToString(array.data[i]);
+                var.type = typeOf(array.data[i]);
+                variables.push_back(var);
+            }
+        }
+    }
+    return response;
+}
+
 
 // Event handlers
 void DAPServer::sendInitializedEvent() {
@@ -846,6 +1224,75 @@ void DAPServer::sendStoppedEvent(const std::string& reason, int threadId, int li
     body["allThreadsStopped"] = true;
     body["line"] = line;
     sendEvent("stopped", body);
+    if (!replay_ && interpreter_) {
+        previousStop_ = lastStop_;
+        lastStop_ = interpreter_->getVariables()->advanceGeneration();
+    }
+    // Built while the client is still reading the event
+    ++stopGeneration_;
+    captureStopSnapshot();
+}
+
+void DAPServer::captureStopSnapshot() {
+    BASIC_TIMELINE_SCOPE("dap stop snapshot");
+    stopSnapshot_.threads = protocol::serialize(handleThreads(json::object()));
+    stopSnapshot_.stackTrace = protocol::serialize(handleStackTrace(StackTraceArguments()));
+    stopSnapshot_.scopes = protocol::serialize(handleScopes(ScopesArguments()));
+    stopSnapshot_.locals = protocol::serialize(handleVariables(VariablesArguments(1)));
+    stopSnapshot_.generation = stopGeneration_;
+}
+
+bool DAPServer::answerFromStopSnapshot(const DAPMessage& message, DAPRequestType command) {
+    // Requests that only read the paused state keep the snapshot; any
+    // other (stepping, setVariable, evaluate, an edit...) retires it
+    const std::string* body = nullptr;
+    switch (command) {
+    case DAPRequestType::THREADS: body = &stopSnapshot_.threads; break;
+    case DAPRequestType::STACKTRACE: body = &stopSnapshot_.stackTrace; break;
+    case DAPRequestType::SCOPES: body = &stopSnapshot_.scopes; break;
+    case DAPRequestType::VARIABLES:
+        if (message.arguments.is_object() && message.arguments.value("variablesReference", 0) == 1) {
+            body = &stopSnapshot_.locals;
+        }
+        break;
+    case DAPRequestType::VARIABLESDELTA:
+    case DAPRequestType::SOURCE:
+    case DAPRequestType::LOADEDSOURCES:
+    case DAPRequestType::MODULES:
+    case DAPRequestType::EXCEPTIONINFO:
+    case DAPRequestType::SETBREAKPOINTS:
+    case DAPRequestType::SETFUNCTIONBREAKPOINTS:
+    case DAPRequestType::SETEXCEPTIONBREAKPOINTS:
+        break;
+    default:
+        ++stopGeneration_;
+        return false;
+    }
+    if (!body || stopSnapshot_.generation == 0 || stopSnapshot_.generation != stopGeneration_) {
+        return false;
+    }
+    sendResponseBody(message, *body);
+    return true;
+}
+
+void DAPServer::sendResponseBody(const DAPMessage& request, const std::string& body) {
+    BASIC_TIMELINE_SCOPE("dap send", request.command);
+    // Same members, in the same order, as sendMessage writes
+    std::string content = "{\"body\":" + body + ",\"command\":" + json(request.command).dump() +
+        ",\"request_seq\":" + request.id.dump() + ",\"seq\":1,\"success\":true,\"type\":\"response\"}";
+    if (enableLogging_) {
+        std::cerr << "[DAP] Sending: " << content << std::endl;
+    }
+    writeFrame(content);
+}
+
+void DAPServer::respond(const DAPMessage& request, const json& body) {
+    sendMessage(createResponse(request.id, body));
+}
+
+template <typename T>
+void DAPServer::respond(const DAPMessage& request, const T& body) {
+    sendResponseBody(request, protocol::serialize(body));
 }
 
 void DAPServer::sendContinuedEvent(int threadId) {
@@ -873,10 +1320,7 @@ void DAPServer::sendThreadEvent(const std::string& reason, int threadId) {
 }
 
 void DAPServer::sendOutputEvent(const std::string& category, const std::string& output) {
-    json body;
-    body["category"] = category;
-    body["output"] = output;
-    sendEvent("output", body);
+    sendEventBody("output", protocol::serialize(OutputEvent(category, output)));
 }
 
 void DAPServer::sendBreakpointEvent(const std::string& reason, const Breakpoint& breakpoint) {
@@ -917,13 +1361,10 @@ void DAPServer::sendCapabilitiesEvent(const json& capabilities) {
 
 // Debugger control methods
 void DAPServer::setBreakpoint(const std::string& source, int line) {
-    breakpoints_[source].insert(line);
-    
-    Breakpoint bp(nextBreakpointId_++);
-    bp.line = line;
-    bp.source = source;
-    bp.verified = true;
-    breakpointMap_[bp.id] = bp;
+    if (breakpoints_[source].try_emplace(line, Breakpoint(nextBreakpointId_)).second) {
+        nextBreakpointId_++;
+    }
+    resyncBreakpoints();
 }
 
 void DAPServer::removeBreakpoint(const std::string& source, int line) {
@@ -931,20 +1372,24 @@ void DAPServer::removeBreakpoint(const std::string& source, int line) {
     if (it != breakpoints_.end()) {
         it->second.erase(line);
     }
+    resyncBreakpoints();
 }
 
 void DAPServer::clearBreakpoints() {
     breakpoints_.clear();
-    breakpointMap_.clear();
+    resyncBreakpoints();
 }
 
 void DAPServer::step() {
     if (paused_) {
         currentLine_++;
         paused_ = false;
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        {
+            BASIC_TIMELINE_SCOPE("dap step sleep");
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
         paused_ = true;
-        basic::BasicInterpreter* interpreter = basic::getInterpreter();
+        basic::BasicInterpreter* interpreter = interpreter_;
         interpreter->step();
         currentLine_ = interpreter->getCurrentLine();
         sendStoppedEvent("step", currentThread_, currentLine_);
@@ -1027,13 +1472,10 @@ std::vector<StackFrame> DAPServer::getStackTrace(int threadId) {
     
     StackFrame frame(1);
     frame.name = "main";
-    // Set source as an object with name, path, and sourceReference fields
-    frame.source = {
-        {"name", currentSource_},
-        {"path", currentSource_},
-        {"sourceReference", 0}
-    };
-    frame.line = currentLine_;
+    auto [source, line] = currentPosition();
+    frame.source.name = source;
+    frame.source.path = source;
+    frame.line = line;
     frame.column = 0;
     frames.push_back(frame);
     
@@ -1058,6 +1500,58 @@ void DAPServer::addSource(const std::string& path, const std::string& content) {
     std::cerr << "DAP: Total sources loaded: " << sources_.size() << std::endl;
 }
 
+std::shared_ptr<const basic::Program> DAPServer::linkedProgram() {
+    std::string content = getSource(currentSource_);
+    if (content.empty()) {
+        return nullptr;
+    }
+    if (!program_ || program_->source() != content) {
+        program_ = basic::Program::link(currentSource_, [this, &content](const std::string& path) {
+            if (path == currentSource_) {
+                return std::optional<std::string>(content);
+            }
+            // Included files are read from disk so edits saved since are seen
+            std::optional<std::string> text = basic::Program::readFile(path);
+            if (!text && !getSource(path).empty()) {
+                text = getSource(path);
+            }
+            if (text) {
+                bool known = sources_.count(path) > 0;
+                sources_[path] = *text;
+                if (!known) {
+                    sendLoadedSourceEvent("new", Source(path));
+                }
+            }
+            return text;
+        });
+    }
+    return program_;
+}
+
+std::shared_ptr<const basic::Program> DAPServer::programFor(const std::string& path) {
+    if (case_insensitive_compare(path, currentSource_)) {
+        auto linked = linkedProgram();
+        return linked && !linked->modules().empty() ? linked->modules()[0].program : linked;
+    }
+    if (program_) {
+        int module = program_->moduleIndex(path);
+        if (module >= 0) {
+            return program_->modules()[static_cast<size_t>(module)].program;
+        }
+    }
+    std::string content = getSource(path);
+    return content.empty() ? nullptr : basic::ProgramCache::shared().get(content);
+}
+
+// Lines of an included file are reported in that file
+std::pair<std::string, int> DAPServer::currentPosition() const {
+    if (!replay_ && program_ && !program_->modules().empty()) {
+        basic::Program::Location location = program_->location(currentLine_);
+        return {program_->modules()[location.module].path, location.line};
+    }
+    return {currentSource_, currentLine_};
+}
+
 std::string DAPServer::getSource(const std::string& path) const {
     auto it = sources_.find(path);
     return it != sources_.end() ? it->second : "";
@@ -1107,28 +1601,20 @@ DAPMessage DAPServer::createErrorResponse(const json& id, int code, const std::s
 }
 
 void DAPServer::sendEvent(const std::string& event, const nlohmann::json& body) {
-    nlohmann::json message;
-    message["type"] = "event";
-    message["event"] = event;
-    message["body"] = body;
+    sendEventBody(event, body.dump());
+}
 
-    // Serialize the message to a string
-    std::string content = message.dump();
+void DAPServer::sendEventBody(const std::string& event, const std::string& body) {
+    BASIC_TIMELINE_SCOPE("dap send event", event);
+    // Same members, in the same order, as a dumped json message
+    std::string content = "{\"body\":" + body + ",\"event\":" + protocol::serialize(event) + ",\"type\":\"event\"}";
 
     if (enableLogging_) {
         std::cerr << "[DAP] Sending Event: " << content << std::endl;
     }
 
 
-    // DAP protocol requires a Content-Length header
-    std::string header = "Content-Length: " + std::to_string(content.size()) + "\r\n\r\n";
-
-    // Write header and content to stdout (or socket if using network)
-    if (useNetwork_) {
-        sendNetwork(header + content);
-    } else {
-        std::cout << header << content << std::flush;
-    }
+    writeFrame(content);
 }
 
 int DAPServer::nextBreakpointId() {
@@ -1138,18 +1624,15 @@ int DAPServer::nextBreakpointId() {
 bool DAPServer::hasBreakpoint(const std::string& source, int line) {
     auto it = breakpoints_.find(source);
     if (it != breakpoints_.end()) {
-        return it->second.find(line) != it->second.end();
+        for (const auto& [requestedLine, breakpoint] : it->second) {
+            if (breakpoint.verified && breakpoint.line == line) {
+                return true;
+            }
+        }
     }
     return false;
 }
 
-void DAPServer::updateBreakpointStatus() {
-    // Update breakpoint verification status
-    for (auto& pair : breakpointMap_) {
-        pair.second.verified = true;
-    }
-}
-
 // Called by the interpreter after each statement or line
 void DAPServer::checkForStep(int line) {
     std::unique_lock<std::mutex> lock(mutex_);
@@ -1157,11 +1640,12 @@ void DAPServer::checkForStep(int line) {
     // Check if we are in step mode or if a breakpoint is set at this line
     if (shouldPauseAt(line)) {
         // Send "stopped" event to the client with the current line number
-        sendStoppedEvent("step", 1, line);
         if( line > 0 ) {
             currentLine_ = line;
         }
+        sendStoppedEvent("step", 1, line);
         // Wait until the user resumes (step/continue)
+        BASIC_TIMELINE_SCOPE("dap wait for resume");
         pauseCondition_.wait(lock, [this]() { return !paused_; });
     }
 }
@@ -1171,13 +1655,8 @@ bool DAPServer::shouldPauseAt(int line) {
     // Check step mode or breakpoint
     if (stepMode_) return true;
     
-    // Check if any breakpoint is set at this line in any source
-    for (const auto& sourceBreakpoints : breakpoints_) {
-        if (sourceBreakpoints.second.find(line) != sourceBreakpoints.second.end()) {
-            return true;
-        }
-    }
-    return false;
+    // Only the current source's breakpoints are set
+    return activeBreakpointLines_.count(line) > 0;
 }
 
 
@@ -0,0 +1,80 @@
+#include "interpreter/alloc_profile.h"
+#include "interpreter/program.h"
+#include "protocol/json_escape.h"
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+
+namespace basic {
+
+void AllocationProfile::grow(int line) {
+    size_t oldSize = lines_.size();
+    lines_.resize(std::max<size_t>(static_cast<size_t>(line) + 1, oldSize * 2));
+    for (size_t i = oldSize; i < lines_.size(); ++i) {
+        lines_[i].line = static_cast<int>(i);
+    }
+}
+
+std::vector<LineAllocations> AllocationProfile::sorted() const {
+    std::vector<LineAllocations> result;
+    for (const LineAllocations& entry : lines_) {
+        if (entry.count != 0) result.push_back(entry);
+    }
+    std::stable_sort(result.begin(), result.end(), [](const LineAllocations& a, const LineAllocations& b) {
+        return a.bytes > b.bytes;
+    });
+    return result;
+}
+
+void AllocationProfile::writeReport(std::ostream& out, const Program* program, size_t maxLines) const {
+    std::vector<LineAllocations> entries = sorted();
+    size_t total = 0;
+    for (const LineAllocations& entry : entries) total += entry.bytes;
+
+    out << "Allocation profile (" << formatBytes(total) << " in " << entries.size() << " lines)\n";
+    out << std::setw(6) << "line" << std::setw(10) << "count" << std::setw(12) << "bytes"
+        << std::setw(8) << "%" << std::setw(12) << "peak" << "  source\n";
+    for (size_t i = 0; i < entries.size() && i < maxLines; ++i) {
+        const LineAllocations& entry = entries[i];
+        std::string text;
+        if (program && static_cast<size_t>(entry.line) <= program->size()) {
+            text = program->lines()[entry.line - 1].text;
+        }
+        double percent = total ? 100.0 * static_cast<double>(entry.bytes) / static_cast<double>(total) : 0.0;
+        out << std::setw(6) << entry.line << std::setw(10) << entry.count << std::setw(12)
+            << formatBytes(entry.bytes) << std::setw(7) << std::fixed << std::setprecision(1) << percent
+            << "%" << std::setw(12) << formatBytes(entry.peak) << "  " << text << "\n";
+    }
+}
+
+void AllocationProfile::writeHints(std::ostream& out, const std::string& source) const {
+    std::string escaped;
+    protocol::appendEscaped(escaped, source);
+    out << "{\"version\":1,\"source\":\"" << escaped << "\",\"lines\":[";
+    bool first = true;
+    for (const LineAllocations& entry : sorted()) {
+        out << (first ? "" : ",") << "{\"line\":" << entry.line << ",\"count\":" << entry.count
+            << ",\"bytes\":" << entry.bytes << ",\"peak\":" << entry.peak << "}";
+        first = false;
+    }
+    out << "]}\n";
+}
+
+std::string formatBytes(size_t bytes) {
+    static const char* const units[] = {"B", "KB", "MB", "GB", "TB"};
+    double value = static_cast<double>(bytes);
+    int unit = 0;
+    while (value >= 1024 && unit < 4) {
+        value /= 1024;
+        ++unit;
+    }
+    char buffer[32];
+    if (unit == 0) {
+        std::snprintf(buffer, sizeof(buffer), "%zu B", bytes);
+    } else {
+        std::snprintf(buffer, sizeof(buffer), "%.1f %s", value, units[unit]);
+    }
+    return buffer;
+}
+
+} // namespace basic
@@ -0,0 +1,506 @@
+#include "interpreter/array_sort.h"
+#include "interpreter/variables.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+namespace basic {
+
+namespace {
+
+constexpr size_t kParallelThreshold = 1 << 18;
+constexpr size_t kMaxSortThreads = 8;
+
+// ---------------------------------------------------------------------------
+// pdqsort (pattern-defeating quicksort, Orson Peters). Median-of-3 / ninther
+// pivots, insertion sort for short ranges, early exit on already partitioned
+// input and a heapsort fallback after too many unbalanced partitions.
+// ---------------------------------------------------------------------------
+
+constexpr ptrdiff_t kInsertionSortThreshold = 24;
+constexpr ptrdiff_t kNintherThreshold = 128;
+constexpr ptrdiff_t kPartialInsertionSortLimit = 8;
+
+template <typename It, typename Less>
+void insertionSort(It begin, It end, Less less) {
+    if (begin == end) return;
+    for (It cur = begin + 1; cur != end; ++cur) {
+        It sift = cur;
+        It siftPrev = cur - 1;
+        if (less(*sift, *siftPrev)) {
+            auto tmp = std::move(*sift);
+            do {
+                *sift-- = std::move(*siftPrev);
+            } while (sift != begin && less(tmp, *--siftPrev));
+            *sift = std::move(tmp);
+        }
+    }
+}
+
+// Requires *(begin - 1) to be no greater than any element in the range
+template <typename It, typename Less>
+void unguardedInsertionSort(It begin, It end, Less less) {
+    if (begin == end) return;
+    for (It cur = begin + 1; cur != end; ++cur) {
+        It sift = cur;
+        It siftPrev = cur - 1;
+        if (less(*sift, *siftPrev)) {
+            auto tmp = std::move(*sift);
+            do {
+                *sift-- = std::move(*siftPrev);
+            } while (less(tmp, *--siftPrev));
+            *sift = std::move(tmp);
+        }
+    }
+}
+
+// Insertion sort that gives up once too many elements have moved
+template <typename It, typename Less>
+bool partialInsertionSort(It begin, It end, Less less) {
+    if (begin == end) return true;
+    ptrdiff_t moved = 0;
+    for (It cur = begin + 1; cur != end; ++cur) {
+        It sift = cur;
+        It siftPrev = cur - 1;
+        if (less(*sift, *siftPrev)) {
+            auto tmp = std::move(*sift);
+            do {
+                *sift-- = std::move(*siftPrev);
+            } while (sift != begin && less(tmp, *--siftPrev));
+            *sift = std::move(tmp);
+            moved += cur - sift;
+        }
+        if (moved > kPartialInsertionSortLimit) return false;
+    }
+    return true;
+}
+
+template <typename It, typename Less>
+void sort2(It a, It b, Less less) {
+    if (less(*b, *a)) std::iter_swap(a, b);
+}
+
+template <typename It, typename Less>
+void sort3(It a, It b, It c, Less less) {
+    sort2(a, b, less);
+    sort2(b, c, less);
+    sort2(a, b, less);
+}
+
+// Partitions around *begin; elements equal to the pivot go right. Returns the
+// pivot position and whether the range was already partitioned.
+template <typename It, typename Less>
+std::pair<It, bool> partitionRight(It begin, It end, Less less) {
+    auto pivot = std::move(*begin);
+    It first = begin;
+    It last = end;
+
+    while (less(*++first, pivot));
+    if (first - 1 == begin) {
+        while (first < last && !less(*--last, pivot));
+    } else {
+        while (!less(*--last, pivot));
+    }
+
+    bool alreadyPartitioned = first >= last;
+    while (first < last) {
+        std::iter_swap(first, last);
+        while (less(*++first, pivot));
+        while (!less(*--last, pivot));
+    }
+
+    It pivotPos = first - 1;
+    *begin = std::move(*pivotPos);
+    *pivotPos = std::move(pivot);
+    return {pivotPos, alreadyPartitioned};
+}
+
+// Partitions around *begin with elements equal to the pivot going left; used
+// when the pivot equals the previous pivot so runs of equal keys finish fast.
+template <typename It, typename Less>
+It partitionLeft(It begin, It end, Less less) {
+    auto pivot = std::move(*begin);
+    It first = begin;
+    It last = end;
+
+    while (less(pivot, *--last));
+    if (last + 1 == end) {
+        while (first < last && !less(pivot, *++first));
+    } else {
+        while (!less(pivot, *++first));
+    }
+
+    while (first < last) {
+        std::iter_swap(first, last);
+        while (less(pivot, *--last));
+        while (!less(pivot, *++first));
+    }
+
+    It pivotPos = last;
+    *begin = std::move(*pivotPos);
+    *pivotPos = std::move(pivot);
+    return pivotPos;
+}
+
+template <typename It, typename Less>
+void pdqsortLoop(It begin, It end, Less less, int badAllowed, bool leftmost) {
+    for (;;) {
+        ptrdiff_t size = end - begin;
+        if (size < kInsertionSortThreshold) {
+            if (leftmost) {
+                insertionSort(begin, end, less);
+            } else {
+                unguardedInsertionSort(begin, end, less);
+            }
+            return;
+        }
+
+        ptrdiff_t half = size / 2;
+        if (size > kNintherThreshold) {
+            sort3(begin, begin + half, end - 1, less);
+            sort3(begin + 1, begin + (half - 1), end - 2, less);
+            sort3(begin + 2, begin + (half + 1), end - 3, less);
+            sort3(begin + (half - 1), begin + half, begin + (half + 1), less);
+            std::iter_swap(begin, begin + half);
+        } else {
+            sort3(begin + half, begin, end - 1, less);
+        }
+
+        if (!leftmost && !less(*(begin - 1), *begin)) {
+            begin = partitionLeft(begin, end, less) + 1;
+            continue;
+        }
+
+        auto [pivotPos, alreadyPartitioned] = partitionRight(begin, end, less);
+        ptrdiff_t leftSize = pivotPos - begin;
+        ptrdiff_t rightSize = end - (pivotPos + 1);
+
+        if (leftSize < size / 8 || rightSize < size / 8) {
+            if (--badAllowed == 0) {
+                std::make_heap(begin, end, less);
+                std::sort_heap(begin, end, less);
+                return;
+            }
+            // Shuffle a few elements to break up the pattern
+            if (leftSize >= kInsertionSortThreshold) {
+                std::iter_swap(begin, begin + leftSize / 4);
+                std::iter_swap(pivotPos - 1, pivotPos - leftSize / 4);
+                if (leftSize > kNintherThreshold) {
+                    std::iter_swap(begin + 1, begin + (leftSize / 4 + 1));
+                    std::iter_swap(begin + 2, begin + (leftSize / 4 + 2));
+                    std::iter_swap(pivotPos - 2, pivotPos - (leftSize / 4 + 1));
+                    std::iter_swap(pivotPos - 3, pivotPos - (leftSize / 4 + 2));
+                }
+            }
+            if (rightSize >= kInsertionSortThreshold) {
+                std::iter_swap(pivotPos + 1, pivotPos + (1 + rightSize / 4));
+                std::iter_swap(end - 1, end - rightSize / 4);
+                if (rightSize > kNintherThreshold) {
+                    std::iter_swap(pivotPos + 2, pivotPos + (2 + rightSize / 4));
+                    std::iter_swap(pivotPos + 3, pivotPos + (3 + rightSize / 4));
+                    std::iter_swap(end - 2, end - (1 + rightSize / 4));
+                    std::iter_swap(end - 3, end - (2 + rightSize / 4));
+                }
+            }
+        } else if (alreadyPartitioned &&
+                   partialInsertionSort(begin, pivotPos, less) &&
+                   partialInsertionSort(pivotPos + 1, end, less)) {
+            return;
+        }
+
+        pdqsortLoop(begin, pivotPos, less, badAllowed, leftmost);
+        begin = pivotPos + 1;
+        leftmost = false;
+    }
+}
+
+template <typename It, typename Less>
+void pdqsort(It begin, It end, Less less) {
+    if (begin == end) return;
+    int log2 = 0;
+    for (ptrdiff_t n = end - begin; n > 1; n >>= 1) ++log2;
+    pdqsortLoop(begin, end, less, log2, true);
+}
+
+// ---------------------------------------------------------------------------
+// Sort entries. Each carries the element's original index so the values can
+// be permuted afterwards and ties resolve in index order.
+// ---------------------------------------------------------------------------
+
+struct NumericEntry {
+    uint64_t key;
+    uint32_t index;
+};
+
+struct StringEntry {
+    uint64_t prefix; // first 8 bytes, big-endian, zero padded
+    uint32_t index;
+    const std::string* text;
+};
+
+bool numericLess(const NumericEntry& a, const NumericEntry& b) {
+    return a.key != b.key ? a.key < b.key : a.index < b.index;
+}
+
+bool stringLess(const StringEntry& a, const StringEntry& b) {
+    if (a.prefix != b.prefix) return a.prefix < b.prefix;
+    int result = std::string_view(*a.text).compare(*b.text);
+    return result != 0 ? result < 0 : a.index < b.index;
+}
+
+// Maps numbers to unsigned keys with the same ordering
+uint64_t integerKey(int value) {
+    return static_cast<uint32_t>(value) ^ 0x80000000u;
+}
+
+// -0.0 and 0.0 compare equal, so they share a key and keep their order
+uint64_t doubleKey(double value) {
+    if (value == 0) value = 0.0;
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0x8000000000000000ull) ? ~bits : bits | 0x8000000000000000ull;
+}
+
+int integerFromKey(uint64_t key) {
+    return static_cast<int>(static_cast<uint32_t>(key) ^ 0x80000000u);
+}
+
+double doubleFromKey(uint64_t key) {
+    uint64_t bits = (key & 0x8000000000000000ull) ? key & ~0x8000000000000000ull : ~key;
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+uint64_t stringPrefix(const std::string& text) {
+    uint64_t prefix = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        prefix <<= 8;
+        if (i < text.size()) prefix |= static_cast<unsigned char>(text[i]);
+    }
+    return prefix;
+}
+
+// Stable LSD radix sort on 8-bit digits. Digits that are the same for
+// every entry (e.g. the upper half of integer keys) are skipped.
+constexpr int kRadixBits = 8;
+constexpr int kRadixBuckets = 1 << kRadixBits;
+constexpr int kRadixDigits = (64 + kRadixBits - 1) / kRadixBits;
+
+size_t radixDigit(uint64_t key, int digit) {
+    return static_cast<size_t>(key >> (digit * kRadixBits)) & (kRadixBuckets - 1);
+}
+
+void radixSort(NumericEntry* begin, NumericEntry* end) {
+    size_t n = static_cast<size_t>(end - begin);
+    if (n < 2) return;
+
+    std::vector<size_t> counts(kRadixDigits * kRadixBuckets, 0);
+    for (NumericEntry* entry = begin; entry != end; ++entry) {
+        for (int digit = 0; digit < kRadixDigits; ++digit) {
+            ++counts[digit * kRadixBuckets + radixDigit(entry->key, digit)];
+        }
+    }
+
+    std::vector<NumericEntry> scratch(n);
+    NumericEntry* src = begin;
+    NumericEntry* dst = scratch.data();
+    for (int digit = 0; digit < kRadixDigits; ++digit) {
+        size_t* count = &counts[digit * kRadixBuckets];
+        if (count[radixDigit(begin->key, digit)] == n) continue;
+
+        size_t offset = 0;
+        for (int bucket = 0; bucket < kRadixBuckets; ++bucket) {
+            size_t c = count[bucket];
+            count[bucket] = offset;
+            offset += c;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            dst[count[radixDigit(src[i].key, digit)]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+    if (src != begin) {
+        std::copy(src, src + n, begin);
+    }
+}
+
+// Sorts large inputs as independent chunks on worker threads, then merges
+// adjacent runs pairwise (also in parallel) until one run is left.
+template <typename Entry, typename SortChunk, typename Less>
+void sortEntries(std::vector<Entry>& entries, SortChunk sortChunk, Less less, size_t threads) {
+    size_t n = entries.size();
+    if (threads == 0) {
+        threads = std::min<size_t>(std::thread::hardware_concurrency(), kMaxSortThreads);
+    }
+    if (n < kParallelThreshold || threads < 2) {
+        sortChunk(entries.data(), entries.data() + n);
+        return;
+    }
+
+    std::vector<size_t> bounds;
+    for (size_t i = 0; i <= threads; ++i) {
+        bounds.push_back(n * i / threads);
+    }
+    {
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < threads; ++i) {
+            Entry* data = entries.data();
+            workers.emplace_back([&sortChunk, data, lo = bounds[i], hi = bounds[i + 1]] {
+                sortChunk(data + lo, data + hi);
+            });
+        }
+        for (auto& worker : workers) worker.join();
+    }
+
+    std::vector<Entry> buffer(n);
+    Entry* src = entries.data();
+    Entry* dst = buffer.data();
+    while (bounds.size() > 2) {
+        std::vector<size_t> merged;
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i + 1 < bounds.size(); i += 2) {
+            size_t lo = bounds[i];
+            size_t mid = bounds[i + 1];
+            size_t hi = i + 2 < bounds.size() ? bounds[i + 2] : mid;
+            workers.emplace_back([=] {
+                std::merge(src + lo, src + mid, src + mid, src + hi, dst + lo, less);
+            });
+            merged.push_back(lo);
+        }
+        merged.push_back(n);
+        for (auto& worker : workers) worker.join();
+        std::swap(src, dst);
+        bounds.swap(merged);
+    }
+    if (src != entries.data()) {
+        std::copy(src, src + n, entries.data());
+    }
+}
+
+template <typename Entry>
+void permute(std::pmr::vector<Value>& data, const std::vector<Entry>& order) {
+    std::pmr::vector<Value> sorted(data.get_allocator());
+    sorted.reserve(data.size());
+    for (const Entry& entry : order) {
+        sorted.push_back(std::move(data[entry.index]));
+    }
+    data.swap(sorted);
+}
+
+bool isNumeric(const Value& value) {
+    return !std::holds_alternative<std::string>(value);
+}
+
+double toNumber(const Value& value) {
+    if (std::holds_alternative<int>(value)) return std::get<int>(value);
+    if (std::holds_alternative<double>(value)) return std::get<double>(value);
+    if (std::holds_alternative<bool>(value)) return std::get<bool>(value) ? 1.0 : 0.0;
+    throw std::runtime_error("Cannot compare a string with a number");
+}
+
+} // namespace
+
+void sortArray(Array& keys, Array* payload, size_t threads) {
+    if (keys.dims.size() != 1) {
+        throw std::runtime_error("SORT requires a one-dimensional array");
+    }
+    if (payload == &keys) {
+        payload = nullptr;
+    }
+    if (payload && (payload->dims.size() != 1 || payload->data.size() != keys.data.size())) {
+        throw std::runtime_error("SORT BY requires arrays of the same size");
+    }
+
+    bool hasString = false;
+    bool hasDouble = false;
+    bool hasInteger = false;
+    bool hasBool = false;
+    for (const Value& value : keys.data) {
+        if (std::holds_alternative<std::string>(value)) hasString = true;
+        else if (std::holds_alternative<double>(value)) hasDouble = true;
+        else if (std::holds_alternative<int>(value)) hasInteger = true;
+        else hasBool = true;
+    }
+    if (hasString && (hasDouble || hasInteger || hasBool)) {
+        throw std::runtime_error("SORT cannot order an array that mixes strings and numbers");
+    }
+
+    size_t n = keys.data.size();
+    if (hasString) {
+        std::vector<StringEntry> entries(n);
+        for (size_t i = 0; i < n; ++i) {
+            const std::string& text = std::get<std::string>(keys.data[i]);
+            entries[i] = {stringPrefix(text), static_cast<uint32_t>(i), &text};
+        }
+        sortEntries(entries, [](StringEntry* begin, StringEntry* end) {
+            pdqsort(begin, end, stringLess);
+        }, stringLess, threads);
+        permute(keys.data, entries);
+        if (payload) {
+            permute(payload->data, entries);
+        }
+        return;
+    }
+
+    std::vector<NumericEntry> entries(n);
+    bool negativeZero = false;
+    for (size_t i = 0; i < n; ++i) {
+        const Value& value = keys.data[i];
+        double number = toNumber(value);
+        negativeZero = negativeZero || (number == 0 && std::signbit(number));
+        uint64_t key = hasDouble ? doubleKey(number) : integerKey(static_cast<int>(number));
+        entries[i] = {key, static_cast<uint32_t>(i)};
+    }
+    sortEntries(entries, radixSort, numericLess, threads);
+
+    if (payload) {
+        permute(payload->data, entries);
+    }
+    if (hasBool || (hasDouble && hasInteger) || negativeZero) {
+        permute(keys.data, entries);
+        return;
+    }
+    // Single-type arrays are rebuilt from the keys instead of moving values
+    for (size_t i = 0; i < n; ++i) {
+        if (hasDouble) {
+            keys.data[i] = doubleFromKey(entries[i].key);
+        } else {
+            keys.data[i] = integerFromKey(entries[i].key);
+        }
+    }
+}
+
+int searchArray(const Array& array, const Value& value) {
+    if (array.dims.size() != 1) {
+        throw std::runtime_error("BSEARCH requires a one-dimensional array");
+    }
+
+    auto begin = array.data.begin();
+    auto end = array.data.end();
+    decltype(begin) it;
+    if (std::holds_alternative<std::string>(value)) {
+        const std::string& target = std::get<std::string>(value);
+        it = std::lower_bound(begin, end, target, [](const Value& element, const std::string& t) {
+            if (isNumeric(element)) {
+                throw std::runtime_error("Cannot compare a string with a number");
+            }
+            return std::get<std::string>(element) < t;
+        });
+        if (it == end || std::get<std::string>(*it) != target) return -1;
+    } else {
+        double target = toNumber(value);
+        it = std::lower_bound(begin, end, target, [](const Value& element, double t) {
+            return toNumber(element) < t;
+        });
+        if (it == end || toNumber(*it) != target) return -1;
+    }
+    return static_cast<int>(it - begin);
+}
+
+} // namespace basic
@@ -0,0 +1,350 @@
+#include "interpreter/basic_c_api.h"
+#include "interpreter/basic_interpreter.h"
+#include "interpreter/context_pool.h"
+#include "interpreter/output.h"
+#include "interpreter/program.h"
+#include "interpreter/variables.h"
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+struct basic_program {
+    std::shared_ptr<const basic::Program> program;
+};
+
+struct basic_context {
+    std::unique_ptr<basic::BasicInterpreter> owned;
+    basic::ContextPool::Lease lease;
+    basic::BasicInterpreter* interpreter = nullptr;
+    std::string error;
+    std::string scratch; // backs strings handed out by basic_get
+};
+
+namespace {
+
+struct HostBinding {
+    std::string name;
+    basic_host_function function;
+    void* userData;
+};
+
+basic::Value toValue(const basic_value& value) {
+    if (value.type == BASIC_STRING) {
+        return basic::Value{std::string(value.string ? value.string : "")};
+    }
+    // Whole numbers become integers, as VAL does
+    double d = value.number;
+    if (d == std::floor(d) && d >= INT_MIN && d <= INT_MAX) {
+        return basic::Value{static_cast<int>(d)};
+    }
+    return basic::Value{d};
+}
+
+// The returned string points into value and lives as long as it does
+basic_value fromValue(const basic::Value& value) {
+    basic_value result{BASIC_NUMBER, 0.0, nullptr};
+    if (std::holds_alternative<int>(value)) {
+        result.number = std::get<int>(value);
+    } else if (std::holds_alternative<double>(value)) {
+        result.number = std::get<double>(value);
+    } else if (std::holds_alternative<bool>(value)) {
+        result.number = std::get<bool>(value) ? 1 : 0;
+    } else {
+        result.type = BASIC_STRING;
+        result.string = std::get<std::string>(value).c_str();
+    }
+    return result;
+}
+
+basic::HostFunction wrapHost(const std::string& name, basic_host_function function, void* userData) {
+    if (!function) {
+        return nullptr;
+    }
+    return [name, function, userData](const std::vector<basic::Value>& args) -> basic::Value {
+        std::vector<basic_value> converted;
+        converted.reserve(args.size());
+        for (const auto& arg : args) {
+            converted.push_back(fromValue(arg));
+        }
+        basic_value result{BASIC_NUMBER, 0.0, nullptr};
+        if (function(userData, converted.data(), static_cast<int>(converted.size()), &result) != 0) {
+            throw std::runtime_error("Host function '" + name + "' failed");
+        }
+        return toValue(result);
+    };
+}
+
+// Without a context there is nowhere to put the message
+int fail(basic_context* context, const std::string& message) {
+    if (context) {
+        context->error = message;
+    }
+    return -1;
+}
+
+// No C++ exception may unwind into a C caller: entry points run their body
+// through guard(), which turns one into the context's error
+template <typename Body>
+int guard(basic_context* context, Body&& body) {
+    if (!context) {
+        return -1;
+    }
+    try {
+        return body();
+    } catch (const std::exception& e) {
+        return fail(context, e.what());
+    } catch (...) {
+        return fail(context, "Unknown error");
+    }
+}
+
+} // namespace
+
+struct basic_pool {
+    std::mutex mutex;
+    std::vector<HostBinding> bindings;
+    bool captureOutput = false;
+    std::unique_ptr<basic::ContextPool> pool;
+};
+
+extern "C" {
+
+basic_program* basic_compile(const char* source, char* error, int error_size) {
+    std::string message;
+    try {
+        auto program = basic::ProgramCache::shared().get(source ? source : "");
+        if (program->error().empty()) {
+            return new basic_program{std::move(program)};
+        }
+        message = program->error();
+    } catch (const std::exception& e) {
+        message = e.what();
+    }
+    if (error && error_size > 0) {
+        std::strncpy(error, message.c_str(), static_cast<size_t>(error_size - 1));
+        error[error_size - 1] = '\0';
+    }
+    return nullptr;
+}
+
+void basic_program_free(basic_program* program) {
+    delete program;
+}
+
+basic_context* basic_context_new(void) {
+    try {
+        auto context = std::make_unique<basic_context>();
+        context->owned = std::make_unique<basic::BasicInterpreter>();
+        context->interpreter = context->owned.get();
+        return context.release();
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void basic_context_free(basic_context* context) {
+    delete context;
+}
+
+int basic_context_load(basic_context* context, const basic_program* program) {
+    if (!context) {
+        return -1;
+    }
+    if (!program) {
+        return fail(context, "No program given");
+    }
+    if (!context->owned) {
+        return fail(context, "Pooled contexts run the pool's program");
+    }
+    return guard(context, [&] {
+        if (!context->interpreter->loadProgram(program->program)) {
+            return fail(context, context->interpreter->getLastError());
+        }
+        return 0;
+    });
+}
+
+int basic_context_run(basic_context* context) {
+    return guard(context, [&] {
+        context->error.clear();
+        if (!context->interpreter->execute()) {
+            return fail(context, context->interpreter->getLastError());
+        }
+        return 0;
+    });
+}
+
+int basic_context_reset(basic_context* context) {
+    return guard(context, [&] {
+        context->error.clear();
+        context->interpreter->reset();
+        return 0;
+    });
+}
+
+const char* basic_context_error(const basic_context* context) {
+    return context ? context->error.c_str() : "No context given";
+}
+
+int basic_set_memory_limit(basic_context* context, size_t bytes) {
+    return guard(context, [&] {
+        context->interpreter->setMemoryLimit(bytes);
+        return 0;
+    });
+}
+
+void basic_memory_usage(const basic_context* context, size_t* live, size_t* peak) {
+    basic::BasicInterpreter::MemoryUsage usage{};
+    if (context) {
+        usage = context->interpreter->getMemoryUsage();
+    }
+    if (live) *live = usage.live;
+    if (peak) *peak = usage.peak;
+}
+
+int basic_set_number(basic_context* context, const char* name, double value) {
+    if (!name) {
+        return fail(context, "No variable name given");
+    }
+    return guard(context, [&] {
+        basic_value converted{BASIC_NUMBER, value, nullptr};
+        context->interpreter->setVariable(name, toValue(converted));
+        return 0;
+    });
+}
+
+int basic_set_string(basic_context* context, const char* name, const char* value) {
+    if (!name || !value) {
+        return fail(context, name ? "No string value given" : "No variable name given");
+    }
+    return guard(context, [&] {
+        context->interpreter->setVariable(name, basic::Value{std::string(value)});
+        return 0;
+    });
+}
+
+int basic_get(basic_context* context, const char* name, basic_value* value) {
+    if (!name || !value) {
+        return fail(context, name ? "No value to fill given" : "No variable name given");
+    }
+    return guard(context, [&] {
+        const basic::Variables* variables = context->interpreter->getVariables();
+        if (!variables->exists(name)) {
+            return fail(context, std::string("Variable '") + name + "' not defined");
+        }
+        basic::Value current = context->interpreter->getVariable(name);
+        if (std::holds_alternative<std::string>(current)) {
+            context->scratch = std::get<std::string>(current);
+            *value = basic_value{BASIC_STRING, 0.0, context->scratch.c_str()};
+        } else {
+            *value = fromValue(current);
+        }
+        return 0;
+    });
+}
+
+int basic_bind_function(basic_context* context, const char* name, basic_host_function function,
+                        void* user_data) {
+    if (!name) {
+        return fail(context, "No function name given");
+    }
+    return guard(context, [&] {
+        context->interpreter->bindFunction(name, wrapHost(name, function, user_data));
+        return 0;
+    });
+}
+
+int basic_capture_output(basic_context* context) {
+    return guard(context, [&] {
+        context->interpreter->setOutputSink(std::make_unique<basic::BufferOutputSink>());
+        return 0;
+    });
+}
+
+const char* basic_output(basic_context* context) {
+    const char* contents = "";
+    guard(context, [&] {
+        context->interpreter->flushOutput();
+        auto buffer = dynamic_cast<basic::BufferOutputSink*>(context->interpreter->getOutputSink());
+        contents = buffer ? buffer->contents().c_str() : "";
+        return 0;
+    });
+    return contents;
+}
+
+void basic_clear_output(basic_context* context) {
+    if (!context) {
+        return;
+    }
+    if (auto buffer = dynamic_cast<basic::BufferOutputSink*>(context->interpreter->getOutputSink())) {
+        buffer->clear();
+    }
+}
+
+basic_pool* basic_pool_new(const basic_program* program, int capture_output, int max_idle) {
+    if (!program) {
+        return nullptr;
+    }
+    try {
+        auto owner = std::make_unique<basic_pool>();
+        basic_pool* pool = owner.get();
+        pool->captureOutput = capture_output != 0;
+        pool->pool = std::make_unique<basic::ContextPool>(
+            program->program,
+            [pool](basic::BasicInterpreter& interpreter) {
+                if (pool->captureOutput) {
+                    interpreter.setOutputSink(std::make_unique<basic::BufferOutputSink>());
+                }
+                std::lock_guard<std::mutex> lock(pool->mutex);
+                for (const auto& binding : pool->bindings) {
+                    interpreter.bindFunction(binding.name,
+                                             wrapHost(binding.name, binding.function, binding.userData));
+                }
+            },
+            max_idle > 0 ? static_cast<size_t>(max_idle) : 64);
+        return owner.release();
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void basic_pool_free(basic_pool* pool) {
+    delete pool;
+}
+
+int basic_pool_bind_function(basic_pool* pool, const char* name, basic_host_function function,
+                             void* user_data) {
+    if (!pool || !name) {
+        return -1;
+    }
+    try {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->bindings.push_back(HostBinding{name, function, user_data});
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+basic_context* basic_pool_acquire(basic_pool* pool) {
+    if (!pool) {
+        return nullptr;
+    }
+    try {
+        auto context = std::make_unique<basic_context>();
+        context->lease = pool->pool->acquire();
+        context->interpreter = context->lease.get();
+        basic_clear_output(context.get());
+        return context.release();
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void basic_pool_release(basic_pool* /*pool*/, basic_context* context) {
+    delete context;
+}
+
+} // extern "C"
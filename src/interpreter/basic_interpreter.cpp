@@ -4,58 +4,185 @@
 #include "interpreter/runtime.h"
 #include "interpreter/variables.h"
 #include "interpreter/functions.h"
+#include "interpreter/output.h"
+#include "interpreter/program.h"
+#include "interpreter/memory_account.h"
+#include "interpreter/coverage.h"
+#include "interpreter/trace.h"
+#include "interpreter/timeline.h"
 
 #include <iostream>
 #include <sstream>
 #include <algorithm>
-#include <regex>
 #include <chrono>
 #include <thread>
 
 namespace basic {
 
 BasicInterpreter::BasicInterpreter() 
-    : currentLine_(0), running_(false), debugging_(false), paused_(false) {
+    : debugHook_(nullptr), coverage_(nullptr), trace_(nullptr), currentLine_(0), running_(false), debugging_(false), paused_(false) {
     
+    memory_ = std::make_unique<MemoryAccount>();
     parser_ = std::make_unique<Parser>();
     lexer_ = std::make_unique<Lexer>();
     runtime_ = std::make_unique<Runtime>();
-    variables_ = std::make_unique<Variables>();
+    runtime_->setMemoryAccount(memory_.get());
+    variables_ = std::make_unique<Variables>(memory_.get());
     functions_ = std::make_unique<Functions>();
+    output_ = std::make_unique<StreamOutputSink>(std::cout);
+    runtime_->setOutput(output_.get());
 }
 
-BasicInterpreter::~BasicInterpreter() = default;
+BasicInterpreter::~BasicInterpreter() {
+    // Output that cannot be flushed by now is lost
+    try {
+        flushOutput();
+    } catch (...) {
+    }
+}
 
 bool BasicInterpreter::loadProgram(const std::string& source) {
-    source_ = source;
-    lines_.clear();
-    
-    std::istringstream iss(source);
-    std::string line;
-    while (std::getline(iss, line)) {
-        lines_.push_back(line);
-    }
-    
+    return loadProgram(ProgramCache::shared().get(source));
+}
+
+bool BasicInterpreter::loadProgram(std::shared_ptr<const Program> program) {
+    program_ = std::move(program);
+    runtime_->clearCaches();
     currentLine_ = 0;
     lastError_.clear();
     
-    // Parse the program
-    try {
-        auto tokens = lexer_->tokenize(source);
-        auto ast = parser_->parse(tokens);
-        if (!ast) {
-            lastError_ = "Failed to parse program";
+    if (!program_) {
+        lastError_ = "No program loaded";
+        return false;
+    }
+    if (!program_->error().empty()) {
+        lastError_ = program_->error();
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<const Program> BasicInterpreter::getProgram() const {
+    return program_;
+}
+
+// The FOR (block form) and NEXT statements of a line, which pair up at run
+// time through the loop stack
+static void collectLoops(const ASTNode* node, std::vector<std::string>& loops) {
+    if (!node) return;
+    switch (node->getType()) {
+        case NodeType::FOR_STATEMENT: {
+            auto* forNode = static_cast<const ForStatementNode*>(node);
+            if (forNode->body) {
+                collectLoops(forNode->body.get(), loops);
+            } else {
+                loops.push_back("FOR " + forNode->variableName);
+            }
+            break;
+        }
+        case NodeType::NEXT_STATEMENT:
+            loops.push_back("NEXT");
+            break;
+        case NodeType::IF_STATEMENT: {
+            auto* ifNode = static_cast<const IfStatementNode*>(node);
+            collectLoops(ifNode->thenStatement.get(), loops);
+            collectLoops(ifNode->elseStatement.get(), loops);
+            break;
+        }
+        case NodeType::WHILE_STATEMENT:
+            collectLoops(static_cast<const WhileStatementNode*>(node)->body.get(), loops);
+            break;
+        case NodeType::PROGRAM:
+            for (const auto& statement : static_cast<const ProgramNode*>(node)->statements) {
+                collectLoops(statement.get(), loops);
+            }
+            break;
+        case NodeType::STATEMENT_LIST:
+            for (const auto& statement : static_cast<const StatementListNode*>(node)->statements) {
+                collectLoops(statement.get(), loops);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+bool BasicInterpreter::patchProgram(const std::string& source) {
+    if (!program_) {
+        lastError_ = "No program loaded";
+        return false;
+    }
+    // Both are laid out by line for the program they were started with
+    if (coverage_ || trace_) {
+        lastError_ = "Cannot patch the program while coverage or a trace is being recorded";
+        return false;
+    }
+    if (!program_->modules().empty()) {
+        lastError_ = "Programs with INCLUDE are not patched; restart to apply the edit";
+        return false;
+    }
+
+    Program::Patch patch = Program::patch(program_, source);
+    const auto& newLines = patch.program->lines();
+    for (size_t i : patch.compiled) {
+        if (!newLines[i].error.empty()) {
+            lastError_ = "Line " + std::to_string(i + 1) + ": " + newLines[i].error;
             return false;
         }
-        return true;
-    } catch (const std::exception& e) {
-        lastError_ = e.what();
+        if (!newLines[i].include.empty()) {
+            lastError_ = "Line " + std::to_string(i + 1) + ": INCLUDE takes effect on restart";
+            return false;
+        }
+    }
+    // NEXT finds its FOR through the loop stack, so the loops must still line
+    // up the same way
+    std::vector<std::string> oldLoops;
+    std::vector<std::string> newLoops;
+    for (const auto& line : program_->lines()) {
+        collectLoops(line.statement.get(), oldLoops);
+    }
+    for (const auto& line : newLines) {
+        collectLoops(line.statement.get(), newLoops);
+    }
+    if (oldLoops != newLoops) {
+        size_t first = patch.compiled.empty() ? newLines.size() : patch.compiled.front();
+        lastError_ = "Line " + std::to_string(first + 1) +
+                     ": the edit changes the FOR/NEXT structure; restart to apply it";
         return false;
     }
+    // A running loop already evaluated its FOR line, and NEXT jumps back to it
+    for (const auto& blk : runtime_->block) {
+        if (blk->line != 0 && patch.mapLine(blk->line) < 0) {
+            lastError_ = "Line " + std::to_string(blk->line + 1) + ": FOR " + blk->variableName +
+                         " is running; restart to apply the edit";
+            return false;
+        }
+    }
+
+    for (auto& blk : runtime_->block) {
+        if (blk->line != 0) {
+            blk->line = patch.mapLine(blk->line);
+        }
+    }
+    // Paused on a replaced line: resume where its replacement starts
+    int current = patch.mapLine(currentLine_);
+    if (current < 0) {
+        int previous = currentLine_ - 1;
+        while (previous >= 0 && patch.mapLine(previous) < 0) {
+            --previous;
+        }
+        current = previous < 0 ? 0 : patch.mapLine(previous) + 1;
+    }
+    currentLine_ = current;
+
+    program_ = std::move(patch.program);
+    runtime_->clearCaches();
+    lastError_.clear();
+    return true;
 }
 
 bool BasicInterpreter::execute() {
-    if (lines_.empty()) {
+    if (!program_ || program_->empty()) {
         lastError_ = "No program loaded";
         return false;
     }
@@ -65,7 +192,7 @@ bool BasicInterpreter::execute() {
     lastError_.clear();
     
     try {
-        while (running_ && currentLine_ < lines_.size()) {
+        while (running_ && currentLine_ < static_cast<int>(program_->size())) {
             // Check for breakpoints
             if (debugging_ && breakpoints_.find(currentLine_ + 1) != breakpoints_.end()) {
                 paused_ = true;
@@ -76,11 +203,10 @@ bool BasicInterpreter::execute() {
             
             if (!running_) break;
             
-            std::string line = lines_[currentLine_];
-            if (!line.empty()) {
-                if (!executeLine(line)) {
-                    return false;
-                }
+            if (!executeProgramLine(currentLine_)) {
+                running_ = false;
+                flushOutput();
+                return false;
             }
             
             currentLine_++;
@@ -88,10 +214,12 @@ bool BasicInterpreter::execute() {
     } catch (const std::exception& e) {
         lastError_ = e.what();
         running_ = false;
+        flushOutput();
         return false;
     }
     
     running_ = false;
+    flushOutput();
     return true;
 }
 
@@ -99,13 +227,7 @@ bool BasicInterpreter::executeLine(const std::string& line) {
     if (line.empty()) return true;
     
     try {
-        // Remove line number if present
-        std::string code = line;
-        std::regex lineNumRegex(R"(^\s*(\d+)\s*(.*))");
-        std::smatch match;
-        if (std::regex_match(line, match, lineNumRegex)) {
-            code = match[2].str();
-        }
+        std::string code = Program::stripLineNumber(line);
         
         // Skip empty lines and comments
         if (code.empty() || code[0] == '\'') {
@@ -119,13 +241,48 @@ bool BasicInterpreter::executeLine(const std::string& line) {
         // Parse the line
         auto ast = parser_->parseLine(tokens);
         if (!ast) {
-            // If end of loop - 'Next' - we need to test for that with already started loops 
             lastError_ = "Failed to parse line: " + line;
             return false;
         }
-        
-        // Execute the line
-        Value result = runtime_->execute(ast.get(), variables_.get(), functions_.get());        
+        // Entries cached for an earlier one-off AST could alias this one
+        runtime_->clearCaches();
+        return executeStatement(ast.get());
+    } catch (const std::exception& e) {
+        lastError_ = "Error executing line: " + std::string(e.what());
+        return false;
+    }
+}
+
+// Lines of the loaded program were parsed by Program::compile
+bool BasicInterpreter::executeProgramLine(size_t index) {
+    BASIC_TIMELINE_SCOPE("execute line");
+    const Program::Line& line = program_->lines()[index];
+    if (line.statement) {
+        memory_->setLine(static_cast<int>(index) + 1);
+        if (coverage_) {
+            coverage_->hitLine(index);
+        }
+        if (trace_) {
+            trace_->statement(static_cast<int>(index) + 1, *variables_);
+        }
+        return executeStatement(line.statement.get());
+    }
+    if (!line.error.empty()) {
+        lastError_ = line.error;
+        return false;
+    }
+    if (!line.include.empty()) {
+        // Program::link resolves includes; a program given as text has no file
+        lastError_ = "Line " + std::to_string(index + 1) + ": INCLUDE \"" + line.include +
+                     "\" needs the program to be loaded from a file";
+        return false;
+    }
+    return true;
+}
+
+bool BasicInterpreter::executeStatement(const ASTNode* statement) {
+    try {
+        Value result = runtime_->execute(statement, variables_.get(), functions_.get());
 
         // Remember the line of the statement
         if (!runtime_->block.empty()) {
@@ -157,6 +314,7 @@ Value BasicInterpreter::evaluateExpression(const std::string& expr) {
     auto ast = parser_->parseLine(tokens);
     if (!ast) throw std::runtime_error("Failed to parse expression");
     // Execute
+    runtime_->clearCaches();
     return runtime_->execute(ast.get(), variables_.get(), functions_.get());
 }
 
@@ -178,8 +336,8 @@ void BasicInterpreter::step() {
     if (paused_) {
         paused_ = false;
         // Execute one line
-        if (currentLine_ < lines_.size()) {
-            executeLine(lines_[currentLine_]);
+        if (program_ && currentLine_ < static_cast<int>(program_->size())) {
+            executeProgramLine(currentLine_);
             currentLine_++;
         }
         paused_ = true;
@@ -188,13 +346,16 @@ void BasicInterpreter::step() {
 
 void BasicInterpreter::continueExecution() {
     paused_ = false;
-    while(currentLine_ < lines_.size()) {
-        if (breakpoints_.find(currentLine_ + 1) != breakpoints_.end())
+    // The line paused on runs first, or a breakpoint there would never let go
+    bool first = true;
+    while (program_ && currentLine_ < static_cast<int>(program_->size())) {
+        if (!first && breakpoints_.find(currentLine_ + 1) != breakpoints_.end())
         {
             paused_ = true;
             break;
         }
-        executeLine(lines_[currentLine_]);
+        first = false;
+        executeProgramLine(currentLine_);
         currentLine_++;
     }
 }
@@ -215,6 +376,14 @@ std::map<std::string, Value> BasicInterpreter::getAllVariables() {
     return variables_->getAll();
 }
 
+const Variables* BasicInterpreter::getVariables() const {
+    return variables_.get();
+}
+
+Variables* BasicInterpreter::getVariables() {
+    return variables_.get();
+}
+
 void BasicInterpreter::defineFunction(const std::string& name, const std::string& body) {
     functions_->define(name, body);
 }
@@ -223,6 +392,10 @@ Value BasicInterpreter::callFunction(const std::string& name, const std::vector<
     return functions_->call(name, args, variables_.get());
 }
 
+void BasicInterpreter::bindFunction(const std::string& name, HostFunction function) {
+    functions_->bindHost(name, std::move(function));
+}
+
 bool BasicInterpreter::isRunning() const {
     return running_;
 }
@@ -232,7 +405,7 @@ int BasicInterpreter::getCurrentLine() const {
 }
 
 std::string BasicInterpreter::getCurrentSource() const {
-    return source_;
+    return program_ ? program_->source() : std::string();
 }
 
 std::string BasicInterpreter::getLastError() const {
@@ -245,13 +418,76 @@ void BasicInterpreter::clearError() {
 
 void BasicInterpreter::cleanup() {
     // Reset...
-    variables_ = std::make_unique<Variables>();
-    lines_.clear();
+    flushOutput();
+    variables_ = std::make_unique<Variables>(memory_.get());
+    variables_->setTrace(trace_);
+    program_.reset();
     lastError_.clear();
-    source_.clear();
     currentLine_ = 0;
     runtime_ = std::make_unique<Runtime>();
+    runtime_->setOutput(output_.get());
+    runtime_->setDebugHook(debugHook_);
+    runtime_->setMemoryAccount(memory_.get());
+    runtime_->setCoverage(coverage_);
+    memory_->resetPeak();
+
+}
+
+// Clears state in place rather than rebuilding the components, so a context
+// can be reused for the next run without allocating
+void BasicInterpreter::reset() {
+    flushOutput();
+    variables_->clear();
+    functions_->reset();
+    runtime_->reset();
+    memory_->resetPeak();
+    lastError_.clear();
+    currentLine_ = 0;
+    running_ = false;
+    paused_ = false;
+}
+
+void BasicInterpreter::setOutputSink(std::unique_ptr<OutputSink> sink) {
+    flushOutput();
+    output_ = sink ? std::move(sink) : std::make_unique<StreamOutputSink>(std::cout);
+    runtime_->setOutput(output_.get());
+}
+
+OutputSink* BasicInterpreter::getOutputSink() const {
+    return output_.get();
+}
+
+void BasicInterpreter::setMemoryLimit(size_t bytes) {
+    memory_->setLimit(bytes);
+}
+
+BasicInterpreter::MemoryUsage BasicInterpreter::getMemoryUsage() const {
+    return MemoryUsage{memory_->live(), memory_->peak(), memory_->limit()};
+}
+
+void BasicInterpreter::setAllocationProfile(AllocationProfile* profile) {
+    memory_->setProfile(profile);
+}
 
+void BasicInterpreter::setCoverage(CoverageMap* coverage) {
+    coverage_ = coverage;
+    runtime_->setCoverage(coverage);
+}
+
+void BasicInterpreter::setTrace(TraceRecorder* trace) {
+    trace_ = trace;
+    variables_->setTrace(trace);
+}
+
+void BasicInterpreter::setDebugHook(DebugHook* hook) {
+    debugHook_ = hook;
+    runtime_->setDebugHook(hook);
+}
+
+void BasicInterpreter::flushOutput() {
+    if (output_) {
+        output_->flush();
+    }
 }
 
 
@@ -0,0 +1,82 @@
+#include "interpreter/context_pool.h"
+#include "interpreter/program.h"
+#include <stdexcept>
+
+namespace basic {
+
+ContextPool::Lease::Lease(ContextPool* pool, std::unique_ptr<BasicInterpreter> context)
+    : pool_(pool), context_(std::move(context)) {}
+
+ContextPool::Lease::Lease(Lease&& other) noexcept
+    : pool_(other.pool_), context_(std::move(other.context_)) {
+    other.pool_ = nullptr;
+}
+
+ContextPool::Lease& ContextPool::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        release();
+        pool_ = other.pool_;
+        context_ = std::move(other.context_);
+        other.pool_ = nullptr;
+    }
+    return *this;
+}
+
+ContextPool::Lease::~Lease() {
+    release();
+}
+
+// Runs from the destructor and the noexcept move, so it must not throw. A
+// context whose reset fails (its output sink cannot flush) is dropped
+// rather than pooled in an unknown state.
+void ContextPool::Lease::release() {
+    if (pool_ && context_) {
+        try {
+            pool_->giveBack(std::move(context_));
+        } catch (...) {
+        }
+    }
+    pool_ = nullptr;
+    context_.reset();
+}
+
+ContextPool::ContextPool(std::shared_ptr<const Program> program, Setup setup, size_t maxIdle)
+    : program_(std::move(program)), setup_(std::move(setup)), maxIdle_(maxIdle) {
+    if (!program_) {
+        throw std::runtime_error("ContextPool requires a compiled program");
+    }
+}
+
+ContextPool::Lease ContextPool::acquire() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!idle_.empty()) {
+            std::unique_ptr<BasicInterpreter> context = std::move(idle_.back());
+            idle_.pop_back();
+            return Lease(this, std::move(context));
+        }
+    }
+
+    // Built outside the lock; setup may be slow
+    auto context = std::make_unique<BasicInterpreter>();
+    if (setup_) {
+        setup_(*context);
+    }
+    context->loadProgram(program_);
+    return Lease(this, std::move(context));
+}
+
+size_t ContextPool::idleCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return idle_.size();
+}
+
+void ContextPool::giveBack(std::unique_ptr<BasicInterpreter> context) {
+    context->reset();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (idle_.size() < maxIdle_) {
+        idle_.push_back(std::move(context));
+    }
+}
+
+} // namespace basic
@@ -0,0 +1,182 @@
+#include "interpreter/coverage.h"
+#include "interpreter/program.h"
+#include "protocol/json_escape.h"
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <stdexcept>
+
+namespace basic {
+
+namespace {
+
+const char kMagic[8] = {'B', 'A', 'S', 'C', 'O', 'V', '1', '\n'};
+
+std::string xmlEscape(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        if (c == '&') out += "&amp;";
+        else if (c == '<') out += "&lt;";
+        else if (c == '>') out += "&gt;";
+        else if (c == '"') out += "&quot;";
+        else out += c;
+    }
+    return out;
+}
+
+std::string rate(size_t hit, size_t total) {
+    char buffer[16];
+    std::snprintf(buffer, sizeof(buffer), "%.4f", total ? static_cast<double>(hit) / static_cast<double>(total) : 1.0);
+    return buffer;
+}
+
+} // namespace
+
+CoverageMap::CoverageMap(const Program& program)
+    : program_(program), lines_(program.size(), 0), branches_(2 * program.branchCount(), 0) {}
+
+void CoverageMap::merge(const CoverageMap& other) {
+    if (&other.program_ != &program_ &&
+        (other.program_.hash() != program_.hash() || other.program_.source() != program_.source())) {
+        throw std::runtime_error("Coverage maps belong to different programs");
+    }
+    for (size_t i = 0; i < lines_.size(); ++i) lines_[i] |= other.lines_[i];
+    for (size_t i = 0; i < branches_.size(); ++i) branches_[i] |= other.branches_[i];
+}
+
+bool CoverageMap::save(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) return false;
+    uint64_t header[3] = {static_cast<uint64_t>(program_.hash()), lines_.size(), branches_.size()};
+    out.write(kMagic, sizeof(kMagic));
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(lines_.data()), static_cast<std::streamsize>(lines_.size()));
+    out.write(reinterpret_cast<const char*>(branches_.data()), static_cast<std::streamsize>(branches_.size()));
+    return static_cast<bool>(out);
+}
+
+bool CoverageMap::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    char magic[sizeof(kMagic)];
+    uint64_t header[3];
+    if (!in.read(magic, sizeof(magic)) || std::string(magic, sizeof(magic)) != std::string(kMagic, sizeof(kMagic)) ||
+        !in.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+        header[0] != static_cast<uint64_t>(program_.hash()) || header[1] != lines_.size() ||
+        header[2] != branches_.size()) {
+        return false;
+    }
+    std::vector<uint8_t> lines(lines_.size());
+    std::vector<uint8_t> branches(branches_.size());
+    if (!in.read(reinterpret_cast<char*>(lines.data()), static_cast<std::streamsize>(lines.size())) ||
+        !in.read(reinterpret_cast<char*>(branches.data()), static_cast<std::streamsize>(branches.size()))) {
+        return false;
+    }
+    for (size_t i = 0; i < lines_.size(); ++i) lines_[i] |= lines[i];
+    for (size_t i = 0; i < branches_.size(); ++i) branches_[i] |= branches[i];
+    return true;
+}
+
+CoverageMap::Totals CoverageMap::totals() const {
+    Totals totals;
+    const auto& lines = program_.lines();
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (!lines[i].statement) continue;
+        ++totals.lines;
+        if (lines_[i]) ++totals.linesHit;
+    }
+    for (size_t b = 0; b < program_.branchCount(); ++b) {
+        if (program_.branchLine(b) == 0) continue; // replaced by a patch
+        totals.branches += 2;
+        totals.branchesHit += branches_[2 * b] + branches_[2 * b + 1];
+    }
+    return totals;
+}
+
+std::vector<std::pair<size_t, size_t>> CoverageMap::branchesByLine() const {
+    std::vector<std::pair<size_t, size_t>> result(lines_.size());
+    for (size_t b = 0; b < program_.branchCount(); ++b) {
+        if (program_.branchLine(b) == 0) continue; // replaced by a patch
+        auto& entry = result[static_cast<size_t>(program_.branchLine(b)) - 1];
+        entry.first += branches_[2 * b] + branches_[2 * b + 1];
+        entry.second += 2;
+    }
+    return result;
+}
+
+void CoverageMap::writeLcov(std::ostream& out, const std::string& sourcePath) const {
+    const auto& lines = program_.lines();
+    out << "TN:\nSF:" << sourcePath << "\n";
+    for (size_t b = 0; b < program_.branchCount(); ++b) {
+        int line = program_.branchLine(b);
+        if (line == 0) continue;
+        bool reached = lines_[static_cast<size_t>(line) - 1] != 0;
+        for (int outcome = 0; outcome < 2; ++outcome) {
+            out << "BRDA:" << line << "," << b << "," << outcome << ",";
+            if (reached) out << static_cast<int>(branches_[2 * b + outcome]);
+            else out << "-";
+            out << "\n";
+        }
+    }
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (lines[i].statement) {
+            out << "DA:" << i + 1 << "," << static_cast<int>(lines_[i]) << "\n";
+        }
+    }
+    Totals t = totals();
+    out << "BRF:" << t.branches << "\nBRH:" << t.branchesHit << "\n";
+    out << "LF:" << t.lines << "\nLH:" << t.linesHit << "\nend_of_record\n";
+}
+
+void CoverageMap::writeCobertura(std::ostream& out, const std::string& sourcePath) const {
+    const auto& lines = program_.lines();
+    Totals t = totals();
+    auto branches = branchesByLine();
+    std::string lineRate = rate(t.linesHit, t.lines);
+    std::string branchRate = rate(t.branchesHit, t.branches);
+
+    out << "<?xml version=\"1.0\" ?>\n"
+        << "<coverage line-rate=\"" << lineRate << "\" branch-rate=\"" << branchRate
+        << "\" lines-covered=\"" << t.linesHit << "\" lines-valid=\"" << t.lines
+        << "\" branches-covered=\"" << t.branchesHit << "\" branches-valid=\"" << t.branches
+        << "\" complexity=\"0\" version=\"1\" timestamp=\"" << std::time(nullptr) << "\">\n"
+        << "  <packages>\n    <package name=\"basic\" line-rate=\"" << lineRate << "\" branch-rate=\""
+        << branchRate << "\" complexity=\"0\">\n      <classes>\n"
+        << "        <class name=\"" << xmlEscape(sourcePath) << "\" filename=\"" << xmlEscape(sourcePath)
+        << "\" line-rate=\"" << lineRate << "\" branch-rate=\"" << branchRate << "\" complexity=\"0\">\n"
+        << "          <methods/>\n          <lines>\n";
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (!lines[i].statement) continue;
+        int line = static_cast<int>(i) + 1;
+        out << "            <line number=\"" << line << "\" hits=\"" << static_cast<int>(lines_[i]) << "\"";
+        auto [taken, total] = branches[i];
+        if (total) {
+            out << " branch=\"true\" condition-coverage=\"" << (100 * taken / total) << "% (" << taken << "/"
+                << total << ")\"";
+        } else {
+            out << " branch=\"false\"";
+        }
+        out << "/>\n";
+    }
+    out << "          </lines>\n        </class>\n      </classes>\n    </package>\n  </packages>\n</coverage>\n";
+}
+
+void CoverageMap::writeDecorations(std::ostream& out, const std::string& sourcePath) const {
+    const auto& lines = program_.lines();
+    auto branches = branchesByLine();
+    std::string escaped;
+    protocol::appendEscaped(escaped, sourcePath);
+    out << "{\"version\":1,\"source\":\"" << escaped << "\",\"lines\":[";
+    bool first = true;
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (!lines[i].statement) continue;
+        int line = static_cast<int>(i) + 1;
+        auto [taken, total] = branches[i];
+        const char* state = !lines_[i] ? "uncovered" : (taken < total ? "partial" : "covered");
+        out << (first ? "" : ",") << "{\"line\":" << line << ",\"state\":\"" << state << "\"}";
+        first = false;
+    }
+    out << "]}\n";
+}
+
+} // namespace basic
@@ -0,0 +1,148 @@
+#include "interpreter/csv_reader.h"
+#include "interpreter/simd_string.h"
+#include <algorithm>
+
+namespace basic {
+
+namespace {
+constexpr size_t kReadChunk = 1 << 20;
+const std::vector<std::string_view> kNoFields;
+}
+
+FieldSplitter::FieldSplitter(char delimiter) : delimiter_(delimiter) {}
+
+const std::vector<std::string_view>& FieldSplitter::split(std::string_view line) {
+    fields_.clear();
+
+    if (simd::findByte(line, '"') != simd::npos) {
+        splitQuoted(line);
+        return fields_;
+    }
+
+    // Fast path: no quotes, every delimiter ends a field
+    positions_.clear();
+    simd::findAll(line, delimiter_, positions_);
+    size_t start = 0;
+    for (size_t position : positions_) {
+        fields_.emplace_back(line.data() + start, position - start);
+        start = position + 1;
+    }
+    fields_.emplace_back(line.data() + start, line.size() - start);
+    return fields_;
+}
+
+void FieldSplitter::splitQuoted(std::string_view line) {
+    // Unescaped text is never longer than the line, so reserving up front
+    // keeps views into scratch_ stable while it is appended to.
+    scratch_.clear();
+    scratch_.reserve(line.size());
+
+    size_t pos = 0;
+    for (;;) {
+        if (pos < line.size() && line[pos] == '"') {
+            size_t start = pos + 1;
+            size_t quote = simd::findByte(line, '"', start);
+            size_t scratchStart = scratch_.size();
+            bool escaped = false;
+            while (quote != simd::npos && quote + 1 < line.size() && line[quote + 1] == '"') {
+                escaped = true;
+                scratch_.append(line.data() + start, quote + 1 - start);
+                start = quote + 2;
+                quote = simd::findByte(line, '"', start);
+            }
+            if (quote == simd::npos) {
+                quote = line.size(); // unterminated quote: take the rest
+            }
+            if (escaped) {
+                scratch_.append(line.data() + start, quote - start);
+                fields_.emplace_back(scratch_.data() + scratchStart, scratch_.size() - scratchStart);
+            } else {
+                fields_.emplace_back(line.data() + start, quote - start);
+            }
+            // Anything between the closing quote and the delimiter is ignored
+            size_t delimiter = simd::findByte(line, delimiter_, std::min(quote + 1, line.size()));
+            if (delimiter == simd::npos) break;
+            pos = delimiter + 1;
+        } else {
+            size_t delimiter = simd::findByte(line, delimiter_, pos);
+            if (delimiter == simd::npos) {
+                fields_.emplace_back(line.data() + pos, line.size() - pos);
+                break;
+            }
+            fields_.emplace_back(line.data() + pos, delimiter - pos);
+            pos = delimiter + 1;
+        }
+    }
+}
+
+CsvReader::CsvReader(const std::string& path, char delimiter)
+    : file_(path, std::ios::binary), pos_(0), splitter_(delimiter), fields_(&kNoFields) {}
+
+bool CsvReader::isOpen() const {
+    return file_.is_open();
+}
+
+bool CsvReader::fillBuffer() {
+    if (!file_) return false;
+    buffer_.resize(kReadChunk);
+    file_.read(&buffer_[0], static_cast<std::streamsize>(kReadChunk));
+    buffer_.resize(static_cast<size_t>(file_.gcount()));
+    pos_ = 0;
+    return !buffer_.empty();
+}
+
+bool CsvReader::next() {
+    record_.clear();
+    bool spanning = false;
+    bool inQuotes = false;
+    std::string_view record;
+
+    for (;;) {
+        if (pos_ >= buffer_.size() && !fillBuffer()) {
+            if (!spanning) {
+                fields_ = &kNoFields;
+                return false;
+            }
+            record = record_; // last record without a trailing newline
+            break;
+        }
+
+        std::string_view chunk(buffer_);
+        size_t start = pos_;
+        size_t i = pos_;
+        bool complete = false;
+        while ((i = simd::findEither(chunk, '\n', '"', i)) != simd::npos) {
+            if (chunk[i] == '"') {
+                inQuotes = !inQuotes;
+            } else if (!inQuotes) {
+                complete = true;
+                break;
+            }
+            ++i;
+        }
+
+        if (complete) {
+            if (spanning) {
+                record_.append(chunk.data() + start, i - start);
+                record = record_;
+            } else {
+                record = chunk.substr(start, i - start);
+            }
+            pos_ = i + 1;
+            break;
+        }
+
+        // Record continues in the next chunk
+        record_.append(chunk.data() + start, chunk.size() - start);
+        spanning = true;
+        pos_ = buffer_.size();
+    }
+
+    if (!record.empty() && record.back() == '\r') {
+        record.remove_suffix(1);
+    }
+    fields_ = &splitter_.split(record);
+    return true;
+}
+
+} // namespace basic
@@ -0,0 +1,192 @@
+#include "interpreter/dictionary.h"
+#include "interpreter/memory_account.h"
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace basic {
+
+namespace {
+constexpr size_t kNotFound = static_cast<size_t>(-1);
+constexpr size_t kMinCapacity = 8;
+
+uint32_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return static_cast<uint32_t>(x);
+}
+}
+
+Dictionary::Dictionary(MemoryAccount* memory)
+    : slots_(memory ? static_cast<std::pmr::memory_resource*>(memory) : std::pmr::get_default_resource()),
+      size_(0), mask_(0), memory_(memory), stringBytes_(0) {}
+
+Dictionary::Dictionary(Dictionary&& other) noexcept
+    : slots_(std::move(other.slots_)), size_(other.size_), mask_(other.mask_),
+      memory_(other.memory_), stringBytes_(other.stringBytes_) {
+    other.size_ = 0;
+    other.mask_ = 0;
+    other.stringBytes_ = 0;
+}
+
+Dictionary::~Dictionary() {
+    release(stringBytes_);
+}
+
+void Dictionary::charge(size_t bytes) {
+    if (memory_ && bytes) {
+        memory_->charge(bytes);
+        stringBytes_ += bytes;
+    }
+}
+
+void Dictionary::release(size_t bytes) {
+    if (memory_ && bytes) {
+        memory_->release(bytes);
+        stringBytes_ -= bytes;
+    }
+}
+
+// 1, 1.0 and TRUE-style booleans address the same entry
+Value Dictionary::normalizeKey(const Value& key) {
+    if (std::holds_alternative<bool>(key)) {
+        return Value{std::get<bool>(key) ? 1 : 0};
+    }
+    if (std::holds_alternative<double>(key)) {
+        double d = std::get<double>(key);
+        if (std::isnan(d)) {
+            throw std::runtime_error("NaN cannot be used as a dictionary key");
+        }
+        if (d == std::floor(d) && d >= INT_MIN && d <= INT_MAX) {
+            return Value{static_cast<int>(d)};
+        }
+    }
+    return key;
+}
+
+uint32_t Dictionary::hashKey(const Value& key) {
+    if (std::holds_alternative<std::string>(key)) {
+        // FNV-1a
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (unsigned char c : std::get<std::string>(key)) {
+            hash = (hash ^ c) * 0x100000001b3ull;
+        }
+        return mix(hash);
+    }
+    if (std::holds_alternative<int>(key)) {
+        return mix(static_cast<uint64_t>(static_cast<uint32_t>(std::get<int>(key))));
+    }
+    uint64_t bits;
+    double d = std::get<double>(key);
+    std::memcpy(&bits, &d, sizeof(bits));
+    return mix(bits ^ 0x9e3779b97f4a7c15ull);
+}
+
+size_t Dictionary::findSlot(const Value& key, uint32_t hash) const {
+    if (slots_.empty()) return kNotFound;
+    size_t pos = hash & mask_;
+    for (uint32_t distance = 1;; ++distance) {
+        const Slot& slot = slots_[pos];
+        // An empty slot, or one closer to its home than we are, ends the probe
+        if (slot.distance < distance) return kNotFound;
+        if (slot.hash == hash && slot.key == key) return pos;
+        pos = (pos + 1) & mask_;
+    }
+}
+
+const Value* Dictionary::find(const Value& key) const {
+    Value normalized = normalizeKey(key);
+    size_t pos = findSlot(normalized, hashKey(normalized));
+    return pos == kNotFound ? nullptr : &slots_[pos].value;
+}
+
+void Dictionary::set(const Value& key, const Value& value) {
+    Value normalized = normalizeKey(key);
+    uint32_t hash = hashKey(normalized);
+    size_t pos = findSlot(normalized, hash);
+    if (pos != kNotFound) {
+        charge(MemoryAccount::heapBytes(value));
+        release(MemoryAccount::heapBytes(slots_[pos].value));
+        slots_[pos].value = value;
+        return;
+    }
+
+    // Keep the load factor at or below 7/8
+    if ((size_ + 1) * 8 > slots_.size() * 7) {
+        grow();
+    }
+    charge(MemoryAccount::heapBytes(normalized) + MemoryAccount::heapBytes(value));
+    Slot slot;
+    slot.key = std::move(normalized);
+    slot.value = value;
+    slot.hash = hash;
+    slot.distance = 1;
+    insertNew(std::move(slot));
+}
+
+void Dictionary::insertNew(Slot slot) {
+    size_t pos = slot.hash & mask_;
+    for (;;) {
+        Slot& current = slots_[pos];
+        if (current.distance == 0) {
+            current = std::move(slot);
+            ++size_;
+            return;
+        }
+        // Robin Hood: the entry further from home takes the slot
+        if (current.distance < slot.distance) {
+            std::swap(current, slot);
+        }
+        pos = (pos + 1) & mask_;
+        ++slot.distance;
+    }
+}
+
+bool Dictionary::erase(const Value& key) {
+    Value normalized = normalizeKey(key);
+    size_t pos = findSlot(normalized, hashKey(normalized));
+    if (pos == kNotFound) return false;
+    release(MemoryAccount::heapBytes(slots_[pos].key) + MemoryAccount::heapBytes(slots_[pos].value));
+
+    // Shift the following displaced entries back one slot
+    size_t next = (pos + 1) & mask_;
+    while (slots_[next].distance > 1) {
+        slots_[pos] = std::move(slots_[next]);
+        --slots_[pos].distance;
+        pos = next;
+        next = (next + 1) & mask_;
+    }
+    slots_[pos] = Slot();
+    --size_;
+    return true;
+}
+
+void Dictionary::clear() {
+    release(stringBytes_);
+    // Frees the table as well, so an emptied DICT holds no memory
+    std::pmr::vector<Slot>(slots_.get_allocator()).swap(slots_);
+    size_ = 0;
+    mask_ = 0;
+}
+
+void Dictionary::grow() {
+    std::pmr::vector<Slot> old(slots_.get_allocator());
+    old.swap(slots_);
+    size_t capacity = old.empty() ? kMinCapacity : old.size() * 2;
+    slots_.resize(capacity);
+    mask_ = capacity - 1;
+    size_ = 0;
+    for (Slot& slot : old) {
+        if (slot.distance != 0) {
+            slot.distance = 1;
+            insertNew(std::move(slot));
+        }
+    }
+}
+
+} // namespace basic
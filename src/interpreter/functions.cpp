@@ -3,13 +3,56 @@
 #include "interpreter/lexer.h"
 #include "interpreter/parser.h"
 #include "interpreter/runtime.h"
+#include "interpreter/simd_string.h"
+#include "interpreter/array_sort.h"
+#include <chrono>
 #include <cmath>
+#include <cstring>
+#include <random>
 #include <stdexcept>
 #include <sstream>
 
 namespace basic {
 
-Functions::Functions() {}
+namespace {
+
+const std::string& stringArg(const Value& value, const char* function) {
+    if (!std::holds_alternative<std::string>(value)) {
+        throw std::runtime_error(std::string(function) + " expects a string argument");
+    }
+    return std::get<std::string>(value);
+}
+
+int intArg(const Value& value) {
+    return std::visit([](const auto& v) -> int {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, int>) return v;
+        else if constexpr (std::is_same_v<T, double>) return static_cast<int>(v);
+        else return 0;
+    }, value);
+}
+
+char delimiterArg(const std::vector<Value>& args, size_t index, const char* function) {
+    if (args.size() <= index) return ',';
+    const std::string& delimiter = stringArg(args[index], function);
+    if (delimiter.size() != 1) {
+        throw std::runtime_error(std::string(function) + " delimiter must be a single character");
+    }
+    return delimiter[0];
+}
+
+Dictionary& dictArg(const Value& value, Variables* variables, const char* function) {
+    const std::string& name = stringArg(value, function);
+    Dictionary* dict = variables->getDict(name);
+    if (!dict) {
+        throw std::runtime_error("Dictionary '" + name + "' not declared");
+    }
+    return *dict;
+}
+
+} // namespace
+
+Functions::Functions() : lastRandom_(0.0) {}
 
 void Functions::define(const std::string& name, const std::string& body) {
     functions_[name] = body;
@@ -17,9 +60,13 @@ void Functions::define(const std::string& name, const std::string& body) {
 
 Value Functions::call(const std::string& name, const std::vector<Value>& args, Variables* variables) {
     // First check if it's a built-in function
-    Value builtinResult = callBuiltin(name, args);
-    if (builtinResult.index() != 0) { // Not empty
-        return builtinResult;
+    if (auto builtinResult = callBuiltin(name, args, variables)) {
+        return *builtinResult;
+    }
+    
+    auto host = hostFunctions_.find(name);
+    if (host != hostFunctions_.end()) {
+        return host->second(args);
     }
     
     // Check if it's a user-defined function
@@ -49,10 +96,59 @@ void Functions::clear() {
 }
 
 bool Functions::exists(const std::string& name) const {
-    return functions_.find(name) != functions_.end();
+    return functions_.find(name) != functions_.end() ||
+           hostFunctions_.find(name) != hostFunctions_.end();
+}
+
+void Functions::bindHost(const std::string& name, HostFunction function) {
+    if (isBuiltin(name)) {
+        throw std::runtime_error("Cannot rebind built-in function '" + name + "'");
+    }
+    ++hostGeneration_;
+    if (function) {
+        hostFunctions_[name] = std::move(function);
+    } else {
+        hostFunctions_.erase(name);
+    }
+}
+
+const HostFunction* Functions::findHost(const std::string& name) const {
+    auto it = hostFunctions_.find(name);
+    return it != hostFunctions_.end() ? &it->second : nullptr;
+}
+
+void Functions::reset() {
+    functions_.clear();
+    random_.seed(Random::kDefaultSeed);
+    lastRandom_ = 0.0;
 }
 
-Value Functions::callBuiltin(const std::string& name, const std::vector<Value>& args) {
+bool Functions::isBuiltin(const std::string& name) const {
+    static const char* const names[] = {
+        "ABS", "SIN", "COS", "TAN", "SQRT", "LOG", "EXP",
+        "RND", "LEN", "MID", "LEFT", "RIGHT", "VAL", "STR",
+        "INSTR", "UCASE", "LCASE", "TRIM", "LTRIM", "RTRIM", "REPLACE", "STRCOMP",
+        "FIELD$", "SPLIT", "CSVREAD", "BSEARCH",
+        "SET", "GET", "HAS", "DEL", "KEYS"
+    };
+    for (const char* builtin : names) {
+        if (name == builtin) return true;
+    }
+    return false;
+}
+
+bool Functions::takesArray(const std::string& name, size_t index) {
+    if (index == 0) {
+        return name == "BSEARCH" || name == "SET" || name == "GET" || name == "HAS" || name == "DEL" ||
+               name == "KEYS";
+    }
+    if (index == 1) {
+        return name == "SPLIT" || name == "CSVREAD" || name == "KEYS";
+    }
+    return false;
+}
+
+std::optional<Value> Functions::callBuiltin(const std::string& name, const std::vector<Value>& args, Variables* variables) {
     if (name == "ABS") return abs(args);
     if (name == "SIN") return sin(args);
     if (name == "COS") return cos(args);
@@ -66,8 +162,26 @@ Value Functions::callBuiltin(const std::string& name, const std::vector<Value>&
     if (name == "RIGHT") return right(args);
     if (name == "VAL") return val(args);
     if (name == "STR") return str(args);
+    if (name == "RND") return rnd(args);
+    if (name == "INSTR") return instr(args);
+    if (name == "UCASE") return ucase(args);
+    if (name == "LCASE") return lcase(args);
+    if (name == "TRIM") return trim(args, true, true, "TRIM");
+    if (name == "LTRIM") return trim(args, true, false, "LTRIM");
+    if (name == "RTRIM") return trim(args, false, true, "RTRIM");
+    if (name == "REPLACE") return replace(args);
+    if (name == "STRCOMP") return strcomp(args);
+    if (name == "FIELD$") return field(args);
+    if (name == "SPLIT") return split(args, variables);
+    if (name == "CSVREAD") return csvread(args, variables);
+    if (name == "BSEARCH") return bsearch(args, variables);
+    if (name == "SET") return dictSet(args, variables);
+    if (name == "GET") return dictGet(args, variables);
+    if (name == "HAS") return dictHas(args, variables);
+    if (name == "DEL") return dictDel(args, variables);
+    if (name == "KEYS") return dictKeys(args, variables);
     
-    return Value{}; // Empty value indicates not a built-in function
+    return std::nullopt; // Not a built-in function
 }
 
 Value Functions::abs(const std::vector<Value>& args) {
@@ -181,6 +295,54 @@ Value Functions::exp(const std::vector<Value>& args) {
     }, args[0]);
 }
 
+// RND([x]) - next uniform [0, 1) value; RND(0) repeats the last one and a
+// negative x reseeds with x first
+Value Functions::rnd(const std::vector<Value>& args) {
+    if (args.size() > 1) {
+        throw std::runtime_error("RND function takes at most 1 argument");
+    }
+    if (!args.empty()) {
+        if (std::holds_alternative<std::string>(args[0])) {
+            throw std::runtime_error("RND expects a numeric argument");
+        }
+        // TRUE and FALSE count as 1 and 0, as for host function arguments
+        double x = host_detail::Arg<double>::get(args[0], "RND", 0);
+        if (x == 0) {
+            return Value{lastRandom_};
+        }
+        if (x < 0) {
+            randomize(args[0]);
+        }
+    }
+    lastRandom_ = random_.nextDouble();
+    return Value{lastRandom_};
+}
+
+void Functions::randomize() {
+    std::random_device device;
+    uint64_t seed = (static_cast<uint64_t>(device()) << 32) ^ device() ^
+        static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+    random_.seed(seed);
+}
+
+// 42 and 42.0 give the same sequence
+void Functions::randomize(const Value& seed) {
+    uint64_t bits = 0;
+    if (std::holds_alternative<int>(seed)) {
+        bits = static_cast<uint64_t>(static_cast<int64_t>(std::get<int>(seed)));
+    } else if (std::holds_alternative<double>(seed)) {
+        double d = std::get<double>(seed);
+        if (d == std::floor(d) && std::fabs(d) < 9.2e18) {
+            bits = static_cast<uint64_t>(static_cast<int64_t>(d));
+        } else {
+            std::memcpy(&bits, &d, sizeof(bits));
+        }
+    } else {
+        throw std::runtime_error("RANDOMIZE expects a numeric seed");
+    }
+    random_.seed(bits);
+}
+
 Value Functions::len(const std::vector<Value>& args) {
     if (args.size() != 1) {
         throw std::runtime_error("LEN function requires exactly 1 argument");
@@ -317,4 +479,231 @@ Value Functions::str(const std::vector<Value>& args) {
     }, args[0]);
 }
 
+// INSTR([start,] text$, search$) - 1-based position of search$, 0 if absent
+Value Functions::instr(const std::vector<Value>& args) {
+    if (args.size() < 2 || args.size() > 3) {
+        throw std::runtime_error("INSTR function requires 2 or 3 arguments");
+    }
+    size_t first = args.size() == 3 ? 1 : 0;
+    int start = args.size() == 3 ? intArg(args[0]) : 1;
+    const std::string& text = stringArg(args[first], "INSTR");
+    const std::string& search = stringArg(args[first + 1], "INSTR");
+    if (start < 1) {
+        throw std::runtime_error("INSTR start position must be at least 1");
+    }
+    
+    size_t pos = simd::find(text, search, static_cast<size_t>(start - 1));
+    return Value{pos == simd::npos ? 0 : static_cast<int>(pos + 1)};
+}
+
+Value Functions::ucase(const std::vector<Value>& args) {
+    if (args.size() != 1) {
+        throw std::runtime_error("UCASE function requires exactly 1 argument");
+    }
+    std::string result = stringArg(args[0], "UCASE");
+    simd::toUpper(&result[0], result.size());
+    return Value{std::move(result)};
+}
+
+Value Functions::lcase(const std::vector<Value>& args) {
+    if (args.size() != 1) {
+        throw std::runtime_error("LCASE function requires exactly 1 argument");
+    }
+    std::string result = stringArg(args[0], "LCASE");
+    simd::toLower(&result[0], result.size());
+    return Value{std::move(result)};
+}
+
+// TRIM/LTRIM/RTRIM - strip spaces, tabs and line breaks
+Value Functions::trim(const std::vector<Value>& args, bool left, bool right, const char* function) {
+    if (args.size() != 1) {
+        throw std::runtime_error(std::string(function) + " function requires exactly 1 argument");
+    }
+    std::string_view text = stringArg(args[0], function);
+    size_t end = right ? simd::trimSpaceEnd(text) : text.size();
+    size_t begin = left ? simd::skipSpace(text.substr(0, end)) : 0;
+    return Value{std::string(text.substr(begin, end - begin))};
+}
+
+// REPLACE(text$, search$, replacement$) - replaces every occurrence
+Value Functions::replace(const std::vector<Value>& args) {
+    if (args.size() != 3) {
+        throw std::runtime_error("REPLACE function requires exactly 3 arguments");
+    }
+    const std::string& text = stringArg(args[0], "REPLACE");
+    const std::string& search = stringArg(args[1], "REPLACE");
+    const std::string& replacement = stringArg(args[2], "REPLACE");
+    if (search.empty()) {
+        return Value{text};
+    }
+    
+    size_t pos = simd::find(text, search);
+    if (pos == simd::npos) {
+        return Value{text};
+    }
+    std::string result;
+    result.reserve(text.size());
+    size_t start = 0;
+    do {
+        result.append(text, start, pos - start);
+        result.append(replacement);
+        start = pos + search.size();
+        pos = simd::find(text, search, start);
+    } while (pos != simd::npos);
+    result.append(text, start, std::string::npos);
+    return Value{std::move(result)};
+}
+
+// STRCOMP(a$, b$ [, ignoreCase]) - returns -1, 0 or 1
+Value Functions::strcomp(const std::vector<Value>& args) {
+    if (args.size() < 2 || args.size() > 3) {
+        throw std::runtime_error("STRCOMP function requires 2 or 3 arguments");
+    }
+    const std::string& a = stringArg(args[0], "STRCOMP");
+    const std::string& b = stringArg(args[1], "STRCOMP");
+    bool ignoreCase = args.size() == 3 && intArg(args[2]) != 0;
+    int result = ignoreCase ? simd::compareIgnoreCase(a, b) : simd::compare(a, b);
+    return Value{result < 0 ? -1 : (result > 0 ? 1 : 0)};
+}
+
+// FIELD$(record$, n [, delimiter$]) - n-th field (1-based) of a delimited record
+Value Functions::field(const std::vector<Value>& args) {
+    if (args.size() < 2 || args.size() > 3) {
+        throw std::runtime_error("FIELD$ function requires 2 or 3 arguments");
+    }
+    const std::string& record = stringArg(args[0], "FIELD$");
+    int index = intArg(args[1]);
+    splitter_.setDelimiter(delimiterArg(args, 2, "FIELD$"));
+    
+    const auto& fields = splitter_.split(record);
+    if (index < 1 || index > static_cast<int>(fields.size())) {
+        return Value{std::string()};
+    }
+    return Value{std::string(fields[index - 1])};
+}
+
+// SPLIT(record$, A() [, delimiter$]) - fills A(0..n-1) with the fields, returns n
+Value Functions::split(const std::vector<Value>& args, Variables* variables) {
+    if (args.size() < 2 || args.size() > 3) {
+        throw std::runtime_error("SPLIT function requires 2 or 3 arguments");
+    }
+    const std::string& record = stringArg(args[0], "SPLIT");
+    const std::string& arrayName = stringArg(args[1], "SPLIT");
+    splitter_.setDelimiter(delimiterArg(args, 2, "SPLIT"));
+    
+    const auto& fields = splitter_.split(record);
+    Array& array = variables->getOrCreateArray(arrayName);
+    array.dims.assign(1, static_cast<int>(fields.size()));
+    array.data.resize(fields.size());
+    for (size_t i = 0; i < fields.size(); ++i) {
+        array.data[i] = std::string(fields[i]);
+    }
+    variables->recount(array);
+    return Value{static_cast<int>(fields.size())};
+}
+
+// CSVREAD(file$, A() [, delimiter$]) - loads a CSV file into A(row, column).
+// The first record fixes the column count. Returns the number of rows.
+Value Functions::csvread(const std::vector<Value>& args, Variables* variables) {
+    if (args.size() < 2 || args.size() > 3) {
+        throw std::runtime_error("CSVREAD function requires 2 or 3 arguments");
+    }
+    const std::string& path = stringArg(args[0], "CSVREAD");
+    const std::string& arrayName = stringArg(args[1], "CSVREAD");
+    
+    CsvReader reader(path, delimiterArg(args, 2, "CSVREAD"));
+    if (!reader.isOpen()) {
+        throw std::runtime_error("CSVREAD cannot open " + path);
+    }
+    
+    Array& array = variables->getOrCreateArray(arrayName);
+    array.data.clear();
+    size_t columns = 0;
+    size_t rows = 0;
+    while (reader.next()) {
+        const auto& fields = reader.fields();
+        if (fields.size() == 1 && fields[0].empty()) {
+            continue; // blank line
+        }
+        if (rows == 0) {
+            columns = fields.size();
+        }
+        for (size_t i = 0; i < columns; ++i) {
+            array.data.emplace_back(i < fields.size() ? std::string(fields[i]) : std::string());
+        }
+        ++rows;
+    }
+    array.dims = {static_cast<int>(rows), static_cast<int>(columns)};
+    variables->recount(array);
+    return Value{static_cast<int>(rows)};
+}
+
+// BSEARCH(A(), value) - index of value in the ascending array A, or -1
+Value Functions::bsearch(const std::vector<Value>& args, Variables* variables) {
+    if (args.size() != 2) {
+        throw std::runtime_error("BSEARCH function requires exactly 2 arguments");
+    }
+    const std::string& arrayName = stringArg(args[0], "BSEARCH");
+    Array* array = variables->getArray(arrayName);
+    if (!array) {
+        throw std::runtime_error("Array '" + arrayName + "' not dimensioned");
+    }
+    return Value{searchArray(*array, args[1])};
+}
+
+// SET(D(), key, value) - stores value under key, returns value
+Value Functions::dictSet(const std::vector<Value>& args, Variables* variables) {
+    if (args.size() != 3) {
+        throw std::runtime_error("SET function requires exactly 3 arguments");
+    }
+    dictArg(args[0], variables, "SET").set(args[1], args[2]);
+    return args[2];
+}
+
+// GET(D(), key [, default]) - value under key; default (or an error) if absent
+Value Functions::dictGet(const std::vector<Value>& args, Variables* variables) {
+    if (args.size() < 2 || args.size() > 3) {
+        throw std::runtime_error("GET function requires 2 or 3 arguments");
+    }
+    const Value* found = dictArg(args[0], variables, "GET").find(args[1]);
+    if (found) {
+        return *found;
+    }
+    if (args.size() == 3) {
+        return args[2];
+    }
+    throw std::runtime_error("Key not found in dictionary '" + std::get<std::string>(args[0]) + "'");
+}
+
+Value Functions::dictHas(const std::vector<Value>& args, Variables* variables) {
+    if (args.size() != 2) {
+        throw std::runtime_error("HAS function requires exactly 2 arguments");
+    }
+    return Value{dictArg(args[0], variables, "HAS").find(args[1]) != nullptr};
+}
+
+Value Functions::dictDel(const std::vector<Value>& args, Variables* variables) {
+    if (args.size() != 2) {
+        throw std::runtime_error("DEL function requires exactly 2 arguments");
+    }
+    return Value{dictArg(args[0], variables, "DEL").erase(args[1])};
+}
+
+// KEYS(D(), A()) - fills A(0..n-1) with the keys of D, returns n
+Value Functions::dictKeys(const std::vector<Value>& args, Variables* variables) {
+    if (args.size() != 2) {
+        throw std::runtime_error("KEYS function requires exactly 2 arguments");
+    }
+    const Dictionary& dict = dictArg(args[0], variables, "KEYS");
+    Array& array = variables->getOrCreateArray(stringArg(args[1], "KEYS"));
+    array.dims.assign(1, static_cast<int>(dict.size()));
+    array.data.clear();
+    array.data.reserve(dict.size());
+    dict.forEach([&array](const Value& key, const Value&) {
+        array.data.push_back(key);
+    });
+    variables->recount(array);
+    return Value{static_cast<int>(dict.size())};
+}
+
 } // namespace basic 
\ No newline at end of file
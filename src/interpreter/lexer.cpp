@@ -1,16 +1,15 @@
 #include "interpreter/lexer.h"
+#include "interpreter/timeline.h"
 #include <cctype>
 #include <sstream>
 #include <stdexcept>
 
 namespace basic {
 
-Lexer::Lexer() {
-    setupKeywords();
-}
+Lexer::Lexer() : keywords_(keywordTable()) {}
 
-void Lexer::setupKeywords() {
-    keywords_ = {
+const std::map<std::string, TokenType>& Lexer::keywordTable() {
+    static const std::map<std::string, TokenType> keywords = {
         {"LET", TokenType::LET},
         {"IF", TokenType::IF},
         {"THEN", TokenType::THEN},
@@ -33,11 +32,19 @@ void Lexer::setupKeywords() {
         {"READ", TokenType::READ},
         {"DATA", TokenType::DATA},
         {"RESTORE", TokenType::RESTORE},
-        {"DIM", TokenType::DIM}
+        {"DIM", TokenType::DIM},
+        {"SORT", TokenType::SORT},
+        {"BY", TokenType::BY},
+        {"DICT", TokenType::DICT},
+        {"RANDOMIZE", TokenType::RANDOMIZE},
+        {"RNDFILL", TokenType::RNDFILL},
+        {"USING", TokenType::USING}
     };
+    return keywords;
 }
 
 std::vector<Token> Lexer::tokenize(const std::string& input) {
+    BASIC_TIMELINE_SCOPE("lex");
     std::vector<Token> tokens;
     std::string current;
     int line = 1;
@@ -144,6 +151,13 @@ std::vector<Token> Lexer::tokenize(const std::string& input) {
                 column++;
             }
             
+            // String-typed names carry a trailing '$' (A$, FIELD$)
+            if (pos < input.length() && input[pos] == '$') {
+                identifier += '$';
+                pos++;
+                column++;
+            }
+            
             // Check if it's a keyword
             auto it = keywords_.find(identifier);
             if (it != keywords_.end()) {
@@ -275,6 +289,12 @@ std::string Lexer::tokenTypeToString(TokenType type) {
         case TokenType::DATA: return "DATA";
         case TokenType::RESTORE: return "RESTORE";
         case TokenType::DIM: return "DIM";
+        case TokenType::SORT: return "SORT";
+        case TokenType::BY: return "BY";
+        case TokenType::DICT: return "DICT";
+        case TokenType::RANDOMIZE: return "RANDOMIZE";
+        case TokenType::RNDFILL: return "RNDFILL";
+        case TokenType::USING: return "USING";
         case TokenType::PLUS: return "PLUS";
         case TokenType::MINUS: return "MINUS";
         case TokenType::MULTIPLY: return "MULTIPLY";
@@ -0,0 +1,57 @@
+#include "interpreter/memory_account.h"
+#include "interpreter/alloc_profile.h"
+#include <stdexcept>
+#include <string>
+
+namespace basic {
+
+MemoryAccount::MemoryAccount(std::pmr::memory_resource* upstream)
+    : upstream_(upstream), limit_(kUnlimited), live_(0), peak_(0) {}
+
+void MemoryAccount::charge(size_t bytes) {
+    size_t live = live_.load(std::memory_order_relaxed) + bytes;
+    size_t limit = limit_.load(std::memory_order_relaxed);
+    if (limit != kUnlimited && live > limit) {
+        throw std::runtime_error("Out of memory: program exceeded its limit of " +
+                                 std::to_string(limit) + " bytes");
+    }
+    live_.store(live, std::memory_order_relaxed);
+    if (live > peak_.load(std::memory_order_relaxed)) {
+        peak_.store(live, std::memory_order_relaxed);
+    }
+    if (profile_) {
+        profile_->record(line_, bytes, live);
+    }
+}
+
+void MemoryAccount::release(size_t bytes) {
+    size_t live = live_.load(std::memory_order_relaxed);
+    live_.store(live > bytes ? live - bytes : 0, std::memory_order_relaxed);
+}
+
+size_t MemoryAccount::heapBytes(const Value& value) {
+    static const size_t smallCapacity = std::string().capacity();
+    const std::string* text = std::get_if<std::string>(&value);
+    return text && text->size() > smallCapacity ? text->size() + 1 : 0;
+}
+
+void* MemoryAccount::do_allocate(size_t bytes, size_t alignment) {
+    charge(bytes);
+    try {
+        return upstream_->allocate(bytes, alignment);
+    } catch (...) {
+        release(bytes);
+        throw;
+    }
+}
+
+void MemoryAccount::do_deallocate(void* pointer, size_t bytes, size_t alignment) {
+    upstream_->deallocate(pointer, bytes, alignment);
+    release(bytes);
+}
+
+bool MemoryAccount::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+} // namespace basic
@@ -0,0 +1,335 @@
+#include "interpreter/output.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+#ifdef BASIC_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace basic {
+
+// --- StreamOutputSink ---
+
+StreamOutputSink::StreamOutputSink(std::ostream& out) : out_(out) {}
+
+StreamOutputSink::StreamOutputSink(std::unique_ptr<std::ostream> out)
+    : ownedStream_(std::move(out)), out_(*ownedStream_) {}
+
+void StreamOutputSink::write(const char* data, size_t size) {
+    out_.write(data, static_cast<std::streamsize>(size));
+}
+
+void StreamOutputSink::flush() {
+    out_.flush();
+}
+
+// --- BufferOutputSink ---
+
+void BufferOutputSink::write(const char* data, size_t size) {
+    buffer_.append(data, size);
+}
+
+// --- AsyncOutputSink ---
+
+AsyncOutputSink::AsyncOutputSink(std::ostream& out, size_t pageSize)
+    : out_(out), pageSize_(pageSize), writePending_(false), stopping_(false) {
+    fillPage_.reserve(pageSize_);
+    writePage_.reserve(pageSize_);
+    writer_ = std::thread(&AsyncOutputSink::writerLoop, this);
+}
+
+AsyncOutputSink::AsyncOutputSink(std::unique_ptr<std::ostream> out, size_t pageSize)
+    : ownedStream_(std::move(out)), out_(*ownedStream_), pageSize_(pageSize),
+      writePending_(false), stopping_(false) {
+    fillPage_.reserve(pageSize_);
+    writePage_.reserve(pageSize_);
+    writer_ = std::thread(&AsyncOutputSink::writerLoop, this);
+}
+
+AsyncOutputSink::~AsyncOutputSink() {
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+}
+
+void AsyncOutputSink::write(const char* data, size_t size) {
+    while (size > 0) {
+        size_t chunk = std::min(size, pageSize_ - fillPage_.size());
+        fillPage_.insert(fillPage_.end(), data, data + chunk);
+        data += chunk;
+        size -= chunk;
+        if (fillPage_.size() >= pageSize_) {
+            submitFillPage();
+        }
+    }
+}
+
+void AsyncOutputSink::flush() {
+    if (!fillPage_.empty()) {
+        submitFillPage();
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    drained_.wait(lock, [this]() { return !writePending_; });
+}
+
+void AsyncOutputSink::submitFillPage() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // Only one page can be in flight; wait for the writer to hand it back
+    drained_.wait(lock, [this]() { return !writePending_; });
+    std::swap(fillPage_, writePage_);
+    writePending_ = true;
+    lock.unlock();
+    wake_.notify_one();
+}
+
+void AsyncOutputSink::writerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this]() { return writePending_ || stopping_; });
+        if (!writePending_) {
+            return;
+        }
+        lock.unlock();
+        out_.write(writePage_.data(), static_cast<std::streamsize>(writePage_.size()));
+        out_.flush();
+        lock.lock();
+        writePage_.clear();
+        writePending_ = false;
+        drained_.notify_all();
+    }
+}
+
+#ifdef BASIC_HAVE_IO_URING
+
+// --- IoUringOutputSink ---
+// Talks to the kernel directly through the io_uring syscalls so there is no
+// dependency on liburing.
+
+namespace {
+
+int ioUringSetup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(int ringFd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+// Synchronous fallback used for short writes and kernels that reject the op
+void writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Output write failed: " + std::string(std::strerror(errno)));
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+} // namespace
+
+IoUringOutputSink::IoUringOutputSink(int fd, bool ownsFd, size_t pageSize)
+    : fd_(fd), ownsFd_(ownsFd), pageSize_(pageSize), fillIndex_(0), pendingSize_(0), pending_(false),
+      ringFd_(-1), sqRing_(MAP_FAILED), cqRing_(MAP_FAILED), sqes_(MAP_FAILED),
+      sqRingSize_(0), cqRingSize_(0), sqesSize_(0),
+      sqHead_(nullptr), sqTail_(nullptr), sqMask_(nullptr), sqArray_(nullptr),
+      cqHead_(nullptr), cqTail_(nullptr), cqMask_(nullptr), cqes_(nullptr) {
+    pages_[0].reserve(pageSize_);
+    pages_[1].reserve(pageSize_);
+}
+
+IoUringOutputSink::~IoUringOutputSink() {
+    if (ringFd_ >= 0) {
+        try {
+            flush();
+        } catch (...) {
+        }
+    }
+    if (sqes_ != MAP_FAILED) munmap(sqes_, sqesSize_);
+    if (cqRing_ != MAP_FAILED) munmap(cqRing_, cqRingSize_);
+    if (sqRing_ != MAP_FAILED) munmap(sqRing_, sqRingSize_);
+    if (ringFd_ >= 0) close(ringFd_);
+    if (ownsFd_ && fd_ >= 0) close(fd_);
+}
+
+std::unique_ptr<IoUringOutputSink> IoUringOutputSink::create(int fd, bool ownsFd, size_t pageSize) {
+    std::unique_ptr<IoUringOutputSink> sink(new IoUringOutputSink(fd, ownsFd, pageSize));
+    if (!sink->setup()) {
+        // Leave the descriptor to the caller's fallback path
+        sink->ownsFd_ = false;
+        return nullptr;
+    }
+    return sink;
+}
+
+bool IoUringOutputSink::setup() {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    // Two pages in flight at most, so a tiny ring is plenty
+    ringFd_ = ioUringSetup(4, &params);
+    if (ringFd_ < 0) {
+        return false;
+    }
+    // Writes use offset -1 ("current file position"), which needs this feature
+    if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+        return false;
+    }
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+
+    sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    cqRing_ = mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+    sqes_ = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+    if (sqRing_ == MAP_FAILED || cqRing_ == MAP_FAILED || sqes_ == MAP_FAILED) {
+        return false;
+    }
+
+    char* sq = static_cast<char*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+    char* cq = static_cast<char*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = cq + params.cq_off.cqes;
+    return true;
+}
+
+void IoUringOutputSink::write(const char* data, size_t size) {
+    while (size > 0) {
+        std::vector<char>& page = pages_[fillIndex_];
+        size_t chunk = std::min(size, pageSize_ - page.size());
+        page.insert(page.end(), data, data + chunk);
+        data += chunk;
+        size -= chunk;
+        if (page.size() >= pageSize_) {
+            submitFillPage();
+        }
+    }
+}
+
+void IoUringOutputSink::flush() {
+    if (!pages_[fillIndex_].empty()) {
+        submitFillPage();
+    }
+    waitForPending();
+}
+
+void IoUringOutputSink::submitFillPage() {
+    // Reap the previous page before its buffer is reused
+    waitForPending();
+
+    std::vector<char>& page = pages_[fillIndex_];
+    unsigned tail = *sqTail_;
+    unsigned index = tail & *sqMask_;
+    io_uring_sqe* sqe = static_cast<io_uring_sqe*>(sqes_) + index;
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd_;
+    sqe->addr = reinterpret_cast<unsigned long long>(page.data());
+    sqe->len = static_cast<unsigned>(page.size());
+    sqe->off = static_cast<unsigned long long>(-1);
+    sqArray_[index] = index;
+    __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+
+    if (ioUringEnter(ringFd_, 1, 0, 0) < 0) {
+        // Could not submit; undo and write the page ourselves
+        __atomic_store_n(sqTail_, tail, __ATOMIC_RELEASE);
+        writeAll(fd_, page.data(), page.size());
+        page.clear();
+        return;
+    }
+
+    pendingSize_ = page.size();
+    pending_ = true;
+    fillIndex_ ^= 1;
+    pages_[fillIndex_].clear();
+}
+
+void IoUringOutputSink::waitForPending() {
+    if (!pending_) {
+        return;
+    }
+    unsigned head = *cqHead_;
+    while (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+        if (ioUringEnter(ringFd_, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+            throw std::runtime_error("io_uring wait failed: " + std::string(std::strerror(errno)));
+        }
+    }
+    io_uring_cqe* cqe = static_cast<io_uring_cqe*>(cqes_) + (head & *cqMask_);
+    int result = cqe->res;
+    __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+    pending_ = false;
+
+    const std::vector<char>& page = pages_[fillIndex_ ^ 1];
+    if (result < 0) {
+        writeAll(fd_, page.data(), pendingSize_);
+    } else if (static_cast<size_t>(result) < pendingSize_) {
+        writeAll(fd_, page.data() + result, pendingSize_ - static_cast<size_t>(result));
+    }
+}
+
+#endif
+
+std::unique_ptr<OutputSink> createFileOutputSink(const std::string& path, bool async) {
+    if (async) {
+#ifdef BASIC_HAVE_IO_URING
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open output file: " + path);
+        }
+        if (auto sink = IoUringOutputSink::create(fd, true)) {
+            return sink;
+        }
+        close(fd);
+#endif
+        auto file = std::make_unique<std::ofstream>(path, std::ios::binary | std::ios::trunc);
+        if (!file->is_open()) {
+            throw std::runtime_error("Cannot open output file: " + path);
+        }
+        return std::make_unique<AsyncOutputSink>(std::move(file));
+    }
+
+    auto file = std::make_unique<std::ofstream>(path, std::ios::binary | std::ios::trunc);
+    if (!file->is_open()) {
+        throw std::runtime_error("Cannot open output file: " + path);
+    }
+    return std::make_unique<StreamOutputSink>(std::move(file));
+}
+
+std::unique_ptr<OutputSink> createStdoutSink(bool async) {
+    if (async) {
+        std::cout.flush();
+#ifdef BASIC_HAVE_IO_URING
+        if (auto sink = IoUringOutputSink::create(STDOUT_FILENO, false)) {
+            return sink;
+        }
+#endif
+        return std::make_unique<AsyncOutputSink>(std::cout);
+    }
+    return std::make_unique<StreamOutputSink>(std::cout);
+}
+
+} // namespace basic
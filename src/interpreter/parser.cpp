@@ -1,4 +1,6 @@
 #include "interpreter/parser.h"
+#include "interpreter/functions.h"
+#include "interpreter/timeline.h"
 #include <stdexcept>
 #include <sstream>
 
@@ -7,12 +9,14 @@ namespace basic {
 Parser::Parser() : current_(0) {}
 
 std::unique_ptr<ASTNode> Parser::parse(const std::vector<Token>& tokens) {
+    BASIC_TIMELINE_SCOPE("parse");
     tokens_ = tokens;
     current_ = 0;
     return parseProgram();
 }
 
 std::unique_ptr<ASTNode> Parser::parseLine(const std::vector<Token>& tokens) {
+    BASIC_TIMELINE_SCOPE("parse");
     tokens_ = tokens;
     current_ = 0;
     return parseStatement();
@@ -49,18 +53,40 @@ std::unique_ptr<ASTNode> Parser::parseStatement() {
             return parsePrintStatement();
         } else if (match(TokenType::INPUT)) {
             return parseInputStatement();
+        } else if (match(TokenType::DIM)) {
+            return parseDimStatement();
+        } else if (match(TokenType::RANDOMIZE)) {
+            return parseRandomizeStatement();
+        } else if (match(TokenType::RNDFILL)) {
+            return parseRndFillStatement();
+        } else if (match(TokenType::DICT)) {
+            return parseDictStatement();
+        } else if (match(TokenType::SORT)) {
+            return parseSortStatement();
         } else if (check(TokenType::IDENTIFIER)) {
             // Could be assignment or function call
+            Token name = current();
             advance();
             if (match(TokenType::ASSIGN)) {
                 auto letStmt = std::make_unique<LetStatementNode>();
-                letStmt->variableName = current().value;
+                letStmt->line = name.line;
+                letStmt->variableName = name.value;
                 letStmt->value = parseExpression();
                 return letStmt;
             } else {
-                // Function call
+                // Function call, or A(I) = ... array element assignment
                 current_--;
-                return parseFunctionCall();
+                auto call = parseFunctionCall();
+                if (match(TokenType::ASSIGN)) {
+                    auto* callNode = static_cast<FunctionCallNode*>(call.get());
+                    auto letStmt = std::make_unique<LetStatementNode>();
+                    letStmt->line = name.line;
+                    letStmt->variableName = callNode->functionName;
+                    letStmt->indices = std::move(callNode->arguments);
+                    letStmt->value = parseExpression();
+                    return letStmt;
+                }
+                return call;
             }
         } else {
             // Try to parse as expression
@@ -83,6 +109,13 @@ std::unique_ptr<ASTNode> Parser::parseLetStatement() {
     letStmt->variableName = current().value;
     advance();
     
+    if (match(TokenType::LPAREN)) {
+        do {
+            letStmt->indices.push_back(parseExpression());
+        } while (match(TokenType::COMMA));
+        consume(TokenType::RPAREN, "Expected ')' after array subscripts");
+    }
+    
     if (!match(TokenType::ASSIGN)) {
         throw std::runtime_error("Expected '=' after variable name");
     }
@@ -163,6 +196,26 @@ std::unique_ptr<ASTNode> Parser::parsePrintStatement() {
     auto printStmt = std::make_unique<PrintStatementNode>();
     printStmt->line = current().line;
     
+    if (match(TokenType::USING)) {
+        printStmt->usingFormat = parseExpression();
+        if (printStmt->usingFormat->getType() == NodeType::LITERAL) {
+            const Value& format = static_cast<LiteralNode*>(printStmt->usingFormat.get())->value;
+            if (std::holds_alternative<std::string>(format)) {
+                printStmt->usingTemplate = std::make_unique<PrintUsingTemplate>(std::get<std::string>(format));
+            }
+        }
+        if (!match(TokenType::SEMICOLON) && !match(TokenType::COMMA)) {
+            throw std::runtime_error("Expected ';' after PRINT USING format");
+        }
+        while (!isAtEnd() && !check(TokenType::COLON)) {
+            printStmt->expressions.push_back(parseExpression());
+            if (!match(TokenType::COMMA) && !match(TokenType::SEMICOLON)) {
+                break;
+            }
+        }
+        return printStmt;
+    }
+    
     while (!isAtEnd() && !check(TokenType::SEMICOLON) && !check(TokenType::COLON)) {
         printStmt->expressions.push_back(parseExpression());
         
@@ -197,6 +250,81 @@ std::unique_ptr<ASTNode> Parser::parseInputStatement() {
     return inputStmt;
 }
 
+std::unique_ptr<ASTNode> Parser::parseDimStatement() {
+    auto dimStmt = std::make_unique<DimStatementNode>();
+    dimStmt->line = current().line;
+    
+    do {
+        if (!check(TokenType::IDENTIFIER)) {
+            throw std::runtime_error("Expected array name in DIM statement");
+        }
+        DimStatementNode::Declaration declaration;
+        declaration.name = current().value;
+        advance();
+        
+        consume(TokenType::LPAREN, "Expected '(' after array name");
+        do {
+            declaration.bounds.push_back(parseExpression());
+        } while (match(TokenType::COMMA));
+        consume(TokenType::RPAREN, "Expected ')' after array bounds");
+        
+        dimStmt->declarations.push_back(std::move(declaration));
+    } while (match(TokenType::COMMA));
+    
+    return dimStmt;
+}
+
+std::unique_ptr<ASTNode> Parser::parseRandomizeStatement() {
+    auto randomizeStmt = std::make_unique<RandomizeStatementNode>();
+    randomizeStmt->line = current().line;
+    
+    if (!isAtEnd() && !check(TokenType::COLON)) {
+        randomizeStmt->seed = parseExpression();
+    }
+    return randomizeStmt;
+}
+
+std::unique_ptr<ASTNode> Parser::parseRndFillStatement() {
+    auto fillStmt = std::make_unique<RndFillStatementNode>();
+    fillStmt->line = current().line;
+    fillStmt->arrayName = parseArrayReference("RNDFILL");
+    return fillStmt;
+}
+
+std::unique_ptr<ASTNode> Parser::parseDictStatement() {
+    auto dictStmt = std::make_unique<DictStatementNode>();
+    dictStmt->line = current().line;
+    
+    do {
+        dictStmt->names.push_back(parseArrayReference("DICT"));
+    } while (match(TokenType::COMMA));
+    return dictStmt;
+}
+
+std::unique_ptr<ASTNode> Parser::parseSortStatement() {
+    auto sortStmt = std::make_unique<SortStatementNode>();
+    sortStmt->line = current().line;
+    
+    sortStmt->arrayName = parseArrayReference("SORT");
+    if (match(TokenType::BY)) {
+        sortStmt->keyArrayName = parseArrayReference("SORT BY");
+    }
+    return sortStmt;
+}
+
+// Whole-array or dictionary reference: NAME or NAME()
+std::string Parser::parseArrayReference(const char* statement) {
+    if (!check(TokenType::IDENTIFIER)) {
+        throw std::runtime_error(std::string("Expected array name in ") + statement);
+    }
+    std::string name = current().value;
+    advance();
+    if (match(TokenType::LPAREN)) {
+        consume(TokenType::RPAREN, "Expected ')' after array name");
+    }
+    return name;
+}
+
 std::unique_ptr<ASTNode> Parser::parseFunctionCall() {
     auto funcCall = std::make_unique<FunctionCallNode>();
     
@@ -209,7 +337,14 @@ std::unique_ptr<ASTNode> Parser::parseFunctionCall() {
     
     if (match(TokenType::LPAREN)) {
         while (!check(TokenType::RPAREN) && !isAtEnd()) {
-            funcCall->arguments.push_back(parseExpression());
+            if (Functions::takesArray(funcCall->functionName, funcCall->arguments.size())) {
+                auto reference = std::make_unique<ArrayReferenceNode>();
+                reference->line = current().line;
+                reference->arrayName = parseArrayReference(funcCall->functionName.c_str());
+                funcCall->arguments.push_back(std::move(reference));
+            } else {
+                funcCall->arguments.push_back(parseExpression());
+            }
             
             if (!match(TokenType::COMMA)) {
                 break;
@@ -231,7 +366,7 @@ std::unique_ptr<ASTNode> Parser::parseExpression() {
            match(TokenType::GREATER) || match(TokenType::GREATER_EQUAL)) {
         
         auto binaryExpr = std::make_unique<BinaryExpressionNode>();
-        binaryExpr->operator_ = current().type;
+        binaryExpr->operator_ = last().type;
         binaryExpr->left = std::move(left);
         binaryExpr->right = parseTerm();
         left = std::move(binaryExpr);
@@ -245,7 +380,7 @@ std::unique_ptr<ASTNode> Parser::parseTerm() {
     
     while (match(TokenType::MULTIPLY) || match(TokenType::DIVIDE) || match(TokenType::MOD)) {
         auto binaryExpr = std::make_unique<BinaryExpressionNode>();
-        binaryExpr->operator_ = current().type;
+        binaryExpr->operator_ = last().type;
         binaryExpr->left = std::move(left);
         binaryExpr->right = parseFactor();
         left = std::move(binaryExpr);
@@ -272,7 +407,7 @@ std::unique_ptr<ASTNode> Parser::parsePrimary() {
     if (match(TokenType::NUMBER)) {
         auto literal = std::make_unique<LiteralNode>();
         try {
-            if (current().value.find('.') != std::string::npos) {
+            if (last().value.find('.') != std::string::npos) {
                 literal->value = std::stod(last().value);
             } else {
                 literal->value = std::stoi(last().value);
@@ -289,6 +424,10 @@ std::unique_ptr<ASTNode> Parser::parsePrimary() {
         return literal;
     }
     
+    if (check(TokenType::IDENTIFIER) && peek().type == TokenType::LPAREN) {
+        return parseFunctionCall();
+    }
+    
     if (match(TokenType::IDENTIFIER)) {
         auto identifier = std::make_unique<IdentifierNode>();
         identifier->name = last().value;
@@ -392,7 +531,59 @@ std::string StatementListNode::toString() const {
 }
 
 std::string LetStatementNode::toString() const {
-    return "LET " + variableName + " = " + value->toString();
+    std::string target = variableName;
+    if (!indices.empty()) {
+        target += "(";
+        for (size_t i = 0; i < indices.size(); ++i) {
+            if (i > 0) target += ", ";
+            target += indices[i]->toString();
+        }
+        target += ")";
+    }
+    return "LET " + target + " = " + value->toString();
+}
+
+std::string DimStatementNode::toString() const {
+    std::string result = "DIM ";
+    for (size_t i = 0; i < declarations.size(); ++i) {
+        if (i > 0) result += ", ";
+        result += declarations[i].name + "(";
+        for (size_t j = 0; j < declarations[i].bounds.size(); ++j) {
+            if (j > 0) result += ", ";
+            result += declarations[i].bounds[j]->toString();
+        }
+        result += ")";
+    }
+    return result;
+}
+
+std::string RandomizeStatementNode::toString() const {
+    return seed ? "RANDOMIZE " + seed->toString() : "RANDOMIZE";
+}
+
+std::string RndFillStatementNode::toString() const {
+    return "RNDFILL " + arrayName + "()";
+}
+
+std::string DictStatementNode::toString() const {
+    std::string result = "DICT ";
+    for (size_t i = 0; i < names.size(); ++i) {
+        if (i > 0) result += ", ";
+        result += names[i];
+    }
+    return result;
+}
+
+std::string ArrayReferenceNode::toString() const {
+    return arrayName + "()";
+}
+
+std::string SortStatementNode::toString() const {
+    std::string result = "SORT " + arrayName + "()";
+    if (!keyArrayName.empty()) {
+        result += " BY " + keyArrayName + "()";
+    }
+    return result;
 }
 
 std::string IfStatementNode::toString() const {
@@ -425,6 +616,9 @@ std::string WhileStatementNode::toString() const {
 
 std::string PrintStatementNode::toString() const {
     std::string result = "PRINT ";
+    if (usingFormat) {
+        result += "USING " + usingFormat->toString() + "; ";
+    }
     for (size_t i = 0; i < expressions.size(); ++i) {
         if (i > 0) result += ", ";
         result += expressions[i]->toString();
@@ -0,0 +1,311 @@
+#include "interpreter/print_using.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+namespace basic {
+
+namespace {
+
+constexpr int kMaxExactFraction = 15;
+
+double numberValue(const Value& value) {
+    if (std::holds_alternative<int>(value)) return std::get<int>(value);
+    if (std::holds_alternative<double>(value)) return std::get<double>(value);
+    if (std::holds_alternative<bool>(value)) return std::get<bool>(value) ? 1 : 0;
+    throw std::runtime_error("PRINT USING: string value for a numeric field");
+}
+
+} // namespace
+
+PrintUsingTemplate::PrintUsingTemplate(const std::string& format)
+    : format_(format), hasFields_(false) {
+    size_t n = format_.size();
+    auto at = [&](size_t k) { return k < n ? format_[k] : '\0'; };
+
+    std::string literal;
+    auto flushLiteral = [&]() {
+        if (!literal.empty()) {
+            Item item{ItemKind::Literal};
+            item.text = std::move(literal);
+            items_.push_back(std::move(item));
+            literal.clear();
+        }
+    };
+    auto addField = [&](Item item) {
+        flushLiteral();
+        items_.push_back(std::move(item));
+        hasFields_ = true;
+    };
+
+    size_t i = 0;
+    while (i < n) {
+        char c = format_[i];
+        if (c == '_' && i + 1 < n) {
+            literal += format_[i + 1];
+            i += 2;
+            continue;
+        }
+        if (c == '!' || c == '&') {
+            addField(Item{c == '!' ? ItemKind::FirstChar : ItemKind::WholeString});
+            ++i;
+            continue;
+        }
+        if (c == '\\') {
+            size_t close = i + 1;
+            while (at(close) == ' ') ++close;
+            if (at(close) == '\\') {
+                Item item{ItemKind::FixedString};
+                item.width = static_cast<int>(close - i + 1);
+                addField(std::move(item));
+                i = close + 1;
+                continue;
+            }
+        }
+
+        bool number = c == '#' ||
+            (c == '.' && at(i + 1) == '#') ||
+            (c == '*' && at(i + 1) == '*') ||
+            (c == '$' && at(i + 1) == '$') ||
+            (c == '+' && (at(i + 1) == '#' || (at(i + 1) == '.' && at(i + 2) == '#') ||
+                          (at(i + 1) == '*' && at(i + 2) == '*') ||
+                          (at(i + 1) == '$' && at(i + 2) == '$')));
+        if (number) {
+            Item item{ItemKind::Number};
+            i = parseNumberField(i, item.number);
+            addField(std::move(item));
+            continue;
+        }
+
+        literal += c;
+        ++i;
+    }
+    flushLiteral();
+}
+
+size_t PrintUsingTemplate::parseNumberField(size_t pos, NumberField& field) const {
+    size_t n = format_.size();
+    auto at = [&](size_t k) { return k < n ? format_[k] : '\0'; };
+
+    size_t j = pos;
+    if (at(j) == '+') {
+        field.leadingSign = true;
+        ++j;
+    }
+    if (at(j) == '*' && at(j + 1) == '*') {
+        field.asteriskFill = true;
+        field.intDigits += 2;
+        j += 2;
+        if (at(j) == '$') {
+            field.dollar = true;
+            ++j;
+        }
+    } else if (at(j) == '$' && at(j + 1) == '$') {
+        // Two positions, one of which holds the $
+        field.dollar = true;
+        field.intDigits += 1;
+        j += 2;
+    }
+    // A comma only belongs to the field when more digits follow it
+    while (at(j) == '#' || (at(j) == ',' && (at(j + 1) == '#' || at(j + 1) == ',' || at(j + 1) == '.'))) {
+        if (at(j) == ',') field.commas = true;
+        ++field.intDigits;
+        ++j;
+    }
+    if (at(j) == '.') {
+        field.point = true;
+        ++j;
+        while (at(j) == '#') {
+            ++field.fracDigits;
+            ++j;
+        }
+    }
+    if (format_.compare(j, 4, "^^^^") == 0) {
+        field.exponentDigits = format_.compare(j, 5, "^^^^^") == 0 ? 3 : 2;
+        j += static_cast<size_t>(field.exponentDigits) + 2;
+    }
+    if (!field.leadingSign && (at(j) == '+' || at(j) == '-')) {
+        field.trailingSign = at(j);
+        ++j;
+    }
+    return j;
+}
+
+void PrintUsingTemplate::apply(const std::vector<Value>& values, std::string& out) const {
+    size_t next = 0;
+    for (;;) {
+        for (const Item& item : items_) {
+            if (item.kind == ItemKind::Literal) {
+                out += item.text;
+                continue;
+            }
+            if (next >= values.size()) return;
+            if (item.kind == ItemKind::Number) {
+                writeNumber(item.number, numberValue(values[next++]), out);
+            } else {
+                writeString(item, values[next++], out);
+            }
+        }
+        if (!hasFields_ || next >= values.size()) return;
+    }
+}
+
+// Digits are produced right to left into a stack buffer and appended once
+void PrintUsingTemplate::writeNumber(const NumberField& field, double value, std::string& out) {
+    int width = field.intDigits + (field.point ? 1 : 0) + field.fracDigits +
+                (field.dollar ? 1 : 0) + (field.leadingSign ? 1 : 0);
+    if (field.exponentDigits) {
+        writeExponent(field, value, width + 2 + field.exponentDigits, out);
+        return;
+    }
+
+    double magnitude = std::fabs(value) * std::pow(10.0, field.fracDigits);
+    if (field.fracDigits > kMaxExactFraction || !(std::round(magnitude) < 1e18)) {
+        // Too large for the integer digit writer: it cannot fit the field anyway
+        char text[512];
+        int length = std::snprintf(text, sizeof(text), "%.*f", field.fracDigits, value);
+        out += '%';
+        out.append(text, static_cast<size_t>(std::max(length, 0)));
+        return;
+    }
+
+    uint64_t scaled = static_cast<uint64_t>(std::round(magnitude));
+    uint64_t divisor = 1;
+    for (int k = 0; k < field.fracDigits; ++k) divisor *= 10;
+    uint64_t intPart = scaled / divisor;
+    uint64_t fracPart = scaled % divisor;
+    bool negative = value < 0 && scaled != 0;
+
+    char buffer[80];
+    char* end = buffer + sizeof(buffer);
+    char* cur = end;
+    for (int k = 0; k < field.fracDigits; ++k) {
+        *--cur = static_cast<char>('0' + fracPart % 10);
+        fracPart /= 10;
+    }
+    if (field.point) {
+        *--cur = '.';
+    }
+    if (intPart == 0) {
+        // -.5 rather than -0.5 when the sign takes the only digit position
+        bool signTakesDigit = negative && !field.leadingSign && !field.trailingSign;
+        if (field.intDigits > (signTakesDigit ? 1 : 0) || !field.point) {
+            *--cur = '0';
+        }
+    }
+    for (int digits = 0; intPart != 0; ++digits) {
+        if (field.commas && digits > 0 && digits % 3 == 0) {
+            *--cur = ',';
+        }
+        *--cur = static_cast<char>('0' + intPart % 10);
+        intPart /= 10;
+    }
+    if (field.dollar) {
+        *--cur = '$';
+    }
+    if (field.leadingSign) {
+        *--cur = negative ? '-' : '+';
+    } else if (negative && !field.trailingSign) {
+        *--cur = '-';
+    }
+
+    int length = static_cast<int>(end - cur);
+    if (length > width) {
+        out += '%';
+    } else {
+        out.append(static_cast<size_t>(width - length), field.asteriskFill ? '*' : ' ');
+    }
+    out.append(cur, static_cast<size_t>(length));
+
+    if (field.trailingSign == '+') {
+        out += negative ? '-' : '+';
+    } else if (field.trailingSign == '-') {
+        out += negative ? '-' : ' ';
+    }
+}
+
+// The digit positions before the point are all filled, with the exponent
+// chosen to fit: ##.##^^^^ prints 234.56 as " 2.35E+02"
+void PrintUsingTemplate::writeExponent(const NumberField& field, double value, int width, std::string& out) {
+    bool ownSign = field.leadingSign || field.trailingSign;
+    int intDigits = field.intDigits - (ownSign || field.intDigits == 0 ? 0 : 1);
+    if (intDigits + field.fracDigits == 0) {
+        intDigits = 1;
+    }
+    int significant = std::min(intDigits + field.fracDigits, 17);
+
+    // One digit before the point from %e, then move the point
+    char scientific[40];
+    std::snprintf(scientific, sizeof(scientific), "%.*e", significant - 1, std::fabs(value));
+    std::string digits;
+    const char* p = scientific;
+    for (; *p && *p != 'e'; ++p) {
+        if (*p != '.') digits += *p;
+    }
+    bool zero = digits.find_first_not_of('0') == std::string::npos;
+    int exponent = zero ? 0 : std::atoi(p + 1) - (intDigits - 1);
+    digits.resize(static_cast<size_t>(intDigits + field.fracDigits), '0');
+    bool negative = value < 0 && !zero;
+
+    std::string text;
+    if (field.leadingSign) {
+        text += negative ? '-' : '+';
+    } else if (negative && !field.trailingSign) {
+        text += '-';
+    }
+    if (field.dollar) {
+        text += '$';
+    }
+    text.append(digits, 0, static_cast<size_t>(intDigits));
+    if (field.point) {
+        text += '.';
+        text.append(digits, static_cast<size_t>(intDigits), std::string::npos);
+    }
+    char suffix[16];
+    std::snprintf(suffix, sizeof(suffix), "E%c%0*d", exponent < 0 ? '-' : '+', field.exponentDigits,
+                  std::abs(exponent));
+    text += suffix;
+
+    // The sign's spare position does not make room for a longer exponent
+    int length = static_cast<int>(text.size());
+    if (length > width || std::abs(exponent) >= (field.exponentDigits == 2 ? 100 : 1000)) {
+        out += '%';
+    } else {
+        out.append(static_cast<size_t>(width - length), field.asteriskFill ? '*' : ' ');
+    }
+    out += text;
+
+    if (field.trailingSign == '+') {
+        out += negative ? '-' : '+';
+    } else if (field.trailingSign == '-') {
+        out += negative ? '-' : ' ';
+    }
+}
+
+void PrintUsingTemplate::writeString(const Item& item, const Value& value, std::string& out) {
+    if (!std::holds_alternative<std::string>(value)) {
+        throw std::runtime_error("PRINT USING: numeric value for a string field");
+    }
+    const std::string& text = std::get<std::string>(value);
+    switch (item.kind) {
+        case ItemKind::FirstChar:
+            out += text.empty() ? ' ' : text[0];
+            break;
+        case ItemKind::WholeString:
+            out += text;
+            break;
+        default: {
+            size_t width = static_cast<size_t>(item.width);
+            size_t copied = std::min(width, text.size());
+            out.append(text, 0, copied);
+            out.append(width - copied, ' ');
+            break;
+        }
+    }
+}
+
+} // namespace basic
@@ -0,0 +1,527 @@
+#include "interpreter/program.h"
+#include "interpreter/lexer.h"
+#include "interpreter/parser.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
+
+namespace basic {
+
+std::shared_ptr<const Program> Program::compile(const std::string& source) {
+    std::shared_ptr<Program> program(new Program());
+    program->source_ = source;
+    program->hash_ = std::hash<std::string>{}(source);
+
+    Lexer lexer;
+    Parser parser;
+
+    std::istringstream iss(source);
+    std::string text;
+    while (std::getline(iss, text)) {
+        // Text the lexer rejects fails the whole load; lines that lex but do
+        // not parse only fail when they run
+        std::string lexError;
+        Line line = compileLine(lexer, parser, text, &lexError);
+        if (program->error_.empty()) {
+            program->error_ = lexError;
+        }
+        if (line.statement) {
+            program->numberBranches(line.statement.get(), static_cast<int>(program->lines_.size()) + 1);
+        }
+        program->lines_.push_back(std::move(line));
+    }
+    program->indexStatements();
+    program->measure();
+    return program;
+}
+
+void Program::indexStatements() {
+    statementLines_.clear();
+    for (size_t i = 0; i < lines_.size(); ++i) {
+        if (lines_[i].statement) {
+            statementLines_.push_back(static_cast<int>(i) + 1);
+        }
+    }
+}
+
+int Program::nextStatementLine(int line) const {
+    auto it = std::lower_bound(statementLines_.begin(), statementLines_.end(), line);
+    return it != statementLines_.end() ? *it : 0;
+}
+
+void Program::measure() {
+    // Roughly one node per few characters of code, each a few words
+    constexpr size_t kAstBytesPerChar = 16;
+    memoryUsage_ = sizeof(Program) + source_.capacity() + lines_.capacity() * sizeof(Line) +
+                   (branchLines_.capacity() + statementLines_.capacity()) * sizeof(int);
+    for (const Line& line : lines_) {
+        memoryUsage_ += line.text.capacity() + line.error.capacity();
+        if (line.statement) {
+            memoryUsage_ += line.text.size() * kAstBytesPerChar;
+        }
+    }
+}
+
+// INCLUDE "file" -> file
+static bool includePath(const std::string& code, std::string& path) {
+    static const char kKeyword[] = "INCLUDE";
+    constexpr size_t kLength = sizeof(kKeyword) - 1;
+    if (code.size() <= kLength || !std::isspace(static_cast<unsigned char>(code[kLength]))) {
+        return false;
+    }
+    for (size_t i = 0; i < kLength; ++i) {
+        if (std::toupper(static_cast<unsigned char>(code[i])) != kKeyword[i]) {
+            return false;
+        }
+    }
+    size_t open = code.find_first_not_of(" \t", kLength);
+    if (open == std::string::npos || code[open] != '"') {
+        return false;
+    }
+    size_t close = code.find('"', open + 1);
+    if (close == std::string::npos || close == open + 1 ||
+        code.find_first_not_of(" \t\r", close + 1) != std::string::npos) {
+        return false;
+    }
+    path = code.substr(open + 1, close - open - 1);
+    return true;
+}
+
+Program::Line Program::compileLine(Lexer& lexer, Parser& parser, const std::string& text, std::string* lexError) {
+    Line line;
+    line.text = text;
+    std::string code = stripLineNumber(text);
+    if (includePath(code, line.include)) {
+        return line;
+    }
+    // Blank lines and comments compile to nothing
+    if (!code.empty() && code[0] != '\'') {
+        try {
+            auto tokens = lexer.tokenize(code);
+            if (!tokens.empty()) {
+                line.statement = parser.parseLine(tokens);
+                if (!line.statement) {
+                    line.error = "Failed to parse line: " + text;
+                }
+            }
+        } catch (const std::exception& e) {
+            // parseLine() reports its failures as a null statement, so this is the lexer
+            line.error = "Error executing line: " + std::string(e.what());
+            if (lexError) {
+                *lexError = e.what();
+            }
+        }
+    }
+    return line;
+}
+
+// Myers' O(ND) diff: for each line of a, its index in b or -1 when it is not
+// part of the longest common subsequence. Gives up (all -1) past maxEdits.
+static std::vector<int> matchLines(const std::string* a, size_t n, const std::string* b, size_t m, int maxEdits) {
+    std::vector<int> match(n, -1);
+    int size = static_cast<int>(n + m);
+    int offset = size + 1;
+    std::vector<int> v(2 * static_cast<size_t>(size) + 3, 0);
+    // trace[d] holds v[-d..d] as it was before round d
+    std::vector<std::vector<int>> trace;
+    int edits = -1;
+    for (int d = 0; d <= size && d <= maxEdits; ++d) {
+        trace.emplace_back(v.begin() + offset - d, v.begin() + offset + d + 1);
+        for (int k = -d; k <= d; k += 2) {
+            int x = (k == -d || (k != d && v[offset + k - 1] < v[offset + k + 1])) ? v[offset + k + 1]
+                                                                                   : v[offset + k - 1] + 1;
+            int y = x - k;
+            while (x < static_cast<int>(n) && y < static_cast<int>(m) && a[x] == b[y]) {
+                ++x;
+                ++y;
+            }
+            v[offset + k] = x;
+            if (x >= static_cast<int>(n) && y >= static_cast<int>(m)) {
+                edits = d;
+                break;
+            }
+        }
+        if (edits >= 0) break;
+    }
+    if (edits < 0) {
+        return match;
+    }
+
+    int x = static_cast<int>(n);
+    int y = static_cast<int>(m);
+    for (int d = edits; d > 0; --d) {
+        const std::vector<int>& prev = trace[d];
+        int k = x - y;
+        int prevK = (k == -d || (k != d && prev[k - 1 + d] < prev[k + 1 + d])) ? k + 1 : k - 1;
+        int prevX = prev[prevK + d];
+        int prevY = prevX - prevK;
+        while (x > prevX && y > prevY) {
+            --x;
+            --y;
+            match[x] = y;
+        }
+        x = prevX;
+        y = prevY;
+    }
+    while (x > 0 && y > 0) {
+        --x;
+        --y;
+        match[x] = y;
+    }
+    return match;
+}
+
+// Unchanged lines are found by diffing the texts, so separate edits each
+// recompile only their own lines
+Program::Patch Program::patch(const std::shared_ptr<const Program>& base, const std::string& source) {
+    std::vector<std::string> texts;
+    std::istringstream iss(source);
+    std::string text;
+    while (std::getline(iss, text)) {
+        texts.push_back(std::move(text));
+    }
+
+    const std::vector<Line>& old = base->lines_;
+    size_t prefix = 0;
+    while (prefix < old.size() && prefix < texts.size() && old[prefix].text == texts[prefix]) {
+        ++prefix;
+    }
+    size_t suffix = 0;
+    while (suffix < old.size() - prefix && suffix < texts.size() - prefix &&
+           old[old.size() - 1 - suffix].text == texts[texts.size() - 1 - suffix]) {
+        ++suffix;
+    }
+
+    Patch result;
+    result.lineMap.assign(old.size(), -1);
+    for (size_t i = 0; i < prefix; ++i) {
+        result.lineMap[i] = static_cast<int>(i);
+    }
+    for (size_t i = 0; i < suffix; ++i) {
+        result.lineMap[old.size() - 1 - i] = static_cast<int>(texts.size() - 1 - i);
+    }
+    std::vector<std::string> middle;
+    for (size_t i = prefix; i < old.size() - suffix; ++i) {
+        middle.push_back(old[i].text);
+    }
+    if (!middle.empty() && texts.size() > prefix + suffix) {
+        std::vector<int> match = matchLines(middle.data(), middle.size(), texts.data() + prefix,
+                                            texts.size() - prefix - suffix, 1024);
+        for (size_t i = 0; i < match.size(); ++i) {
+            if (match[i] >= 0) {
+                result.lineMap[prefix + i] = match[i] + static_cast<int>(prefix);
+            }
+        }
+    }
+
+    std::vector<int> reused(texts.size(), -1);
+    for (size_t i = 0; i < old.size(); ++i) {
+        if (result.lineMap[i] >= 0) {
+            reused[static_cast<size_t>(result.lineMap[i])] = static_cast<int>(i);
+        }
+    }
+
+    std::shared_ptr<Program> program(new Program());
+    program->source_ = source;
+    program->hash_ = std::hash<std::string>{}(source);
+    program->lines_.reserve(texts.size());
+
+    // Shared ASTs keep the branchIndex base gave them, so the slots stay put;
+    // a slot base already retired (line 0) stays retired
+    program->branchLines_.reserve(base->branchLines_.size());
+    for (int line : base->branchLines_) {
+        int moved = line > 0 ? result.lineMap[static_cast<size_t>(line) - 1] : -1;
+        program->branchLines_.push_back(moved < 0 ? 0 : moved + 1);
+    }
+
+    Lexer lexer;
+    Parser parser;
+    for (size_t i = 0; i < texts.size(); ++i) {
+        if (reused[i] >= 0) {
+            program->lines_.push_back(old[static_cast<size_t>(reused[i])]);
+            continue;
+        }
+        Line line = compileLine(lexer, parser, texts[i]);
+        if (line.statement) {
+            program->numberBranches(line.statement.get(), static_cast<int>(i) + 1);
+        }
+        program->lines_.push_back(std::move(line));
+        result.compiled.push_back(i);
+    }
+
+    program->indexStatements();
+    program->measure();
+    result.program = program;
+    return result;
+}
+
+std::optional<std::string> Program::readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return std::nullopt;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+
+// Calls work(0) .. work(count - 1), spread over the hardware threads
+static void parallelFor(size_t count, const std::function<void(size_t)>& work) {
+    size_t threads = std::min<size_t>(count, std::thread::hardware_concurrency());
+    if (threads < 2) {
+        for (size_t i = 0; i < count; ++i) work(i);
+        return;
+    }
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            for (size_t i = next++; i < count; i = next++) work(i);
+        });
+    }
+    for (auto& worker : workers) worker.join();
+}
+
+static std::string resolveInclude(const std::string& from, const std::string& file) {
+    return (std::filesystem::path(from).parent_path() / file).lexically_normal().string();
+}
+
+std::shared_ptr<const Program> Program::link(const std::string& path, const ModuleLoader& load) {
+    std::shared_ptr<Program> linked(new Program());
+    std::vector<Module> modules = {{path, nullptr}};
+    std::map<std::string, size_t> index = {{path, 0}};
+    std::vector<std::string> includedBy = {""};
+
+    // Breadth first: each round reads the files found by the previous one
+    // and compiles them side by side
+    std::vector<size_t> round = {0};
+    while (!round.empty()) {
+        std::vector<std::string> texts(round.size());
+        for (size_t i = 0; i < round.size(); ++i) {
+            const Module& module = modules[round[i]];
+            std::optional<std::string> text = load(module.path);
+            if (!text) {
+                linked->error_ = "Cannot read " + module.path + includedBy[round[i]];
+                return linked;
+            }
+            texts[i] = std::move(*text);
+        }
+        parallelFor(round.size(), [&](size_t i) {
+            modules[round[i]].program = ProgramCache::shared().get(texts[i]);
+        });
+
+        std::vector<size_t> next;
+        for (size_t m : round) {
+            const auto& lines = modules[m].program->lines();
+            for (size_t i = 0; i < lines.size(); ++i) {
+                if (lines[i].include.empty()) continue;
+                std::string file = resolveInclude(modules[m].path, lines[i].include);
+                if (index.emplace(file, modules.size()).second) {
+                    next.push_back(modules.size());
+                    modules.push_back({file, nullptr});
+                    includedBy.push_back(" (included at line " + std::to_string(i + 1) + " of " + modules[m].path + ")");
+                }
+            }
+        }
+        round.swap(next);
+    }
+    // A file that includes only itself still has a cycle to report
+    const auto& mainLines = modules[0].program->lines();
+    if (modules.size() == 1 &&
+        std::none_of(mainLines.begin(), mainLines.end(), [](const Line& line) { return !line.include.empty(); })) {
+        return modules[0].program;
+    }
+
+    // Flatten: an INCLUDE line is followed by the lines of its module
+    std::vector<size_t> stack;
+    std::function<bool(size_t)> expand = [&](size_t m) {
+        if (std::find(stack.begin(), stack.end(), m) != stack.end()) {
+            std::string cycle;
+            for (size_t open : stack) cycle += modules[open].path + " -> ";
+            linked->error_ = "INCLUDE cycle: " + cycle + modules[m].path;
+            return false;
+        }
+        stack.push_back(m);
+        const auto& lines = modules[m].program->lines();
+        for (size_t i = 0; i < lines.size(); ++i) {
+            Line line = lines[i];
+            line.include.clear();
+            linked->lines_.push_back(std::move(line));
+            linked->locations_.push_back({m, static_cast<int>(i) + 1});
+            if (!lines[i].include.empty() && !expand(index.at(resolveInclude(modules[m].path, lines[i].include)))) {
+                return false;
+            }
+        }
+        stack.pop_back();
+        return true;
+    };
+    if (!expand(0)) {
+        linked->lines_.clear();
+        linked->locations_.clear();
+        return linked;
+    }
+
+    linked->source_ = modules[0].program->source();
+    linked->hash_ = 0;
+    for (const Module& module : modules) {
+        linked->hash_ = linked->hash_ * 31 + module.program->hash();
+        if (linked->error_.empty() && !module.program->error().empty()) {
+            linked->error_ = module.path + ": " + module.program->error();
+        }
+    }
+    // Branch slots are numbered per module, so there is no coverage map of
+    // the whole; coverage and traces take single-file programs
+    linked->modules_ = std::move(modules);
+    linked->indexStatements();
+    linked->measure();
+    return linked;
+}
+
+Program::Location Program::location(int line) const {
+    if (line >= 1 && static_cast<size_t>(line) <= locations_.size()) {
+        return locations_[static_cast<size_t>(line) - 1];
+    }
+    return {0, line};
+}
+
+std::vector<int> Program::linesOf(size_t module, int line) const {
+    if (modules_.empty()) {
+        return {line};
+    }
+    std::vector<int> lines;
+    for (size_t i = 0; i < locations_.size(); ++i) {
+        if (locations_[i].module == module && locations_[i].line == line) {
+            lines.push_back(static_cast<int>(i) + 1);
+        }
+    }
+    return lines;
+}
+
+int Program::moduleIndex(const std::string& path) const {
+    for (size_t i = 0; i < modules_.size(); ++i) {
+        if (modules_[i].path == path) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+int Program::Patch::mapLine(int index) const {
+    if (index >= static_cast<int>(lineMap.size())) {
+        // Past the end of base, e.g. a program that ran to completion
+        return index - static_cast<int>(lineMap.size()) + static_cast<int>(program->size());
+    }
+    return index < 0 ? -1 : lineMap[static_cast<size_t>(index)];
+}
+
+// Gives every IF reachable from a statement its coverage slot
+void Program::numberBranches(ASTNode* node, int line) {
+    if (!node) return;
+    switch (node->getType()) {
+        case NodeType::IF_STATEMENT: {
+            auto* ifNode = static_cast<IfStatementNode*>(node);
+            ifNode->branchIndex = static_cast<int>(branchLines_.size());
+            branchLines_.push_back(line);
+            numberBranches(ifNode->thenStatement.get(), line);
+            numberBranches(ifNode->elseStatement.get(), line);
+            break;
+        }
+        case NodeType::FOR_STATEMENT:
+            numberBranches(static_cast<ForStatementNode*>(node)->body.get(), line);
+            break;
+        case NodeType::WHILE_STATEMENT:
+            numberBranches(static_cast<WhileStatementNode*>(node)->body.get(), line);
+            break;
+        case NodeType::PROGRAM:
+            for (auto& statement : static_cast<ProgramNode*>(node)->statements) {
+                numberBranches(statement.get(), line);
+            }
+            break;
+        case NodeType::STATEMENT_LIST:
+            for (auto& statement : static_cast<StatementListNode*>(node)->statements) {
+                numberBranches(statement.get(), line);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+std::string Program::stripLineNumber(const std::string& line) {
+    size_t i = 0;
+    while (i < line.size() && std::isspace(static_cast<unsigned char>(line[i]))) ++i;
+    size_t digits = i;
+    while (i < line.size() && std::isdigit(static_cast<unsigned char>(line[i]))) ++i;
+    if (i == digits) {
+        return line;
+    }
+    while (i < line.size() && std::isspace(static_cast<unsigned char>(line[i]))) ++i;
+    return line.substr(i);
+}
+
+ProgramCache& ProgramCache::shared() {
+    static ProgramCache cache;
+    return cache;
+}
+
+std::shared_ptr<const Program> ProgramCache::get(const std::string& source) {
+    size_t hash = std::hash<std::string>{}(source);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto range = entries_.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            auto program = it->second.lock();
+            if (program && program->source() == source) {
+                return program;
+            }
+        }
+    }
+
+    // Compiled outside the lock; if another thread compiled the same source
+    // meanwhile, its copy wins and this one is dropped
+    auto compiled = Program::compile(source);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto range = entries_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        auto program = it->second.lock();
+        if (program && program->source() == source) {
+            return program;
+        }
+    }
+    entries_.emplace(hash, compiled);
+    if (entries_.size() >= sweepAt_) {
+        sweep();
+    }
+    return compiled;
+}
+
+size_t ProgramCache::size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sweep();
+    return entries_.size();
+}
+
+void ProgramCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+}
+
+// Drops expired entries; the next sweep waits until the cache has doubled
+void ProgramCache::sweep() {
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        if (it->second.expired()) {
+            it = entries_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    sweepAt_ = std::max<size_t>(64, entries_.size() * 2);
+}
+
+} // namespace basic
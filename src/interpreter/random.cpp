@@ -0,0 +1,231 @@
+#include "interpreter/random.h"
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BASIC_SIMD_AVX2 1
+#define BASIC_SIMD_SSE2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BASIC_SIMD_SSE2 1
+#endif
+
+namespace basic {
+
+namespace {
+
+constexpr size_t kStreams = 4;
+constexpr uint64_t kUnitExponent = 0x3ff0000000000000ull; // bits of 1.0
+
+inline uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+uint64_t splitMix64(uint64_t& x) {
+    uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// 52 random mantissa bits under the exponent of 1.0 give [1, 2); the vector
+// kernels use the same mapping so every target produces identical values
+inline double unitDouble(uint64_t x) {
+    uint64_t bits = (x >> 12) | kUnitExponent;
+    double d;
+    std::memcpy(&d, &bits, sizeof(d));
+    return d - 1.0;
+}
+
+void fillScalar(uint64_t lanes[4][4], double* out, size_t rounds) {
+    for (size_t r = 0; r < rounds; ++r) {
+        for (size_t i = 0; i < kStreams; ++i) {
+            uint64_t result = rotl(lanes[1][i] * 5, 7) * 9;
+            uint64_t t = lanes[1][i] << 17;
+            lanes[2][i] ^= lanes[0][i];
+            lanes[3][i] ^= lanes[1][i];
+            lanes[1][i] ^= lanes[2][i];
+            lanes[0][i] ^= lanes[3][i];
+            lanes[2][i] ^= t;
+            lanes[3][i] = rotl(lanes[3][i], 45);
+            out[r * kStreams + i] = unitDouble(result);
+        }
+    }
+}
+
+#if defined(BASIC_SIMD_AVX2)
+inline __m256i rotl256(__m256i x, int k) {
+    return _mm256_or_si256(_mm256_slli_epi64(x, k), _mm256_srli_epi64(x, 64 - k));
+}
+
+void fillVector(uint64_t lanes[4][4], double* out, size_t rounds) {
+    __m256i s0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes[0]));
+    __m256i s1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes[1]));
+    __m256i s2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes[2]));
+    __m256i s3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes[3]));
+    const __m256i exponent = _mm256_set1_epi64x(static_cast<long long>(kUnitExponent));
+    const __m256d one = _mm256_set1_pd(1.0);
+
+    for (size_t r = 0; r < rounds; ++r) {
+        // rotl(s1 * 5, 7) * 9, with the multiplies as shift + add
+        __m256i x = _mm256_add_epi64(s1, _mm256_slli_epi64(s1, 2));
+        x = rotl256(x, 7);
+        x = _mm256_add_epi64(x, _mm256_slli_epi64(x, 3));
+
+        __m256i t = _mm256_slli_epi64(s1, 17);
+        s2 = _mm256_xor_si256(s2, s0);
+        s3 = _mm256_xor_si256(s3, s1);
+        s1 = _mm256_xor_si256(s1, s2);
+        s0 = _mm256_xor_si256(s0, s3);
+        s2 = _mm256_xor_si256(s2, t);
+        s3 = rotl256(s3, 45);
+
+        __m256i bits = _mm256_or_si256(_mm256_srli_epi64(x, 12), exponent);
+        _mm256_storeu_pd(out + r * kStreams, _mm256_sub_pd(_mm256_castsi256_pd(bits), one));
+    }
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes[0]), s0);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes[1]), s1);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes[2]), s2);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes[3]), s3);
+}
+#elif defined(BASIC_SIMD_SSE2)
+inline __m128i rotl128(__m128i x, int k) {
+    return _mm_or_si128(_mm_slli_epi64(x, k), _mm_srli_epi64(x, 64 - k));
+}
+
+// Streams 0-1 and 2-3 are advanced as two independent register pairs
+void fillVector(uint64_t lanes[4][4], double* out, size_t rounds) {
+    __m128i s[4][2];
+    for (int w = 0; w < 4; ++w) {
+        s[w][0] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes[w]));
+        s[w][1] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes[w] + 2));
+    }
+    const __m128i exponent = _mm_set1_epi64x(static_cast<long long>(kUnitExponent));
+    const __m128d one = _mm_set1_pd(1.0);
+
+    for (size_t r = 0; r < rounds; ++r) {
+        for (int h = 0; h < 2; ++h) {
+            __m128i x = _mm_add_epi64(s[1][h], _mm_slli_epi64(s[1][h], 2));
+            x = rotl128(x, 7);
+            x = _mm_add_epi64(x, _mm_slli_epi64(x, 3));
+
+            __m128i t = _mm_slli_epi64(s[1][h], 17);
+            s[2][h] = _mm_xor_si128(s[2][h], s[0][h]);
+            s[3][h] = _mm_xor_si128(s[3][h], s[1][h]);
+            s[1][h] = _mm_xor_si128(s[1][h], s[2][h]);
+            s[0][h] = _mm_xor_si128(s[0][h], s[3][h]);
+            s[2][h] = _mm_xor_si128(s[2][h], t);
+            s[3][h] = rotl128(s[3][h], 45);
+
+            __m128i bits = _mm_or_si128(_mm_srli_epi64(x, 12), exponent);
+            _mm_storeu_pd(out + r * kStreams + h * 2, _mm_sub_pd(_mm_castsi128_pd(bits), one));
+        }
+    }
+
+    for (int w = 0; w < 4; ++w) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes[w]), s[w][0]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes[w] + 2), s[w][1]);
+    }
+}
+#else
+void fillVector(uint64_t lanes[4][4], double* out, size_t rounds) {
+    fillScalar(lanes, out, rounds);
+}
+#endif
+
+} // namespace
+
+Random::Random(uint64_t seed) {
+    this->seed(seed);
+}
+
+void Random::seed(uint64_t seed) {
+    uint64_t x = seed;
+    for (uint64_t& word : state_) {
+        word = splitMix64(x);
+    }
+    startStreams();
+}
+
+// Bulk streams start 1, 2, 3 and 4 jumps past the scalar stream
+void Random::startStreams() {
+    uint64_t stream[4];
+    std::memcpy(stream, state_, sizeof(stream));
+    for (size_t i = 0; i < kStreams; ++i) {
+        jump(stream);
+        for (int w = 0; w < 4; ++w) {
+            lanes_[w][i] = stream[w];
+        }
+    }
+}
+
+uint64_t Random::next() {
+    uint64_t result = rotl(state_[1] * 5, 7) * 9;
+    uint64_t t = state_[1] << 17;
+    state_[2] ^= state_[0];
+    state_[3] ^= state_[1];
+    state_[1] ^= state_[2];
+    state_[0] ^= state_[3];
+    state_[2] ^= t;
+    state_[3] = rotl(state_[3], 45);
+    return result;
+}
+
+double Random::nextDouble() {
+    return unitDouble(next());
+}
+
+void Random::fill(double* out, size_t count) {
+    size_t rounds = count / kStreams;
+    fillVector(lanes_, out, rounds);
+
+    size_t tail = count % kStreams;
+    if (tail != 0) {
+        double last[kStreams];
+        fillScalar(lanes_, last, 1);
+        std::memcpy(out + rounds * kStreams, last, tail * sizeof(double));
+    }
+}
+
+Random Random::stream(size_t index) const {
+    Random result(*this);
+    for (int w = 0; w < 4; ++w) {
+        result.state_[w] = lanes_[w][index];
+    }
+    result.startStreams();
+    return result;
+}
+
+// Advances the state by 2^128 steps
+void Random::jump(uint64_t state[4]) {
+    static const uint64_t kJump[] = {
+        0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull,
+        0xa9582618e03fc9aaull, 0x39abdc4529b1661cull
+    };
+
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (uint64_t word : kJump) {
+        for (int b = 0; b < 64; ++b) {
+            if (word & (1ull << b)) {
+                s0 ^= state[0];
+                s1 ^= state[1];
+                s2 ^= state[2];
+                s3 ^= state[3];
+            }
+            uint64_t t = state[1] << 17;
+            state[2] ^= state[0];
+            state[3] ^= state[1];
+            state[1] ^= state[2];
+            state[0] ^= state[3];
+            state[2] ^= t;
+            state[3] = rotl(state[3], 45);
+        }
+    }
+    state[0] = s0;
+    state[1] = s1;
+    state[2] = s2;
+    state[3] = s3;
+}
+
+} // namespace basic
@@ -2,25 +2,21 @@
 #include "interpreter/variables.h"
 #include "interpreter/functions.h"
 #include "interpreter/parser.h"
+#include "interpreter/output.h"
+#include "interpreter/debug_hook.h"
+#include "interpreter/memory_account.h"
+#include "interpreter/coverage.h"
+#include "interpreter/print_using.h"
+#include "interpreter/array_sort.h"
+#include "interpreter/random.h"
+#include <algorithm>
 #include <iostream>
 #include <cmath>
 #include <stdexcept>
-
-// Add these includes for DAP OutputEvent support
-#include "dap/dap_server.h"
 #include <sstream>
 
 namespace basic {
 
-// Add a pointer to the DAPServer (optional: set via constructor or setter)
-static dap::DAPServer* g_dapServer = nullptr;
-void setDAPServer(dap::DAPServer* server) { g_dapServer = server; }
-
-// Add a pointer to the BasicInterpreter for DAP access
-static BasicInterpreter* g_interpreter = nullptr;
-void setInterpreter(BasicInterpreter* interpreter) { g_interpreter = interpreter; }
-BasicInterpreter* getInterpreter() { return g_interpreter; }
-
 // Helper function to convert Value to string for DAP
 std::string valueToString(const Value& value) {
     return std::visit([](const auto& v) -> std::string {
@@ -35,6 +31,36 @@ std::string valueToString(const Value& value) {
 
 Runtime::Runtime() {}
 
+Runtime::~Runtime() {
+    reset();
+}
+
+void Runtime::reset() {
+    if (memory_) {
+        memory_->release(block.size() * sizeof(RuntimeBlock));
+    }
+    block.clear();
+}
+
+void Runtime::pushBlock(std::unique_ptr<RuntimeBlock> entry) {
+    if (memory_) {
+        memory_->charge(sizeof(RuntimeBlock));
+    }
+    block.push_back(std::move(entry));
+}
+
+void Runtime::popBlock() {
+    if (memory_) {
+        memory_->release(sizeof(RuntimeBlock));
+    }
+    block.pop_back();
+}
+
+void Runtime::clearCaches() {
+    usingCache_.clear();
+    hostCalls_.clear();
+}
+
 Value Runtime::execute(const ASTNode* node, Variables* variables, Functions* functions) {
     if (!node) return Value{};
     
@@ -43,6 +69,16 @@ Value Runtime::execute(const ASTNode* node, Variables* variables, Functions* fun
             return executeProgram(static_cast<const ProgramNode*>(node), variables, functions);
         case NodeType::LET_STATEMENT:
             return executeLetStatement(static_cast<const LetStatementNode*>(node), variables, functions);
+        case NodeType::VARIABLE_DECLARATION:
+            return executeDimStatement(static_cast<const DimStatementNode*>(node), variables, functions);
+        case NodeType::RANDOMIZE_STATEMENT:
+            return executeRandomizeStatement(static_cast<const RandomizeStatementNode*>(node), variables, functions);
+        case NodeType::RNDFILL_STATEMENT:
+            return executeRndFillStatement(static_cast<const RndFillStatementNode*>(node), variables, functions);
+        case NodeType::DICT_DECLARATION:
+            return executeDictStatement(static_cast<const DictStatementNode*>(node), variables, functions);
+        case NodeType::SORT_STATEMENT:
+            return executeSortStatement(static_cast<const SortStatementNode*>(node), variables, functions);
         case NodeType::IF_STATEMENT:
             return executeIfStatement(static_cast<const IfStatementNode*>(node), variables, functions);
         case NodeType::FOR_STATEMENT:
@@ -80,26 +116,139 @@ Value Runtime::executeProgram(const ProgramNode* node, Variables* variables, Fun
 
 Value Runtime::executeLetStatement(const LetStatementNode* node, Variables* variables, Functions* functions) {
     // --- DAP step notification ---
-    if (g_dapServer && g_dapServer->isRunning()) {
-        g_dapServer->checkForStep(node->line);
+    if (debugHook_ && debugHook_->isAttached()) {
+        debugHook_->onStatement(node->line);
     }
     // -----------------------------
 
     Value value = this->execute(node->value.get(), variables, functions);
-    variables->set(node->variableName, value);
+    if (node->indices.size() == 1) {
+        // D(key) = value
+        if (Dictionary* dict = variables->getDict(node->variableName)) {
+            dict->set(this->execute(node->indices[0].get(), variables, functions), value);
+            return value;
+        }
+    }
+    if (!node->indices.empty()) {
+        variables->setElement(node->variableName, evaluateIndices(node->indices, variables, functions), value);
+    } else {
+        variables->set(node->variableName, value);
+    }
     return value;
 }
 
+Value Runtime::executeDimStatement(const DimStatementNode* node, Variables* variables, Functions* functions) {
+    // --- DAP step notification ---
+    if (debugHook_ && debugHook_->isAttached()) {
+        debugHook_->onStatement(node->line);
+    }
+    // -----------------------------
+
+    for (const auto& declaration : node->declarations) {
+        variables->dim(declaration.name, evaluateIndices(declaration.bounds, variables, functions));
+    }
+    return Value{};
+}
+
+Value Runtime::executeRandomizeStatement(const RandomizeStatementNode* node, Variables* variables, Functions* functions) {
+    // --- DAP step notification ---
+    if (debugHook_ && debugHook_->isAttached()) {
+        debugHook_->onStatement(node->line);
+    }
+    // -----------------------------
+
+    if (node->seed) {
+        functions->randomize(this->execute(node->seed.get(), variables, functions));
+    } else {
+        functions->randomize();
+    }
+    return Value{};
+}
+
+Value Runtime::executeRndFillStatement(const RndFillStatementNode* node, Variables* variables, Functions* functions) {
+    // --- DAP step notification ---
+    if (debugHook_ && debugHook_->isAttached()) {
+        debugHook_->onStatement(node->line);
+    }
+    // -----------------------------
+
+    Array* array = variables->getArray(node->arrayName);
+    if (!array) {
+        throw std::runtime_error("Array '" + node->arrayName + "' not dimensioned");
+    }
+    
+    // Generate in cache-sized chunks, then store into the Value slots
+    constexpr size_t kChunk = 1024;
+    double chunk[kChunk];
+    Random& random = functions->getRandom();
+    for (size_t start = 0; start < array->data.size(); start += kChunk) {
+        size_t count = std::min(kChunk, array->data.size() - start);
+        random.fill(chunk, count);
+        for (size_t i = 0; i < count; ++i) {
+            array->data[start + i] = chunk[i];
+        }
+    }
+    if (array->stringBytes) {
+        variables->recount(*array);
+    } else {
+        variables->arrayChanged(*array);
+    }
+    return Value{};
+}
+
+Value Runtime::executeDictStatement(const DictStatementNode* node, Variables* variables, Functions* functions) {
+    // --- DAP step notification ---
+    if (debugHook_ && debugHook_->isAttached()) {
+        debugHook_->onStatement(node->line);
+    }
+    // -----------------------------
+
+    for (const auto& name : node->names) {
+        variables->declareDict(name);
+    }
+    return Value{};
+}
+
+Value Runtime::executeSortStatement(const SortStatementNode* node, Variables* variables, Functions* functions) {
+    // --- DAP step notification ---
+    if (debugHook_ && debugHook_->isAttached()) {
+        debugHook_->onStatement(node->line);
+    }
+    // -----------------------------
+
+    Array* array = variables->getArray(node->arrayName);
+    if (!array) {
+        throw std::runtime_error("Array '" + node->arrayName + "' not dimensioned");
+    }
+    if (node->keyArrayName.empty()) {
+        sortArray(*array);
+        variables->arrayChanged(*array);
+        return Value{};
+    }
+    Array* keys = variables->getArray(node->keyArrayName);
+    if (!keys) {
+        throw std::runtime_error("Array '" + node->keyArrayName + "' not dimensioned");
+    }
+    sortArray(*keys, array);
+    variables->arrayChanged(*keys);
+    variables->arrayChanged(*array);
+    return Value{};
+}
+
 Value Runtime::executeIfStatement(const IfStatementNode* node, Variables* variables, Functions* functions) {
     Value condition = this->execute(node->condition.get(), variables, functions);
     
     // --- DAP step notification ---
-    if (g_dapServer && g_dapServer->isRunning()) {
-        g_dapServer->checkForStep(node->line);
+    if (debugHook_ && debugHook_->isAttached()) {
+        debugHook_->onStatement(node->line);
     }
     // -----------------------------
     
-    if (this->isTruthy(condition)) {
+    bool taken = this->isTruthy(condition);
+    if (coverage_ && node->branchIndex >= 0) {
+        coverage_->hitBranch(node->branchIndex, taken);
+    }
+    if (taken) {
         return this->execute(node->thenStatement.get(), variables, functions);
     } else if (node->elseStatement) {
         return this->execute(node->elseStatement.get(), variables, functions);
@@ -152,12 +301,12 @@ Value Runtime::executeForStatement(const ForStatementNode* node, Variables* vari
         // -----------------------------
         if (!node->body.get()) {
             // Push a context
-            block.push_back(std::make_unique<RuntimeBlock>(node->variableName, currentVal, endVal, stepVal));
+            pushBlock(std::make_unique<RuntimeBlock>(node->variableName, currentVal, endVal, stepVal));
             break;
         }
         // --- DAP step notification ---
-        if (g_dapServer && g_dapServer->isRunning()) {
-            g_dapServer->checkForStep(node->line);
+        if (debugHook_ && debugHook_->isAttached()) {
+            debugHook_->onStatement(node->line);
         }
         this->execute(node->body.get(), variables, functions);
 
@@ -181,7 +330,7 @@ Value Runtime::executeNextStatement(const NextStatementNode* node, Variables* va
                 return Value(blk->line);
             }
             else {
-                block.pop_back();
+                popBlock();
             }
         }
     }
@@ -191,8 +340,8 @@ Value Runtime::executeNextStatement(const NextStatementNode* node, Variables* va
 Value Runtime::executeWhileStatement(const WhileStatementNode* node, Variables* variables, Functions* functions) {
     while (this->isTruthy(this->execute(node->condition.get(), variables, functions))) {
         // --- DAP step notification ---
-        if (g_dapServer && g_dapServer->isRunning()) {
-            g_dapServer->checkForStep(node->line);
+        if (debugHook_ && debugHook_->isAttached()) {
+            debugHook_->onStatement(node->line);
         }
         // -----------------------------
 
@@ -203,11 +352,15 @@ Value Runtime::executeWhileStatement(const WhileStatementNode* node, Variables*
 
 Value Runtime::executePrintStatement(const PrintStatementNode* node, Variables* variables, Functions* functions) {
     // --- DAP step notification ---
-    if (g_dapServer && g_dapServer->isRunning()) {
-        g_dapServer->checkForStep(node->line);
+    if (debugHook_ && debugHook_->isAttached()) {
+        debugHook_->onStatement(node->line);
     }
     // -----------------------------
 
+    if (node->usingFormat) {
+        return executePrintUsing(node, variables, functions);
+    }
+
     std::ostringstream oss;
     for (size_t i = 0; i < node->expressions.size(); ++i) {
         Value value = this->execute(node->expressions[i].get(), variables, functions);
@@ -227,24 +380,66 @@ Value Runtime::executePrintStatement(const PrintStatementNode* node, Variables*
     }
     oss << std::endl;
 
+    writeOutput(oss.str());
+    return Value{};
+}
+
+Value Runtime::executePrintUsing(const PrintStatementNode* node, Variables* variables, Functions* functions) {
+    // Literal formats are compiled by the parser; computed ones are cached
+    // here and recompiled only when the format string changes
+    const PrintUsingTemplate* usingTemplate = node->usingTemplate.get();
+    if (!usingTemplate) {
+        Value format = this->execute(node->usingFormat.get(), variables, functions);
+        if (!std::holds_alternative<std::string>(format)) {
+            throw std::runtime_error("PRINT USING format must be a string");
+        }
+        const std::string& text = std::get<std::string>(format);
+        auto& cached = usingCache_[node];
+        if (!cached || cached->format() != text) {
+            cached = std::make_unique<PrintUsingTemplate>(text);
+        }
+        usingTemplate = cached.get();
+    }
+
+    std::vector<Value> values;
+    values.reserve(node->expressions.size());
+    for (const auto& expression : node->expressions) {
+        values.push_back(this->execute(expression.get(), variables, functions));
+    }
+
+    printBuffer_.clear();
+    usingTemplate->apply(values, printBuffer_);
+    printBuffer_ += '\n';
+    writeOutput(printBuffer_);
+    return Value{};
+}
+
+void Runtime::writeOutput(const std::string& text) {
     // Output to DAP OutputEvent if running under DAP
-    if (g_dapServer && g_dapServer->isRunning()) {
-        g_dapServer->sendOutputEvent("stdout", oss.str());
+    if (debugHook_ && debugHook_->isAttached()) {
+        debugHook_->onOutput(text);
+    } else if (output_) {
+        output_->write(text);
     } else {
-        std::cout << oss.str();
+        std::cout << text;
     }
-    return Value{};
 }
 
 Value Runtime::executeInputStatement(const InputStatementNode* node, Variables* variables, Functions* functions) {
     // --- DAP step notification ---
-    if (g_dapServer && g_dapServer->isRunning()) {
-        g_dapServer->checkForStep(node->line);
+    if (debugHook_ && debugHook_->isAttached()) {
+        debugHook_->onStatement(node->line);
     }
     // -----------------------------
 
-    if (!node->prompt.empty()) {
-        std::cout << node->prompt;
+    // Pending PRINT output has to be visible before we block on input
+    if (output_) {
+        if (!node->prompt.empty()) {
+            output_->write(node->prompt);
+        }
+        output_->flush();
+    } else if (!node->prompt.empty()) {
+        std::cout << node->prompt << std::flush;
     }
     
     std::string input;
@@ -267,14 +462,69 @@ Value Runtime::executeInputStatement(const InputStatementNode* node, Variables*
 }
 
 Value Runtime::executeFunctionCall(const FunctionCallNode* node, Variables* variables, Functions* functions) {
+    // A(I, J) element read
+    if (variables->hasArray(node->functionName)) {
+        return variables->getElement(node->functionName, evaluateIndices(node->arguments, variables, functions));
+    }
+    // D(key) dictionary read
+    if (node->arguments.size() == 1) {
+        if (Dictionary* dict = variables->getDict(node->functionName)) {
+            const Value* found = dict->find(this->execute(node->arguments[0].get(), variables, functions));
+            if (!found) {
+                throw std::runtime_error("Key not found in dictionary '" + node->functionName + "'");
+            }
+            return *found;
+        }
+    }
+    
+    const HostFunction* host = resolveHostCall(node, functions);
+    
     std::vector<Value> args;
+    args.reserve(node->arguments.size());
     for (const auto& arg : node->arguments) {
+        // The built-in looks the array up by name; see Functions::takesArray
+        if (arg->getType() == NodeType::ARRAY_REFERENCE) {
+            args.push_back(Value{static_cast<const ArrayReferenceNode*>(arg.get())->arrayName});
+            continue;
+        }
         args.push_back(this->execute(arg.get(), variables, functions));
     }
     
+    if (host) {
+        return (*host)(args);
+    }
     return functions->call(node->functionName, args, variables);
 }
 
+// Built-in names cannot be bound, so a host function found here is exactly
+// what Functions::call would dispatch to
+const HostFunction* Runtime::resolveHostCall(const FunctionCallNode* node, Functions* functions) {
+    if (!functions->hasHostFunctions()) {
+        return nullptr;
+    }
+    auto it = hostCalls_.find(node);
+    if (it == hostCalls_.end() || it->second.generation != functions->hostGeneration()) {
+        HostCallSite site{functions->findHost(node->functionName), functions->hostGeneration()};
+        it = hostCalls_.insert_or_assign(node, site).first;
+    }
+    return it->second.function;
+}
+
+std::vector<int> Runtime::evaluateIndices(const std::vector<std::unique_ptr<ASTNode>>& nodes, Variables* variables, Functions* functions) {
+    std::vector<int> indices;
+    indices.reserve(nodes.size());
+    for (const auto& node : nodes) {
+        Value value = this->execute(node.get(), variables, functions);
+        indices.push_back(std::visit([](const auto& v) -> int {
+            using T = std::decay_t<decltype(v)>;
+            if constexpr (std::is_same_v<T, int>) return v;
+            else if constexpr (std::is_same_v<T, double>) return static_cast<int>(v);
+            else throw std::runtime_error("Array subscript must be numeric");
+        }, value));
+    }
+    return indices;
+}
+
 Value Runtime::executeBinaryExpression(const BinaryExpressionNode* node, Variables* variables, Functions* functions) {
     Value left = this->execute(node->left.get(), variables, functions);
     Value right = this->execute(node->right.get(), variables, functions);
@@ -332,6 +582,10 @@ Value Runtime::executeLiteral(const LiteralNode* node, Variables* variables, Fun
 }
 
 Value Runtime::executeIdentifier(const IdentifierNode* node, Variables* variables, Functions* functions) {
+    // Bare builtin name such as RND
+    if (!variables->exists(node->name) && functions->isBuiltin(node->name)) {
+        return functions->call(node->name, {}, variables);
+    }
     return variables->get(node->name);
 }
 
@@ -0,0 +1,491 @@
+#include "interpreter/simd_string.h"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+// The AVX2 kernels are compiled in on x86-64 unless BASIC_ENABLE_AVX2 is
+// off, and chosen at startup when the CPU has AVX2. A build with -mavx2
+// needs no check.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BASIC_SIMD_AVX2 1
+#define BASIC_SIMD_SSE2 1
+#define BASIC_AVX2_TARGET
+#elif defined(BASIC_ENABLE_AVX2) && defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define BASIC_SIMD_AVX2 1
+#define BASIC_SIMD_SSE2 1
+#define BASIC_AVX2_TARGET __attribute__((target("avx2")))
+#elif defined(BASIC_ENABLE_AVX2) && defined(_M_X64)
+#include <immintrin.h>
+#define BASIC_SIMD_AVX2 1
+#define BASIC_SIMD_SSE2 1
+#define BASIC_AVX2_TARGET
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BASIC_SIMD_SSE2 1
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace basic {
+namespace simd {
+
+namespace {
+
+inline unsigned countTrailingZeros(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+#ifdef BASIC_SIMD_AVX2
+bool detectAvx2() {
+#if defined(__AVX2__)
+    return true;
+#elif defined(_MSC_VER)
+    // AVX2 in the CPU, and the OS saving the YMM registers
+    int info[4];
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    // May run before other static constructors
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+// False until initialised, so a call from another static constructor gets
+// the SSE2 kernels
+std::atomic<bool> avx2Active{detectAvx2()};
+
+inline bool useAvx2() {
+    return avx2Active.load(std::memory_order_relaxed);
+}
+
+BASIC_AVX2_TARGET inline uint32_t matchMask32(const char* data, __m256i needle) {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+}
+#endif
+
+#ifdef BASIC_SIMD_SSE2
+inline uint32_t matchMask16(const char* data, __m128i needle) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+}
+
+// 0xFF in every lane holding a byte in [lo, hi] (signed compare, so bytes
+// >= 0x80 never match an ASCII range)
+inline __m128i rangeMask16(__m128i block, char lo, char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8(static_cast<char>(lo - 1))),
+                         _mm_cmplt_epi8(block, _mm_set1_epi8(static_cast<char>(hi + 1))));
+}
+
+inline __m128i spaceMask16(__m128i block) {
+    __m128i mask = _mm_cmpeq_epi8(block, _mm_set1_epi8(' '));
+    mask = _mm_or_si128(mask, _mm_cmpeq_epi8(block, _mm_set1_epi8('\t')));
+    mask = _mm_or_si128(mask, _mm_cmpeq_epi8(block, _mm_set1_epi8('\r')));
+    return _mm_or_si128(mask, _mm_cmpeq_epi8(block, _mm_set1_epi8('\n')));
+}
+
+inline __m128i foldLower16(__m128i block) {
+    return _mm_add_epi8(block, _mm_and_si128(rangeMask16(block, 'A', 'Z'), _mm_set1_epi8(0x20)));
+}
+#endif
+
+#ifdef BASIC_SIMD_AVX2
+BASIC_AVX2_TARGET inline __m256i rangeMask32(__m256i block, char lo, char hi) {
+    return _mm256_and_si256(_mm256_cmpgt_epi8(block, _mm256_set1_epi8(static_cast<char>(lo - 1))),
+                            _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(hi + 1)), block));
+}
+
+// The 32-byte loops of the kernels below. Each starts at i, stops at the
+// first hit or where fewer than 32 bytes are left, and leaves i there for
+// the SSE2 and scalar loops to carry on from.
+
+BASIC_AVX2_TARGET void flipCase32(char* data, size_t size, char lo, char hi, size_t& i) {
+    const __m256i bit32 = _mm256_set1_epi8(0x20);
+    for (; i + 32 <= size; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        block = _mm256_xor_si256(block, _mm256_and_si256(rangeMask32(block, lo, hi), bit32));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(data + i), block);
+    }
+}
+
+BASIC_AVX2_TARGET size_t findByte32(const char* data, size_t size, char c, size_t& i) {
+    const __m256i needle32 = _mm256_set1_epi8(c);
+    for (; i + 32 <= size; i += 32) {
+        uint32_t mask = matchMask32(data + i, needle32);
+        if (mask) return i + countTrailingZeros(mask);
+    }
+    return npos;
+}
+
+BASIC_AVX2_TARGET size_t findEither32(const char* data, size_t size, char a, char b, size_t& i) {
+    const __m256i a32 = _mm256_set1_epi8(a);
+    const __m256i b32 = _mm256_set1_epi8(b);
+    for (; i + 32 <= size; i += 32) {
+        uint32_t mask = matchMask32(data + i, a32) | matchMask32(data + i, b32);
+        if (mask) return i + countTrailingZeros(mask);
+    }
+    return npos;
+}
+
+BASIC_AVX2_TARGET size_t findJsonEscape32(const char* data, size_t size, size_t& i) {
+    const __m256i quote32 = _mm256_set1_epi8('"');
+    const __m256i backslash32 = _mm256_set1_epi8('\\');
+    for (; i + 32 <= size; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(block, quote32), _mm256_cmpeq_epi8(block, backslash32));
+        hits = _mm256_or_si256(hits, rangeMask32(block, 0, 0x1f));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+        if (mask) return i + countTrailingZeros(mask);
+    }
+    return npos;
+}
+
+BASIC_AVX2_TARGET size_t findNonAscii32(const char* data, size_t size, size_t& i) {
+    for (; i + 32 <= size; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(block));
+        if (mask) return i + countTrailingZeros(mask);
+    }
+    return npos;
+}
+
+BASIC_AVX2_TARGET void findAll32(const char* data, size_t size, char c, std::vector<size_t>& positions, size_t& i) {
+    const __m256i needle32 = _mm256_set1_epi8(c);
+    for (; i + 32 <= size; i += 32) {
+        uint32_t mask = matchMask32(data + i, needle32);
+        while (mask) {
+            positions.push_back(i + countTrailingZeros(mask));
+            mask &= mask - 1;
+        }
+    }
+}
+
+// Candidate starts up to `last`; see find()
+BASIC_AVX2_TARGET size_t find32(const char* data, size_t last, std::string_view needle, size_t& i) {
+    const size_t length = needle.size();
+    const __m256i first32 = _mm256_set1_epi8(needle[0]);
+    const __m256i final32 = _mm256_set1_epi8(needle[length - 1]);
+    for (; i + 32 <= last + 1; i += 32) {
+        uint32_t mask = matchMask32(data + i, first32) & matchMask32(data + i + length - 1, final32);
+        while (mask) {
+            size_t candidate = i + countTrailingZeros(mask);
+            if (std::memcmp(data + candidate + 1, needle.data() + 1, length - 2) == 0) return candidate;
+            mask &= mask - 1;
+        }
+    }
+    return npos;
+}
+#endif
+
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+inline char asciiLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + 0x20) : c;
+}
+
+inline unsigned countLeadingZeros(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse(&index, mask);
+    return 31u - static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_clz(mask));
+#endif
+}
+
+// Case conversion shared by toUpper/toLower: flips bit 0x20 of every byte
+// in [lo, hi]
+void flipCase(char* data, size_t size, char lo, char hi) {
+    size_t i = 0;
+#ifdef BASIC_SIMD_AVX2
+    if (size >= 32 && useAvx2()) flipCase32(data, size, lo, hi, i);
+#endif
+#ifdef BASIC_SIMD_SSE2
+    const __m128i bit16 = _mm_set1_epi8(0x20);
+    for (; i + 16 <= size; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        block = _mm_xor_si128(block, _mm_and_si128(rangeMask16(block, lo, hi), bit16));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), block);
+    }
+#endif
+    for (; i < size; ++i) {
+        if (data[i] >= lo && data[i] <= hi) data[i] = static_cast<char>(data[i] ^ 0x20);
+    }
+}
+
+} // namespace
+
+size_t findByte(std::string_view text, char c, size_t from) {
+    const char* data = text.data();
+    const size_t size = text.size();
+    size_t i = from;
+
+#ifdef BASIC_SIMD_AVX2
+    if (i + 32 <= size && useAvx2()) {
+        size_t found = findByte32(data, size, c, i);
+        if (found != npos) return found;
+    }
+#endif
+#ifdef BASIC_SIMD_SSE2
+    const __m128i needle16 = _mm_set1_epi8(c);
+    for (; i + 16 <= size; i += 16) {
+        uint32_t mask = matchMask16(data + i, needle16);
+        if (mask) return i + countTrailingZeros(mask);
+    }
+#endif
+    for (; i < size; ++i) {
+        if (data[i] == c) return i;
+    }
+    return npos;
+}
+
+size_t findEither(std::string_view text, char a, char b, size_t from) {
+    const char* data = text.data();
+    const size_t size = text.size();
+    size_t i = from;
+
+#ifdef BASIC_SIMD_AVX2
+    if (i + 32 <= size && useAvx2()) {
+        size_t found = findEither32(data, size, a, b, i);
+        if (found != npos) return found;
+    }
+#endif
+#ifdef BASIC_SIMD_SSE2
+    const __m128i a16 = _mm_set1_epi8(a);
+    const __m128i b16 = _mm_set1_epi8(b);
+    for (; i + 16 <= size; i += 16) {
+        uint32_t mask = matchMask16(data + i, a16) | matchMask16(data + i, b16);
+        if (mask) return i + countTrailingZeros(mask);
+    }
+#endif
+    for (; i < size; ++i) {
+        if (data[i] == a || data[i] == b) return i;
+    }
+    return npos;
+}
+
+size_t findJsonEscape(std::string_view text, size_t from) {
+    const char* data = text.data();
+    const size_t size = text.size();
+    size_t i = from;
+
+#ifdef BASIC_SIMD_AVX2
+    if (i + 32 <= size && useAvx2()) {
+        size_t found = findJsonEscape32(data, size, i);
+        if (found != npos) return found;
+    }
+#endif
+#ifdef BASIC_SIMD_SSE2
+    const __m128i quote16 = _mm_set1_epi8('"');
+    const __m128i backslash16 = _mm_set1_epi8('\\');
+    for (; i + 16 <= size; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(block, quote16), _mm_cmpeq_epi8(block, backslash16));
+        hits = _mm_or_si128(hits, rangeMask16(block, 0, 0x1f));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hits));
+        if (mask) return i + countTrailingZeros(mask);
+    }
+#endif
+    for (; i < size; ++i) {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        if (c == '"' || c == '\\' || c < 0x20) return i;
+    }
+    return npos;
+}
+
+size_t findNonAscii(std::string_view text, size_t from) {
+    const char* data = text.data();
+    const size_t size = text.size();
+    size_t i = from;
+
+#ifdef BASIC_SIMD_AVX2
+    if (i + 32 <= size && useAvx2()) {
+        size_t found = findNonAscii32(data, size, i);
+        if (found != npos) return found;
+    }
+#endif
+#ifdef BASIC_SIMD_SSE2
+    for (; i + 16 <= size; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(block));
+        if (mask) return i + countTrailingZeros(mask);
+    }
+#endif
+    for (; i < size; ++i) {
+        if (static_cast<unsigned char>(data[i]) >= 0x80) return i;
+    }
+    return npos;
+}
+
+void findAll(std::string_view text, char c, std::vector<size_t>& positions) {
+    const char* data = text.data();
+    const size_t size = text.size();
+    size_t i = 0;
+
+#ifdef BASIC_SIMD_AVX2
+    if (size >= 32 && useAvx2()) findAll32(data, size, c, positions, i);
+#endif
+#ifdef BASIC_SIMD_SSE2
+    const __m128i needle16 = _mm_set1_epi8(c);
+    for (; i + 16 <= size; i += 16) {
+        uint32_t mask = matchMask16(data + i, needle16);
+        while (mask) {
+            positions.push_back(i + countTrailingZeros(mask));
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i < size; ++i) {
+        if (data[i] == c) positions.push_back(i);
+    }
+}
+
+size_t find(std::string_view text, std::string_view needle, size_t from) {
+    const size_t size = text.size();
+    const size_t length = needle.size();
+    if (length == 0) return from <= size ? from : npos;
+    if (length > size || from > size - length) return npos;
+    if (length == 1) return findByte(text, needle[0], from);
+
+    const char* data = text.data();
+    const size_t last = size - length; // last valid start position
+    size_t i = from;
+
+#ifdef BASIC_SIMD_AVX2
+    if (i + 32 <= last + 1 && useAvx2()) {
+        size_t found = find32(data, last, needle, i);
+        if (found != npos) return found;
+    }
+#endif
+#ifdef BASIC_SIMD_SSE2
+    const __m128i first16 = _mm_set1_epi8(needle[0]);
+    const __m128i final16 = _mm_set1_epi8(needle[length - 1]);
+    for (; i + 16 <= last + 1; i += 16) {
+        uint32_t mask = matchMask16(data + i, first16) & matchMask16(data + i + length - 1, final16);
+        while (mask) {
+            size_t candidate = i + countTrailingZeros(mask);
+            if (std::memcmp(data + candidate + 1, needle.data() + 1, length - 2) == 0) return candidate;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i <= last; ++i) {
+        if (data[i] == needle[0] && data[i + length - 1] == needle[length - 1] &&
+            std::memcmp(data + i + 1, needle.data() + 1, length - 2) == 0) {
+            return i;
+        }
+    }
+    return npos;
+}
+
+void toUpper(char* data, size_t size) {
+    flipCase(data, size, 'a', 'z');
+}
+
+void toLower(char* data, size_t size) {
+    flipCase(data, size, 'A', 'Z');
+}
+
+size_t skipSpace(std::string_view text) {
+    const char* data = text.data();
+    const size_t size = text.size();
+    size_t i = 0;
+#ifdef BASIC_SIMD_SSE2
+    for (; i + 16 <= size; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        uint32_t notSpace = ~static_cast<uint32_t>(_mm_movemask_epi8(spaceMask16(block))) & 0xFFFFu;
+        if (notSpace) return i + countTrailingZeros(notSpace);
+    }
+#endif
+    for (; i < size; ++i) {
+        if (!isSpace(data[i])) return i;
+    }
+    return size;
+}
+
+size_t trimSpaceEnd(std::string_view text) {
+    const char* data = text.data();
+    size_t end = text.size();
+#ifdef BASIC_SIMD_SSE2
+    for (; end >= 16; end -= 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + end - 16));
+        uint32_t notSpace = ~static_cast<uint32_t>(_mm_movemask_epi8(spaceMask16(block))) & 0xFFFFu;
+        if (notSpace) return end - 16 + (32 - countLeadingZeros(notSpace));
+    }
+#endif
+    for (; end > 0; --end) {
+        if (!isSpace(data[end - 1])) return end;
+    }
+    return 0;
+}
+
+int compare(std::string_view a, std::string_view b) {
+    // memcmp is already vectorized by the C library
+    int result = std::memcmp(a.data(), b.data(), std::min(a.size(), b.size()));
+    if (result != 0) return result;
+    return a.size() < b.size() ? -1 : (a.size() > b.size() ? 1 : 0);
+}
+
+int compareIgnoreCase(std::string_view a, std::string_view b) {
+    const size_t size = std::min(a.size(), b.size());
+    size_t i = 0;
+#ifdef BASIC_SIMD_SSE2
+    for (; i + 16 <= size; i += 16) {
+        __m128i left = foldLower16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a.data() + i)));
+        __m128i right = foldLower16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b.data() + i)));
+        uint32_t differ = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(left, right))) & 0xFFFFu;
+        if (differ) {
+            i += countTrailingZeros(differ);
+            break;
+        }
+    }
+#endif
+    for (; i < size; ++i) {
+        unsigned char left = static_cast<unsigned char>(asciiLower(a[i]));
+        unsigned char right = static_cast<unsigned char>(asciiLower(b[i]));
+        if (left != right) return left < right ? -1 : 1;
+    }
+    return a.size() < b.size() ? -1 : (a.size() > b.size() ? 1 : 0);
+}
+
+const char* kernelName() {
+#if defined(BASIC_SIMD_AVX2)
+    if (useAvx2()) return "avx2";
+#endif
+#if defined(BASIC_SIMD_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+bool setAvx2(bool enabled) {
+#if defined(BASIC_SIMD_AVX2)
+    avx2Active.store(enabled && detectAvx2(), std::memory_order_relaxed);
+    return useAvx2();
+#else
+    (void)enabled;
+    return false;
+#endif
+}
+
+} // namespace simd
+} // namespace basic
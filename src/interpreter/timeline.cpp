@@ -0,0 +1,215 @@
+#include "interpreter/timeline.h"
+
+#ifdef BASIC_HAVE_TIMELINE
+
+#include "protocol/json_escape.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace basic {
+
+namespace {
+
+constexpr size_t kChunkEvents = 4096;
+constexpr size_t kMaxChunks = 1024; // about 4M events per thread
+
+struct Event {
+    const char* name;
+    uint64_t start;
+    uint64_t duration;
+    char detail[TimelineScope::kDetailSize];
+};
+
+// Written only by its thread. count is published with release so the
+// exporter sees complete events; chunks are never freed while recording.
+struct ThreadBuffer {
+    int id = 0;
+    std::string name;
+    std::atomic<Event*> chunks[kMaxChunks] = {};
+    std::atomic<size_t> count{0};
+    std::atomic<size_t> dropped{0};
+
+    ~ThreadBuffer() {
+        for (auto& chunk : chunks) {
+            delete[] chunk.load();
+        }
+    }
+};
+
+// Buffers outlive their threads so a worker's events can still be exported
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::atomic<bool> enabled{false};
+    std::atomic<uint64_t> origin{0};
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+ThreadBuffer& localBuffer() {
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer) {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.buffers.push_back(std::make_unique<ThreadBuffer>());
+        buffer = r.buffers.back().get();
+        buffer->id = static_cast<int>(r.buffers.size());
+        buffer->name = buffer->id == 1 ? "main" : "thread " + std::to_string(buffer->id);
+    }
+    return *buffer;
+}
+
+uint64_t now() {
+    auto ticks = std::chrono::steady_clock::now().time_since_epoch();
+    // Never 0, which marks a scope opened while the timeline was off
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(ticks).count()) | 1;
+}
+
+void writeEscaped(std::ostream& out, const char* text) {
+    std::string escaped;
+    protocol::appendEscaped(escaped, text);
+    out << '"' << escaped << '"';
+}
+
+void writeMicros(std::ostream& out, uint64_t nanos) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%llu.%03llu", static_cast<unsigned long long>(nanos / 1000),
+                  static_cast<unsigned long long>(nanos % 1000));
+    out << text;
+}
+
+} // namespace
+
+void Timeline::start() {
+    uint64_t none = 0;
+    registry().origin.compare_exchange_strong(none, now());
+    registry().enabled.store(true, std::memory_order_release);
+}
+
+void Timeline::stop() {
+    registry().enabled.store(false, std::memory_order_release);
+}
+
+bool Timeline::enabled() {
+    return registry().enabled.load(std::memory_order_relaxed);
+}
+
+bool Timeline::available() {
+    return true;
+}
+
+void Timeline::nameThread(const std::string& name) {
+    ThreadBuffer& buffer = localBuffer();
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    buffer.name = name;
+}
+
+size_t Timeline::droppedEvents() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    size_t dropped = 0;
+    for (const auto& buffer : r.buffers) {
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+void Timeline::writeChromeTrace(std::ostream& out) {
+    Registry& r = registry();
+    uint64_t origin = r.origin.load();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto& buffer : r.buffers) {
+        out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id
+            << ",\"args\":{\"name\":";
+        writeEscaped(out, buffer->name.c_str());
+        out << "}}";
+        first = false;
+
+        size_t count = buffer->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; ++i) {
+            const Event& event = buffer->chunks[i / kChunkEvents].load(std::memory_order_acquire)[i % kChunkEvents];
+            out << ",\n{\"name\":";
+            writeEscaped(out, event.name);
+            out << ",\"cat\":\"basic\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id << ",\"ts\":";
+            writeMicros(out, event.start >= origin ? event.start - origin : 0);
+            out << ",\"dur\":";
+            writeMicros(out, event.duration);
+            if (event.detail[0]) {
+                out << ",\"args\":{\"detail\":";
+                writeEscaped(out, event.detail);
+                out << "}";
+            }
+            out << "}";
+        }
+    }
+    out << "\n]}\n";
+}
+
+TimelineScope::TimelineScope(const char* name, const char* detail)
+    : name_(name), start_(0) {
+    if (!Timeline::enabled()) {
+        return;
+    }
+    detail_[0] = '\0';
+    if (detail) {
+        std::strncpy(detail_, detail, kDetailSize - 1);
+        detail_[kDetailSize - 1] = '\0';
+    }
+    start_ = now();
+}
+
+TimelineScope::~TimelineScope() {
+    if (!start_) {
+        return;
+    }
+    uint64_t end = now();
+    ThreadBuffer& buffer = localBuffer();
+    size_t index = buffer.count.load(std::memory_order_relaxed);
+    size_t chunkIndex = index / kChunkEvents;
+    if (chunkIndex >= kMaxChunks) {
+        buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Event* chunk = buffer.chunks[chunkIndex].load(std::memory_order_relaxed);
+    if (!chunk) {
+        chunk = new Event[kChunkEvents];
+        buffer.chunks[chunkIndex].store(chunk, std::memory_order_release);
+    }
+    Event& event = chunk[index % kChunkEvents];
+    event.name = name_;
+    event.start = start_;
+    event.duration = end - start_;
+    std::memcpy(event.detail, detail_, kDetailSize);
+    buffer.count.store(index + 1, std::memory_order_release);
+}
+
+} // namespace basic
+
+#else
+
+namespace basic {
+
+void Timeline::start() {}
+void Timeline::stop() {}
+bool Timeline::enabled() { return false; }
+bool Timeline::available() { return false; }
+void Timeline::nameThread(const std::string&) {}
+size_t Timeline::droppedEvents() { return 0; }
+
+void Timeline::writeChromeTrace(std::ostream& out) {
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[]}\n";
+}
+
+} // namespace basic
+
+#endif
@@ -0,0 +1,586 @@
+#include "interpreter/trace.h"
+#include "interpreter/output.h"
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+namespace basic {
+
+namespace {
+
+const char kMagic[8] = {'B', 'A', 'S', 'T', 'R', 'C', '1', '\n'};
+
+// Event tags live in the low three bits; a statement keeps its line delta in
+// the upper five when it fits
+enum Tag : uint8_t {
+    kStatement = 0,
+    kSet = 1,
+    kElement = 2,
+    kArray = 3,
+    kDim = 4,
+    kName = 5,
+    kKeyframe = 6,
+    kControl = 7
+};
+enum Control : uint8_t { kClear = 0, kEnd = 1 };
+constexpr uint8_t kLongDelta = 31;
+
+// BASIC arithmetic yields doubles; whole ones are stored as varints
+enum ValueTag : uint8_t { kInt = 0, kDouble = 1, kString = 2, kFalse = 3, kTrue = 4, kWholeDouble = 5 };
+constexpr double kMaxWholeDouble = 9007199254740992.0; // 2^53
+
+constexpr size_t kDrainSize = 64 * 1024;
+
+uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+void putString(std::string& out, const std::string& text) {
+    putVarint(out, text.size());
+    out += text;
+}
+
+void putValue(std::string& out, const Value& value) {
+    if (std::holds_alternative<int>(value)) {
+        out += static_cast<char>(kInt);
+        putVarint(out, zigzag(std::get<int>(value)));
+    } else if (std::holds_alternative<double>(value)) {
+        double number = std::get<double>(value);
+        // -0.0 keeps its sign bit by taking the raw path
+        if (std::fabs(number) <= kMaxWholeDouble && std::trunc(number) == number &&
+            !(number == 0 && std::signbit(number))) {
+            out += static_cast<char>(kWholeDouble);
+            putVarint(out, zigzag(static_cast<int64_t>(number)));
+            return;
+        }
+        out += static_cast<char>(kDouble);
+        char bytes[sizeof(double)];
+        std::memcpy(bytes, &number, sizeof(bytes));
+        out.append(bytes, sizeof(bytes));
+    } else if (std::holds_alternative<std::string>(value)) {
+        out += static_cast<char>(kString);
+        putString(out, std::get<std::string>(value));
+    } else {
+        out += static_cast<char>(std::get<bool>(value) ? kTrue : kFalse);
+    }
+}
+
+void putDims(std::string& out, const std::vector<int>& dims) {
+    putVarint(out, dims.size());
+    for (int dim : dims) {
+        putVarint(out, static_cast<uint64_t>(dim));
+    }
+}
+
+// Bounds-checked reader over the trace bytes
+class Input {
+public:
+    Input(const std::string& data, size_t pos) : data_(data), pos_(pos) {}
+
+    size_t pos() const { return pos_; }
+    bool atEnd() const { return pos_ >= data_.size(); }
+
+    uint8_t byte() {
+        need(1);
+        return static_cast<uint8_t>(data_[pos_++]);
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t b = byte();
+            value |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80)) return value;
+        }
+        throw std::runtime_error("Corrupt trace: varint too long");
+    }
+
+    std::string string() {
+        size_t size = count();
+        need(size);
+        std::string text = data_.substr(pos_, size);
+        pos_ += size;
+        return text;
+    }
+
+    void skipString() {
+        size_t size = count();
+        need(size);
+        pos_ += size;
+    }
+
+    Value value() {
+        switch (byte()) {
+            case kInt: return Value{static_cast<int>(unzigzag(varint()))};
+            case kDouble: {
+                need(sizeof(double));
+                double number;
+                std::memcpy(&number, data_.data() + pos_, sizeof(number));
+                pos_ += sizeof(number);
+                return Value{number};
+            }
+            case kString: return Value{string()};
+            case kFalse: return Value{false};
+            case kTrue: return Value{true};
+            case kWholeDouble: return Value{static_cast<double>(unzigzag(varint()))};
+        }
+        throw std::runtime_error("Corrupt trace: bad value tag");
+    }
+
+    void skipValue() {
+        switch (byte()) {
+            case kInt:
+            case kWholeDouble: varint(); return;
+            case kDouble: need(sizeof(double)); pos_ += sizeof(double); return;
+            case kString: skipString(); return;
+            case kFalse:
+            case kTrue: return;
+        }
+        throw std::runtime_error("Corrupt trace: bad value tag");
+    }
+
+    std::vector<int> dims() {
+        std::vector<int> result(count());
+        for (int& dim : result) {
+            dim = static_cast<int>(varint());
+        }
+        return result;
+    }
+
+    // A length or element count; never more than the bytes left
+    size_t count() {
+        uint64_t value = varint();
+        if (value > data_.size()) {
+            throw std::runtime_error("Corrupt trace: bad length");
+        }
+        return static_cast<size_t>(value);
+    }
+
+private:
+    const std::string& data_;
+    size_t pos_;
+
+    void need(size_t size) const {
+        if (size > data_.size() - pos_) {
+            throw std::runtime_error("Corrupt trace: truncated event");
+        }
+    }
+};
+
+size_t elementCount(const std::vector<int>& dims) {
+    size_t total = 1;
+    for (int dim : dims) total *= static_cast<size_t>(dim);
+    return total;
+}
+
+Array makeArray(const std::string& name, const std::vector<int>& dims) {
+    Array array;
+    array.dims = dims;
+    bool isString = !name.empty() && name.back() == '$';
+    array.data.assign(elementCount(dims), isString ? Value{std::string()} : Value{0});
+    return array;
+}
+
+} // namespace
+
+// --- TraceRecorder ---
+
+TraceRecorder::TraceRecorder(const std::string& path, const std::string& sourcePath, const std::string& source,
+                             size_t keyframeInterval)
+    : sink_(createFileOutputSink(path, true)), keyframeInterval_(keyframeInterval),
+      steps_(0), written_(0), lastLine_(0), lastKeyframeStep_(0), lastKeyframeEnd_(0),
+      lastKeyframeBytes_(0), finished_(false) {
+    buffer_.append(kMagic, sizeof(kMagic));
+    putString(buffer_, sourcePath);
+    putString(buffer_, source);
+}
+
+TraceRecorder::~TraceRecorder() {
+    // Without an end event the reader reports the run as cut off
+    if (!finished_) {
+        drain(true);
+        sink_->flush();
+    }
+}
+
+uint64_t TraceRecorder::nameId(const std::string& name) {
+    auto it = names_.find(name);
+    if (it != names_.end()) {
+        return it->second;
+    }
+    uint64_t id = names_.size();
+    names_.emplace(name, id);
+    buffer_ += static_cast<char>(kName);
+    putVarint(buffer_, id);
+    putString(buffer_, name);
+    return id;
+}
+
+void TraceRecorder::statement(int line, const Variables& variables) {
+    uint64_t delta = zigzag(static_cast<int64_t>(line) - lastLine_);
+    if (delta < kLongDelta) {
+        buffer_ += static_cast<char>((delta << 3) | kStatement);
+    } else {
+        buffer_ += static_cast<char>((kLongDelta << 3) | kStatement);
+        putVarint(buffer_, delta);
+    }
+    lastLine_ = line;
+    if (steps_ == 0 ||
+        (steps_ - lastKeyframeStep_ >= keyframeInterval_ && bytes() - lastKeyframeEnd_ >= lastKeyframeBytes_)) {
+        keyframe(variables);
+    }
+    ++steps_;
+    drain(false);
+}
+
+void TraceRecorder::keyframe(const Variables& variables) {
+    std::map<std::string, Value> scalars = variables.getAll();
+    const auto& arrays = variables.getAllArrays();
+    for (const auto& entry : scalars) nameId(entry.first);
+    for (const auto& entry : arrays) nameId(entry.first);
+
+    size_t start = bytes();
+    buffer_ += static_cast<char>(kKeyframe);
+    putVarint(buffer_, steps_);
+    putVarint(buffer_, static_cast<uint64_t>(lastLine_));
+    putVarint(buffer_, scalars.size());
+    for (const auto& [name, value] : scalars) {
+        putVarint(buffer_, names_[name]);
+        putValue(buffer_, value);
+    }
+    putVarint(buffer_, arrays.size());
+    for (const auto& [name, array] : arrays) {
+        putVarint(buffer_, names_[name]);
+        putDims(buffer_, array.dims);
+        for (const Value& value : array.data) {
+            putValue(buffer_, value);
+        }
+    }
+    lastKeyframeStep_ = steps_;
+    lastKeyframeEnd_ = bytes();
+    lastKeyframeBytes_ = lastKeyframeEnd_ - start;
+}
+
+void TraceRecorder::set(const std::string& name, const Value& value) {
+    uint64_t id = nameId(name);
+    buffer_ += static_cast<char>(kSet);
+    putVarint(buffer_, id);
+    putValue(buffer_, value);
+}
+
+void TraceRecorder::setElement(const std::string& name, size_t offset, const Value& value) {
+    uint64_t id = nameId(name);
+    buffer_ += static_cast<char>(kElement);
+    putVarint(buffer_, id);
+    putVarint(buffer_, offset);
+    putValue(buffer_, value);
+}
+
+void TraceRecorder::dim(const std::string& name, const std::vector<int>& dims) {
+    uint64_t id = nameId(name);
+    buffer_ += static_cast<char>(kDim);
+    putVarint(buffer_, id);
+    putDims(buffer_, dims);
+}
+
+void TraceRecorder::array(const std::string& name, const Array& array) {
+    uint64_t id = nameId(name);
+    buffer_ += static_cast<char>(kArray);
+    putVarint(buffer_, id);
+    putDims(buffer_, array.dims);
+    for (const Value& value : array.data) {
+        putValue(buffer_, value);
+    }
+    drain(false);
+}
+
+void TraceRecorder::clear() {
+    buffer_ += static_cast<char>((kClear << 3) | kControl);
+}
+
+void TraceRecorder::finish(bool ok, const std::string& error) {
+    if (finished_) {
+        return;
+    }
+    buffer_ += static_cast<char>((kEnd << 3) | kControl);
+    putVarint(buffer_, ok ? 1 : 0);
+    putString(buffer_, error);
+    drain(true);
+    sink_->flush();
+    finished_ = true;
+}
+
+void TraceRecorder::drain(bool force) {
+    if (buffer_.size() >= kDrainSize || (force && !buffer_.empty())) {
+        sink_->write(buffer_);
+        written_ += buffer_.size();
+        buffer_.clear();
+    }
+}
+
+// --- TraceReader ---
+
+TraceReader::TraceReader(const std::string& path)
+    : steps_(0), ok_(false), finished_(false), cursor_{0, 0, 0}, cursorValid_(false) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Cannot open trace: " + path);
+    }
+    data_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    if (data_.size() < sizeof(kMagic) || data_.compare(0, sizeof(kMagic), kMagic, sizeof(kMagic)) != 0) {
+        throw std::runtime_error("Not a BASIC trace: " + path);
+    }
+    Input header(data_, sizeof(kMagic));
+    sourcePath_ = header.string();
+    source_ = header.string();
+
+    // One pass to index names and keyframes; the step count wraps to 0 on
+    // the first statement
+    Cursor cursor{header.pos(), std::numeric_limits<size_t>::max(), 0};
+    try {
+        while (decode(cursor, nullptr)) {
+        }
+    } catch (const std::runtime_error&) {
+        // A run that was killed leaves a partial last event; keep what came before it
+        data_.resize(cursor.pos);
+    }
+    steps_ = cursor.step + 1;
+    if (keyframes_.empty() && steps_ > 0) {
+        throw std::runtime_error("Corrupt trace: no keyframe");
+    }
+    if (!finished_) {
+        error_ = "Trace ends before the program finished";
+    }
+}
+
+bool TraceReader::decode(Cursor& cursor, State* state) {
+    Input in(data_, cursor.pos);
+    if (in.atEnd()) {
+        return false;
+    }
+    uint8_t tag = in.byte();
+    switch (tag & 7) {
+        case kStatement: {
+            uint64_t delta = tag >> 3;
+            if (delta == kLongDelta) {
+                delta = in.varint();
+            }
+            cursor.line = static_cast<int>(cursor.line + unzigzag(delta));
+            ++cursor.step;
+            break;
+        }
+        case kSet: {
+            size_t id = in.count();
+            if (state) {
+                state->variables[names_.at(id)] = in.value();
+            } else {
+                in.skipValue();
+            }
+            break;
+        }
+        case kElement: {
+            size_t id = in.count();
+            size_t offset = in.count();
+            if (state) {
+                Array& array = state->arrays[names_.at(id)];
+                Value value = in.value();
+                if (offset < array.data.size()) {
+                    array.data[offset] = std::move(value);
+                }
+            } else {
+                in.skipValue();
+            }
+            break;
+        }
+        case kArray: {
+            size_t id = in.count();
+            std::vector<int> dims = in.dims();
+            size_t total = elementCount(dims);
+            if (state) {
+                Array array;
+                array.dims = std::move(dims);
+                array.data.reserve(total);
+                for (size_t i = 0; i < total; ++i) array.data.push_back(in.value());
+                state->arrays[names_.at(id)] = std::move(array);
+            } else {
+                for (size_t i = 0; i < total; ++i) in.skipValue();
+            }
+            break;
+        }
+        case kDim: {
+            size_t id = in.count();
+            std::vector<int> dims = in.dims();
+            if (state) {
+                const std::string& name = names_.at(id);
+                state->arrays[name] = makeArray(name, dims);
+            }
+            break;
+        }
+        case kName: {
+            size_t id = in.count();
+            std::string name = in.string();
+            if (id == names_.size()) {
+                names_.push_back(std::move(name));
+            }
+            break;
+        }
+        case kKeyframe: {
+            // Replaying forward already has this state; only index it
+            size_t offset = cursor.pos;
+            size_t step = in.count();
+            in.varint();
+            for (size_t n = in.count(); n > 0; --n) {
+                in.count();
+                in.skipValue();
+            }
+            for (size_t n = in.count(); n > 0; --n) {
+                in.count();
+                size_t total = elementCount(in.dims());
+                for (size_t i = 0; i < total; ++i) in.skipValue();
+            }
+            if (keyframes_.empty() || keyframes_.back().step < step) {
+                keyframes_.push_back({step, offset});
+            }
+            break;
+        }
+        case kControl:
+            if ((tag >> 3) == kClear) {
+                if (state) {
+                    state->variables.clear();
+                    state->arrays.clear();
+                }
+            } else {
+                ok_ = in.varint() != 0;
+                error_ = in.string();
+                finished_ = true;
+                cursor.pos = in.pos();
+                return false;
+            }
+            break;
+    }
+    cursor.pos = in.pos();
+    return true;
+}
+
+size_t TraceReader::keyframeBefore(size_t step) const {
+    size_t low = 0;
+    size_t high = keyframes_.size();
+    while (high - low > 1) {
+        size_t mid = (low + high) / 2;
+        if (keyframes_[mid].step <= step) low = mid;
+        else high = mid;
+    }
+    return low;
+}
+
+TraceReader::Cursor TraceReader::loadKeyframe(size_t index, State* state) {
+    Input in(data_, keyframes_[index].offset + 1);
+    Cursor cursor{0, in.count(), 0};
+    cursor.line = static_cast<int>(in.varint());
+    if (state) {
+        state->variables.clear();
+        state->arrays.clear();
+    }
+    for (size_t n = in.count(); n > 0; --n) {
+        size_t id = in.count();
+        if (state) {
+            state->variables[names_.at(id)] = in.value();
+        } else {
+            in.skipValue();
+        }
+    }
+    for (size_t n = in.count(); n > 0; --n) {
+        size_t id = in.count();
+        std::vector<int> dims = in.dims();
+        size_t total = elementCount(dims);
+        if (state) {
+            Array& array = state->arrays[names_.at(id)];
+            array.dims = std::move(dims);
+            array.data.clear();
+            array.data.reserve(total);
+            for (size_t i = 0; i < total; ++i) array.data.push_back(in.value());
+        } else {
+            for (size_t i = 0; i < total; ++i) in.skipValue();
+        }
+    }
+    cursor.pos = in.pos();
+    return cursor;
+}
+
+const TraceReader::State& TraceReader::seek(size_t step) {
+    if (steps_ == 0) {
+        return state_;
+    }
+    step = std::min(step, steps_);
+    size_t keyframe = keyframeBefore(step);
+    if (!cursorValid_ || cursor_.step > step || keyframes_[keyframe].step > cursor_.step) {
+        cursor_ = loadKeyframe(keyframe, &state_);
+        cursorValid_ = true;
+    }
+    while (cursor_.step < step) {
+        if (!decode(cursor_, &state_)) {
+            // Past the last statement: the state the program finished with
+            cursor_.step = steps_;
+            break;
+        }
+    }
+    state_.step = cursor_.step;
+    state_.line = cursor_.line;
+    return state_;
+}
+
+std::optional<size_t> TraceReader::find(size_t from, bool forward, const std::function<bool(int line)>& match) {
+    if (steps_ == 0) {
+        return std::nullopt;
+    }
+    if (forward) {
+        seek(from);
+        Cursor cursor = cursor_;
+        while (cursor.step < steps_) {
+            size_t step = cursor.step;
+            if (!decode(cursor, nullptr)) break;
+            if (cursor.step != step && match(cursor.line)) {
+                return cursor.step;
+            }
+        }
+        return std::nullopt;
+    }
+
+    // Backwards one keyframe segment at a time, collecting only line numbers
+    from = std::min(from, steps_);
+    while (from > 0) {
+        size_t keyframe = keyframeBefore(from - 1);
+        Cursor cursor = loadKeyframe(keyframe, nullptr);
+        size_t first = cursor.step;
+        std::vector<int> lines{cursor.line};
+        while (cursor.step + 1 < from && decode(cursor, nullptr)) {
+            if (cursor.step == first + lines.size()) {
+                lines.push_back(cursor.line);
+            }
+        }
+        for (size_t i = lines.size(); i > 0; --i) {
+            if (match(lines[i - 1])) {
+                return first + i - 1;
+            }
+        }
+        from = first;
+    }
+    return std::nullopt;
+}
+
+} // namespace basic
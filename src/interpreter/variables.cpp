@@ -1,33 +1,218 @@
 #include "interpreter/variables.h"
+#include "interpreter/memory_account.h"
+#include "interpreter/trace.h"
 #include <stdexcept>
 
 namespace basic {
 
-Variables::Variables() {}
+Variables::Variables(MemoryAccount* memory) : memory_(memory), trace_(nullptr), stringBytes_(0) {}
+
+Variables::~Variables() {
+    clear();
+}
+
+void Variables::charge(size_t bytes) {
+    if (memory_ && bytes) memory_->charge(bytes);
+}
+
+void Variables::release(size_t bytes) {
+    if (memory_ && bytes) memory_->release(bytes);
+}
 
 void Variables::set(const std::string& name, const Value& value) {
-    variables_[name] = value;
+    size_t bytes = MemoryAccount::heapBytes(value);
+    charge(bytes);
+    Scalar& slot = variables_[name];
+    size_t old = MemoryAccount::heapBytes(slot.value);
+    release(old);
+    stringBytes_ += bytes - old;
+    slot.value = value;
+    slot.changed = generation_;
+    if (trace_) trace_->set(name, value);
 }
 
 Value Variables::get(const std::string& name) const {
     auto it = variables_.find(name);
     if (it != variables_.end()) {
-        return it->second;
+        return it->second.value;
     }
     // Return default value (0) for undefined variables
     return Value{0};
 }
 
 std::map<std::string, Value> Variables::getAll() const {
-    return variables_;
+    std::map<std::string, Value> all;
+    for (const auto& [name, slot] : variables_) {
+        all.emplace_hint(all.end(), name, slot.value);
+    }
+    return all;
+}
+
+std::map<std::string, Value> Variables::changedSince(uint64_t generation) const {
+    std::map<std::string, Value> changed;
+    for (const auto& [name, slot] : variables_) {
+        if (slot.changed > generation) {
+            changed.emplace_hint(changed.end(), name, slot.value);
+        }
+    }
+    return changed;
+}
+
+bool Variables::changedSince(const std::string& name, uint64_t generation) const {
+    auto it = variables_.find(name);
+    return it != variables_.end() && it->second.changed > generation;
 }
 
 void Variables::clear() {
+    release(stringBytes_);
+    stringBytes_ = 0;
+    for (const auto& [name, array] : arrays_) {
+        release(array.stringBytes);
+    }
     variables_.clear();
+    arrays_.clear();
+    dicts_.clear();
+    clearedAt_ = generation_;
+    if (trace_) trace_->clear();
 }
 
 bool Variables::exists(const std::string& name) const {
     return variables_.find(name) != variables_.end();
 }
 
+size_t Array::offset(const std::vector<int>& indices) const {
+    if (indices.size() != dims.size()) {
+        throw std::runtime_error("Wrong number of array subscripts");
+    }
+    size_t result = 0;
+    for (size_t i = 0; i < dims.size(); ++i) {
+        if (indices[i] < 0 || indices[i] >= dims[i]) {
+            throw std::runtime_error("Array subscript out of range");
+        }
+        result = result * dims[i] + indices[i];
+    }
+    return result;
+}
+
+void Variables::dim(const std::string& name, const std::vector<int>& bounds) {
+    Array array(memory_ ? static_cast<std::pmr::memory_resource*>(memory_) : std::pmr::get_default_resource());
+    size_t total = 1;
+    for (int bound : bounds) {
+        if (bound < 0) {
+            throw std::runtime_error("Negative array bound for " + name);
+        }
+        array.dims.push_back(bound + 1);
+        total *= static_cast<size_t>(bound + 1);
+    }
+    bool isString = !name.empty() && name.back() == '$';
+    array.data.assign(total, isString ? Value{std::string()} : Value{0});
+    // Replacing an array frees its strings
+    auto it = arrays_.find(name);
+    if (it != arrays_.end()) {
+        release(it->second.stringBytes);
+        arrays_.erase(it);
+    }
+    auto& stored = arrays_.emplace(name, std::move(array)).first->second;
+    if (trace_) trace_->dim(name, stored.dims);
+}
+
+bool Variables::hasArray(const std::string& name) const {
+    return arrays_.find(name) != arrays_.end();
+}
+
+Array* Variables::getArray(const std::string& name) {
+    auto it = arrays_.find(name);
+    return it != arrays_.end() ? &it->second : nullptr;
+}
+
+Array& Variables::getOrCreateArray(const std::string& name) {
+    auto it = arrays_.find(name);
+    if (it == arrays_.end()) {
+        it = arrays_.emplace(name, Array(memory_ ? static_cast<std::pmr::memory_resource*>(memory_)
+                                                 : std::pmr::get_default_resource())).first;
+    }
+    return it->second;
+}
+
+Value Variables::getElement(const std::string& name, const std::vector<int>& indices) const {
+    auto it = arrays_.find(name);
+    if (it == arrays_.end()) {
+        throw std::runtime_error("Array '" + name + "' not dimensioned");
+    }
+    return it->second.data[it->second.offset(indices)];
+}
+
+void Variables::setElement(const std::string& name, const std::vector<int>& indices, const Value& value) {
+    auto it = arrays_.find(name);
+    if (it == arrays_.end()) {
+        throw std::runtime_error("Array '" + name + "' not dimensioned");
+    }
+    Array& array = it->second;
+    size_t offset = array.offset(indices);
+    Value& slot = array.data[offset];
+    size_t bytes = MemoryAccount::heapBytes(value);
+    charge(bytes);
+    size_t old = MemoryAccount::heapBytes(slot);
+    release(old);
+    array.stringBytes += bytes - old;
+    slot = value;
+    if (trace_) trace_->setElement(name, offset, value);
+}
+
+void Variables::recount(Array& array) {
+    size_t bytes = 0;
+    for (const Value& value : array.data) {
+        bytes += MemoryAccount::heapBytes(value);
+    }
+    if (bytes > array.stringBytes) {
+        try {
+            charge(bytes - array.stringBytes);
+        } catch (...) {
+            // The strings are already stored; over the limit they are dropped
+            // so that the account still matches what the array holds
+            for (Value& value : array.data) {
+                if (MemoryAccount::heapBytes(value)) value = std::string();
+            }
+            release(array.stringBytes);
+            array.stringBytes = 0;
+            arrayChanged(array);
+            throw;
+        }
+    } else {
+        release(array.stringBytes - bytes);
+    }
+    array.stringBytes = bytes;
+    arrayChanged(array);
+}
+
+void Variables::arrayChanged(const Array& array) {
+    if (!trace_) {
+        return;
+    }
+    for (const auto& [name, stored] : arrays_) {
+        if (&stored == &array) {
+            trace_->array(name, array);
+            return;
+        }
+    }
+}
+
+const std::map<std::string, Array>& Variables::getAllArrays() const {
+    return arrays_;
+}
+
+void Variables::declareDict(const std::string& name) {
+    dicts_.erase(name);
+    dicts_.emplace(name, Dictionary(memory_));
+}
+
+Dictionary* Variables::getDict(const std::string& name) {
+    auto it = dicts_.find(name);
+    return it != dicts_.end() ? &it->second : nullptr;
+}
+
+const std::map<std::string, Dictionary>& Variables::getAllDicts() const {
+    return dicts_;
+}
+
 } // namespace basic 
\ No newline at end of file
@@ -0,0 +1,285 @@
+#include "lsp/lsp_daemon.h"
+#include "lsp/lsp_server.h"
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace lsp {
+
+#ifndef _WIN32
+
+static sockaddr_un socketAddress(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path too long: " + path);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+// -1 when nothing is listening
+static int connectSocket(const std::string& path) {
+    sockaddr_un address = socketAddress(path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = send(fd, data, size, MSG_NOSIGNAL);
+        if (written < 0 && errno == ENOTSOCK) {
+            written = write(fd, data, size);
+        }
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// Removes one complete message from buffer into body. Throws on a header
+// that cannot be framed, after which the stream cannot be resynchronised.
+static bool nextFrame(std::string& buffer, std::string& body) {
+    size_t headerEnd = buffer.find("\r\n\r\n");
+    if (headerEnd == std::string::npos) {
+        return false;
+    }
+    size_t length = 0;
+    size_t pos = buffer.find("Content-Length: ");
+    if (pos != std::string::npos && pos < headerEnd) {
+        const char* digits = buffer.c_str() + pos + 16;
+        char* end = nullptr;
+        errno = 0;
+        unsigned long long value = std::strtoull(digits, &end, 10);
+        if (end == digits || errno == ERANGE || value > (1ull << 31) || (*end != '\r' && *end != ' ')) {
+            throw std::runtime_error("Bad Content-Length header");
+        }
+        length = static_cast<size_t>(value);
+    }
+    if (buffer.size() < headerEnd + 4 + length) {
+        return false;
+    }
+    body = buffer.substr(headerEnd + 4, length);
+    buffer.erase(0, headerEnd + 4 + length);
+    return true;
+}
+
+LSPDaemon::LSPDaemon(const std::string& socketPath, std::chrono::seconds idleTimeout, size_t memoryBudget)
+    : socketPath_(socketPath), idleTimeout_(idleTimeout), memoryBudget_(memoryBudget), listenFd_(-1) {}
+
+LSPDaemon::~LSPDaemon() {
+    if (listenFd_ >= 0) {
+        close(listenFd_);
+        unlink(socketPath_.c_str());
+    }
+}
+
+void LSPDaemon::run(const bool& running) {
+    sockaddr_un address = socketAddress(socketPath_);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+    }
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        int error = errno;
+        // A socket file nobody answers on was left by a daemon that died
+        int probe = error == EADDRINUSE ? connectSocket(socketPath_) : -1;
+        if (probe >= 0) {
+            close(probe);
+            close(fd);
+            throw std::runtime_error("A language server daemon is already listening on " + socketPath_);
+        }
+        if (error == EADDRINUSE) {
+            unlink(socketPath_.c_str());
+        }
+        if (error != EADDRINUSE || bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            close(fd);
+            throw std::runtime_error("Cannot bind " + socketPath_ + ": " + std::strerror(error == EADDRINUSE ? errno : error));
+        }
+    }
+    if (listen(fd, 16) < 0) {
+        close(fd);
+        throw std::runtime_error("Cannot listen on " + socketPath_ + ": " + std::strerror(errno));
+    }
+    listenFd_ = fd;
+
+    struct Client {
+        int fd;
+        std::string buffer;
+        std::unique_ptr<LSPServer> server;
+        bool closed = false;
+    };
+    auto workspace = std::make_shared<Workspace>(memoryBudget_);
+    std::vector<std::unique_ptr<Client>> clients;
+    auto idleSince = std::chrono::steady_clock::now();
+
+    while (running) {
+        std::vector<pollfd> fds;
+        fds.push_back({listenFd_, POLLIN, 0});
+        for (const auto& client : clients) {
+            fds.push_back({client->fd, POLLIN, 0});
+        }
+        if (poll(fds.data(), fds.size(), 200) < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error(std::string("poll: ") + std::strerror(errno));
+        }
+
+        for (size_t i = 0; i < clients.size(); ++i) {
+            Client& client = *clients[i];
+            if (!(fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            char chunk[65536];
+            ssize_t received = recv(client.fd, chunk, sizeof(chunk), 0);
+            if (received <= 0) {
+                client.closed = received == 0 || errno != EINTR;
+                continue;
+            }
+            client.buffer.append(chunk, static_cast<size_t>(received));
+            std::string body;
+            try {
+                while (!client.closed && nextFrame(client.buffer, body)) {
+                    LSPMessage message = LSPServer::parseMessage(body);
+                    client.server->processMessage(message);
+                    // "exit" ends this client's session, not the daemon
+                    client.closed = message.method == "exit";
+                }
+            } catch (const std::exception& e) {
+                // Only this client is dropped; the others keep the daemon
+                std::fprintf(stderr, "Closing LSP client: %s\n", e.what());
+                client.closed = true;
+            }
+        }
+        for (auto it = clients.begin(); it != clients.end();) {
+            if ((*it)->closed) {
+                (*it)->server.reset();
+                close((*it)->fd);
+                it = clients.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int clientFd = accept(listenFd_, nullptr, nullptr);
+            if (clientFd >= 0) {
+                auto client = std::make_unique<Client>();
+                client->fd = clientFd;
+                client->server = std::make_unique<LSPServer>(workspace);
+                client->server->setWriter([clientFd](const std::string& data) {
+                    writeAll(clientFd, data.data(), data.size());
+                });
+                clients.push_back(std::move(client));
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (!clients.empty()) {
+            idleSince = now;
+        } else if (now - idleSince >= idleTimeout_) {
+            break;
+        }
+    }
+    for (const auto& client : clients) {
+        close(client->fd);
+    }
+}
+
+int LSPDaemon::connectStdio(const std::string& socketPath, const std::string& self,
+                            std::chrono::seconds idleTimeout, size_t memoryBudget, const bool& running) {
+    int fd = connectSocket(socketPath);
+    if (fd < 0) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            // Detached, so it outlives the editor that started it
+            setsid();
+            int devNull = open("/dev/null", O_RDWR);
+            dup2(devNull, 0);
+            dup2(devNull, 1);
+            dup2(devNull, 2);
+            std::string timeout = std::to_string(idleTimeout.count());
+            std::string memory = std::to_string(memoryBudget / (1024 * 1024));
+            execlp(self.c_str(), self.c_str(), "--lsp-daemon", socketPath.c_str(), "--idle-timeout", timeout.c_str(),
+                   "--lsp-memory", memory.c_str(), static_cast<char*>(nullptr));
+            _exit(127);
+        }
+        for (int attempt = 0; attempt < 50 && fd < 0 && pid > 0; ++attempt) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            fd = connectSocket(socketPath);
+        }
+        if (fd < 0) {
+            std::fprintf(stderr, "Cannot reach the language server daemon on %s\n", socketPath.c_str());
+            return 1;
+        }
+    }
+
+    pollfd fds[2] = {{0, POLLIN, 0}, {fd, POLLIN, 0}};
+    char chunk[65536];
+    while (running) {
+        if (poll(fds, 2, 200) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t n = read(0, chunk, sizeof(chunk));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                // The editor is done sending, but replies to what it sent may
+                // still be on their way: half-close and read until the daemon
+                // closes this session
+                shutdown(fd, SHUT_WR);
+                fds[0].fd = -1;
+            } else if (!writeAll(fd, chunk, static_cast<size_t>(n))) {
+                break;
+            }
+        }
+        if (fds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0 || !writeAll(1, chunk, static_cast<size_t>(n))) break;
+        }
+    }
+    close(fd);
+    return 0;
+}
+
+#else
+
+LSPDaemon::LSPDaemon(const std::string& socketPath, std::chrono::seconds idleTimeout, size_t memoryBudget)
+    : socketPath_(socketPath), idleTimeout_(idleTimeout), memoryBudget_(memoryBudget), listenFd_(-1) {}
+
+LSPDaemon::~LSPDaemon() = default;
+
+void LSPDaemon::run(const bool&) {
+    throw std::runtime_error("The language server daemon is not supported on Windows");
+}
+
+int LSPDaemon::connectStdio(const std::string&, const std::string&, std::chrono::seconds, size_t, const bool&) {
+    std::fprintf(stderr, "The language server daemon is not supported on Windows\n");
+    return 1;
+}
+
+#endif
+
+} // namespace lsp
@@ -1,16 +1,23 @@
 #include "lsp/lsp_server.h"
+#include "interpreter/alloc_profile.h"
+#include "interpreter/program.h"
+#include "interpreter/timeline.h"
+#include "protocol/json_string.h"
 #include <iostream>
 #include <sstream>
+#include <fstream>
 #include <algorithm>
+#include <cctype>
 
 namespace lsp {
 
-LSPServer::LSPServer() : running_(false) {
-    setupHandlers();
-}
+LSPServer::LSPServer() : LSPServer(std::make_shared<Workspace>()) {}
+
+LSPServer::LSPServer(std::shared_ptr<Workspace> workspace) : running_(false), workspace_(std::move(workspace)) {}
 
 LSPServer::~LSPServer() {
     stop();
+    releaseDocuments();
 }
 
 void LSPServer::start() {
@@ -27,6 +34,7 @@ bool LSPServer::isRunning() const {
 }
 
 void LSPServer::sendMessage(const LSPMessage& message) {
+    BASIC_TIMELINE_SCOPE("lsp send", message.method);
     json response;
     
     if (message.type == MessageType::RESPONSE) {
@@ -46,9 +54,31 @@ void LSPServer::sendMessage(const LSPMessage& message) {
         }
     }
     
-    std::string content = response.dump();
-    std::cout << "Content-Length: " << content.length() << "\r\n\r\n";
-    std::cout << content << std::flush;
+    sendFramed(response.dump());
+}
+
+template <typename T>
+void LSPServer::sendResult(const json& id, const T& result) {
+    protocol::JsonWriter writer;
+    writer.beginObject();
+    writer.field("id", id);
+    writer.field("jsonrpc", "2.0");
+    writer.field("result", result);
+    writer.endObject();
+    sendFramed(writer.str());
+}
+
+void LSPServer::sendFramed(const std::string& content) {
+    std::string framed = "Content-Length: " + std::to_string(content.length()) + "\r\n\r\n" + content;
+    if (writer_) {
+        writer_(framed);
+    } else {
+        std::cout << framed << std::flush;
+    }
+}
+
+void LSPServer::setWriter(std::function<void(const std::string&)> writer) {
+    writer_ = std::move(writer);
 }
 
 LSPMessage LSPServer::receiveMessage() {
@@ -77,8 +107,12 @@ LSPMessage LSPServer::receiveMessage() {
     content.resize(contentLength);
     std::cin.read(&content[0], contentLength);
     
+    return parseMessage(content);
+}
+
+LSPMessage LSPServer::parseMessage(const std::string& content) {
     try {
-        json j = json::parse(content);
+        json j = protocol::parse(content);
         LSPMessage message;
         
         if (j.contains("id")) {
@@ -103,44 +137,67 @@ LSPMessage LSPServer::receiveMessage() {
 }
 
 void LSPServer::processMessage(const LSPMessage& message) {
-    if (message.type == MessageType::REQUEST) {
-        auto handler = requestHandlers_.find(message.method);
-        if (handler != requestHandlers_.end()) {
-            json result = handler->second(message.params);
-            sendMessage(createResponse(message.id, result));
+    BASIC_TIMELINE_SCOPE("lsp process", message.method);
+    // A handler that rejects its params fails that message, not the session
+    try {
+        dispatch(message);
+    } catch (const std::exception& e) {
+        if (message.type == MessageType::REQUEST) {
+            sendMessage(createErrorResponse(message.id, -32603, e.what()));
         } else {
+            sendNotification("window/logMessage", {{"type", 1}, {"message", message.method + ": " + e.what()}});
+        }
+    }
+}
+
+void LSPServer::dispatch(const LSPMessage& message) {
+    const json& params = message.params;
+    if (message.type == MessageType::REQUEST) {
+        switch (toRequestType(message.method)) {
+        case RequestType::INITIALIZE: sendResult(message.id, handleInitialize(params)); break;
+        case RequestType::SHUTDOWN: sendResult(message.id, handleShutdown(params)); break;
+        case RequestType::TEXTDOCUMENT_COMPLETION:
+            sendResult(message.id, handleCompletion(TextDocumentPositionParams::fromJson(params)));
+            break;
+        case RequestType::TEXTDOCUMENT_HOVER:
+            sendResult(message.id, handleHover(TextDocumentPositionParams::fromJson(params)));
+            break;
+        case RequestType::TEXTDOCUMENT_DEFINITION:
+            sendResult(message.id, handleDefinition(TextDocumentPositionParams::fromJson(params)));
+            break;
+        case RequestType::TEXTDOCUMENT_REFERENCES:
+            sendResult(message.id, handleReferences(TextDocumentPositionParams::fromJson(params)));
+            break;
+        case RequestType::TEXTDOCUMENT_SIGNATUREHELP: sendResult(message.id, handleSignatureHelp(params)); break;
+        case RequestType::TEXTDOCUMENT_DOCUMENTSYMBOL:
+            sendResult(message.id, handleDocumentSymbol(DocumentSymbolParams::fromJson(params)));
+            break;
+        case RequestType::TEXTDOCUMENT_FORMATTING: sendResult(message.id, handleFormatting(params)); break;
+        case RequestType::WORKSPACE_SYMBOL: sendResult(message.id, handleWorkspaceSymbol(params)); break;
+        case RequestType::TEXTDOCUMENT_INLAYHINT: sendResult(message.id, handleInlayHint(params)); break;
+        case RequestType::BASIC_COVERAGE: sendResult(message.id, handleCoverage(params)); break;
+        case RequestType::BASIC_MEMORYSTATS: sendResult(message.id, handleMemoryStats(params)); break;
+        case RequestType::UNKNOWN:
             sendMessage(createErrorResponse(message.id, -32601, "Method not found"));
+            break;
         }
     } else if (message.type == MessageType::NOTIFICATION) {
-        auto handler = notificationHandlers_.find(message.method);
-        if (handler != notificationHandlers_.end()) {
-            handler->second(message.params);
+        switch (toNotificationType(message.method)) {
+        case NotificationType::INITIALIZED: handleInitialized(params); break;
+        case NotificationType::TEXTDOCUMENT_DIDOPEN: handleDidOpen(DidOpenTextDocumentParams::fromJson(params)); break;
+        case NotificationType::TEXTDOCUMENT_DIDCHANGE:
+            handleDidChange(DidChangeTextDocumentParams::fromJson(params));
+            break;
+        case NotificationType::TEXTDOCUMENT_DIDCLOSE:
+            handleDidClose(DidCloseTextDocumentParams::fromJson(params));
+            break;
+        case NotificationType::TEXTDOCUMENT_DIDSAVE: handleDidSave(params); break;
+        case NotificationType::WORKSPACE_DIDCHANGECONFIGURATION: handleDidChangeConfiguration(params); break;
+        case NotificationType::UNKNOWN: break;
         }
     }
 }
 
-void LSPServer::setupHandlers() {
-    // Request handlers
-    requestHandlers_["initialize"] = [this](const json& params) { return handleInitialize(params); };
-    requestHandlers_["shutdown"] = [this](const json& params) { return handleShutdown(params); };
-    requestHandlers_["textDocument/completion"] = [this](const json& params) { return handleCompletion(params); };
-    requestHandlers_["textDocument/hover"] = [this](const json& params) { return handleHover(params); };
-    requestHandlers_["textDocument/definition"] = [this](const json& params) { return handleDefinition(params); };
-    requestHandlers_["textDocument/references"] = [this](const json& params) { return handleReferences(params); };
-    requestHandlers_["textDocument/signatureHelp"] = [this](const json& params) { return handleSignatureHelp(params); };
-    requestHandlers_["textDocument/documentSymbol"] = [this](const json& params) { return handleDocumentSymbol(params); };
-    requestHandlers_["textDocument/formatting"] = [this](const json& params) { return handleFormatting(params); };
-    requestHandlers_["workspace/symbol"] = [this](const json& params) { return handleWorkspaceSymbol(params); };
-    
-    // Notification handlers
-    notificationHandlers_["initialized"] = [this](const json& params) { handleInitialized(params); };
-    notificationHandlers_["textDocument/didOpen"] = [this](const json& params) { handleDidOpen(params); };
-    notificationHandlers_["textDocument/didChange"] = [this](const json& params) { handleDidChange(params); };
-    notificationHandlers_["textDocument/didClose"] = [this](const json& params) { handleDidClose(params); };
-    notificationHandlers_["textDocument/didSave"] = [this](const json& params) { handleDidSave(params); };
-    notificationHandlers_["workspace/didChangeConfiguration"] = [this](const json& params) { handleDidChangeConfiguration(params); };
-}
-
 json LSPServer::handleInitialize(const json& params) {
     json capabilities = {
         {"textDocumentSync", {
@@ -162,7 +219,8 @@ json LSPServer::handleInitialize(const json& params) {
         }},
         {"documentSymbolProvider", true},
         {"documentFormattingProvider", true},
-        {"workspaceSymbolProvider", true}
+        {"workspaceSymbolProvider", true},
+        {"inlayHintProvider", true}
     };
     
     return {
@@ -178,54 +236,22 @@ json LSPServer::handleShutdown(const json& params) {
     return json::object();
 }
 
-json LSPServer::handleCompletion(const json& params) {
-    std::string uri = params["textDocument"]["uri"];
-    Position position = Position::fromJson(params["position"]);
-    
-    auto completions = getCompletions(uri, position);
-    json items = json::array();
-    
-    for (const auto& completion : completions) {
-        items.push_back(completion.toJson());
-    }
-    
-    return {{"isIncomplete", false}, {"items", items}};
+CompletionList LSPServer::handleCompletion(const TextDocumentPositionParams& params) {
+    CompletionList list;
+    list.items = getCompletions(params.textDocument.uri, params.position);
+    return list;
 }
 
-json LSPServer::handleHover(const json& params) {
-    std::string uri = params["textDocument"]["uri"];
-    Position position = Position::fromJson(params["position"]);
-    
-    auto hover = getHover(uri, position);
-    return hover.toJson();
+Hover LSPServer::handleHover(const TextDocumentPositionParams& params) {
+    return getHover(params.textDocument.uri, params.position);
 }
 
-json LSPServer::handleDefinition(const json& params) {
-    std::string uri = params["textDocument"]["uri"];
-    Position position = Position::fromJson(params["position"]);
-    
-    auto definitions = getDefinitions(uri, position);
-    json locations = json::array();
-    
-    for (const auto& def : definitions) {
-        locations.push_back(def.toJson());
-    }
-    
-    return locations;
+std::vector<Location> LSPServer::handleDefinition(const TextDocumentPositionParams& params) {
+    return getDefinitions(params.textDocument.uri, params.position);
 }
 
-json LSPServer::handleReferences(const json& params) {
-    std::string uri = params["textDocument"]["uri"];
-    Position position = Position::fromJson(params["position"]);
-    
-    auto references = getReferences(uri, position);
-    json locations = json::array();
-    
-    for (const auto& ref : references) {
-        locations.push_back(ref.toJson());
-    }
-    
-    return locations;
+std::vector<Location> LSPServer::handleReferences(const TextDocumentPositionParams& params) {
+    return getReferences(params.textDocument.uri, params.position);
 }
 
 json LSPServer::handleSignatureHelp(const json& params) {
@@ -236,33 +262,25 @@ json LSPServer::handleSignatureHelp(const json& params) {
     };
 }
 
-json LSPServer::handleDocumentSymbol(const json& params) {
-    std::string uri = params["textDocument"]["uri"];
-    
-    auto symbols = getDocumentSymbols(uri);
-    json items = json::array();
-    
-    for (const auto& symbol : symbols) {
-        items.push_back(symbol.toJson());
-    }
-    
-    return items;
+std::vector<DocumentSymbol> LSPServer::handleDocumentSymbol(const DocumentSymbolParams& params) {
+    return getDocumentSymbols(params.textDocument.uri);
 }
 
-json LSPServer::handleFormatting(const json& params) {
+std::vector<TextEdit> LSPServer::handleFormatting(const json& params) {
     std::string uri = params["textDocument"]["uri"];
     int tabSize = params.value("options", json::object()).value("tabSize", 4);
     bool insertSpaces = params.value("options", json::object()).value("insertSpaces", true);
     
     std::string content = getDocument(uri);
     if (content.empty()) {
-        return json::array();
+        return {};
     }
     
     // Simple formatting: trim whitespace and ensure consistent indentation
     std::istringstream iss(content);
     std::string line;
-    std::vector<std::string> formattedLines;
+    std::string newText;
+    int lineCount = 0;
     
     while (std::getline(iss, line)) {
         // Trim leading/trailing whitespace
@@ -270,22 +288,15 @@ json LSPServer::handleFormatting(const json& params) {
         line.erase(line.find_last_not_of(" \t\r\n") + 1);
         
         if (!line.empty()) {
-            formattedLines.push_back(line);
+            newText += line;
+            newText += '\n';
+            ++lineCount;
         }
     }
     
-    json edits = json::array();
-    if (!formattedLines.empty()) {
-        json edit;
-        edit["range"]["start"]["line"] = 0;
-        edit["range"]["start"]["character"] = 0;
-        edit["range"]["end"]["line"] = formattedLines.size();
-        edit["range"]["end"]["character"] = 0;
-        edit["newText"] = "";
-        for (const auto& formattedLine : formattedLines) {
-            edit["newText"] = edit["newText"].get<std::string>() + formattedLine + "\n";
-        }
-        edits.push_back(edit);
+    std::vector<TextEdit> edits;
+    if (lineCount > 0) {
+        edits.emplace_back(Range(Position(0, 0), Position(lineCount, 0)), newText);
     }
     
     return edits;
@@ -297,14 +308,14 @@ json LSPServer::handleWorkspaceSymbol(const json& params) {
     json symbols = json::array();
     
     // Search through all documents for symbols
-    for (const auto& doc : documents_) {
-        auto docSymbols = getDocumentSymbols(doc.first);
+    for (const auto& uri : workspace_->uris()) {
+        auto docSymbols = getDocumentSymbols(uri);
         for (const auto& symbol : docSymbols) {
             if (symbol.name.find(query) != std::string::npos) {
                 json symbolInfo;
                 symbolInfo["name"] = symbol.name;
                 symbolInfo["kind"] = symbol.kind;
-                symbolInfo["location"] = Location(doc.first, symbol.range).toJson();
+                symbolInfo["location"] = Location(uri, symbol.range).toJson();
                 symbols.push_back(symbolInfo);
             }
         }
@@ -317,21 +328,19 @@ void LSPServer::handleInitialized(const json& params) {
     // Server is now ready to handle requests
 }
 
-void LSPServer::handleDidOpen(const json& params) {
-    std::string uri = params["textDocument"]["uri"];
-    std::string content = params["textDocument"]["text"];
-    addDocument(uri, content);
+void LSPServer::handleDidOpen(const DidOpenTextDocumentParams& params) {
+    addDocument(params.textDocument.uri, params.textDocument.text);
 }
 
-void LSPServer::handleDidChange(const json& params) {
-    std::string uri = params["textDocument"]["uri"];
-    std::string content = params["contentChanges"][0]["text"];
-    updateDocument(uri, content);
+void LSPServer::handleDidChange(const DidChangeTextDocumentParams& params) {
+    // Full sync: the last change holds the whole text
+    if (!params.contentChanges.empty()) {
+        updateDocument(params.textDocument.uri, params.contentChanges.back().text);
+    }
 }
 
-void LSPServer::handleDidClose(const json& params) {
-    std::string uri = params["textDocument"]["uri"];
-    removeDocument(uri);
+void LSPServer::handleDidClose(const DidCloseTextDocumentParams& params) {
+    removeDocument(params.textDocument.uri);
 }
 
 void LSPServer::handleDidSave(const json& params) {
@@ -343,20 +352,146 @@ void LSPServer::handleDidChangeConfiguration(const json& params) {
 }
 
 void LSPServer::addDocument(const std::string& uri, const std::string& content) {
-    documents_[uri] = content;
+    auto id = workspace_->id(uri);
+    if (id && opened_.count(*id)) {
+        workspace_->update(uri, content);
+    } else {
+        opened_.insert(workspace_->open(uri, content));
+    }
+    publishDiagnostics(uri);
 }
 
 void LSPServer::updateDocument(const std::string& uri, const std::string& content) {
-    documents_[uri] = content;
+    auto id = workspace_->id(uri);
+    if (!id || !opened_.count(*id)) {
+        addDocument(uri, content);
+        return;
+    }
+    workspace_->update(uri, content);
+    publishDiagnostics(uri);
 }
 
 void LSPServer::removeDocument(const std::string& uri) {
-    documents_.erase(uri);
+    auto id = workspace_->id(uri);
+    if (id && opened_.erase(*id)) {
+        workspace_->close(*id);
+    }
+    sendNotification("textDocument/publishDiagnostics", {{"uri", uri}, {"diagnostics", json::array()}});
+}
+
+void LSPServer::releaseDocuments() {
+    for (auto id : opened_) {
+        workspace_->close(id);
+    }
+    opened_.clear();
+}
+
+// Lines that failed to compile, from the document's cached Program
+void LSPServer::publishDiagnostics(const std::string& uri) {
+    json diagnostics = json::array();
+    if (auto program = workspace_->program(uri)) {
+        const auto& lines = program->lines();
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (lines[i].error.empty()) continue;
+            Range range(Position(static_cast<int>(i), 0), Position(static_cast<int>(i), static_cast<int>(lines[i].text.size())));
+            diagnostics.push_back({{"range", range.toJson()}, {"severity", 1}, {"source", "basic"}, {"message", lines[i].error}});
+        }
+    }
+    sendNotification("textDocument/publishDiagnostics", {{"uri", uri}, {"diagnostics", diagnostics}});
+}
+
+// Shows the per-line totals of the last `--run <file> --alloc-profile`,
+// read from <file>.allocprof.json, at the end of each line
+json LSPServer::handleInlayHint(const json& params) {
+    std::string uri = params["textDocument"]["uri"];
+    json hints = json::array();
+    
+    std::ifstream file(uriToPath(uri) + ".allocprof.json");
+    if (!file.is_open()) {
+        return hints;
+    }
+    json profile = json::parse(file, nullptr, false);
+    if (profile.is_discarded() || !profile.contains("lines")) {
+        return hints;
+    }
+    
+    std::vector<std::string> lines;
+    std::istringstream iss(getDocument(uri));
+    std::string line;
+    while (std::getline(iss, line)) {
+        lines.push_back(line);
+    }
+    
+    for (const auto& entry : profile["lines"]) {
+        int number = entry.value("line", 0);
+        if (number < 1 || number > static_cast<int>(lines.size())) continue;
+        std::string label = "alloc " + basic::formatBytes(entry.value("bytes", size_t(0))) +
+            " in " + std::to_string(entry.value("count", size_t(0))) +
+            " (peak " + basic::formatBytes(entry.value("peak", size_t(0))) + ")";
+        hints.push_back({
+            {"position", {{"line", number - 1}, {"character", lines[number - 1].size()}}},
+            {"label", label},
+            {"paddingLeft", true}
+        });
+    }
+    return hints;
+}
+
+// Custom request: the line and branch states of the last
+// `--run <file> --coverage <prefix>`, read from <file>.coverage.json, for the
+// client to paint as gutter decorations
+json LSPServer::handleCoverage(const json& params) {
+    std::string uri = params["textDocument"]["uri"];
+    json result = {{"uri", uri}, {"lines", json::array()}};
+    
+    std::ifstream file(uriToPath(uri) + ".coverage.json");
+    if (!file.is_open()) {
+        return result;
+    }
+    json coverage = json::parse(file, nullptr, false);
+    if (coverage.is_discarded() || !coverage.contains("lines")) {
+        return result;
+    }
+    result["lines"] = coverage["lines"];
+    return result;
+}
+
+// Custom request: how much of the workspace memory budget is in use
+json LSPServer::handleMemoryStats(const json& params) {
+    Workspace::MemoryStats stats = workspace_->memoryStats();
+    return {
+        {"budget", stats.budget},
+        {"used", stats.used},
+        {"openDocuments", stats.openDocuments},
+        {"closedDocuments", stats.closedDocuments},
+        {"compiledDocuments", stats.compiledDocuments},
+        {"evictions", stats.evictions},
+        {"recompiles", stats.recompiles},
+        {"cachedPrograms", basic::ProgramCache::shared().size()}
+    };
+}
+
+std::string LSPServer::uriToPath(const std::string& uri) {
+    std::string path = uri;
+    if (path.rfind("file://", 0) == 0) {
+        path = path.substr(7);
+    }
+    std::string decoded;
+    for (size_t i = 0; i < path.size(); ++i) {
+        if (path[i] == '%' && i + 2 < path.size() &&
+            std::isxdigit(static_cast<unsigned char>(path[i + 1])) &&
+            std::isxdigit(static_cast<unsigned char>(path[i + 2]))) {
+            decoded += static_cast<char>(std::stoi(path.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else {
+            decoded += path[i];
+        }
+    }
+    return decoded;
 }
 
 std::string LSPServer::getDocument(const std::string& uri) const {
-    auto it = documents_.find(uri);
-    return it != documents_.end() ? it->second : "";
+    return workspace_->text(uri);
 }
 
 std::vector<CompletionItem> LSPServer::getCompletions(const std::string& uri, const Position& position) {
@@ -455,14 +590,18 @@ std::vector<std::string> LSPServer::getKeywords() {
         "LET", "IF", "THEN", "ELSE", "FOR", "TO", "STEP", "NEXT",
         "WHILE", "WEND", "DO", "LOOP", "UNTIL", "SUB", "END",
         "FUNCTION", "RETURN", "PRINT", "INPUT", "READ", "DATA",
-        "RESTORE", "DIM"
+        "RESTORE", "DIM", "SORT", "BY", "DICT",
+        "RANDOMIZE", "RNDFILL", "USING"
     };
 }
 
 std::vector<std::string> LSPServer::getBuiltinFunctions() {
     return {
-        "ABS", "SIN", "COS", "TAN", "SQRT", "LOG", "EXP",
-        "LEN", "MID", "LEFT", "RIGHT", "VAL", "STR"
+        "ABS", "SIN", "COS", "TAN", "SQRT", "LOG", "EXP", "RND",
+        "LEN", "MID", "LEFT", "RIGHT", "VAL", "STR",
+        "INSTR", "UCASE", "LCASE", "TRIM", "LTRIM", "RTRIM", "REPLACE", "STRCOMP",
+        "FIELD$", "SPLIT", "CSVREAD", "BSEARCH",
+        "SET", "GET", "HAS", "DEL", "KEYS"
     };
 }
 
@@ -499,4 +638,198 @@ void LSPServer::sendNotification(const std::string& method, const json& params)
     sendMessage(message);
 }
 
+Workspace::Workspace(size_t memoryBudget) : budget_(memoryBudget) {}
+
+Workspace::DocumentId Workspace::open(const std::string& uri, const std::string& content) {
+    Document* document = find(uri);
+    if (!document) {
+        DocumentId id;
+        if (!freeIds_.empty()) {
+            id = freeIds_.back();
+            freeIds_.pop_back();
+        } else {
+            id = static_cast<DocumentId>(documents_.size());
+            documents_.emplace_back();
+        }
+        document = &documents_[id];
+        document->uri = uri;
+        document->live = true;
+        ids_.emplace(document->uri, id);
+    }
+    ++document->openCount;
+    // A document reopened with the text it closed with keeps its program
+    setText(*document, content);
+    enforceBudget(document);
+    return ids_.at(document->uri);
+}
+
+// Clients share the document, so the latest edit from any of them wins
+void Workspace::update(const std::string& uri, const std::string& content) {
+    Document* document = find(uri);
+    if (!document || document->openCount == 0) {
+        open(uri, content);
+        return;
+    }
+    setText(*document, content);
+    enforceBudget(document);
+}
+
+bool Workspace::close(DocumentId id) {
+    if (id >= documents_.size() || !documents_[id].live || documents_[id].openCount == 0) {
+        return false;
+    }
+    Document& document = documents_[id];
+    if (--document.openCount > 0) {
+        return false;
+    }
+    // Kept, compiled, until the budget needs the room
+    if (!document.program) {
+        forget(document);
+    }
+    enforceBudget(nullptr);
+    return true;
+}
+
+std::optional<Workspace::DocumentId> Workspace::id(const std::string& uri) const {
+    auto it = ids_.find(uri);
+    if (it == ids_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+std::string Workspace::text(const std::string& uri) const {
+    const Document* document = find(uri);
+    if (!document || document->openCount == 0) {
+        return "";
+    }
+    return document->program ? document->program->source() : document->text;
+}
+
+std::shared_ptr<const basic::Program> Workspace::program(const std::string& uri) {
+    Document* document = find(uri);
+    if (!document || document->openCount == 0) {
+        return nullptr;
+    }
+    document->lastUsed = ++clock_;
+    if (!document->program) {
+        // Evicted earlier; compile it again from the text
+        document->program = basic::ProgramCache::shared().get(document->text);
+        document->text = std::string();
+        ++recompiles_;
+        enforceBudget(document);
+    }
+    return document->program;
+}
+
+std::vector<std::string> Workspace::uris() const {
+    std::vector<std::string> result;
+    for (const auto& document : documents_) {
+        if (document.live && document.openCount > 0) {
+            result.push_back(document.uri);
+        }
+    }
+    return result;
+}
+
+Workspace::MemoryStats Workspace::memoryStats() const {
+    MemoryStats stats;
+    stats.budget = budget_;
+    stats.used = used();
+    for (const auto& document : documents_) {
+        if (!document.live) continue;
+        if (document.openCount > 0) {
+            ++stats.openDocuments;
+        } else {
+            ++stats.closedDocuments;
+        }
+        if (document.program) {
+            ++stats.compiledDocuments;
+        }
+    }
+    stats.evictions = evictions_;
+    stats.recompiles = recompiles_;
+    return stats;
+}
+
+void Workspace::setMemoryBudget(size_t bytes) {
+    budget_ = bytes;
+    enforceBudget(nullptr);
+}
+
+Workspace::Document* Workspace::find(const std::string& uri) {
+    auto it = ids_.find(uri);
+    return it != ids_.end() ? &documents_[it->second] : nullptr;
+}
+
+const Workspace::Document* Workspace::find(const std::string& uri) const {
+    auto it = ids_.find(uri);
+    return it != ids_.end() ? &documents_[it->second] : nullptr;
+}
+
+void Workspace::setText(Document& document, const std::string& content) {
+    document.lastUsed = ++clock_;
+    if (document.program && document.program->source() == content) {
+        return;
+    }
+    document.text = std::string();
+    document.program = basic::ProgramCache::shared().get(content);
+}
+
+void Workspace::forget(Document& document) {
+    DocumentId id = ids_.at(document.uri);
+    ids_.erase(document.uri);
+    document = Document();
+    freeIds_.push_back(id);
+}
+
+size_t Workspace::cost(const Document& document) {
+    return sizeof(Document) + document.uri.capacity() + document.text.capacity() +
+           (document.program ? document.program->memoryUsage() : 0);
+}
+
+size_t Workspace::used() const {
+    size_t total = 0;
+    for (const auto& document : documents_) {
+        if (document.live) {
+            total += cost(document);
+        }
+    }
+    return total;
+}
+
+// Evicts least recently used first: whole closed documents, then the
+// programs of open ones. `keep` is the document being worked on.
+void Workspace::enforceBudget(const Document* keep) {
+    size_t total = used();
+    while (total > budget_) {
+        Document* victim = nullptr;
+        for (auto& document : documents_) {
+            if (document.live && document.openCount == 0 && (!victim || document.lastUsed < victim->lastUsed)) {
+                victim = &document;
+            }
+        }
+        if (victim) {
+            total -= cost(*victim);
+            forget(*victim);
+            ++evictions_;
+            continue;
+        }
+        for (auto& document : documents_) {
+            if (document.live && document.program && &document != keep &&
+                (!victim || document.lastUsed < victim->lastUsed)) {
+                victim = &document;
+            }
+        }
+        if (!victim) {
+            break;
+        }
+        total -= cost(*victim);
+        victim->text = victim->program->source();
+        victim->program.reset();
+        total += cost(*victim);
+        ++evictions_;
+    }
+}
+
 } // namespace lsp 
\ No newline at end of file
@@ -5,24 +5,48 @@
 #include <memory>
 
 #include "lsp/lsp_server.h"
+#include "lsp/lsp_daemon.h"
 #include "dap/dap_server.h"
 #include "interpreter/basic_interpreter.h"
+#include "interpreter/output.h"
+#include "interpreter/alloc_profile.h"
+#include "interpreter/coverage.h"
+#include "interpreter/trace.h"
+#include "interpreter/timeline.h"
+#include "interpreter/program.h"
+#include <fstream>
+#include <sstream>
 
 using namespace lsp;
 using namespace dap;
 using namespace basic;
-namespace basic {
-void setInterpreter(BasicInterpreter* interpreter);
-}
 
 std::unique_ptr<LSPServer> lspServer;
 std::unique_ptr<DAPServer> dapServer;
 std::unique_ptr<BasicInterpreter> interpreter;
 bool running = true;
+std::string timelineFile;
+
+// Stops the timeline and saves it, if --timeline was given
+void writeTimeline(const std::string& path) {
+    if (path.empty()) {
+        return;
+    }
+    Timeline::stop();
+    std::ofstream out(path);
+    Timeline::writeChromeTrace(out);
+    if (!out) {
+        std::cerr << "Error: cannot write timeline to " << path << std::endl;
+    } else if (size_t dropped = Timeline::droppedEvents()) {
+        std::cerr << "Timeline: " << dropped << " events dropped (per-thread buffers full)" << std::endl;
+    }
+}
 
 void signalHandler(int signal) {
-    std::cout << "Received signal " << signal << ", shutting down..." << std::endl;
+    std::cerr << "Received signal " << signal << ", shutting down..." << std::endl;
     running = false;
+    // The servers may be blocked in accept/read and never reach the end of main
+    writeTimeline(timelineFile);
     
     if (lspServer) lspServer->stop();
     if (dapServer) dapServer->stop();
@@ -32,10 +56,23 @@ void printUsage(const char* programName) {
     std::cout << "Usage: " << programName << " [OPTIONS]\n"
               << "Options:\n"
               << "  --lsp-only     Run only the Language Server Protocol server\n"
+              << "  --lsp-daemon <socket> Serve any number of LSP clients on a Unix socket, sharing one workspace\n"
+              << "  --lsp-connect <socket> Connect stdin/stdout to the LSP daemon, starting it if needed\n"
+              << "  --idle-timeout <seconds> Stop the LSP daemon after this long without clients (default: 600)\n"
+              << "  --lsp-memory <MiB> Memory budget for the language server's documents (default: 64)\n"
               << "  --dap-only     Run only the Debug Adapter Protocol server\n"
               << "  --interactive  Run in interactive mode (default)\n"
               << "  --port <port>  Specify the port for the DAP server (default: 4711)\n"
               << "  --log-dap      Enable logging for the Debug Adapter Protocol server\n"
+              << "  --run <file>   Run a BASIC program without starting the LSP/DAP servers\n"
+              << "  --output <file> Write PRINT output of --run to a file instead of stdout\n"
+              << "  --async-output Write --run output asynchronously (io_uring on Linux, else a writer thread)\n"
+              << "  --alloc-profile Report --run allocations per source line and write <file>.allocprof.json\n"
+              << "  --coverage <prefix> Collect --run line/branch coverage into <prefix>.info (lcov), <prefix>.xml\n"
+              << "                 (Cobertura) and <file>.coverage.json, merged with earlier runs in <prefix>.cov\n"
+              << "  --record <file> Record the --run execution trace for replay in the debugger\n"
+              << "  --timeline <file> Write a Chrome/Perfetto trace of lexing, parsing, execution and\n"
+              << "                 LSP/DAP message handling to <file> on exit\n"
               << "  --help         Show this help message\n"
               << "\n"
               << "When running in interactive mode, the server will:\n"
@@ -52,6 +89,94 @@ void printUsage(const char* programName) {
               << "60 END\n";
 }
 
+// Merges this run into <prefix>.cov and rewrites the reports from the total
+bool writeCoverage(const CoverageMap& run, const Program& program, const std::string& prefix, const std::string& path) {
+    CoverageMap total(program);
+    total.load(prefix + ".cov");
+    total.merge(run);
+    std::ofstream lcov(prefix + ".info");
+    total.writeLcov(lcov, path);
+    std::ofstream cobertura(prefix + ".xml");
+    total.writeCobertura(cobertura, path);
+    // Decoration feed for the language server, next to the program
+    std::ofstream decorations(path + ".coverage.json");
+    total.writeDecorations(decorations, path);
+    return total.save(prefix + ".cov") && lcov && cobertura && decorations;
+}
+
+// Batch mode: load and execute a single program, no LSP/DAP servers
+int runProgram(const std::string& path, const std::string& outputFile, bool asyncOutput, bool allocProfile,
+               const std::string& coveragePrefix, const std::string& recordFile) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Error: cannot open " << path << std::endl;
+        return 1;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    
+    try {
+        interpreter = std::make_unique<BasicInterpreter>();
+        if (!outputFile.empty()) {
+            interpreter->setOutputSink(createFileOutputSink(outputFile, asyncOutput));
+        } else if (asyncOutput) {
+            interpreter->setOutputSink(createStdoutSink(true));
+        }
+        
+        AllocationProfile profile;
+        if (allocProfile) {
+            interpreter->setAllocationProfile(&profile);
+        }
+        
+        std::string source = buffer.str();
+        bool ok = interpreter->loadProgram(Program::link(path, [&](const std::string& module) {
+            return module == path ? std::optional<std::string>(source) : Program::readFile(module);
+        }));
+        if (ok && !interpreter->getProgram()->modules().empty() && (!coveragePrefix.empty() || !recordFile.empty())) {
+            std::cerr << "Error: --coverage and --record take a single file, not a program with INCLUDE" << std::endl;
+            return 1;
+        }
+        std::unique_ptr<CoverageMap> coverage;
+        if (ok && !coveragePrefix.empty()) {
+            coverage = std::make_unique<CoverageMap>(*interpreter->getProgram());
+            interpreter->setCoverage(coverage.get());
+        }
+        std::unique_ptr<TraceRecorder> trace;
+        if (ok && !recordFile.empty()) {
+            trace = std::make_unique<TraceRecorder>(recordFile, path, source);
+            interpreter->setTrace(trace.get());
+        }
+        ok = ok && interpreter->execute();
+        interpreter->flushOutput();
+        if (trace) {
+            interpreter->setTrace(nullptr);
+            trace->finish(ok, ok ? std::string() : interpreter->getLastError());
+        }
+        if (coverage) {
+            interpreter->setCoverage(nullptr);
+            if (!writeCoverage(*coverage, *interpreter->getProgram(), coveragePrefix, path)) {
+                std::cerr << "Error: cannot write coverage to " << coveragePrefix << ".*" << std::endl;
+            }
+        }
+        if (allocProfile) {
+            interpreter->setAllocationProfile(nullptr);
+            profile.writeReport(std::cerr, interpreter->getProgram().get());
+            // Inlay hints for the language server, next to the program
+            std::ofstream hints(path + ".allocprof.json");
+            profile.writeHints(hints, path);
+        }
+        if (!ok) {
+            std::cerr << "Error: " << interpreter->getLastError() << std::endl;
+            return 1;
+        }
+        interpreter.reset();
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
     // Set up signal handling
     signal(SIGINT, signalHandler);
@@ -63,6 +188,16 @@ int main(int argc, char* argv[]) {
     bool interactive = true;
     int port = 4711;
     bool enableLogging = false;
+    std::string runFile;
+    std::string outputFile;
+    bool asyncOutput = false;
+    bool allocProfile = false;
+    std::string coveragePrefix;
+    std::string recordFile;
+    std::string daemonSocket;
+    std::string connectSocket;
+    int idleTimeout = 600;
+    size_t lspMemory = Workspace::kDefaultMemoryBudget;
     
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
@@ -78,6 +213,29 @@ int main(int argc, char* argv[]) {
             enableLogging = true;
         } else if (arg == "--port" && i + 1 < argc) {
             port = std::stoi(argv[++i]);
+        } else if (arg == "--run" && i + 1 < argc) {
+            runFile = argv[++i];
+            interactive = false;
+        } else if (arg == "--output" && i + 1 < argc) {
+            outputFile = argv[++i];
+        } else if (arg == "--async-output") {
+            asyncOutput = true;
+        } else if (arg == "--alloc-profile") {
+            allocProfile = true;
+        } else if (arg == "--coverage" && i + 1 < argc) {
+            coveragePrefix = argv[++i];
+        } else if (arg == "--record" && i + 1 < argc) {
+            recordFile = argv[++i];
+        } else if (arg == "--lsp-daemon" && i + 1 < argc) {
+            daemonSocket = argv[++i];
+        } else if (arg == "--lsp-connect" && i + 1 < argc) {
+            connectSocket = argv[++i];
+        } else if (arg == "--idle-timeout" && i + 1 < argc) {
+            idleTimeout = std::stoi(argv[++i]);
+        } else if (arg == "--lsp-memory" && i + 1 < argc) {
+            lspMemory = static_cast<size_t>(std::stoul(argv[++i])) * 1024 * 1024;
+        } else if (arg == "--timeline" && i + 1 < argc) {
+            timelineFile = argv[++i];
         } else if (arg == "--help" || arg == "-h") {
             printUsage(argv[0]);
             return 0;
@@ -88,36 +246,64 @@ int main(int argc, char* argv[]) {
         }
     }
     
+    if (!timelineFile.empty()) {
+        if (!Timeline::available()) {
+            std::cerr << "Warning: built with BASIC_ENABLE_TIMELINE=OFF, --timeline records nothing" << std::endl;
+        }
+        Timeline::start();
+    }
+    
+    if (!runFile.empty()) {
+        int status = runProgram(runFile, outputFile, asyncOutput, allocProfile, coveragePrefix, recordFile);
+        writeTimeline(timelineFile);
+        return status;
+    }
+    
+    // stdout carries LSP (and in interactive mode DAP) messages from here on,
+    // so status messages go to stderr
+    if (!connectSocket.empty()) {
+        return LSPDaemon::connectStdio(connectSocket, argv[0], std::chrono::seconds(idleTimeout), lspMemory, running);
+    }
+    if (!daemonSocket.empty()) {
+        try {
+            LSPDaemon daemon(daemonSocket, std::chrono::seconds(idleTimeout), lspMemory);
+            daemon.run(running);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        writeTimeline(timelineFile);
+        return 0;
+    }
+    
     try {
         // Initialize the BASIC interpreter
         interpreter = std::make_unique<BasicInterpreter>();
         
         if (interactive || lspOnly) {
-            std::cout << "Starting BASIC Language Server..." << std::endl;
-            lspServer = std::make_unique<LSPServer>();
+            std::cerr << "Starting BASIC Language Server..." << std::endl;
+            lspServer = std::make_unique<LSPServer>(std::make_shared<Workspace>(lspMemory));
             lspServer->start();
         }
         
         if (interactive || dapOnly) {
-            std::cout << "Starting BASIC Debug Adapter..." << std::endl;
+            std::cerr << "Starting BASIC Debug Adapter..." << std::endl;
             dapServer = std::make_unique<DAPServer>();
             if (dapOnly) {
                 dapServer->start(4711, enableLogging);  // Use network mode for DAP-only
-                basic::setDAPServer(dapServer.get());
-                basic::setInterpreter(interpreter.get());
+                dapServer->setInterpreter(interpreter.get());
             } else {
                 dapServer->start(enableLogging);  // Use stdin/stdout for interactive mode
-                basic::setDAPServer(dapServer.get());
-                basic::setInterpreter(interpreter.get());
+                dapServer->setInterpreter(interpreter.get());
             }
             
         }
         
         if (interactive) {
-            std::cout << "BASIC Interpreter with LSP/DAP support is running." << std::endl;
-            std::cout << "LSP server: stdin/stdout" << std::endl;
-            std::cout << "DAP server: port 4711" << std::endl;
-            std::cout << "Press Ctrl+C to exit." << std::endl;
+            std::cerr << "BASIC Interpreter with LSP/DAP support is running." << std::endl;
+            std::cerr << "LSP server: stdin/stdout" << std::endl;
+            std::cerr << "DAP server: port 4711" << std::endl;
+            std::cerr << "Press Ctrl+C to exit." << std::endl;
             
             // Main event loop
             while (running) {
@@ -127,9 +313,7 @@ int main(int argc, char* argv[]) {
                 if (lspServer && lspServer->isRunning()) {
                     try {
                         LSPMessage message = lspServer->receiveMessage();
-                        if (message.type != MessageType::NOTIFICATION) {
-                            lspServer->processMessage(message);
-                        }
+                        lspServer->processMessage(message);
                     } catch (const std::exception& e) {
                         // Handle LSP communication errors
                     }
@@ -149,20 +333,18 @@ int main(int argc, char* argv[]) {
             }
         } else if (lspOnly) {
             // LSP-only mode
-            std::cout << "LSP server running on stdin/stdout" << std::endl;
+            std::cerr << "LSP server running on stdin/stdout" << std::endl;
             while (running && lspServer->isRunning()) {
                 try {
                     LSPMessage message = lspServer->receiveMessage();
-                    if (message.type != MessageType::NOTIFICATION) {
-                        lspServer->processMessage(message);
-                    }
+                    lspServer->processMessage(message);
                 } catch (const std::exception& e) {
                     break;
                 }
             }
         } else if (dapOnly) {
             // DAP-only mode
-            std::cout << "DAP server running on port 4711" << std::endl;
+            std::cerr << "DAP server running on port 4711" << std::endl;
             while (running && dapServer->isRunning()) {
                 try {
                     DAPMessage message = dapServer->receiveMessage();
@@ -180,7 +362,7 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
-    std::cout << "Shutting down BASIC Interpreter..." << std::endl;
+    std::cerr << "Shutting down BASIC Interpreter..." << std::endl;
     
     if (lspServer) {
         lspServer->stop();
@@ -189,7 +371,8 @@ int main(int argc, char* argv[]) {
     if (dapServer) {
         dapServer->stop();
     }
+    writeTimeline(timelineFile);
     
-    std::cout << "Goodbye!" << std::endl;
+    std::cerr << "Goodbye!" << std::endl;
     return 0;
 } 
\ No newline at end of file
@@ -0,0 +1,169 @@
+#include "protocol/json_escape.h"
+#include "interpreter/simd_string.h"
+
+namespace protocol {
+
+namespace simd = basic::simd;
+
+namespace {
+
+// Length of the UTF-8 sequence starting at text[at], or 0 if it is not
+// well-formed (RFC 3629: no overlongs, surrogates or code points past
+// U+10FFFF)
+size_t utf8Length(std::string_view text, size_t at) {
+    auto byte = [&](size_t i) { return i < text.size() ? static_cast<unsigned char>(text[i]) : 0u; };
+    auto continuation = [&](size_t i, unsigned lo = 0x80, unsigned hi = 0xbf) {
+        return byte(i) >= lo && byte(i) <= hi;
+    };
+    unsigned lead = byte(at);
+    if (lead >= 0xc2 && lead <= 0xdf) {
+        return continuation(at + 1) ? 2 : 0;
+    }
+    if (lead >= 0xe0 && lead <= 0xef) {
+        unsigned lo = lead == 0xe0 ? 0xa0 : 0x80;
+        unsigned hi = lead == 0xed ? 0x9f : 0xbf;
+        return continuation(at + 1, lo, hi) && continuation(at + 2) ? 3 : 0;
+    }
+    if (lead >= 0xf0 && lead <= 0xf4) {
+        unsigned lo = lead == 0xf0 ? 0x90 : 0x80;
+        unsigned hi = lead == 0xf4 ? 0x8f : 0xbf;
+        return continuation(at + 1, lo, hi) && continuation(at + 2) && continuation(at + 3) ? 4 : 0;
+    }
+    return 0;
+}
+
+bool validUtf8(std::string_view text) {
+    size_t i = simd::findNonAscii(text);
+    while (i != simd::npos) {
+        size_t length = utf8Length(text, i);
+        if (length == 0) {
+            return false;
+        }
+        i = simd::findNonAscii(text, i + length);
+    }
+    return true;
+}
+
+int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// The four hex digits at text[at], or -1
+long hexQuad(std::string_view text, size_t at) {
+    if (at + 4 > text.size()) {
+        return -1;
+    }
+    long value = 0;
+    for (size_t i = at; i < at + 4; ++i) {
+        int digit = hexDigit(text[i]);
+        if (digit < 0) {
+            return -1;
+        }
+        value = value * 16 + digit;
+    }
+    return value;
+}
+
+void appendUtf8(std::string& out, unsigned long code) {
+    if (code < 0x80) {
+        out += static_cast<char>(code);
+    } else if (code < 0x800) {
+        out += static_cast<char>(0xc0 | (code >> 6));
+        out += static_cast<char>(0x80 | (code & 0x3f));
+    } else if (code < 0x10000) {
+        out += static_cast<char>(0xe0 | (code >> 12));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+        out += static_cast<char>(0x80 | (code & 0x3f));
+    } else {
+        out += static_cast<char>(0xf0 | (code >> 18));
+        out += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+        out += static_cast<char>(0x80 | (code & 0x3f));
+    }
+}
+
+} // namespace
+
+void appendEscaped(std::string& out, std::string_view text) {
+    static const char* hex = "0123456789abcdef";
+    size_t i = 0;
+    while (i < text.size()) {
+        size_t next = simd::findJsonEscape(text, i);
+        if (next == simd::npos) {
+            out.append(text.data() + i, text.size() - i);
+            return;
+        }
+        out.append(text.data() + i, next - i);
+        char c = text[next];
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            out += "\\u00";
+            out += hex[(c >> 4) & 0xf];
+            out += hex[c & 0xf];
+        }
+        i = next + 1;
+    }
+}
+
+bool unescape(std::string_view escaped, std::string& out) {
+    if (!validUtf8(escaped)) {
+        return false;
+    }
+    out.reserve(out.size() + escaped.size());
+    size_t i = 0;
+    while (i < escaped.size()) {
+        size_t next = simd::findJsonEscape(escaped, i);
+        if (next == simd::npos) {
+            out.append(escaped.data() + i, escaped.size() - i);
+            return true;
+        }
+        out.append(escaped.data() + i, next - i);
+        if (escaped[next] != '\\' || next + 1 >= escaped.size()) {
+            return false;
+        }
+        i = next + 2;
+        switch (escaped[next + 1]) {
+        case '"': out += '"'; break;
+        case '\\': out += '\\'; break;
+        case '/': out += '/'; break;
+        case 'b': out += '\b'; break;
+        case 'f': out += '\f'; break;
+        case 'n': out += '\n'; break;
+        case 'r': out += '\r'; break;
+        case 't': out += '\t'; break;
+        case 'u': {
+            long code = hexQuad(escaped, i);
+            if (code < 0 || (code >= 0xdc00 && code <= 0xdfff)) {
+                return false;
+            }
+            i += 4;
+            if (code >= 0xd800 && code <= 0xdbff) {
+                // A high surrogate needs its low half next
+                long low = escaped.substr(i, 2) == "\\u" ? hexQuad(escaped, i + 2) : -1;
+                if (low < 0xdc00 || low > 0xdfff) {
+                    return false;
+                }
+                code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                i += 6;
+            }
+            appendUtf8(out, static_cast<unsigned long>(code));
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace protocol
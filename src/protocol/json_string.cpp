@@ -0,0 +1,76 @@
+#include "protocol/json_string.h"
+#include "interpreter/simd_string.h"
+#include <vector>
+
+namespace protocol {
+
+namespace simd = basic::simd;
+
+namespace {
+
+// Lifted strings are replaced by "\u0000<index>". Every string value that
+// starts with NUL is lifted, whatever its length, so after parsing a NUL
+// prefix always marks a placeholder.
+void restore(nlohmann::json& value, std::vector<std::string>& lifted) {
+    if (value.is_string()) {
+        auto& text = value.get_ref<std::string&>();
+        if (!text.empty() && text[0] == '\0') {
+            text = std::move(lifted[std::stoul(text.substr(1))]);
+        }
+    } else if (value.is_structured()) {
+        for (auto& item : value) {
+            restore(item, lifted);
+        }
+    }
+}
+
+} // namespace
+
+nlohmann::json parse(std::string_view content) {
+    if (content.size() < kLiftedStringSize) {
+        return nlohmann::json::parse(content);
+    }
+
+    std::string skeleton;
+    std::vector<std::string> lifted;
+    size_t copied = 0;
+    size_t quote = simd::findByte(content, '"');
+    while (quote != simd::npos) {
+        // Outside strings only structure, numbers and literals, none of
+        // which hold a quote, so this is always the start of one
+        size_t end = quote + 1;
+        while ((end = simd::findEither(content, '"', '\\', end)) != simd::npos && content[end] == '\\') {
+            end += 2;
+        }
+        if (end == simd::npos || end >= content.size()) {
+            break; // unterminated; the DOM parser reports it
+        }
+        std::string_view body = content.substr(quote + 1, end - quote - 1);
+        size_t after = end + 1;
+        while (after < content.size() && (content[after] == ' ' || content[after] == '\t' ||
+                                          content[after] == '\r' || content[after] == '\n')) {
+            ++after;
+        }
+        bool isKey = after < content.size() && content[after] == ':';
+        if (!isKey && (body.size() >= kLiftedStringSize || body.substr(0, 6) == "\\u0000")) {
+            std::string text;
+            if (!unescape(body, text)) {
+                return nlohmann::json::parse(content);
+            }
+            skeleton.append(content.data() + copied, quote - copied);
+            skeleton += "\"\\u0000" + std::to_string(lifted.size()) + "\"";
+            lifted.push_back(std::move(text));
+            copied = end + 1;
+        }
+        quote = simd::findByte(content, '"', end + 1);
+    }
+    if (lifted.empty()) {
+        return nlohmann::json::parse(content);
+    }
+    skeleton.append(content.data() + copied, content.size() - copied);
+    nlohmann::json tree = nlohmann::json::parse(skeleton);
+    restore(tree, lifted);
+    return tree;
+}
+
+} // namespace protocol
@@ -0,0 +1,97 @@
+#include "protocol/json_writer.h"
+#include "protocol/json_escape.h"
+#include <cmath>
+#include <cstdio>
+
+namespace protocol {
+
+void JsonWriter::separate() {
+    if (afterKey_) {
+        afterKey_ = false;
+        return;
+    }
+    if (!empty_.empty()) {
+        if (!empty_.back()) {
+            out_ += ',';
+        }
+        empty_.back() = false;
+    }
+}
+
+void JsonWriter::beginObject() {
+    separate();
+    out_ += '{';
+    empty_.push_back(true);
+}
+
+void JsonWriter::endObject() {
+    out_ += '}';
+    empty_.pop_back();
+}
+
+void JsonWriter::beginArray() {
+    separate();
+    out_ += '[';
+    empty_.push_back(true);
+}
+
+void JsonWriter::endArray() {
+    out_ += ']';
+    empty_.pop_back();
+}
+
+void JsonWriter::key(std::string_view name) {
+    value(name);
+    out_ += ':';
+    afterKey_ = true;
+}
+
+void JsonWriter::value(bool flag) {
+    separate();
+    out_ += flag ? "true" : "false";
+}
+
+void JsonWriter::value(int number) {
+    separate();
+    out_ += std::to_string(number);
+}
+
+void JsonWriter::value(long long number) {
+    separate();
+    out_ += std::to_string(number);
+}
+
+void JsonWriter::value(unsigned long long number) {
+    separate();
+    out_ += std::to_string(number);
+}
+
+void JsonWriter::value(double number) {
+    separate();
+    if (!std::isfinite(number)) {
+        out_ += "null";
+        return;
+    }
+    char buffer[32];
+    int length = std::snprintf(buffer, sizeof(buffer), "%.17g", number);
+    out_.append(buffer, static_cast<size_t>(length));
+}
+
+void JsonWriter::value(std::string_view text) {
+    separate();
+    out_.reserve(out_.size() + text.size() + 2);
+    out_ += '"';
+    appendEscaped(out_, text);
+    out_ += '"';
+}
+
+void JsonWriter::value(const nlohmann::json& tree) {
+    raw(tree.dump());
+}
+
+void JsonWriter::raw(std::string_view text) {
+    separate();
+    out_ += text;
+}
+
+} // namespace protocol
@@ -0,0 +1,78 @@
+// Checks how whole arrays and dictionaries are passed to built-ins: A() at
+// the positions Functions::takesArray names, and nothing else, whether that
+// is a string holding a name or a call with no arguments.
+#include "check.h"
+#include "interpreter/basic_interpreter.h"
+#include "interpreter/functions.h"
+#include "interpreter/output.h"
+#include <memory>
+#include <string>
+
+namespace {
+
+// Output of the program, or "error: " and the message
+std::string run(const std::string& source) {
+    basic::BasicInterpreter interpreter;
+    interpreter.setOutputSink(std::make_unique<basic::BufferOutputSink>());
+    interpreter.registerFunction("SEVEN", []() { return 7; });
+    if (!interpreter.loadProgram(source) || !interpreter.execute()) {
+        return "error: " + interpreter.getLastError();
+    }
+    return static_cast<basic::BufferOutputSink*>(interpreter.getOutputSink())->contents();
+}
+
+bool contains(const std::string& text, const std::string& part) { return text.find(part) != std::string::npos; }
+
+void testArrays() {
+    CHECK_EQ(run("10 N = SPLIT(\"a,b,c\", A())\n20 PRINT N\n30 PRINT A(1)\n"), "3\nb\n");
+    // The parentheses may be left out, as in SORT
+    CHECK_EQ(run("10 N = SPLIT(\"x;y\", B, \";\")\n20 PRINT B(0)\n"), "x\n");
+    CHECK_EQ(run("10 N = SPLIT(\"c,a,b\", A())\n20 SORT A()\n30 PRINT BSEARCH(A(), \"b\")\n"), "1\n");
+    CHECK_EQ(run("10 DIM A(3)\n20 A(3) = 5\n30 PRINT BSEARCH(A(), 5)\n"), "3\n");
+}
+
+void testDictionaries() {
+    CHECK_EQ(run("10 DICT D\n"
+                 "20 X = SET(D(), \"k\", 5)\n"
+                 "30 N = KEYS(D(), K())\n"
+                 "40 PRINT GET(D, \"k\")\n"
+                 "50 PRINT K(0)\n"
+                 "60 PRINT HAS(D(), \"z\")\n"),
+             "5\nk\n0\n");
+}
+
+// A string is not an array name, even when it holds one
+void testNotNames() {
+    std::string literal = run("10 N = SPLIT(\"a,b\", \"A\")\n");
+    CHECK_EQ_FOR(contains(literal, "error: "), true, literal);
+    std::string expression = run("10 DIM A(1)\n20 PRINT BSEARCH(A() + 1, 0)\n");
+    CHECK_EQ_FOR(contains(expression, "error: "), true, expression);
+    // N$ names an array of its own; its value is left alone
+    CHECK_EQ(run("10 N$ = \"A\"\n20 K = SPLIT(\"p,q\", N$)\n30 PRINT N$\n40 PRINT N$(1)\n"), "A\nq\n");
+}
+
+// Elsewhere NAME() is still a call
+void testCalls() {
+    CHECK_EQ(run("10 PRINT ABS(SEVEN())\n"), "7\n");
+    CHECK_EQ(run("10 N = SPLIT(STR(SEVEN()), A())\n20 PRINT A(0)\n"), "7\n");
+}
+
+void testTable() {
+    CHECK(basic::Functions::takesArray("SPLIT", 1));
+    CHECK(!basic::Functions::takesArray("SPLIT", 0));
+    CHECK(!basic::Functions::takesArray("SPLIT", 2));
+    CHECK(basic::Functions::takesArray("KEYS", 0) && basic::Functions::takesArray("KEYS", 1));
+    CHECK(!basic::Functions::takesArray("LEN", 0));
+    CHECK(!basic::Functions::takesArray("SEVEN", 0));
+}
+
+} // namespace
+
+int main() {
+    testArrays();
+    testDictionaries();
+    testNotNames();
+    testCalls();
+    testTable();
+    return test::result();
+}
@@ -0,0 +1,228 @@
+// Checks SORT and BSEARCH against std::stable_sort and a linear scan: the
+// order-preserving keys for negative and mixed numbers, string prefixes,
+// stability of SORT ... BY, and the chunked path for large arrays.
+#include "check.h"
+#include "interpreter/array_sort.h"
+#include "interpreter/variables.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+basic::Array makeArray(std::vector<basic::Value> values) {
+    basic::Array array;
+    array.dims = {static_cast<int>(values.size())};
+    array.data.assign(values.begin(), values.end());
+    return array;
+}
+
+double number(const basic::Value& value) {
+    if (const int* i = std::get_if<int>(&value)) return *i;
+    if (const bool* b = std::get_if<bool>(&value)) return *b ? 1 : 0;
+    return std::get<double>(value);
+}
+
+bool less(const basic::Value& a, const basic::Value& b) {
+    if (std::holds_alternative<std::string>(a)) return std::get<std::string>(a) < std::get<std::string>(b);
+    return number(a) < number(b);
+}
+
+bool identical(const basic::Value& a, const basic::Value& b) {
+    if (a.index() != b.index()) return false;
+    if (const double* d = std::get_if<double>(&a)) {
+        return std::signbit(*d) == std::signbit(std::get<double>(b)) && *d == std::get<double>(b);
+    }
+    return a == b;
+}
+
+// Sorts values by key with a payload of original positions, and checks both
+// against a stable sort
+void checkSort(const std::vector<basic::Value>& values, const std::string& context, size_t threads = 0) {
+    std::vector<size_t> order(values.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return less(values[a], values[b]); });
+
+    basic::Array keys = makeArray(values);
+    std::vector<basic::Value> positions;
+    for (size_t i = 0; i < values.size(); ++i) positions.push_back(basic::Value{static_cast<int>(i)});
+    basic::Array payload = makeArray(positions);
+    basic::sortArray(keys, &payload, threads);
+
+    size_t wrong = 0;
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (!identical(keys.data[i], values[order[i]]) || std::get<int>(payload.data[i]) != static_cast<int>(order[i])) {
+            ++wrong;
+        }
+    }
+    CHECK_EQ_FOR(wrong, 0u, context);
+
+    // Without a payload the keys come out the same
+    basic::Array alone = makeArray(values);
+    basic::sortArray(alone, nullptr, threads);
+    wrong = 0;
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (!identical(alone.data[i], keys.data[i])) ++wrong;
+    }
+    CHECK_EQ_FOR(wrong, 0u, context + " without payload");
+}
+
+std::vector<basic::Value> randomIntegers(std::mt19937& rng, size_t n, int range) {
+    std::vector<basic::Value> values;
+    for (size_t i = 0; i < n; ++i) {
+        switch (rng() % 20) {
+            case 0: values.push_back(basic::Value{INT_MIN}); break;
+            case 1: values.push_back(basic::Value{INT_MAX}); break;
+            default: values.push_back(basic::Value{static_cast<int>(rng() % static_cast<unsigned>(2 * range)) - range});
+        }
+    }
+    return values;
+}
+
+std::vector<basic::Value> randomDoubles(std::mt19937& rng, size_t n) {
+    static const double specials[] = {0.0, -0.0, 1e-310, -1e-310, 1e308, -1e308,
+                                      std::numeric_limits<double>::infinity(),
+                                      -std::numeric_limits<double>::infinity(), -1.5, 1.5};
+    std::vector<basic::Value> values;
+    for (size_t i = 0; i < n; ++i) {
+        if (rng() % 10 == 0) {
+            values.push_back(basic::Value{specials[rng() % 10]});
+        } else {
+            values.push_back(basic::Value{(static_cast<double>(rng() % 2001) - 1000) / 8});
+        }
+    }
+    return values;
+}
+
+// Ints, doubles and booleans, with equal numbers of different types
+std::vector<basic::Value> randomMixed(std::mt19937& rng, size_t n) {
+    std::vector<basic::Value> values;
+    for (size_t i = 0; i < n; ++i) {
+        int k = static_cast<int>(rng() % 21) - 10;
+        switch (rng() % 4) {
+            case 0: values.push_back(basic::Value{k}); break;
+            case 1: values.push_back(basic::Value{static_cast<double>(k)}); break;
+            case 2: values.push_back(basic::Value{k + 0.25}); break;
+            default: values.push_back(basic::Value{k % 2 == 0}); break;
+        }
+    }
+    return values;
+}
+
+// Shared 8-byte prefixes, embedded NULs and bytes above 127
+std::vector<basic::Value> randomStrings(std::mt19937& rng, size_t n) {
+    static const std::string stems[] = {"", "abcdefgh", "abcdefg", "abc", std::string("abc\0", 4), "\xc3\xa9", "Z"};
+    std::vector<basic::Value> values;
+    for (size_t i = 0; i < n; ++i) {
+        std::string text = stems[rng() % 7];
+        for (size_t k = rng() % 4; k > 0; --k) text += static_cast<char>("a\0z\xff"[rng() % 4]);
+        values.push_back(basic::Value{text});
+    }
+    return values;
+}
+
+void testSmallArrays() {
+    std::mt19937 rng(79);
+    for (int round = 0; round < 150; ++round) {
+        size_t n = rng() % 200;
+        std::string context = "round " + std::to_string(round);
+        checkSort(randomIntegers(rng, n, round % 2 ? 5 : 100000), context + " integers");
+        checkSort(randomDoubles(rng, n), context + " doubles");
+        checkSort(randomMixed(rng, n), context + " mixed");
+        checkSort(randomStrings(rng, n), context + " strings");
+    }
+    // Already sorted, reversed and constant inputs
+    std::vector<basic::Value> run;
+    for (int i = 0; i < 5000; ++i) run.push_back(basic::Value{i * 3 - 7000});
+    checkSort(run, "sorted");
+    std::reverse(run.begin(), run.end());
+    checkSort(run, "reversed");
+    checkSort(std::vector<basic::Value>(5000, basic::Value{std::string("same")}), "constant");
+}
+
+// Past the parallel threshold, with the chunk count forced so the merge runs
+// on any machine, and an odd count to leave a run without a partner
+void testLargeArrays() {
+    std::mt19937 rng(790);
+    const size_t n = (1 << 18) + 1001;
+    checkSort(randomIntegers(rng, n, 1000), "integers", 3);
+    checkSort(randomDoubles(rng, n), "doubles", 8);
+    checkSort(randomMixed(rng, n), "mixed", 5);
+    checkSort(randomStrings(rng, n), "strings", 3);
+}
+
+void testSearch() {
+    std::mt19937 rng(791);
+    for (int round = 0; round < 200; ++round) {
+        basic::Array array = makeArray(round % 2 ? randomIntegers(rng, rng() % 100, 20) : randomMixed(rng, rng() % 100));
+        basic::sortArray(array);
+        for (int k = -25; k <= 25; ++k) {
+            basic::Value target = k % 3 == 0 ? basic::Value{k + 0.25} : basic::Value{k};
+            int expected = -1;
+            for (size_t i = 0; i < array.data.size(); ++i) {
+                if (number(array.data[i]) == number(target)) {
+                    expected = static_cast<int>(i);
+                    break;
+                }
+            }
+            CHECK_EQ_FOR(basic::searchArray(array, target), expected, "round " + std::to_string(round));
+        }
+    }
+
+    basic::Array names = makeArray({basic::Value{std::string("b")}, basic::Value{std::string("a")},
+                                    basic::Value{std::string("b")}, basic::Value{std::string("c")}});
+    basic::sortArray(names);
+    CHECK_EQ(basic::searchArray(names, basic::Value{std::string("b")}), 1);
+    CHECK_EQ(basic::searchArray(names, basic::Value{std::string("bb")}), -1);
+    CHECK_EQ(basic::searchArray(makeArray({}), basic::Value{1}), -1);
+    // TRUE finds 1
+    CHECK_EQ(basic::searchArray(makeArray({basic::Value{0}, basic::Value{1.0}}), basic::Value{true}), 1);
+}
+
+bool throws(const std::function<void()>& f) {
+    try {
+        f();
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+void testErrors() {
+    basic::Array grid = makeArray({basic::Value{1}, basic::Value{2}, basic::Value{3}, basic::Value{4}});
+    grid.dims = {2, 2};
+    CHECK(throws([&] { basic::sortArray(grid); }));
+    CHECK(throws([&] { basic::searchArray(grid, basic::Value{1}); }));
+
+    basic::Array mixed = makeArray({basic::Value{1}, basic::Value{std::string("a")}});
+    CHECK(throws([&] { basic::sortArray(mixed); }));
+    basic::Array keys = makeArray({basic::Value{2}, basic::Value{1}});
+    basic::Array shorter = makeArray({basic::Value{1}});
+    CHECK(throws([&] { basic::sortArray(keys, &shorter); }));
+    // Nothing moves when the arguments are rejected
+    CHECK(keys.data[0] == basic::Value{2});
+    // Sorting an array by itself is a plain sort
+    basic::sortArray(keys, &keys);
+    CHECK(keys.data[0] == basic::Value{1});
+
+    basic::Array numbers = makeArray({basic::Value{1}, basic::Value{2}});
+    CHECK(throws([&] { basic::searchArray(makeArray({basic::Value{std::string("a")}}), basic::Value{1}); }));
+    CHECK(throws([&] { basic::searchArray(numbers, basic::Value{std::string("a")}); }));
+}
+
+} // namespace
+
+int main() {
+    testSmallArrays();
+    testLargeArrays();
+    testSearch();
+    testErrors();
+    return test::result();
+}
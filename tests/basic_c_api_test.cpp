@@ -0,0 +1,128 @@
+// Checks that the C API reports failures as error codes rather than letting
+// C++ exceptions through, in particular going over the memory limit, and
+// that the memory usage it reports stays consistent afterwards.
+#include "check.h"
+#include "interpreter/basic_c_api.h"
+#include <string>
+
+namespace {
+
+struct Usage {
+    size_t live = 0;
+    size_t peak = 0;
+};
+
+Usage usage(basic_context* context) {
+    Usage result;
+    basic_memory_usage(context, &result.live, &result.peak);
+    return result;
+}
+
+bool errorContains(basic_context* context, const char* text) {
+    return std::string(basic_context_error(context)).find(text) != std::string::npos;
+}
+
+void testSetStringOverLimit() {
+    basic_context* context = basic_context_new();
+    CHECK_EQ(basic_set_memory_limit(context, 1000), 0);
+    CHECK_EQ(basic_set_string(context, "A$", std::string(200, 'a').c_str()), 0);
+    Usage before = usage(context);
+    CHECK(before.live > 0);
+
+    CHECK_EQ(basic_set_string(context, "A$", std::string(10000, 'b').c_str()), -1);
+    CHECK(errorContains(context, "Out of memory"));
+    CHECK_EQ(usage(context).live, before.live);
+    // The refused store leaves the old value in place
+    basic_value value;
+    CHECK_EQ(basic_get(context, "A$", &value), 0);
+    CHECK_EQ(std::string(value.string), std::string(200, 'a'));
+
+    CHECK_EQ(basic_set_string(context, "B$", std::string(10000, 'c').c_str()), -1);
+    CHECK_EQ(basic_get(context, "B$", &value), -1);
+    CHECK_EQ(usage(context).live, before.live);
+    basic_context_free(context);
+}
+
+void testRunOverLimit() {
+    // A$ doubles until it passes the limit; SPLIT then fills F$ in bulk
+    const char* programs[] = {
+        "10 A$ = \"xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\"\n"
+        "20 FOR I = 1 TO 20\n"
+        "30 A$ = A$ + A$\n"
+        "40 NEXT I\n",
+        "10 A$ = \"xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx,\"\n"
+        "20 FOR I = 1 TO 5\n"
+        "30 A$ = A$ + A$\n"
+        "40 NEXT I\n"
+        "50 N = SPLIT(A$, F$(), \",\")\n",
+    };
+    for (const char* source : programs) {
+        char error[256];
+        basic_program* program = basic_compile(source, error, sizeof(error));
+        CHECK(program != nullptr);
+        basic_context* context = basic_context_new();
+        CHECK_EQ(basic_capture_output(context), 0);
+        CHECK_EQ(basic_context_load(context, program), 0);
+        CHECK_EQ(basic_set_memory_limit(context, 3000), 0);
+
+        CHECK_EQ(basic_context_run(context), -1);
+        CHECK(errorContains(context, "Out of memory"));
+        Usage after = usage(context);
+        CHECK(after.live <= 3000);
+        CHECK(after.peak <= 3000);
+
+        // Without the limit the same program runs, from a clean account
+        CHECK_EQ(basic_context_reset(context), 0);
+        CHECK_EQ(usage(context).live, 0u);
+        CHECK_EQ(basic_set_memory_limit(context, 0), 0);
+        CHECK_EQ(basic_context_run(context), 0);
+        CHECK(usage(context).live > 3000);
+        basic_context_free(context);
+        basic_program_free(program);
+    }
+}
+
+void testNullArguments() {
+    basic_context* context = basic_context_new();
+    basic_value value;
+    CHECK_EQ(basic_set_string(context, nullptr, "x"), -1);
+    CHECK_EQ(basic_set_string(context, "A$", nullptr), -1);
+    CHECK_EQ(basic_set_number(context, nullptr, 1.0), -1);
+    CHECK_EQ(basic_get(context, nullptr, &value), -1);
+    CHECK_EQ(basic_get(context, "A", nullptr), -1);
+    CHECK_EQ(basic_bind_function(context, nullptr, nullptr, nullptr), -1);
+    CHECK_EQ(basic_context_load(context, nullptr), -1);
+    CHECK(std::string(basic_context_error(context)).size() > 0);
+    basic_context_free(context);
+
+    CHECK(basic_pool_new(nullptr, 0, 0) == nullptr);
+
+    // A NULL context, program or pool fails instead of being dereferenced
+    basic_program* program = basic_compile("10 PRINT 1", nullptr, 0);
+    CHECK_EQ(basic_context_load(nullptr, program), -1);
+    CHECK_EQ(basic_context_run(nullptr), -1);
+    CHECK_EQ(basic_context_reset(nullptr), -1);
+    CHECK_EQ(basic_set_number(nullptr, "A", 1.0), -1);
+    CHECK_EQ(basic_get(nullptr, "A", &value), -1);
+    CHECK_EQ(basic_capture_output(nullptr), -1);
+    CHECK_EQ(std::string(basic_output(nullptr)), "");
+    CHECK(std::string(basic_context_error(nullptr)).size() > 0);
+    Usage none = usage(nullptr);
+    CHECK_EQ(none.live + none.peak, 0u);
+    basic_clear_output(nullptr);
+    CHECK(basic_pool_acquire(nullptr) == nullptr);
+    CHECK_EQ(basic_pool_bind_function(nullptr, "F", nullptr, nullptr), -1);
+    basic_pool_release(nullptr, nullptr);
+    basic_context_free(nullptr);
+    basic_pool_free(nullptr);
+    basic_program_free(program);
+}
+
+} // namespace
+
+int main() {
+    testSetStringOverLimit();
+    testRunOverLimit();
+    testNullArguments();
+    return test::result();
+}
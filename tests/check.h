@@ -0,0 +1,54 @@
+#pragma once
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Minimal assertions for the test executables. A failed check prints its
+// location and the test keeps going; main returns test::result().
+namespace test {
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+inline void fail(const char* file, int line, const std::string& message) {
+    std::cerr << file << ":" << line << ": " << message << std::endl;
+    ++failures();
+}
+
+inline int result() {
+    if (failures() > 0) {
+        std::cerr << failures() << " check(s) failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+template <typename A, typename B>
+void checkEqual(const A& actual, const B& expected, const char* text, const char* file, int line,
+                const std::string& context) {
+    if (!(actual == expected)) {
+        std::ostringstream message;
+        message << text << ": got " << actual << ", expected " << expected;
+        if (!context.empty()) {
+            message << " (" << context << ")";
+        }
+        fail(file, line, message.str());
+    }
+}
+
+} // namespace test
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) test::fail(__FILE__, __LINE__, "CHECK(" #condition ")"); \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) \
+    test::checkEqual((actual), (expected), #actual, __FILE__, __LINE__, std::string())
+
+// As CHECK_EQ, printing `context` (e.g. the input) on failure
+#define CHECK_EQ_FOR(actual, expected, context) \
+    test::checkEqual((actual), (expected), #actual, __FILE__, __LINE__, (context))
@@ -0,0 +1,84 @@
+// Checks that ContextPool recycles contexts, and that a context whose reset
+// throws is dropped when its lease ends instead of escaping the destructor.
+#include "check.h"
+#include "interpreter/context_pool.h"
+#include "interpreter/output.h"
+#include "interpreter/program.h"
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// Throws from flush() once failing is set
+class FailingSink : public basic::OutputSink {
+public:
+    explicit FailingSink(bool* failing) : failing_(failing) {}
+    void write(const char*, size_t) override {}
+    void flush() override {
+        if (*failing_) {
+            throw std::runtime_error("disk full");
+        }
+    }
+
+private:
+    bool* failing_;
+};
+
+void testRecycling() {
+    auto quiet = [](basic::BasicInterpreter& interpreter) {
+        interpreter.setOutputSink(std::make_unique<basic::BufferOutputSink>());
+    };
+    basic::ContextPool pool(basic::Program::compile("10 X = X + 1\n"), quiet, 1);
+    basic::BasicInterpreter* first = nullptr;
+    {
+        auto lease = pool.acquire();
+        first = lease.get();
+        CHECK(lease->execute());
+        CHECK_EQ(pool.idleCount(), 0u);
+    }
+    CHECK_EQ(pool.idleCount(), 1u);
+    {
+        auto lease = pool.acquire();
+        CHECK(lease.get() == first);
+        // Reset on the way back, so X starts from zero again
+        CHECK(lease->execute());
+        CHECK(lease->getVariable("X") == basic::Value{1.0});
+        // Only one is kept idle
+        auto other = pool.acquire();
+        CHECK(other.get() != first);
+    }
+    CHECK_EQ(pool.idleCount(), 1u);
+}
+
+void testFailingReset() {
+    bool failing = false;
+    basic::ContextPool pool(basic::Program::compile("10 PRINT 1\n"), [&](basic::BasicInterpreter& interpreter) {
+        interpreter.setOutputSink(std::make_unique<FailingSink>(&failing));
+    });
+    {
+        auto lease = pool.acquire();
+        CHECK(lease->execute());
+        failing = true;
+    }
+    CHECK_EQ(pool.idleCount(), 0u);
+
+    // Through release() and a move assignment too
+    auto lease = pool.acquire();
+    lease.release();
+    CHECK(!lease);
+    lease = pool.acquire();
+    lease = pool.acquire();
+    CHECK(lease);
+    failing = false;
+    lease.release();
+    CHECK_EQ(pool.idleCount(), 1u);
+}
+
+} // namespace
+
+int main() {
+    testRecycling();
+    testFailingReset();
+    return test::result();
+}
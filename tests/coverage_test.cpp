@@ -0,0 +1,192 @@
+// Checks CoverageMap: what a run records, merging maps of the same program,
+// the saved map format, and the lcov, Cobertura and decoration reports.
+#include "check.h"
+#include "interpreter/basic_interpreter.h"
+#include "interpreter/coverage.h"
+#include "interpreter/output.h"
+#include "interpreter/program.h"
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+const char* kSource = "10 LET X = 1\n"
+                      "20 IF X > 0 THEN PRINT \"pos\"\n"
+                      "30 IF X > 5 THEN PRINT \"big\"\n"
+                      "40 ' note\n"
+                      "50 PRINT X\n";
+
+bool contains(const std::string& text, const std::string& part) { return text.find(part) != std::string::npos; }
+
+std::string lcov(const basic::CoverageMap& map) {
+    std::ostringstream out;
+    map.writeLcov(out, "prog.bas");
+    return out.str();
+}
+
+void run(const std::shared_ptr<const basic::Program>& program, basic::CoverageMap& map) {
+    basic::BasicInterpreter interpreter;
+    interpreter.setOutputSink(std::make_unique<basic::BufferOutputSink>());
+    CHECK(interpreter.loadProgram(program));
+    interpreter.setCoverage(&map);
+    CHECK(interpreter.execute());
+    interpreter.setCoverage(nullptr);
+}
+
+const char* kRunLcov = "TN:\nSF:prog.bas\n"
+                       "BRDA:2,0,0,1\nBRDA:2,0,1,0\nBRDA:3,1,0,0\nBRDA:3,1,1,1\n"
+                       "DA:1,1\nDA:2,1\nDA:3,1\nDA:5,1\n"
+                       "BRF:4\nBRH:2\nLF:4\nLH:4\nend_of_record\n";
+
+void testRecording() {
+    auto program = basic::Program::compile(kSource);
+    basic::CoverageMap empty(*program);
+    // Branches on lines never reached are reported as "-"
+    CHECK_EQ(lcov(empty), "TN:\nSF:prog.bas\n"
+                          "BRDA:2,0,0,-\nBRDA:2,0,1,-\nBRDA:3,1,0,-\nBRDA:3,1,1,-\n"
+                          "DA:1,0\nDA:2,0\nDA:3,0\nDA:5,0\n"
+                          "BRF:4\nBRH:0\nLF:4\nLH:0\nend_of_record\n");
+
+    basic::CoverageMap map(*program);
+    run(program, map);
+    CHECK_EQ(lcov(map), kRunLcov);
+    // Running again changes nothing
+    run(program, map);
+    CHECK_EQ(lcov(map), kRunLcov);
+}
+
+void testMerge() {
+    auto program = basic::Program::compile(kSource);
+    basic::CoverageMap map(*program);
+    run(program, map);
+
+    // A map of the same source compiled separately merges
+    auto again = basic::Program::compile(kSource);
+    CHECK(again != program);
+    basic::CoverageMap other(*again);
+    other.hitLine(0);
+    other.hitBranch(1, true);
+    map.merge(other);
+    CHECK_EQ(lcov(map), "TN:\nSF:prog.bas\n"
+                        "BRDA:2,0,0,1\nBRDA:2,0,1,0\nBRDA:3,1,0,1\nBRDA:3,1,1,1\n"
+                        "DA:1,1\nDA:2,1\nDA:3,1\nDA:5,1\n"
+                        "BRF:4\nBRH:3\nLF:4\nLH:4\nend_of_record\n");
+
+    auto different = basic::Program::compile("10 PRINT 1\n");
+    basic::CoverageMap foreign(*different);
+    bool threw = false;
+    try {
+        map.merge(foreign);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+void testSaveAndLoad() {
+    auto program = basic::Program::compile(kSource);
+    basic::CoverageMap map(*program);
+    run(program, map);
+    std::string path = "coverage_test.cov";
+    CHECK(map.save(path));
+
+    basic::CoverageMap loaded(*program);
+    CHECK(loaded.load(path));
+    CHECK_EQ(lcov(loaded), kRunLcov);
+    // Loading ORs into what the map already has
+    basic::CoverageMap partial(*program);
+    partial.hitBranch(1, true);
+    CHECK(partial.load(path));
+    CHECK(contains(lcov(partial), "BRH:3\n"));
+
+    // Another program's map, a missing file, a cut-off file and a file that
+    // is not a map are all refused and leave the map as it was
+    auto different = basic::Program::compile("10 PRINT 1\n20 PRINT 2\n");
+    basic::CoverageMap foreign(*different);
+    foreign.hitLine(0);
+    CHECK(foreign.save("coverage_test_other.cov"));
+    basic::CoverageMap refused(*program);
+    CHECK(!refused.load("coverage_test_other.cov"));
+    CHECK(!refused.load("coverage_test_missing.cov"));
+
+    std::ifstream in(path, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    for (size_t size : {size_t{0}, size_t{5}, size_t{20}, data.size() - 1}) {
+        std::ofstream(path, std::ios::binary | std::ios::trunc).write(data.data(), static_cast<std::streamsize>(size));
+        CHECK_EQ_FOR(refused.load(path), false, "cut at " + std::to_string(size));
+    }
+    std::string corrupt = data;
+    corrupt[0] = 'X';
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << corrupt;
+    CHECK(!refused.load(path));
+    CHECK_EQ(lcov(refused), lcov(basic::CoverageMap(*program)));
+
+    CHECK(!map.save("no-such-directory/coverage.cov"));
+    std::remove(path.c_str());
+    std::remove("coverage_test_other.cov");
+}
+
+void testReports() {
+    auto program = basic::Program::compile(kSource);
+    basic::CoverageMap map(*program);
+    run(program, map);
+
+    std::ostringstream decorations;
+    map.writeDecorations(decorations, "dir\\\"q\".bas");
+    CHECK_EQ(decorations.str(), "{\"version\":1,\"source\":\"dir\\\\\\\"q\\\".bas\",\"lines\":["
+                                "{\"line\":1,\"state\":\"covered\"},{\"line\":2,\"state\":\"partial\"},"
+                                "{\"line\":3,\"state\":\"partial\"},{\"line\":5,\"state\":\"covered\"}]}\n");
+
+    std::ostringstream cobertura;
+    map.writeCobertura(cobertura, "a&b<c>.bas");
+    std::string xml = cobertura.str();
+    CHECK_EQ_FOR(contains(xml, "<coverage line-rate=\"1.0000\" branch-rate=\"0.5000\" lines-covered=\"4\" "
+                               "lines-valid=\"4\" branches-covered=\"2\" branches-valid=\"4\""),
+                 true, xml);
+    CHECK_EQ_FOR(contains(xml, "filename=\"a&amp;b&lt;c&gt;.bas\""), true, xml);
+    CHECK_EQ_FOR(contains(xml, "<line number=\"2\" hits=\"1\" branch=\"true\" condition-coverage=\"50% (1/2)\"/>"),
+                 true, xml);
+    CHECK_EQ_FOR(contains(xml, "<line number=\"5\" hits=\"1\" branch=\"false\"/>"), true, xml);
+    CHECK_EQ_FOR(contains(xml, "number=\"4\""), false, xml);
+
+    // An empty program is fully covered rather than dividing by zero
+    auto blank = basic::Program::compile("10 ' nothing\n");
+    std::ostringstream none;
+    basic::CoverageMap(*blank).writeCobertura(none, "blank.bas");
+    CHECK_EQ_FOR(contains(none.str(), "line-rate=\"1.0000\" branch-rate=\"1.0000\""), true, none.str());
+}
+
+// IFs replaced by a patch keep their slots but are not reported
+void testPatchedProgram() {
+    auto base = basic::Program::compile(kSource);
+    std::string edited = kSource;
+    edited.replace(edited.find("X > 5"), 5, "X > 6");
+    auto patched = basic::Program::patch(base, edited).program;
+    CHECK_EQ(patched->branchCount(), 3u);
+
+    basic::CoverageMap map(*patched);
+    run(patched, map);
+    CHECK_EQ(lcov(map), "TN:\nSF:prog.bas\n"
+                        "BRDA:2,0,0,1\nBRDA:2,0,1,0\nBRDA:3,2,0,0\nBRDA:3,2,1,1\n"
+                        "DA:1,1\nDA:2,1\nDA:3,1\nDA:5,1\n"
+                        "BRF:4\nBRH:2\nLF:4\nLH:4\nend_of_record\n");
+    std::ostringstream cobertura;
+    map.writeCobertura(cobertura, "prog.bas");
+    CHECK_EQ_FOR(contains(cobertura.str(), "branches-covered=\"2\" branches-valid=\"4\""), true, cobertura.str());
+}
+
+} // namespace
+
+int main() {
+    testRecording();
+    testMerge();
+    testSaveAndLoad();
+    testReports();
+    testPatchedProgram();
+    return test::result();
+}
@@ -0,0 +1,166 @@
+// Checks the DICT hash table against std::unordered_map on random insert,
+// overwrite and erase churn, its growth at the 7/8 load factor, and which
+// keys address the same entry.
+#include "check.h"
+#include "interpreter/dictionary.h"
+#include "interpreter/memory_account.h"
+#include <cmath>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+namespace {
+
+// The model's key: numbers that are whole and fit an int, and booleans, are
+// the same key as that int
+std::string modelKey(const basic::Value& key) {
+    if (const bool* b = std::get_if<bool>(&key)) return "i" + std::to_string(*b ? 1 : 0);
+    if (const int* i = std::get_if<int>(&key)) return "i" + std::to_string(*i);
+    if (const double* d = std::get_if<double>(&key)) {
+        if (*d == std::floor(*d) && *d >= std::numeric_limits<int>::min() && *d <= std::numeric_limits<int>::max()) {
+            return "i" + std::to_string(static_cast<int>(*d));
+        }
+        return "d" + std::to_string(*d);
+    }
+    return "s" + std::get<std::string>(key);
+}
+
+// A small key space, so that sets overwrite and erases hit, written in the
+// different forms of the same key
+basic::Value randomKey(std::mt19937& rng, int range) {
+    int n = static_cast<int>(rng() % static_cast<unsigned>(range));
+    switch (rng() % 6) {
+        case 0: return basic::Value{n};
+        case 1: return basic::Value{static_cast<double>(n)};
+        case 2: return basic::Value{n + 0.5};
+        case 3: return basic::Value{n % 2 == 0};
+        case 4: return basic::Value{"k" + std::to_string(n)};
+        default: return basic::Value{std::to_string(n) + std::string(n % 40, 'x')};
+    }
+}
+
+basic::Value randomValue(std::mt19937& rng) {
+    if (rng() % 3 == 0) return basic::Value{std::string(rng() % 40, 'v')};
+    return basic::Value{static_cast<int>(rng() % 1000)};
+}
+
+void testAgainstModel() {
+    std::mt19937 rng(80);
+    basic::MemoryAccount account;
+    basic::Dictionary dict(&account);
+    std::unordered_map<std::string, basic::Value> model;
+    // Phases of growth, churn at a steady size, and shrinking
+    const int ranges[] = {16, 300, 3000, 3000, 50};
+    for (int phase = 0; phase < 5; ++phase) {
+        int range = ranges[phase];
+        unsigned eraseOdds = phase == 4 ? 2 : (phase == 3 ? 3 : 5);
+        for (int op = 0; op < 20000; ++op) {
+            std::string context = "phase " + std::to_string(phase) + " op " + std::to_string(op);
+            basic::Value key = randomKey(rng, range);
+            std::string k = modelKey(key);
+            if (rng() % eraseOdds == 0) {
+                bool erased = model.erase(k) > 0;
+                CHECK_EQ_FOR(dict.erase(key), erased, context);
+            } else if (rng() % 3 == 0) {
+                const basic::Value* found = dict.find(key);
+                auto it = model.find(k);
+                CHECK_EQ_FOR(found != nullptr, it != model.end(), context);
+                if (found && it != model.end()) CHECK_EQ_FOR(*found == it->second, true, context);
+            } else {
+                basic::Value value = randomValue(rng);
+                dict.set(key, value);
+                model[k] = value;
+            }
+            CHECK_EQ_FOR(dict.size(), model.size(), context);
+        }
+
+        // Every entry is found, and forEach visits each once with its stored key
+        size_t visited = 0;
+        size_t stringBytes = 0;
+        dict.forEach([&](const basic::Value& key, const basic::Value& value) {
+            ++visited;
+            auto it = model.find(modelKey(key));
+            CHECK_EQ_FOR(it != model.end() && it->second == value, true, modelKey(key));
+            CHECK_EQ_FOR(std::holds_alternative<bool>(key), false, modelKey(key));
+            stringBytes += basic::MemoryAccount::heapBytes(key) + basic::MemoryAccount::heapBytes(value);
+        });
+        CHECK_EQ(visited, model.size());
+        // What is left over is the slot table
+        CHECK(account.live() >= stringBytes);
+    }
+
+    dict.clear();
+    CHECK_EQ(dict.size(), 0u);
+    CHECK(dict.find(basic::Value{1}) == nullptr);
+    CHECK_EQ(account.live(), 0u);
+}
+
+// The table doubles when an insert would take it past 7/8 full
+void testGrowth() {
+    basic::MemoryAccount account;
+    basic::Dictionary dict(&account);
+    dict.set(basic::Value{0}, basic::Value{0});
+    size_t slotBytes = account.live() / 8;
+    CHECK(slotBytes > 0 && account.live() % 8 == 0);
+    size_t capacity = 8;
+    for (int n = 2; n <= 5000; ++n) {
+        dict.set(basic::Value{n * 7919}, basic::Value{n});
+        if (static_cast<size_t>(n) * 8 > capacity * 7) capacity *= 2;
+        CHECK_EQ_FOR(account.live(), capacity * slotBytes, "size " + std::to_string(n));
+    }
+    // Overwriting and erasing never resize
+    for (int n = 2; n <= 5000; n += 2) {
+        dict.set(basic::Value{n * 7919}, basic::Value{-n});
+        CHECK(dict.erase(basic::Value{static_cast<double>(n * 7919)}));
+    }
+    CHECK_EQ(account.live(), capacity * slotBytes);
+    CHECK_EQ(dict.size(), 2500u);
+    for (int n = 2; n <= 5000; ++n) {
+        const basic::Value* found = dict.find(basic::Value{n * 7919});
+        CHECK_EQ_FOR(found != nullptr, n % 2 == 1, std::to_string(n));
+    }
+}
+
+void testKeyNormalisation() {
+    basic::Dictionary dict;
+    dict.set(basic::Value{1}, basic::Value{std::string("one")});
+    dict.set(basic::Value{1.0}, basic::Value{std::string("one again")});
+    CHECK_EQ(dict.size(), 1u);
+    CHECK(dict.find(basic::Value{true}) && *dict.find(basic::Value{true}) == basic::Value{std::string("one again")});
+    dict.set(basic::Value{true}, basic::Value{2});
+    CHECK_EQ(dict.size(), 1u);
+    CHECK(*dict.find(basic::Value{1}) == basic::Value{2});
+
+    // 0, -0.0 and FALSE too; 1.5, "1" and 2^31 are keys of their own
+    dict.set(basic::Value{false}, basic::Value{0});
+    CHECK(dict.find(basic::Value{-0.0}) != nullptr);
+    CHECK(dict.find(basic::Value{0}) != nullptr);
+    dict.set(basic::Value{1.5}, basic::Value{3});
+    dict.set(basic::Value{std::string("1")}, basic::Value{4});
+    dict.set(basic::Value{2147483648.0}, basic::Value{5});
+    CHECK_EQ(dict.size(), 5u);
+    CHECK(dict.find(basic::Value{std::numeric_limits<int>::min()}) == nullptr);
+    CHECK(dict.erase(basic::Value{1.0}));
+    CHECK(!dict.erase(basic::Value{true}));
+    CHECK(*dict.find(basic::Value{std::string("1")}) == basic::Value{4});
+
+    bool threw = false;
+    try {
+        dict.set(basic::Value{std::nan("")}, basic::Value{0});
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK_EQ(dict.size(), 4u);
+}
+
+} // namespace
+
+int main() {
+    testAgainstModel();
+    testGrowth();
+    testKeyNormalisation();
+    return test::result();
+}
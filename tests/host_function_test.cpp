@@ -0,0 +1,103 @@
+// Checks typed host functions: argument conversion and errors in
+// makeHostFunction, and that the runtime's per-call-site cache follows
+// rebinding.
+#include "check.h"
+#include "interpreter/basic_interpreter.h"
+#include "interpreter/host_function.h"
+#include "interpreter/output.h"
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string errorOf(const basic::HostFunction& function, const std::vector<basic::Value>& args) {
+    try {
+        function(args);
+    } catch (const std::runtime_error& e) {
+        return e.what();
+    }
+    return "";
+}
+
+void testConversions() {
+    auto total = basic::makeHostFunction("TOTAL", [](double price, int quantity, bool taxed) {
+        return price * quantity * (taxed ? 1.5 : 1.0);
+    });
+    CHECK_EQ(std::get<double>(total({2.5, 4, true})), 15.0);
+    // int truncates; TRUE and FALSE count as 1 and 0
+    CHECK_EQ(std::get<double>(total({2, 3.9, 0})), 6.0);
+    CHECK_EQ(std::get<double>(total({true, 2, false})), 2.0);
+
+    auto label = basic::makeHostFunction("LABEL", [](const std::string& name, float size) {
+        return name + ":" + std::to_string(static_cast<int>(size));
+    });
+    CHECK_EQ(std::get<std::string>(label({std::string("box"), 7.0})), "box:7");
+
+    CHECK_EQ(std::get<int>(basic::makeHostFunction("N", [](int n) { return static_cast<long>(n) * 2; })({21})), 42);
+    CHECK_EQ(std::get<bool>(basic::makeHostFunction("B", [](int n) { return n > 0; })({1})), true);
+    CHECK_EQ(std::get<std::string>(basic::makeHostFunction("S", []() { return "text"; })({})), "text");
+    int calls = 0;
+    CHECK_EQ(std::get<int>(basic::makeHostFunction("V", [&calls](const basic::Value&) { ++calls; })({1.0})), 0);
+    CHECK_EQ(calls, 1);
+    // Untyped callables are used as they are
+    auto count = basic::makeHostFunction("COUNT", [](const std::vector<basic::Value>& args) {
+        return basic::Value{static_cast<int>(args.size())};
+    });
+    CHECK_EQ(std::get<int>(count({1, 2, 3})), 3);
+
+    CHECK_EQ(errorOf(total, {1.0, 2}), "TOTAL function requires exactly 3 arguments");
+    CHECK_EQ(errorOf(label, {std::string("x")}), "LABEL function requires exactly 2 arguments");
+    CHECK_EQ(errorOf(total, {1.0, std::string("2"), true}), "TOTAL argument 2 must be numeric");
+    CHECK_EQ(errorOf(label, {3, 1}), "LABEL argument 1 must be a string");
+}
+
+// A program that calls F from one call site many times
+std::string runCalls(basic::BasicInterpreter& interpreter) {
+    CHECK(interpreter.execute());
+    return std::get<std::string>(interpreter.getVariable("S$"));
+}
+
+void testRebinding() {
+    basic::BasicInterpreter interpreter;
+    interpreter.setOutputSink(std::make_unique<basic::BufferOutputSink>());
+    std::vector<int> seen;
+    interpreter.registerFunction("F", [&seen](int n) {
+        seen.push_back(n);
+        return std::string("a");
+    });
+    CHECK(interpreter.loadProgram("10 S$ = \"\"\n"
+                                  "20 FOR I = 1 TO 5\n"
+                                  "30 S$ = S$ + F(I)\n"
+                                  "40 NEXT I\n"));
+    CHECK_EQ(runCalls(interpreter), "aaaaa");
+    CHECK_EQ(seen.size(), 5u);
+    CHECK(seen.size() == 5 && seen.front() == 1 && seen.back() == 5);
+
+    // The call site resolved F on its first run; the new binding still wins
+    interpreter.registerFunction("F", [](int n) { return std::to_string(n); });
+    CHECK_EQ(runCalls(interpreter), "12345");
+    CHECK_EQ(seen.size(), 5u);
+
+    // Unbinding turns the call into an error rather than a stale call
+    interpreter.bindFunction("F", nullptr);
+    CHECK(!interpreter.execute());
+    CHECK(!interpreter.getLastError().empty());
+
+    bool refused = false;
+    try {
+        interpreter.registerFunction("LEN", [](const std::string&) { return 0; });
+    } catch (const std::runtime_error&) {
+        refused = true;
+    }
+    CHECK(refused);
+}
+
+} // namespace
+
+int main() {
+    testConversions();
+    testRebinding();
+    return test::result();
+}
@@ -0,0 +1,86 @@
+// Checks the protocol layer's JSON strings against nlohmann::json: what
+// appendEscaped writes reads back unchanged, and protocol::parse, which
+// lifts long and NUL-prefixed strings out before the DOM parse, gives the
+// same tree and accepts and rejects the same input.
+#include "check.h"
+#include "protocol/json_string.h"
+#include "protocol/json_writer.h"
+#include <functional>
+#include <random>
+#include <string>
+
+using json = nlohmann::json;
+
+namespace {
+
+// Escapes, control characters, and one- to four-byte UTF-8
+std::string randomText(std::mt19937& rng, size_t length) {
+    static const char* pieces[] = {"a", "\"", "\\", "\n", "\t", "\x01", "\xc3\xa9", "\xe2\x82\xac",
+                                   "\xf0\x9f\x98\x80", " ", "/", "x", "\x1f", "\x7f", "\b", "\f"};
+    std::string text;
+    for (size_t i = 0; i < length; ++i) {
+        text += pieces[rng() % 16];
+    }
+    return text;
+}
+
+void testRoundTrips() {
+    std::mt19937 rng(100);
+    for (int round = 0; round < 3000; ++round) {
+        std::string context = "round " + std::to_string(round);
+        // Every tenth string is long enough for parse() to lift it
+        std::string text = randomText(rng, rng() % (round % 10 == 0 ? 20000 : 200));
+        if (round % 7 == 0) {
+            // Looks like parse()'s own "\u0000<n>" placeholders
+            text = std::string(1, '\0') + std::to_string(round % 3) + text;
+        }
+
+        std::string escaped;
+        protocol::appendEscaped(escaped, text);
+        CHECK_EQ_FOR(json::parse("\"" + escaped + "\"").get<std::string>() == text, true, context);
+        std::string unescaped;
+        CHECK_EQ_FOR(protocol::unescape(escaped, unescaped), true, context);
+        CHECK_EQ_FOR(unescaped == text, true, context);
+        CHECK_EQ_FOR(protocol::serialize(text) == json(text).dump(), true, context);
+
+        json message = {{"method", "textDocument/didOpen"},
+                        {"params", {{"textDocument", {{"text", text}, {"uri", "file:///x"}}},
+                                    {"list", {text, 1, "short", text, std::string(1, '\0')}}}}};
+        // Indented or not, and with non-ASCII written as \u escapes or not
+        std::string dumped = message.dump(round % 2 ? -1 : 2, ' ', round % 3 == 0);
+        CHECK_EQ_FOR(protocol::parse(dumped) == json::parse(dumped), true, context);
+    }
+}
+
+bool rejects(const std::function<json()>& parse) {
+    try {
+        parse();
+    } catch (const json::parse_error&) {
+        return true;
+    }
+    return false;
+}
+
+// Bad escapes, lone surrogates, invalid UTF-8 and raw control characters,
+// inside strings long enough to be lifted
+void testInvalidInput() {
+    std::string padding(protocol::kLiftedStringSize + 10, 'a');
+    const char* bad[] = {"\\x", "\\ud800", "\\udc00x", "\\ud800\\u0041", "\xc3", "\xed\xa0\x80", "\xc0\x80",
+                         "\xf4\x90\x80\x80", "\x01", "\\u12", "\\"};
+    for (const char* piece : bad) {
+        std::string document = "{\"t\":\"" + padding + piece + "\"}";
+        CHECK_EQ_FOR(rejects([&] { return protocol::parse(document); }), true, piece);
+        CHECK_EQ_FOR(rejects([&] { return json::parse(document); }), true, piece);
+    }
+    // A key is never lifted, however long
+    std::string document = "{\"" + padding + "\":\"" + padding + "\"}";
+    CHECK(protocol::parse(document) == json::parse(document));
+}
+
+} // namespace
+
+int main() {
+    testRoundTrips();
+    testInvalidInput();
+    return test::result();
+}
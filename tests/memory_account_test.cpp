@@ -0,0 +1,154 @@
+// Checks MemoryAccount's limit and peak bookkeeping, and that Variables keeps
+// the account equal to what it actually holds, including after a write is
+// refused for going over the limit.
+#include "check.h"
+#include "interpreter/memory_account.h"
+#include "interpreter/variables.h"
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+const std::string kLong(100, 'x'); // past the small-string storage
+
+bool overLimit(const std::function<void()>& write) {
+    try {
+        write();
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+// What variables holds in the account's terms: array storage, which is
+// allocated through it, and the strings stored anywhere
+size_t heldBytes(basic::Variables& variables) {
+    size_t bytes = 0;
+    for (const auto& [name, value] : variables.getAll()) {
+        bytes += basic::MemoryAccount::heapBytes(value);
+    }
+    for (const auto& [name, array] : variables.getAllArrays()) {
+        bytes += array.data.capacity() * sizeof(basic::Value);
+        for (const basic::Value& value : array.data) {
+            bytes += basic::MemoryAccount::heapBytes(value);
+        }
+    }
+    return bytes;
+}
+
+void testAccount() {
+    basic::MemoryAccount account;
+    account.charge(100);
+    account.charge(50);
+    account.release(120);
+    CHECK_EQ(account.live(), 30u);
+    CHECK_EQ(account.peak(), 150u);
+    account.resetPeak();
+    CHECK_EQ(account.peak(), 30u);
+
+    account.setLimit(100);
+    account.charge(70);
+    CHECK_EQ(account.live(), 100u);
+    // A refused charge leaves the counters alone
+    CHECK(overLimit([&] { account.charge(1); }));
+    CHECK_EQ(account.live(), 100u);
+    CHECK_EQ(account.peak(), 100u);
+
+    account.setLimit(basic::MemoryAccount::kUnlimited);
+    account.charge(1000);
+    CHECK_EQ(account.live(), 1100u);
+    // Releasing more than is live stops at zero
+    account.release(5000);
+    CHECK_EQ(account.live(), 0u);
+}
+
+void testAllocations() {
+    basic::MemoryAccount account;
+    {
+        std::pmr::vector<double> values(&account);
+        values.reserve(64);
+        CHECK_EQ(account.live(), 64 * sizeof(double));
+        account.setLimit(account.live() + 8);
+        CHECK(overLimit([&] { values.reserve(128); }));
+        CHECK_EQ(values.capacity(), 64u);
+        CHECK_EQ(account.live(), 64 * sizeof(double));
+    }
+    CHECK_EQ(account.live(), 0u);
+}
+
+void testScalars() {
+    basic::MemoryAccount account;
+    basic::Variables variables(&account);
+    variables.set("A$", std::string("short"));
+    CHECK_EQ(account.live(), 0u);
+    variables.set("A$", kLong);
+    CHECK_EQ(account.live(), heldBytes(variables));
+    CHECK(account.live() > 0);
+    variables.set("A$", 1.0);
+    CHECK_EQ(account.live(), 0u);
+
+    variables.set("A$", kLong);
+    account.setLimit(account.live() + 10);
+    CHECK(overLimit([&] { variables.set("B$", kLong); }));
+    CHECK(!variables.exists("B$"));
+    CHECK_EQ(account.live(), heldBytes(variables));
+    variables.clear();
+    CHECK_EQ(account.live(), 0u);
+}
+
+void testArrays() {
+    basic::MemoryAccount account;
+    basic::Variables variables(&account);
+    variables.dim("A", {9});
+    CHECK_EQ(account.live(), heldBytes(variables));
+    variables.setElement("A", {3}, kLong);
+    CHECK_EQ(account.live(), heldBytes(variables));
+
+    account.setLimit(account.live() + 10);
+    CHECK(overLimit([&] { variables.setElement("A", {4}, kLong); }));
+    CHECK_EQ(std::get<int>(variables.getElement("A", {4})), 0);
+    CHECK_EQ(account.live(), heldBytes(variables));
+}
+
+// Bulk writers store first and recount afterwards
+void testRecount() {
+    basic::MemoryAccount account;
+    basic::Variables variables(&account);
+    basic::Array& array = variables.getOrCreateArray("F");
+    array.dims = {4};
+    array.data.assign(4, kLong);
+    variables.recount(array);
+    CHECK_EQ(account.live(), heldBytes(variables));
+
+    // Shrinking only releases
+    account.setLimit(account.live());
+    array.data[0] = std::string("x");
+    variables.recount(array);
+    CHECK_EQ(account.live(), heldBytes(variables));
+
+    // Over the limit the stored strings are dropped, not left uncharged.
+    // The limit leaves room for the bigger storage but not its strings.
+    account.setLimit(account.live() + 8 * sizeof(basic::Value) + 50);
+    array.dims = {8};
+    array.data.resize(8, kLong);
+    CHECK(overLimit([&] { variables.recount(array); }));
+    CHECK_EQ(account.live(), heldBytes(variables));
+    CHECK_EQ(array.stringBytes, 0u);
+
+    account.setLimit(basic::MemoryAccount::kUnlimited);
+    variables.clear();
+    CHECK_EQ(account.live(), 0u);
+}
+
+} // namespace
+
+int main() {
+    testAccount();
+    testAllocations();
+    testScalars();
+    testArrays();
+    testRecount();
+    return test::result();
+}
@@ -0,0 +1,76 @@
+// Checks Program::nextStatementLine, which moves breakpoints on blank,
+// comment and unparsable lines to the next statement, against a scan of the
+// compiled lines, for compiled and patched programs.
+#include "check.h"
+#include "interpreter/program.h"
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// 1-based line of the first statement at or after line, 0 when none follows
+int referenceNextStatement(const basic::Program& program, int line) {
+    for (int i = std::max(line, 1); i <= static_cast<int>(program.size()); ++i) {
+        if (program.lines()[static_cast<size_t>(i) - 1].statement) return i;
+    }
+    return 0;
+}
+
+void checkAllLines(const basic::Program& program, const std::string& context) {
+    for (int line = -1; line <= static_cast<int>(program.size()) + 2; ++line) {
+        CHECK_EQ_FOR(program.nextStatementLine(line), referenceNextStatement(program, line),
+                     context + " line " + std::to_string(line));
+    }
+}
+
+std::string randomSource(std::mt19937& rng, size_t lines) {
+    static const char* kinds[] = {"PRINT 1", "LET A = 2", "", "' comment", "   ", "LET", "INCLUDE \"x.bas\""};
+    std::string source;
+    for (size_t i = 0; i < lines; ++i) {
+        source += std::to_string((i + 1) * 10) + " " + kinds[rng() % 7] + "\n";
+    }
+    return source;
+}
+
+void testExample() {
+    auto program = basic::Program::compile("10 ' setup\n"
+                                           "20 LET A = 1\n"
+                                           "\n"
+                                           "30 ' loop\n"
+                                           "40 PRINT A\n"
+                                           "50 ' done\n");
+    CHECK_EQ(program->nextStatementLine(1), 2);
+    CHECK_EQ(program->nextStatementLine(2), 2);
+    CHECK_EQ(program->nextStatementLine(3), 5);
+    CHECK_EQ(program->nextStatementLine(5), 5);
+    CHECK_EQ(program->nextStatementLine(6), 0);
+    CHECK_EQ(program->nextStatementLine(100), 0);
+
+    auto comments = basic::Program::compile("10 ' only\n20 ' comments\n");
+    CHECK_EQ(comments->nextStatementLine(1), 0);
+    auto empty = basic::Program::compile("");
+    CHECK_EQ(empty->nextStatementLine(1), 0);
+}
+
+void testRandomPrograms() {
+    std::mt19937 rng(96);
+    for (int trial = 0; trial < 300; ++trial) {
+        auto program = basic::Program::compile(randomSource(rng, rng() % 30));
+        checkAllLines(*program, "trial " + std::to_string(trial));
+
+        // The index is rebuilt for patched programs, which mix reused lines
+        // with newly compiled ones
+        auto patch = basic::Program::patch(program, randomSource(rng, rng() % 30));
+        checkAllLines(*patch.program, "patched trial " + std::to_string(trial));
+    }
+}
+
+} // namespace
+
+int main() {
+    testExample();
+    testRandomPrograms();
+    return test::result();
+}
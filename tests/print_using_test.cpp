@@ -0,0 +1,147 @@
+// Checks PRINT USING templates: how formats compile into fields and
+// literals, and what the digit writer produces for each kind of field.
+#include "check.h"
+#include "interpreter/print_using.h"
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string format(const std::string& format, const std::vector<basic::Value>& values) {
+    std::string out;
+    basic::PrintUsingTemplate(format).apply(values, out);
+    return out;
+}
+
+std::string number(const std::string& field, double value) { return format(field, {value}); }
+
+void checkNumber(const std::string& field, double value, const std::string& expected) {
+    CHECK_EQ_FOR(number(field, value), expected, field + " " + std::to_string(value));
+}
+
+void testDigits() {
+    checkNumber("###", 5, "  5");
+    checkNumber("###", 0, "  0");
+    checkNumber("#.##", 3.14159, "3.14");
+    checkNumber("#.##", 2.005, "2.01");
+    checkNumber("###.##", -1.5, " -1.50");
+    checkNumber(".##", 0.5, ".50");
+    // The sign takes the only digit position rather than a leading 0
+    checkNumber("#.##", -0.5, "-.50");
+    checkNumber("##.##", -0.5, "-0.50");
+    checkNumber("#.#", -0.04, "0.0");
+    checkNumber("#####", 2.5, "    3");
+}
+
+void testOverflow() {
+    checkNumber("##", 123, "%123");
+    checkNumber("#.#", -12.25, "%-12.3");
+    checkNumber("$$#", 1000, "%$1000");
+    // Beyond the integer digit writer, still printed in full
+    checkNumber("##.##", 1e20, "%100000000000000000000.00");
+}
+
+void testCommas() {
+    checkNumber("#,###,###", 1234567, "1,234,567");
+    checkNumber("#,###,###", 1234, "    1,234");
+    checkNumber("##,###.##", -98765.4321, "%-98,765.43");
+    checkNumber("###,###.##", -98765.4321, "-98,765.43");
+    // A comma at the end of the field is a literal
+    CHECK_EQ(format("###, ###", {1, 2}), "  1,   2");
+}
+
+void testSigns() {
+    checkNumber("+###", 42, " +42");
+    checkNumber("+###", -42, " -42");
+    checkNumber("###+", 42, " 42+");
+    checkNumber("###+", -42, " 42-");
+    checkNumber("###-", 42, " 42 ");
+    checkNumber("###-", -42, " 42-");
+    checkNumber("+.##", 0.25, "+.25");
+    // -0.001 rounds to zero and loses its sign
+    checkNumber("+#.##", -0.001, "+0.00");
+}
+
+void testDollarAndAsterisks() {
+    checkNumber("$$###.##", 12.5, "  $12.50");
+    checkNumber("$$###.##", -12.5, " -$12.50");
+    checkNumber("**###", 42, "***42");
+    checkNumber("**#.##", 1.5, "**1.50");
+    checkNumber("**$##.##", 7.25, "***$7.25");
+    checkNumber("**$#,###.##", 1234.5, "**$1,234.50");
+    checkNumber("+$$##", 5, "  +$5");
+}
+
+void testExponent() {
+    checkNumber("##.##^^^^", 234.56, " 2.35E+02");
+    checkNumber("##.##^^^^", -234.56, "-2.35E+02");
+    checkNumber("##.##^^^^", 0, " 0.00E+00");
+    checkNumber("##.##^^^^", 0.000123, " 1.23E-04");
+    checkNumber("###.#^^^^", 12345, " 12.3E+03");
+    checkNumber(".####^^^^-", -888888, ".8889E+06-");
+    checkNumber(".####^^^^-", 888888, ".8889E+06 ");
+    checkNumber("+.##^^^^", 123, "+.12E+03");
+    checkNumber("+#.##^^^^", -9.999, "-1.00E+01");
+    checkNumber("#.##^^^^", 12345, " .12E+05");
+    checkNumber("##.##^^^^^", 1e150, " 1.00E+150");
+    // An exponent too long for the field overflows like a long number
+    checkNumber("##.##^^^^", 1e150, "%1.00E+150");
+    // Three carets are literal text
+    CHECK_EQ(format("#.#^^^", {1.5}), "1.5^^^");
+    CHECK_EQ(format("##^^^^ ##", {3, 4}), " 3E+00  4");
+}
+
+void testStrings() {
+    CHECK_EQ(format("!", {std::string("Hello")}), "H");
+    CHECK_EQ(format("!", {std::string("")}), " ");
+    CHECK_EQ(format("&", {std::string("Hello")}), "Hello");
+    CHECK_EQ(format("\\\\", {std::string("Hello")}), "He");
+    CHECK_EQ(format("\\  \\|", {std::string("Hello")}), "Hell|");
+    CHECK_EQ(format("\\  \\|", {std::string("Hi")}), "Hi  |");
+    // A lone backslash is literal
+    CHECK_EQ(format("\\ x &", {std::string("y")}), "\\ x y");
+}
+
+void testTemplates() {
+    // Literals, _ escapes, and fields reused while values remain
+    CHECK_EQ(format("Total: $$##.## _& done", {12.5}), "Total:  $12.50 & done");
+    CHECK_EQ(format("_#### ", {7, 8}), "#  7 #  8 ");
+    CHECK_EQ(format("[##]", {1, 2, 3}), "[ 1][ 2][ 3]");
+    CHECK_EQ(format("& is ###", {std::string("x"), 1, std::string("y")}), "x is   1y is ");
+    // Output stops at the first field after the values run out
+    CHECK_EQ(format("A ## B ## C", {5}), "A  5 B ");
+    CHECK_EQ(format("no fields", {1, 2}), "no fields");
+    CHECK_EQ(format("## trailing_", {1}), " 1 trailing_");
+    CHECK_EQ(format("$5 and #", {9}), "$5 and 9");
+    // ** alone is a field of two digit positions
+    CHECK_EQ(format("**x ##", {1, 2}), "*1x  2");
+    // Booleans print as numbers
+    CHECK_EQ(format("##", {true}), " 1");
+
+    const char* mismatches[][2] = {{"##", "s"}, {"&", ""}};
+    for (const auto& mismatch : mismatches) {
+        bool threw = false;
+        try {
+            basic::Value value = mismatch[1][0] == 's' ? basic::Value{std::string("s")} : basic::Value{1};
+            format(mismatch[0], {value});
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        CHECK_EQ_FOR(threw, true, mismatch[0]);
+    }
+}
+
+} // namespace
+
+int main() {
+    testDigits();
+    testOverflow();
+    testCommas();
+    testSigns();
+    testDollarAndAsterisks();
+    testExponent();
+    testStrings();
+    testTemplates();
+    return test::result();
+}
@@ -0,0 +1,102 @@
+// Checks that ProgramCache hands out one Program per source text, for
+// interpreters and concurrent callers alike, and lets it go with its last user.
+#include "check.h"
+#include "interpreter/basic_interpreter.h"
+#include "interpreter/program.h"
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const std::string kSource = "10 LET X = 1\n20 PRINT X\n";
+
+void testSharing() {
+    basic::ProgramCache cache;
+    auto first = cache.get(kSource);
+    auto second = cache.get(kSource);
+    CHECK(first == second);
+    CHECK_EQ(first->source(), kSource);
+    CHECK_EQ(cache.size(), 1u);
+
+    auto other = cache.get(kSource + "30 PRINT 2\n");
+    CHECK(other != first);
+    CHECK_EQ(cache.size(), 2u);
+}
+
+void testExpiry() {
+    basic::ProgramCache cache;
+    auto program = cache.get(kSource);
+    std::weak_ptr<const basic::Program> watch = program;
+    program.reset();
+    // The cache holds programs weakly, so nothing keeps this one alive
+    CHECK(watch.expired());
+    CHECK_EQ(cache.size(), 0u);
+
+    auto again = cache.get(kSource);
+    CHECK_EQ(again->source(), kSource);
+    CHECK_EQ(cache.size(), 1u);
+    cache.clear();
+    CHECK_EQ(cache.size(), 0u);
+    // clear() only forgets the entry; the program stays valid for its users
+    CHECK_EQ(again->lines().size(), 2u);
+}
+
+// Past the sweep threshold, expired entries are dropped as new ones arrive
+void testSweep() {
+    basic::ProgramCache cache;
+    for (int i = 0; i < 1000; ++i) {
+        cache.get("10 PRINT " + std::to_string(i) + "\n");
+    }
+    CHECK_EQ(cache.size(), 0u);
+}
+
+void testInterpreters() {
+    basic::ProgramCache::shared().clear();
+    std::vector<std::unique_ptr<basic::BasicInterpreter>> interpreters;
+    for (int i = 0; i < 8; ++i) {
+        interpreters.push_back(std::make_unique<basic::BasicInterpreter>());
+        CHECK(interpreters.back()->loadProgram(kSource));
+    }
+    for (const auto& interpreter : interpreters) {
+        CHECK(interpreter->getProgram() == interpreters.front()->getProgram());
+    }
+    CHECK_EQ(basic::ProgramCache::shared().size(), 1u);
+
+    interpreters.clear();
+    CHECK_EQ(basic::ProgramCache::shared().size(), 0u);
+}
+
+// Threads racing to compile the same source all end up with one copy
+void testConcurrentGet() {
+    basic::ProgramCache cache;
+    std::string source;
+    for (int i = 1; i <= 200; ++i) {
+        source += std::to_string(i * 10) + " LET X = X + " + std::to_string(i) + "\n";
+    }
+    const size_t threadCount = 8;
+    std::vector<std::shared_ptr<const basic::Program>> programs(threadCount);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t] { programs[t] = cache.get(source); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (const auto& program : programs) {
+        CHECK(program == programs.front());
+    }
+    CHECK_EQ(cache.size(), 1u);
+}
+
+} // namespace
+
+int main() {
+    testSharing();
+    testExpiry();
+    testSweep();
+    testInterpreters();
+    testConcurrentGet();
+    return test::result();
+}
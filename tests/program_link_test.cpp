@@ -0,0 +1,122 @@
+// Checks Program::link: how INCLUDE lines are flattened and located, and the
+// errors for missing files, include cycles and modules that do not load.
+#include "check.h"
+#include "interpreter/program.h"
+#include <map>
+#include <optional>
+#include <string>
+
+namespace {
+
+using Files = std::map<std::string, std::string>;
+
+basic::Program::ModuleLoader loader(const Files& files) {
+    return [&files](const std::string& path) -> std::optional<std::string> {
+        auto it = files.find(path);
+        if (it == files.end()) return std::nullopt;
+        return it->second;
+    };
+}
+
+bool contains(const std::string& text, const std::string& part) { return text.find(part) != std::string::npos; }
+
+void testFlatten() {
+    Files files = {
+        {"src/main.bas", "10 INCLUDE \"lib/util.bas\"\n20 PRINT A\n30 INCLUDE \"lib/util.bas\"\n"},
+        {"src/lib/util.bas", "10 LET A = 1\n20 INCLUDE \"../consts.bas\"\n"},
+        {"src/consts.bas", "10 LET B = 2\n"},
+    };
+    auto program = basic::Program::link("src/main.bas", loader(files));
+    CHECK_EQ(program->error(), "");
+    CHECK_EQ(program->modules().size(), 3u);
+    CHECK_EQ(program->modules()[0].path, "src/main.bas");
+    CHECK_EQ(program->moduleIndex("src/lib/util.bas"), 1);
+    CHECK_EQ(program->moduleIndex("src/consts.bas"), 2);
+    CHECK_EQ(program->moduleIndex("src/other.bas"), -1);
+
+    // main 10, util 10-20, consts 10, main 20, main 30, util 10-20, consts 10
+    const int modules[] = {0, 1, 1, 2, 0, 0, 1, 1, 2};
+    const int lines[] = {1, 1, 2, 1, 2, 3, 1, 2, 1};
+    CHECK_EQ(program->size(), 9u);
+    for (int i = 0; i < 9; ++i) {
+        basic::Program::Location location = program->location(i + 1);
+        CHECK_EQ_FOR(location.module, static_cast<size_t>(modules[i]), "line " + std::to_string(i + 1));
+        CHECK_EQ_FOR(location.line, lines[i], "line " + std::to_string(i + 1));
+        // INCLUDE lines are kept, as lines with nothing to run
+        CHECK_EQ_FOR(program->lines()[static_cast<size_t>(i)].include, std::string(), "line " + std::to_string(i + 1));
+    }
+    // A module included twice answers for both copies
+    auto copies = program->linesOf(1, 1);
+    CHECK_EQ(copies.size(), 2u);
+    CHECK(copies.size() == 2 && copies[0] == 2 && copies[1] == 7);
+    // The modules are shared with the cache, like any compiled file
+    CHECK(program->modules()[2].program == basic::ProgramCache::shared().get(files["src/consts.bas"]));
+}
+
+void testSingleFile() {
+    Files files = {{"main.bas", "10 PRINT 1\n"}};
+    auto program = basic::Program::link("main.bas", loader(files));
+    CHECK_EQ(program->error(), "");
+    CHECK(program->modules().empty());
+    CHECK(program == basic::ProgramCache::shared().get(files["main.bas"]));
+    CHECK_EQ(program->location(1).line, 1);
+    CHECK_EQ(program->linesOf(0, 1).size(), 1u);
+}
+
+void testMissingFiles() {
+    Files files = {{"main.bas", "10 PRINT 1\n20 INCLUDE \"gone.bas\"\n"}};
+    auto program = basic::Program::link("main.bas", loader(files));
+    CHECK_EQ(program->error(), "Cannot read gone.bas (included at line 2 of main.bas)");
+    CHECK(program->empty());
+
+    program = basic::Program::link("absent.bas", loader(files));
+    CHECK_EQ(program->error(), "Cannot read absent.bas");
+}
+
+void testCycles() {
+    Files self = {{"a.bas", "10 INCLUDE \"a.bas\"\n"}};
+    auto program = basic::Program::link("a.bas", loader(self));
+    CHECK_EQ(program->error(), "INCLUDE cycle: a.bas -> a.bas");
+    CHECK(program->empty());
+
+    Files ring = {
+        {"a.bas", "10 PRINT 1\n20 INCLUDE \"b.bas\"\n"},
+        {"b.bas", "10 INCLUDE \"c.bas\"\n"},
+        {"c.bas", "10 INCLUDE \"a.bas\"\n"},
+    };
+    program = basic::Program::link("a.bas", loader(ring));
+    CHECK_EQ(program->error(), "INCLUDE cycle: a.bas -> b.bas -> c.bas -> a.bas");
+    CHECK(program->empty());
+
+    // Including one file from two places is not a cycle
+    Files diamond = {
+        {"a.bas", "10 INCLUDE \"b.bas\"\n20 INCLUDE \"c.bas\"\n"},
+        {"b.bas", "10 INCLUDE \"d.bas\"\n"},
+        {"c.bas", "10 INCLUDE \"d.bas\"\n"},
+        {"d.bas", "10 PRINT 4\n"},
+    };
+    program = basic::Program::link("a.bas", loader(diamond));
+    CHECK_EQ(program->error(), "");
+    CHECK_EQ(program->size(), 6u);
+}
+
+void testModuleErrors() {
+    Files files = {
+        {"main.bas", "10 INCLUDE \"bad.bas\"\n"},
+        {"bad.bas", "10 PRINT 1\n20 PRINT @\n"},
+    };
+    auto program = basic::Program::link("main.bas", loader(files));
+    CHECK_EQ_FOR(contains(program->error(), "bad.bas: "), true, program->error());
+    CHECK_EQ_FOR(contains(program->error(), "Unknown character: @"), true, program->error());
+}
+
+} // namespace
+
+int main() {
+    testFlatten();
+    testSingleFile();
+    testMissingFiles();
+    testCycles();
+    testModuleErrors();
+    return test::result();
+}
@@ -0,0 +1,201 @@
+// Checks Program::patch's line diff against a longest-common-subsequence
+// reference on random edits, and the edits BasicInterpreter::patchProgram
+// turns down.
+#include "check.h"
+#include "interpreter/basic_interpreter.h"
+#include "interpreter/coverage.h"
+#include "interpreter/output.h"
+#include "interpreter/program.h"
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string join(const std::vector<std::string>& lines) {
+    std::string source;
+    for (const std::string& line : lines) source += line + "\n";
+    return source;
+}
+
+size_t lcsLength(const std::vector<std::string>& a, const std::vector<std::string>& b) {
+    std::vector<std::vector<size_t>> table(a.size() + 1, std::vector<size_t>(b.size() + 1, 0));
+    for (size_t i = 1; i <= a.size(); ++i) {
+        for (size_t j = 1; j <= b.size(); ++j) {
+            table[i][j] = a[i - 1] == b[j - 1] ? table[i - 1][j - 1] + 1
+                                               : std::max(table[i - 1][j], table[i][j - 1]);
+        }
+    }
+    return table[a.size()][b.size()];
+}
+
+// Few distinct statements, so that repeated lines make the diff ambiguous
+std::string randomLine(std::mt19937& rng) {
+    static const char* statements[] = {"LET A = 1", "LET B = A + 1", "PRINT A", "PRINT \"x\"", "' note", ""};
+    return statements[rng() % 6];
+}
+
+void checkPatch(const std::vector<std::string>& before, const std::vector<std::string>& after,
+                const std::string& context) {
+    auto base = basic::Program::compile(join(before));
+    basic::Program::Patch patch = basic::Program::patch(base, join(after));
+    CHECK_EQ_FOR(patch.program->size(), after.size(), context);
+    CHECK_EQ_FOR(patch.lineMap.size(), before.size(), context);
+
+    // Kept lines are in order, unchanged and share base's AST; every other
+    // line of the new program is compiled
+    std::vector<bool> kept(after.size(), false);
+    int last = -1;
+    size_t matched = 0;
+    for (size_t i = 0; i < before.size(); ++i) {
+        int to = patch.lineMap[i];
+        CHECK_EQ_FOR(patch.mapLine(static_cast<int>(i)), to, context);
+        if (to < 0) continue;
+        CHECK_EQ_FOR(to > last, true, context);
+        last = to;
+        ++matched;
+        kept[static_cast<size_t>(to)] = true;
+        CHECK_EQ_FOR(after[static_cast<size_t>(to)], before[i], context);
+        CHECK_EQ_FOR(patch.program->lines()[static_cast<size_t>(to)].statement == base->lines()[i].statement,
+                     true, context);
+    }
+    CHECK_EQ_FOR(matched, lcsLength(before, after), context);
+    std::vector<size_t> compiled;
+    for (size_t i = 0; i < after.size(); ++i) {
+        if (!kept[i]) compiled.push_back(i);
+    }
+    CHECK_EQ_FOR(patch.compiled == compiled, true, context);
+}
+
+void testRandomEdits() {
+    std::mt19937 rng(91);
+    for (int trial = 0; trial < 2000; ++trial) {
+        std::vector<std::string> before(rng() % 40);
+        for (std::string& line : before) line = randomLine(rng);
+        std::vector<std::string> after = before;
+        int edits = 1 + static_cast<int>(rng() % 8);
+        for (int e = 0; e < edits; ++e) {
+            size_t at = after.empty() ? 0 : rng() % (after.size() + 1);
+            switch (rng() % 3) {
+                case 0:
+                    after.insert(after.begin() + static_cast<long>(at), randomLine(rng));
+                    break;
+                case 1:
+                    if (at < after.size()) after.erase(after.begin() + static_cast<long>(at));
+                    break;
+                default:
+                    if (at < after.size()) after[at] = randomLine(rng);
+                    break;
+            }
+        }
+        checkPatch(before, after, "trial " + std::to_string(trial));
+    }
+}
+
+void testSimpleEdits() {
+    std::vector<std::string> lines = {"10 LET A = 1", "20 LET B = 2", "30 PRINT A", "40 PRINT B"};
+    checkPatch(lines, lines, "unchanged");
+    checkPatch(lines, {}, "emptied");
+    checkPatch({}, lines, "from empty");
+
+    std::vector<std::string> edited = lines;
+    edited[1] = "20 LET B = 3";
+    auto base = basic::Program::compile(join(lines));
+    auto patch = basic::Program::patch(base, join(edited));
+    CHECK_EQ(patch.compiled.size(), 1u);
+    CHECK_EQ(patch.compiled[0], 1u);
+    CHECK_EQ(patch.lineMap[1], -1);
+    // Past the end of base, lines shift by the change in length
+    edited.insert(edited.begin(), "5 PRINT 0");
+    patch = basic::Program::patch(base, join(edited));
+    CHECK_EQ(patch.mapLine(4), 5);
+    CHECK_EQ(patch.mapLine(-1), -1);
+}
+
+// Each save in the debugger patches the previous patch's result, whose
+// replaced IF slots are already retired
+void testChainedPatches() {
+    std::shared_ptr<const basic::Program> program =
+        basic::Program::compile("10 LET X = 1\n20 IF X > 0 THEN PRINT X\n30 LET Y = 2\n");
+    CHECK_EQ(program->branchCount(), 1u);
+    const char* edits[] = {
+        "10 LET X = 1\n20 IF X > 5 THEN PRINT X\n30 LET Y = 2\n",
+        "10 LET X = 1\n20 IF X > 6 THEN PRINT X\n30 LET Y = 2\n",
+        "5 PRINT 0\n10 LET X = 1\n20 IF X > 6 THEN PRINT X\n30 LET Y = 2\n",
+        "5 PRINT 0\n10 LET X = 1\n30 LET Y = 2\n",
+    };
+    const std::vector<std::vector<int>> slots = {{0, 2}, {0, 0, 2}, {0, 0, 3}, {0, 0, 0}};
+    for (size_t i = 0; i < 4; ++i) {
+        program = basic::Program::patch(program, edits[i]).program;
+        std::vector<int> lines;
+        for (size_t slot = 0; slot < program->branchCount(); ++slot) lines.push_back(program->branchLine(slot));
+        CHECK_EQ_FOR(lines == slots[i], true, edits[i]);
+    }
+
+    basic::BasicInterpreter interpreter;
+    auto* sink = new basic::BufferOutputSink();
+    interpreter.setOutputSink(std::unique_ptr<basic::OutputSink>(sink));
+    CHECK(interpreter.loadProgram("10 LET X = 7\n20 IF X > 0 THEN PRINT X\n"));
+    CHECK(interpreter.patchProgram("10 LET X = 7\n20 IF X > 5 THEN PRINT X\n"));
+    CHECK(interpreter.patchProgram("10 LET X = 7\n20 IF X > 9 THEN PRINT X\n"));
+    CHECK(interpreter.patchProgram("10 LET X = 7\n20 IF X > 6 THEN PRINT X + 1\n"));
+    CHECK(interpreter.execute());
+    CHECK_EQ(sink->contents(), "8\n");
+}
+
+std::string patchError(const std::string& source, const std::string& edited, bool run = true,
+                       bool coverage = false) {
+    basic::BasicInterpreter interpreter;
+    interpreter.setOutputSink(std::make_unique<basic::BufferOutputSink>());
+    if (!interpreter.loadProgram(source)) return "load failed: " + interpreter.getLastError();
+    std::unique_ptr<basic::CoverageMap> map;
+    if (coverage) {
+        map = std::make_unique<basic::CoverageMap>(*interpreter.getProgram());
+        interpreter.setCoverage(map.get());
+    }
+    if (run) interpreter.execute();
+    return interpreter.patchProgram(edited) ? "" : interpreter.getLastError();
+}
+
+bool contains(const std::string& text, const std::string& part) { return text.find(part) != std::string::npos; }
+
+void testRejections() {
+    const std::string source = "10 PRINT 1\n20 FOR I = 1 TO 3\n30 PRINT I\n40 NEXT I\n";
+    CHECK_EQ(patchError(source, "10 PRINT 2\n20 FOR I = 1 TO 3\n30 PRINT I\n40 NEXT I\n"), "");
+
+    basic::BasicInterpreter empty;
+    CHECK(!empty.patchProgram(source));
+    CHECK_EQ(empty.getLastError(), "No program loaded");
+
+    std::string error = patchError(source, "10 PRINT 1\n20 FOR I = 1 TO 3\n30 LET\n40 NEXT I\n");
+    CHECK_EQ_FOR(contains(error, "Line 3: Failed to parse line"), true, error);
+
+    error = patchError(source, "10 INCLUDE \"other.bas\"\n20 FOR I = 1 TO 3\n30 PRINT I\n40 NEXT I\n");
+    CHECK_EQ_FOR(contains(error, "Line 1: INCLUDE takes effect on restart"), true, error);
+
+    error = patchError(source, "10 PRINT 1\n20 FOR I = 1 TO 3\n30 PRINT I\n");
+    CHECK_EQ_FOR(contains(error, "changes the FOR/NEXT structure"), true, error);
+    error = patchError(source, source + "50 FOR J = 1 TO 2\n60 NEXT J\n");
+    CHECK_EQ_FOR(contains(error, "Line 5: the edit changes the FOR/NEXT structure"), true, error);
+
+    error = patchError(source, "10 PRINT 2\n" + source.substr(source.find('\n') + 1), false, true);
+    CHECK_EQ_FOR(contains(error, "coverage or a trace is being recorded"), true, error);
+
+    // END leaves the loop open, so its FOR line may no longer be rewritten
+    const std::string stopped = "10 PRINT 1\n20 FOR I = 1 TO 3\n30 END\n40 NEXT I\n";
+    error = patchError(stopped, "10 PRINT 1\n20 FOR I = 1 TO 5\n30 END\n40 NEXT I\n");
+    CHECK_EQ_FOR(contains(error, "FOR I is running"), true, error);
+    CHECK_EQ(patchError(stopped, "10 PRINT 2\n20 FOR I = 1 TO 3\n30 END\n40 NEXT I\n"), "");
+}
+
+} // namespace
+
+int main() {
+    testRandomEdits();
+    testSimpleEdits();
+    testChainedPatches();
+    testRejections();
+    return test::result();
+}
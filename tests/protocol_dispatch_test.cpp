@@ -0,0 +1,80 @@
+// Checks the generated name lookups of the LSP and DAP dispatch tables: every
+// name in protocol/*.protocol maps to its own enum value, in schema order,
+// and near misses map to UNKNOWN.
+#include "check.h"
+#include "protocol/dap_protocol.h"
+#include "protocol/lsp_protocol.h"
+#include <fstream>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Names under each "dispatch Enum" heading of a schema
+std::map<std::string, std::vector<std::string>> dispatchTables(const std::string& path) {
+    std::map<std::string, std::vector<std::string>> tables;
+    std::ifstream in(path);
+    CHECK_EQ_FOR(in.good(), true, path);
+    std::string line;
+    std::vector<std::string>* current = nullptr;
+    while (std::getline(in, line)) {
+        if (line.rfind("dispatch ", 0) == 0) {
+            current = &tables[line.substr(9)];
+        } else if (line.empty() || line[0] != ' ') {
+            current = nullptr;
+        } else if (current) {
+            current->push_back(line.substr(line.find_first_not_of(' ')));
+        }
+    }
+    return tables;
+}
+
+// Variations on a name that must not be found
+std::vector<std::string> nearMisses(const std::string& name) {
+    std::vector<std::string> misses = {name + "x", name.substr(1), name.substr(0, name.size() - 1), " " + name,
+                                       name + '\0'};
+    for (size_t i = 0; i < name.size(); ++i) {
+        std::string changed = name;
+        changed[i] = static_cast<char>(changed[i] ^ 0x20);
+        misses.push_back(changed);
+    }
+    return misses;
+}
+
+template <typename Enum>
+void checkTable(const std::vector<std::string>& names, const std::function<Enum(std::string_view)>& lookup,
+                const std::string& table) {
+    CHECK_EQ_FOR(names.empty(), false, table);
+    std::set<std::string> known(names.begin(), names.end());
+    for (size_t i = 0; i < names.size(); ++i) {
+        // The enum lists UNKNOWN first, then the names in schema order
+        CHECK_EQ_FOR(static_cast<size_t>(lookup(names[i])), i + 1, table + " " + names[i]);
+        for (const std::string& miss : nearMisses(names[i])) {
+            if (known.count(miss)) continue;
+            CHECK_EQ_FOR(static_cast<size_t>(lookup(miss)), 0u, table + " \"" + miss + "\"");
+        }
+    }
+    CHECK(lookup("") == Enum::UNKNOWN);
+    CHECK(lookup("$/cancelRequest") == Enum::UNKNOWN);
+}
+
+} // namespace
+
+int main() {
+    auto lsp = dispatchTables(BASIC_PROTOCOL_DIR "/lsp.protocol");
+    auto dap = dispatchTables(BASIC_PROTOCOL_DIR "/dap.protocol");
+    CHECK_EQ(lsp.size(), 2u);
+    CHECK_EQ(dap.size(), 1u);
+    checkTable<lsp::RequestType>(lsp["RequestType"], lsp::toRequestType, "RequestType");
+    checkTable<lsp::NotificationType>(lsp["NotificationType"], lsp::toNotificationType, "NotificationType");
+    checkTable<dap::DAPRequestType>(dap["DAPRequestType"], dap::toDAPRequestType, "DAPRequestType");
+
+    // Requests and notifications are separate tables
+    for (const std::string& name : lsp["NotificationType"]) {
+        CHECK_EQ_FOR(lsp::toRequestType(name) == lsp::RequestType::UNKNOWN, true, name);
+    }
+    return test::result();
+}
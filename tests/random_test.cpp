@@ -0,0 +1,95 @@
+// Checks that Random::fill(), vector kernels included, writes exactly the
+// values of its four scalar streams, and RND's argument handling.
+#include "check.h"
+#include "interpreter/functions.h"
+#include "interpreter/random.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<uint64_t> seeds() {
+    std::vector<uint64_t> result = {basic::Random::kDefaultSeed, UINT64_MAX, 0x8000000000000000ull,
+                                    static_cast<uint64_t>(-42), 0x123456789abcdefull};
+    for (uint64_t seed = 0; seed < 256; ++seed) {
+        result.push_back(seed);
+    }
+    return result;
+}
+
+void testFillMatchesStreams() {
+    // Consecutive fills, with tails that drop part of a round
+    const size_t counts[] = {0, 1, 3, 4, 5, 7, 8, 13, 64, 101, 2, 1000};
+    for (uint64_t seed : seeds()) {
+        basic::Random random(seed);
+        basic::Random untouched(seed);
+        std::vector<basic::Random> streams;
+        for (size_t i = 0; i < 4; ++i) {
+            streams.push_back(random.stream(i));
+        }
+
+        for (size_t count : counts) {
+            std::vector<double> out(count);
+            random.fill(out.data(), count);
+            for (size_t round = 0; round * 4 < count; ++round) {
+                for (size_t i = 0; i < 4; ++i) {
+                    double expected = streams[i].nextDouble();
+                    size_t at = round * 4 + i;
+                    if (at < count) {
+                        CHECK_EQ_FOR(out[at], expected, "seed " + std::to_string(seed) + " stream " +
+                                     std::to_string(i) + " value " + std::to_string(at) + " of " +
+                                     std::to_string(count));
+                        CHECK(out[at] >= 0.0 && out[at] < 1.0);
+                    }
+                }
+            }
+        }
+        // fill() leaves the scalar stream where it was
+        for (int i = 0; i < 4; ++i) {
+            CHECK_EQ_FOR(random.nextDouble(), untouched.nextDouble(), "seed " + std::to_string(seed));
+        }
+    }
+}
+
+// Each bulk stream starts one jump (2^128 steps) past the one before it
+void testStreamSpacing() {
+    for (uint64_t seed : seeds()) {
+        basic::Random random(seed);
+        for (size_t i = 0; i + 1 < 4; ++i) {
+            basic::Random next = random.stream(i).stream(0);
+            basic::Random expected = random.stream(i + 1);
+            for (int n = 0; n < 8; ++n) {
+                CHECK_EQ_FOR(next.next(), expected.next(), "seed " + std::to_string(seed) + " stream " +
+                             std::to_string(i + 1));
+            }
+        }
+    }
+}
+
+void testRndArguments() {
+    basic::Functions functions;
+    functions.randomize(basic::Value{7});
+    double first = std::get<double>(functions.call("RND", {basic::Value{true}}, nullptr));
+    CHECK(first >= 0.0 && first < 1.0);
+    // FALSE is 0, which repeats the last value
+    CHECK_EQ(std::get<double>(functions.call("RND", {basic::Value{false}}, nullptr)), first);
+    CHECK_EQ(std::get<double>(functions.call("RND", {basic::Value{0.0}}, nullptr)), first);
+
+    bool threw = false;
+    try {
+        functions.call("RND", {basic::Value{std::string("x")}}, nullptr);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+} // namespace
+
+int main() {
+    testFillMatchesStreams();
+    testStreamSpacing();
+    testRndArguments();
+    return test::result();
+}
@@ -0,0 +1,230 @@
+// Checks the simd_string kernels and the builtins on top of them against
+// plain scalar loops. Lengths 0..70 put every match, mismatch and trim
+// boundary in the 32-byte (AVX2) and 16-byte (SSE2) blocks and in the
+// scalar tail. The AVX2 kernels are checked when the CPU has them.
+#include "check.h"
+#include "interpreter/functions.h"
+#include "interpreter/simd_string.h"
+#include <cctype>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace simd = basic::simd;
+
+namespace {
+
+constexpr size_t kMaxLength = 70;
+
+char asciiUpper(char c) { return c >= 'a' && c <= 'z' ? static_cast<char>(c - 'a' + 'A') : c; }
+char asciiLower(char c) { return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c; }
+bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+int sign(int value) { return value < 0 ? -1 : (value > 0 ? 1 : 0); }
+
+int referenceCompareIgnoreCase(const std::string& a, const std::string& b) {
+    for (size_t i = 0; i < a.size() && i < b.size(); ++i) {
+        auto left = static_cast<unsigned char>(asciiLower(a[i]));
+        auto right = static_cast<unsigned char>(asciiLower(b[i]));
+        if (left != right) return left < right ? -1 : 1;
+    }
+    return a.size() < b.size() ? -1 : (a.size() > b.size() ? 1 : 0);
+}
+
+std::string referenceReplace(const std::string& text, const std::string& search, const std::string& replacement) {
+    if (search.empty()) return text;
+    std::string result;
+    size_t start = 0;
+    for (size_t pos; (pos = text.find(search, start)) != std::string::npos; start = pos + search.size()) {
+        result += text.substr(start, pos - start) + replacement;
+    }
+    return result + text.substr(start);
+}
+
+// Few distinct letters so that partial needle matches are common
+std::string randomText(std::mt19937& rng, size_t length, const char* alphabet) {
+    std::string alphabetText(alphabet);
+    std::string text(length, ' ');
+    for (char& c : text) {
+        c = alphabetText[rng() % alphabetText.size()];
+    }
+    return text;
+}
+
+std::string describe(const std::string& text) { return "\"" + text + "\" (" + std::to_string(text.size()) + ")"; }
+
+void testFind(std::mt19937& rng) {
+    for (size_t length = 0; length <= kMaxLength; ++length) {
+        std::string text = randomText(rng, length, "abcAB");
+        for (int trial = 0; trial < 8; ++trial) {
+            // Half the needles are cut from the text so they occur in it
+            size_t needleLength = rng() % (std::min<size_t>(length, 40) + 2);
+            std::string needle = trial % 2 == 0 && needleLength <= length
+                ? text.substr(rng() % (length - needleLength + 1), needleLength)
+                : randomText(rng, needleLength, "abc");
+            for (size_t from = 0; from <= length + 1; ++from) {
+                CHECK_EQ_FOR(simd::find(text, needle, from), std::string_view(text).find(needle, from),
+                             describe(text) + " needle \"" + needle + "\" from " + std::to_string(from));
+            }
+        }
+        // Only the final position matches, behind many first-byte candidates
+        std::string last(length, 'a');
+        if (length >= 2) {
+            last[length - 1] = 'b';
+            CHECK_EQ_FOR(simd::find(last, "ab"), length - 2, describe(last));
+        }
+    }
+}
+
+size_t referenceScan(const std::string& text, size_t from, bool (*hit)(unsigned char)) {
+    for (size_t i = from; i < text.size(); ++i) {
+        if (hit(static_cast<unsigned char>(text[i]))) return i;
+    }
+    return simd::npos;
+}
+
+// findByte, findEither, findJsonEscape, findNonAscii and findAll over text
+// with one kind of hit planted at each position in turn
+void testScan(std::mt19937& rng) {
+    const char planted[] = {'x', '"', '\\', '\n', '\x01', '\x80', '\xff'};
+    for (size_t length = 0; length <= kMaxLength; ++length) {
+        for (size_t at = 0; at <= length; ++at) {
+            std::string text = randomText(rng, length, "abc ");
+            if (at < length) text[at] = planted[rng() % sizeof(planted)];
+            if (at + 5 < length && rng() % 2) text[at + 5] = planted[rng() % sizeof(planted)];
+            for (size_t from = 0; from <= length + 1; from += 1 + (length > 40 ? 3 : 0)) {
+                std::string context = describe(text) + " from " + std::to_string(from);
+                CHECK_EQ_FOR(simd::findByte(text, 'x', from), std::string_view(text).find('x', from), context);
+                CHECK_EQ_FOR(simd::findEither(text, '"', '\\', from), std::string_view(text).find_first_of("\"\\", from),
+                             context);
+                CHECK_EQ_FOR(simd::findJsonEscape(text, from),
+                             referenceScan(text, from, [](unsigned char c) { return c == '"' || c == '\\' || c < 0x20; }),
+                             context);
+                CHECK_EQ_FOR(simd::findNonAscii(text, from),
+                             referenceScan(text, from, [](unsigned char c) { return c >= 0x80; }), context);
+            }
+            std::vector<size_t> positions;
+            std::vector<size_t> expected;
+            simd::findAll(text, 'a', positions);
+            for (size_t i = 0; i < text.size(); ++i) {
+                if (text[i] == 'a') expected.push_back(i);
+            }
+            CHECK_EQ_FOR(positions == expected, true, describe(text));
+        }
+    }
+}
+
+void testCase() {
+    for (size_t length = 0; length <= kMaxLength; ++length) {
+        for (int offset = 0; offset < 4; ++offset) {
+            // Every byte value, shifted so each lands in every lane
+            std::string buffer(length + offset, '\0');
+            for (size_t i = 0; i < buffer.size(); ++i) {
+                buffer[i] = static_cast<char>((i * 7 + length) & 0xff);
+            }
+            std::string upper = buffer;
+            std::string lower = buffer;
+            simd::toUpper(&upper[offset], length);
+            simd::toLower(&lower[offset], length);
+            for (size_t i = 0; i < buffer.size(); ++i) {
+                bool converted = i >= static_cast<size_t>(offset);
+                CHECK_EQ_FOR(upper[i], converted ? asciiUpper(buffer[i]) : buffer[i], "length " + std::to_string(length));
+                CHECK_EQ_FOR(lower[i], converted ? asciiLower(buffer[i]) : buffer[i], "length " + std::to_string(length));
+            }
+        }
+    }
+}
+
+void testTrim(std::mt19937& rng, basic::Functions& functions) {
+    const char* spaces = " \t\r\n";
+    for (size_t length = 0; length <= kMaxLength; ++length) {
+        for (size_t word = 0; word <= length; ++word) {
+            // Spaces around a run of letters starting at `word`
+            std::string text(length, ' ');
+            for (size_t i = 0; i < length; ++i) {
+                text[i] = spaces[rng() % 4];
+            }
+            size_t wordLength = std::min<size_t>(rng() % 4, length - word);
+            for (size_t i = word; i < word + wordLength; ++i) {
+                text[i] = "x\x80 "[i % 3];
+            }
+            size_t begin = 0;
+            while (begin < length && isSpace(text[begin])) ++begin;
+            size_t end = length;
+            while (end > 0 && isSpace(text[end - 1])) --end;
+            CHECK_EQ_FOR(simd::skipSpace(text), begin, describe(text));
+            CHECK_EQ_FOR(simd::trimSpaceEnd(text), end, describe(text));
+
+            std::string trimmed = begin < end ? text.substr(begin, end - begin) : "";
+            CHECK_EQ_FOR(std::get<std::string>(functions.call("TRIM", {text}, nullptr)), trimmed, describe(text));
+            CHECK_EQ_FOR(std::get<std::string>(functions.call("LTRIM", {text}, nullptr)), text.substr(begin),
+                         describe(text));
+            CHECK_EQ_FOR(std::get<std::string>(functions.call("RTRIM", {text}, nullptr)), text.substr(0, end),
+                         describe(text));
+        }
+    }
+}
+
+void testCompare(std::mt19937& rng) {
+    for (size_t length = 0; length <= kMaxLength; ++length) {
+        std::string a = randomText(rng, length, "aBcD[`@{");
+        std::string flipped = a;
+        for (char& c : flipped) {
+            c = std::isupper(static_cast<unsigned char>(c)) ? asciiLower(c) : asciiUpper(c);
+        }
+        CHECK_EQ_FOR(simd::compareIgnoreCase(a, flipped), 0, describe(a));
+        // One differing byte at each position, including case-sensitive
+        // neighbours of the letters such as '@', '[', '`' and '{'
+        for (size_t at = 0; at < length; ++at) {
+            for (char c : {'a', 'Z', '[', '`', '\x80', '\0'}) {
+                std::string b = flipped;
+                b[at] = c;
+                CHECK_EQ_FOR(sign(simd::compareIgnoreCase(a, b)), referenceCompareIgnoreCase(a, b),
+                             describe(a) + " vs " + describe(b));
+                CHECK_EQ_FOR(sign(simd::compare(a, b)), sign(a.compare(b)), describe(a) + " vs " + describe(b));
+            }
+        }
+        // Prefixes order before the longer string
+        for (size_t cut = 0; cut <= length; ++cut) {
+            std::string prefix = flipped.substr(0, cut);
+            CHECK_EQ_FOR(sign(simd::compareIgnoreCase(prefix, a)), cut < length ? -1 : 0, describe(prefix));
+            CHECK_EQ_FOR(sign(simd::compareIgnoreCase(a, prefix)), cut < length ? 1 : 0, describe(prefix));
+        }
+    }
+}
+
+void testReplace(std::mt19937& rng, basic::Functions& functions) {
+    for (size_t length = 0; length <= kMaxLength; ++length) {
+        for (int trial = 0; trial < 12; ++trial) {
+            std::string text = randomText(rng, length, "abab-");
+            std::string search = randomText(rng, 1 + rng() % 3, "ab");
+            std::string replacement = randomText(rng, rng() % 4, "XY");
+            CHECK_EQ_FOR(std::get<std::string>(functions.call("REPLACE", {text, search, replacement}, nullptr)),
+                         referenceReplace(text, search, replacement),
+                         describe(text) + " \"" + search + "\" -> \"" + replacement + "\"");
+
+            // INSTR is 1-based with 0 for no match
+            size_t pos = text.find(search);
+            CHECK_EQ_FOR(std::get<int>(functions.call("INSTR", {text, search}, nullptr)),
+                         pos == std::string::npos ? 0 : static_cast<int>(pos + 1), describe(text));
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    // With the AVX2 kernels when the CPU has them, then without
+    for (bool avx2 : {true, false}) {
+        simd::setAvx2(avx2);
+        std::mt19937 rng(2024);
+        basic::Functions functions;
+        testFind(rng);
+        testScan(rng);
+        testCase();
+        testTrim(rng, functions);
+        testCompare(rng);
+        testReplace(rng, functions);
+        std::cout << "simd_string (" << simd::kernelName() << ")" << std::endl;
+    }
+    return test::result();
+}
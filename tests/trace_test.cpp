@@ -0,0 +1,254 @@
+// Checks TraceRecorder and TraceReader: a random history of variable and
+// array writes reads back at every step, find() walks forwards and backwards
+// across keyframes, and a cut-off file keeps everything before the cut.
+#include "check.h"
+#include "interpreter/basic_interpreter.h"
+#include "interpreter/output.h"
+#include "interpreter/trace.h"
+#include "interpreter/variables.h"
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Snapshot {
+    int line;
+    std::map<std::string, basic::Value> variables;
+    std::map<std::string, std::vector<basic::Value>> arrays;
+};
+
+Snapshot snapshot(int line, const basic::Variables& variables) {
+    Snapshot result{line, variables.getAll(), {}};
+    for (const auto& [name, array] : variables.getAllArrays()) {
+        result.arrays[name].assign(array.data.begin(), array.data.end());
+    }
+    return result;
+}
+
+// Exact, so that -0.0 and 0.0 or 1 and 1.0 differ
+bool same(const basic::Value& a, const basic::Value& b) {
+    if (a.index() != b.index()) return false;
+    if (const double* d = std::get_if<double>(&a)) {
+        return std::memcmp(d, &std::get<double>(b), sizeof(double)) == 0;
+    }
+    return a == b;
+}
+
+bool matches(const basic::TraceReader::State& state, const Snapshot& expected) {
+    if (state.line != expected.line || state.variables.size() != expected.variables.size() ||
+        state.arrays.size() != expected.arrays.size()) {
+        return false;
+    }
+    for (const auto& [name, value] : expected.variables) {
+        auto it = state.variables.find(name);
+        if (it == state.variables.end() || !same(it->second, value)) return false;
+    }
+    for (const auto& [name, values] : expected.arrays) {
+        auto it = state.arrays.find(name);
+        if (it == state.arrays.end() || it->second.data.size() != values.size()) return false;
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (!same(it->second.data[i], values[i])) return false;
+        }
+    }
+    return true;
+}
+
+basic::Value randomValue(std::mt19937& rng) {
+    static const double doubles[] = {0.5, -0.0, 0.0, -3.0, 1e300, 9007199254740992.0, 9007199254740994.0,
+                                     -1.25e-7, 4096.0};
+    switch (rng() % 5) {
+        case 0: return basic::Value{static_cast<int>(rng() % 2000) - 1000};
+        case 1: return basic::Value{rng() % 2 ? INT_MIN : INT_MAX};
+        case 2: return basic::Value{doubles[rng() % 9]};
+        case 3: return basic::Value{std::string(rng() % 300, static_cast<char>('a' + rng() % 26))};
+        default: return basic::Value{rng() % 2 == 0};
+    }
+}
+
+std::string readAll(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Records steps statements with random writes between them and returns the
+// state seen by each statement, plus the final state
+std::vector<Snapshot> record(const std::string& path, size_t steps) {
+    std::mt19937 rng(89);
+    basic::Variables variables;
+    basic::TraceRecorder recorder(path, "random.bas", "10 PRINT 1\n", 8);
+    variables.setTrace(&recorder);
+    std::vector<Snapshot> states;
+    static const char* scalars[] = {"A", "B", "C$", "LONGER_NAME", "X"};
+    int line = 1;
+    for (size_t step = 0; step < steps; ++step) {
+        // Mostly the next line, sometimes far away in either direction
+        int jump = rng() % 4 == 0 ? static_cast<int>(rng() % 20000) - 10000 : 1;
+        line = std::max(1, line + jump);
+        recorder.statement(line, variables);
+        states.push_back(snapshot(line, variables));
+        for (int writes = static_cast<int>(rng() % 4); writes > 0; --writes) {
+            switch (rng() % 10) {
+                case 0:
+                    variables.dim(rng() % 2 ? "M" : "S$", {static_cast<int>(rng() % 6), static_cast<int>(rng() % 3)});
+                    break;
+                case 1:
+                case 2:
+                    if (basic::Array* array = variables.getArray("M")) {
+                        int i = static_cast<int>(rng() % static_cast<unsigned>(array->dims[0]));
+                        variables.setElement("M", {i, 0}, basic::Value{static_cast<double>(rng() % 100) / 4});
+                    }
+                    break;
+                case 3:
+                    if (basic::Array* array = variables.getArray("S$")) {
+                        for (auto& value : array->data) value = basic::Value{std::string(rng() % 5, 'z')};
+                        variables.recount(*array);
+                    }
+                    break;
+                case 4:
+                    if (rng() % 20 == 0) variables.clear();
+                    break;
+                default:
+                    variables.set(scalars[rng() % 5], randomValue(rng));
+                    break;
+            }
+        }
+    }
+    states.push_back(snapshot(line, variables));
+    recorder.finish(true, "");
+    // ~Variables clears, which would record into the recorder it outlives
+    variables.setTrace(nullptr);
+    return states;
+}
+
+void testSeek(const std::string& path, const std::vector<Snapshot>& states) {
+    basic::TraceReader reader(path);
+    size_t steps = states.size() - 1;
+    CHECK_EQ(reader.steps(), steps);
+    CHECK(reader.ok());
+    CHECK_EQ(reader.sourcePath(), "random.bas");
+    CHECK_EQ(reader.source(), "10 PRINT 1\n");
+
+    // In order, then backwards, then jumping about
+    for (size_t step = 0; step <= steps; ++step) {
+        CHECK_EQ_FOR(matches(reader.seek(step), states[step]), true, "step " + std::to_string(step));
+        CHECK_EQ_FOR(reader.seek(step).step, step, "step " + std::to_string(step));
+    }
+    for (size_t step = steps + 1; step > 0; --step) {
+        CHECK_EQ_FOR(matches(reader.seek(step - 1), states[step - 1]), true, "back " + std::to_string(step - 1));
+    }
+    std::mt19937 rng(890);
+    for (int i = 0; i < 300; ++i) {
+        size_t step = rng() % (steps + 1);
+        CHECK_EQ_FOR(matches(reader.seek(step), states[step]), true, "jump " + std::to_string(step));
+    }
+    CHECK_EQ(reader.seek(steps + 10).step, steps);
+}
+
+void testFind(const std::string& path, const std::vector<Snapshot>& states) {
+    basic::TraceReader reader(path);
+    size_t steps = states.size() - 1;
+    std::mt19937 rng(891);
+    for (int i = 0; i < 200; ++i) {
+        size_t from = rng() % (steps + 1);
+        int wanted = states[rng() % steps].line;
+        auto match = [wanted](int line) { return line == wanted; };
+
+        std::optional<size_t> expected;
+        for (size_t step = from + 1; step < steps && !expected; ++step) {
+            if (states[step].line == wanted) expected = step;
+        }
+        CHECK_EQ_FOR(reader.find(from, true, match) == expected, true, "forward from " + std::to_string(from));
+
+        expected.reset();
+        for (size_t step = from; step > 0 && !expected; --step) {
+            if (states[step - 1].line == wanted) expected = step - 1;
+        }
+        CHECK_EQ_FOR(reader.find(from, false, match) == expected, true, "backward from " + std::to_string(from));
+    }
+}
+
+// A killed run leaves a partial last event; everything before it reads back
+void testTruncated(const std::string& path, const std::vector<Snapshot>& states) {
+    std::string data = readAll(path);
+    std::string cutPath = path + ".cut";
+    std::mt19937 rng(892);
+    for (int i = 0; i < 40; ++i) {
+        size_t size = 64 + rng() % (data.size() - 64);
+        {
+            std::ofstream out(cutPath, std::ios::binary | std::ios::trunc);
+            out.write(data.data(), static_cast<std::streamsize>(size));
+        }
+        std::string context = "cut at " + std::to_string(size);
+        basic::TraceReader reader(cutPath);
+        CHECK_EQ_FOR(reader.ok(), false, context);
+        CHECK_EQ_FOR(reader.error(), "Trace ends before the program finished", context);
+        CHECK_EQ_FOR(reader.steps() > 0 && reader.steps() < states.size(), true, context);
+        // The last position is as far as the cut file got, so it is not checked
+        for (size_t step = 0; step + 1 < reader.steps(); step += 7) {
+            CHECK_EQ_FOR(matches(reader.seek(step), states[step]), true, context + " step " + std::to_string(step));
+        }
+    }
+    // Inside the header, or not a trace at all, is an error
+    for (size_t size : {size_t{4}, size_t{12}}) {
+        std::ofstream(cutPath, std::ios::binary | std::ios::trunc).write(data.data(), static_cast<std::streamsize>(size));
+        bool threw = false;
+        try {
+            basic::TraceReader reader(cutPath);
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        CHECK_EQ_FOR(threw, true, "cut at " + std::to_string(size));
+    }
+    std::remove(cutPath.c_str());
+}
+
+void testInterpreterRun(const std::string& path) {
+    {
+        basic::BasicInterpreter interpreter;
+        interpreter.setOutputSink(std::make_unique<basic::BufferOutputSink>());
+        basic::TraceRecorder recorder(path, "loop.bas", "", 2);
+        interpreter.setTrace(&recorder);
+        CHECK(interpreter.loadProgram("10 S$ = \"\"\n"
+                                      "20 FOR I = 1 TO 3\n"
+                                      "30 S$ = S$ + \"a\"\n"
+                                      "40 NEXT I\n"
+                                      "50 PRINT S$\n"));
+        CHECK(interpreter.execute());
+        recorder.finish(true, "");
+        interpreter.setTrace(nullptr);
+    }
+    basic::TraceReader reader(path);
+    const int lines[] = {1, 2, 3, 4, 3, 4, 3, 4, 5};
+    CHECK_EQ(reader.steps(), 9u);
+    for (size_t step = 0; step < 9; ++step) {
+        CHECK_EQ_FOR(reader.seek(step).line, lines[step], "step " + std::to_string(step));
+    }
+    const auto& final = reader.seek(9);
+    CHECK(final.variables.count("S$") && std::get<std::string>(final.variables.at("S$")) == "aaa");
+    CHECK_EQ(reader.find(0, true, [](int line) { return line == 3; }).value_or(0), 2u);
+    CHECK_EQ(reader.find(9, false, [](int line) { return line == 3; }).value_or(0), 6u);
+    CHECK(!reader.find(6, true, [](int line) { return line == 3; }));
+}
+
+} // namespace
+
+int main() {
+    std::string path = "trace_test.trace";
+    std::vector<Snapshot> states = record(path, 600);
+    testSeek(path, states);
+    testFind(path, states);
+    testTruncated(path, states);
+    testInterpreterRun(path);
+    std::remove(path.c_str());
+    return test::result();
+}
@@ -0,0 +1,88 @@
+// Checks Variables' change tracking, which the debugger's variable deltas are
+// built on, against a model that remembers when each scalar was last written.
+#include "check.h"
+#include "interpreter/variables.h"
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+void testStops() {
+    basic::Variables variables;
+    variables.set("A", 1);
+    variables.set("B", 2);
+    uint64_t first = variables.advanceGeneration();
+    CHECK(variables.changedSince(first).empty());
+    CHECK(!variables.changedSince("A", first));
+
+    variables.set("B", 3);
+    variables.set("C$", std::string("new"));
+    auto changed = variables.changedSince(first);
+    CHECK_EQ(changed.size(), 2u);
+    CHECK(changed.count("B") == 1 && changed.count("C$") == 1);
+    CHECK_EQ(std::get<int>(changed["B"]), 3);
+    CHECK(variables.changedSince("C$", first));
+    CHECK(!variables.changedSince("missing", first));
+
+    // Writing the same value still counts as a change
+    uint64_t second = variables.advanceGeneration();
+    variables.set("A", 1);
+    CHECK_EQ(variables.changedSince(second).size(), 1u);
+    // Older stops see everything written since them
+    CHECK_EQ(variables.changedSince(first).size(), 3u);
+    CHECK_EQ(variables.changedSince(0).size(), 3u);
+
+    CHECK_EQ(variables.clearedAt(), 0u);
+    variables.clear();
+    CHECK_EQ(variables.clearedAt(), variables.generation());
+    CHECK(variables.clearedAt() > second);
+    CHECK(variables.changedSince(first).empty());
+}
+
+void testRandomHistory() {
+    std::mt19937 rng(97);
+    const char* names[] = {"A", "B", "C", "D$", "E$", "I"};
+    basic::Variables variables;
+    std::map<std::string, uint64_t> written; // generation of each name's last write
+    std::vector<uint64_t> stops;
+    for (int step = 0; step < 20000; ++step) {
+        unsigned action = rng() % 100;
+        if (action < 80) {
+            std::string name = names[rng() % 6];
+            variables.set(name, static_cast<int>(rng() % 1000));
+            written[name] = variables.generation();
+        } else if (action < 99) {
+            stops.push_back(variables.advanceGeneration());
+        } else {
+            variables.clear();
+            written.clear();
+        }
+
+        // Every earlier stop, including ones from before a clear
+        uint64_t since = stops.empty() ? 0 : stops[rng() % stops.size()];
+        std::map<std::string, uint64_t> expected;
+        for (const auto& [name, generation] : written) {
+            if (generation > since) expected[name] = generation;
+        }
+        auto changed = variables.changedSince(since);
+        CHECK_EQ_FOR(changed.size(), expected.size(), "step " + std::to_string(step));
+        for (const auto& [name, value] : changed) {
+            CHECK_EQ_FOR(expected.count(name), 1u, name);
+            CHECK_EQ_FOR(std::get<int>(value), std::get<int>(variables.get(name)), name);
+        }
+        for (const char* name : names) {
+            CHECK_EQ_FOR(variables.changedSince(name, since), expected.count(name) == 1,
+                         std::string(name) + " step " + std::to_string(step));
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    testStops();
+    testRandomHistory();
+    return test::result();
+}
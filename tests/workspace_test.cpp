@@ -0,0 +1,160 @@
+// Checks the language server's Workspace: that it stays within its memory
+// budget, the order it evicts in, recompiling evicted programs on access,
+// and reuse of document ids.
+#include "check.h"
+#include "interpreter/program.h"
+#include "lsp/lsp_server.h"
+#include <string>
+
+namespace {
+
+std::string uri(int n) { return "file:///doc" + std::to_string(n) + ".bas"; }
+
+// Distinct text per document, so no two share a cached program
+std::string source(int n, int lines) {
+    std::string text;
+    for (int i = 1; i <= lines; ++i) {
+        text += std::to_string(i * 10) + " PRINT " + std::to_string(n) + " + " + std::to_string(i) + "\n";
+    }
+    return text;
+}
+
+void testBudget() {
+    const size_t budget = 2 * 1024 * 1024;
+    lsp::Workspace workspace(budget);
+    for (int n = 0; n < 40; ++n) {
+        workspace.open(uri(n), source(n, 1000));
+        auto stats = workspace.memoryStats();
+        CHECK_EQ_FOR(stats.used <= budget, true, "after opening " + std::to_string(n));
+        if (n % 3 == 0) workspace.program(uri(n / 2));
+    }
+    auto stats = workspace.memoryStats();
+    CHECK_EQ(stats.openDocuments, 40u);
+    CHECK(stats.compiledDocuments < 40u);
+    CHECK(stats.evictions > 0u);
+    // Every document still has its text and compiles on access
+    for (int n = 0; n < 40; ++n) {
+        CHECK_EQ_FOR(workspace.text(uri(n)), source(n, 1000), uri(n));
+        auto program = workspace.program(uri(n));
+        CHECK_EQ_FOR(program != nullptr && program->source() == source(n, 1000), true, uri(n));
+        CHECK_EQ_FOR(workspace.memoryStats().used <= budget, true, uri(n));
+    }
+    CHECK(workspace.memoryStats().recompiles > 0u);
+
+    // Closing documents keeps them compiled until the budget needs the room
+    for (int n = 0; n < 40; ++n) workspace.close(*workspace.id(uri(n)));
+    stats = workspace.memoryStats();
+    CHECK_EQ(stats.openDocuments, 0u);
+    CHECK(stats.closedDocuments > 0u);
+    CHECK(stats.used <= budget);
+    workspace.setMemoryBudget(0);
+    stats = workspace.memoryStats();
+    CHECK_EQ(stats.closedDocuments, 0u);
+    CHECK_EQ(stats.used, 0u);
+}
+
+// Closed documents go first whatever their age, then the programs of open
+// documents, least recently used first
+void testEvictionOrder() {
+    lsp::Workspace workspace(64 * 1024 * 1024);
+    for (int n = 0; n < 4; ++n) workspace.open(uri(n), source(n, 50));
+    workspace.program(uri(2));
+    workspace.program(uri(3));
+    CHECK(workspace.close(*workspace.id(uri(0))));
+    // doc1 is closed last and reopened, so it is newer than the open ones
+    CHECK(workspace.close(*workspace.id(uri(1))));
+    workspace.open(uri(1), source(1, 50));
+    CHECK(workspace.close(*workspace.id(uri(1))));
+    CHECK_EQ(workspace.memoryStats().closedDocuments, 2u);
+
+    workspace.setMemoryBudget(workspace.memoryStats().used - 1);
+    CHECK(!workspace.id(uri(0)));
+    CHECK(workspace.id(uri(1)));
+    workspace.setMemoryBudget(workspace.memoryStats().used - 1);
+    CHECK(!workspace.id(uri(1)));
+    auto stats = workspace.memoryStats();
+    CHECK_EQ(stats.evictions, 2u);
+    CHECK_EQ(stats.compiledDocuments, 2u);
+
+    // doc2 was used before doc3, so its program goes
+    workspace.setMemoryBudget(stats.used - 1);
+    stats = workspace.memoryStats();
+    CHECK_EQ(stats.openDocuments, 2u);
+    CHECK_EQ(stats.compiledDocuments, 1u);
+    CHECK_EQ(stats.evictions, 3u);
+    CHECK_EQ(workspace.text(uri(2)), source(2, 50));
+    CHECK_EQ(stats.recompiles, 0u);
+
+    // Asking for it compiles it again, and now doc3's program is the colder
+    CHECK(workspace.program(uri(2))->source() == source(2, 50));
+    stats = workspace.memoryStats();
+    CHECK_EQ(stats.recompiles, 1u);
+    CHECK_EQ(stats.compiledDocuments, 1u);
+    workspace.program(uri(2));
+    CHECK_EQ(workspace.memoryStats().recompiles, 1u);
+    workspace.program(uri(3));
+    CHECK_EQ(workspace.memoryStats().recompiles, 2u);
+}
+
+void testReopenAndSharing() {
+    lsp::Workspace workspace;
+    auto id = workspace.open(uri(0), source(0, 5));
+    auto program = workspace.program(uri(0));
+    // A second client opening the document shares it
+    CHECK_EQ(workspace.open(uri(0), source(0, 5)), id);
+    CHECK(!workspace.close(id));
+    CHECK_EQ(workspace.text(uri(0)), source(0, 5));
+    CHECK(workspace.close(id));
+    CHECK(!workspace.close(id));
+    CHECK_EQ(workspace.text(uri(0)), "");
+    CHECK(workspace.program(uri(0)) == nullptr);
+    CHECK(workspace.uris().empty());
+
+    // Reopened with the same text, it keeps its program
+    CHECK_EQ(workspace.open(uri(0), source(0, 5)), id);
+    CHECK(workspace.program(uri(0)) == program);
+    workspace.update(uri(0), source(0, 6));
+    CHECK(workspace.program(uri(0)) != program);
+    CHECK_EQ(workspace.memoryStats().recompiles, 0u);
+
+    // Updating a document nobody has open opens it
+    workspace.update(uri(1), source(1, 5));
+    CHECK_EQ(workspace.uris().size(), 2u);
+    CHECK(!workspace.close(12345));
+}
+
+// Ids of forgotten documents are handed out again
+void testIdRecycling() {
+    lsp::Workspace workspace;
+    auto first = workspace.open(uri(0), source(0, 5));
+    auto second = workspace.open(uri(1), source(1, 5));
+    CHECK(first != second);
+    workspace.close(first);
+    // Still known while it is kept compiled
+    CHECK(workspace.id(uri(0)) && *workspace.id(uri(0)) == first);
+    CHECK(workspace.open(uri(2), source(2, 5)) != first);
+
+    workspace.setMemoryBudget(workspace.memoryStats().used - 1);
+    CHECK(!workspace.id(uri(0)));
+    CHECK_EQ(workspace.open(uri(3), source(3, 5)), first);
+    CHECK_EQ(workspace.text(uri(3)), source(3, 5));
+
+    // A document whose program was evicted is forgotten as soon as it closes
+    workspace.setMemoryBudget(0);
+    CHECK_EQ(workspace.memoryStats().compiledDocuments, 0u);
+    CHECK(workspace.close(second));
+    CHECK(!workspace.id(uri(1)));
+    workspace.setMemoryBudget(lsp::Workspace::kDefaultMemoryBudget);
+    CHECK_EQ(workspace.open(uri(4), source(4, 5)), second);
+    CHECK_EQ(workspace.memoryStats().openDocuments, 3u);
+}
+
+} // namespace
+
+int main() {
+    testBudget();
+    testEvictionOrder();
+    testReopenAndSharing();
+    testIdRecycling();
+    return test::result();
+}
@@ -0,0 +1,466 @@
+// Generates the typed message structs and dispatch tables of a protocol
+// server from its schema (see protocol/dap.protocol for the syntax):
+//
+//   protocol_gen <schema> <namespace> <output header>
+//
+// Run by the build; the generated header is not checked in.
+
+#include "protocol/name_hash.h"
+#include <cctype>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Field {
+    std::string name;
+    std::string type;
+    bool optional = false;
+    std::vector<std::string> comment;
+};
+
+struct Struct {
+    std::string name;
+    std::vector<std::string> constructorArgs;
+    std::vector<Field> fields;
+    std::vector<std::string> comment;
+};
+
+struct Dispatch {
+    std::string name;
+    std::vector<std::string> names;
+    std::vector<std::string> comment;
+};
+
+// Structs and dispatch tables in schema order
+struct Schema {
+    struct Item {
+        bool isStruct;
+        size_t index;
+    };
+    std::vector<Item> items;
+    std::vector<Struct> structs;
+    std::vector<Dispatch> dispatches;
+};
+
+const std::set<std::string> kScalars = {"int", "uint64", "bool", "double"};
+
+std::string trim(const std::string& text) {
+    size_t start = text.find_first_not_of(" \t\r");
+    if (start == std::string::npos) {
+        return "";
+    }
+    return text.substr(start, text.find_last_not_of(" \t\r") - start + 1);
+}
+
+bool isIdentifier(const std::string& text) {
+    if (text.empty() || std::isdigit(static_cast<unsigned char>(text[0]))) {
+        return false;
+    }
+    for (char c : text) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_') {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool isList(const std::string& type) {
+    return type.compare(0, 5, "list<") == 0 && type.back() == '>';
+}
+
+std::string elementOf(const std::string& type) {
+    return type.substr(5, type.size() - 6);
+}
+
+std::string cppType(const std::string& type) {
+    if (type == "int" || type == "bool" || type == "double") return type;
+    if (type == "uint64") return "uint64_t";
+    if (type == "string") return "std::string";
+    if (type == "json") return "json";
+    if (isList(type)) return "std::vector<" + cppType(elementOf(type)) + ">";
+    return type;
+}
+
+Schema parse(std::istream& in, const std::string& path) {
+    Schema schema;
+    std::vector<std::string> comment;
+    std::string text;
+    int number = 0;
+    enum { NONE, STRUCT, DISPATCH } block = NONE;
+    std::set<std::string> declared;
+    std::set<std::string> names;
+
+    auto fail = [&](const std::string& message) {
+        throw std::runtime_error(path + ":" + std::to_string(number) + ": " + message);
+    };
+    auto checkType = [&](const std::string& type, const std::string& owner) {
+        std::string base = isList(type) ? elementOf(type) : type;
+        if (isList(base)) {
+            fail("Lists of lists are not supported");
+        }
+        // A struct may hold a list of itself (e.g. a tree's children)
+        bool known = kScalars.count(base) || base == "string" || base == "json" || declared.count(base) ||
+            (isList(type) && base == owner);
+        if (!known) {
+            fail("Unknown type " + type);
+        }
+    };
+
+    while (std::getline(in, text)) {
+        ++number;
+        bool indented = !text.empty() && (text[0] == ' ' || text[0] == '\t');
+        std::string line = trim(text);
+        if (line.empty()) {
+            if (!indented) {
+                comment.clear();
+            }
+            continue;
+        }
+        if (line[0] == '#') {
+            comment.push_back(trim(line.substr(1)));
+            continue;
+        }
+
+        if (indented) {
+            if (block == STRUCT) {
+                Struct& owner = schema.structs.back();
+                size_t colon = line.find(':');
+                if (colon == std::string::npos) {
+                    fail("Expected `field: type`");
+                }
+                Field field;
+                field.name = trim(line.substr(0, colon));
+                field.type = trim(line.substr(colon + 1));
+                if (!field.name.empty() && field.name.back() == '?') {
+                    field.optional = true;
+                    field.name.pop_back();
+                }
+                if (!isIdentifier(field.name)) {
+                    fail("Bad field name " + field.name);
+                }
+                for (const auto& other : owner.fields) {
+                    if (other.name == field.name) {
+                        fail("Duplicate field " + field.name);
+                    }
+                }
+                checkType(field.type, owner.name);
+                field.comment = std::move(comment);
+                comment.clear();
+                owner.fields.push_back(std::move(field));
+            } else if (block == DISPATCH) {
+                schema.dispatches.back().names.push_back(line);
+                comment.clear();
+            } else {
+                fail("Indented line outside a struct or dispatch block");
+            }
+            continue;
+        }
+
+        if (block == STRUCT) {
+            declared.insert(schema.structs.back().name);
+        }
+        std::istringstream words(line);
+        std::string keyword;
+        words >> keyword;
+        std::string rest = trim(line.substr(keyword.size()));
+        if (keyword == "struct") {
+            Struct item;
+            size_t paren = rest.find('(');
+            item.name = trim(rest.substr(0, paren));
+            if (paren != std::string::npos) {
+                if (rest.back() != ')') {
+                    fail("Expected `)`");
+                }
+                std::istringstream args(rest.substr(paren + 1, rest.size() - paren - 2));
+                std::string arg;
+                while (std::getline(args, arg, ',')) {
+                    item.constructorArgs.push_back(trim(arg));
+                }
+            }
+            if (!isIdentifier(item.name) || !names.insert(item.name).second) {
+                fail("Bad or duplicate struct name " + item.name);
+            }
+            item.comment = std::move(comment);
+            schema.items.push_back({true, schema.structs.size()});
+            schema.structs.push_back(std::move(item));
+            block = STRUCT;
+        } else if (keyword == "dispatch") {
+            Dispatch item;
+            item.name = rest;
+            if (!isIdentifier(item.name) || !names.insert(item.name).second) {
+                fail("Bad or duplicate dispatch name " + item.name);
+            }
+            item.comment = std::move(comment);
+            schema.items.push_back({false, schema.dispatches.size()});
+            schema.dispatches.push_back(std::move(item));
+            block = DISPATCH;
+        } else {
+            fail("Expected `struct` or `dispatch`");
+        }
+        comment.clear();
+    }
+
+    for (const auto& item : schema.structs) {
+        for (const auto& arg : item.constructorArgs) {
+            bool found = false;
+            for (const auto& field : item.fields) {
+                found = found || field.name == arg;
+            }
+            if (!found) {
+                number = 0;
+                fail(item.name + " has no field " + arg + " to construct from");
+            }
+        }
+    }
+    return schema;
+}
+
+void writeComment(std::ostream& out, const std::vector<std::string>& comment, const std::string& indent) {
+    for (const auto& line : comment) {
+        out << indent << "//" << (line.empty() ? "" : " ") << line << "\n";
+    }
+}
+
+// Condition under which an optional field is written
+std::string present(const Field& field) {
+    if (field.type == "bool") return field.name;
+    if (kScalars.count(field.type)) return field.name + " != 0";
+    if (field.type == "json") return "!" + field.name + ".is_null()";
+    return "!" + field.name + ".empty()";
+}
+
+std::string absent(const Field& field) {
+    if (field.type == "bool") return "!" + field.name;
+    if (kScalars.count(field.type)) return field.name + " == 0";
+    if (field.type == "json") return field.name + ".is_null()";
+    return field.name + ".empty()";
+}
+
+// Type test of a parsed json value `value` for a field of type
+std::string accepts(const std::string& type, const std::string& value) {
+    if (type == "int") return value + "is_number_integer()";
+    if (type == "uint64") return value + "is_number_unsigned()";
+    if (type == "bool") return value + "is_boolean()";
+    if (type == "double") return value + "is_number()";
+    if (type == "string") return value + "is_string()";
+    if (isList(type)) return value + "is_array()";
+    return "";
+}
+
+void writeStruct(std::ostream& out, const Struct& item) {
+    writeComment(out, item.comment, "");
+    out << "struct " << item.name << " {\n";
+    for (const auto& field : item.fields) {
+        writeComment(out, field.comment, "    ");
+        out << "    " << cppType(field.type) << " " << field.name;
+        if (field.type == "bool") {
+            out << " = false";
+        } else if (kScalars.count(field.type)) {
+            out << " = 0";
+        }
+        out << ";\n";
+    }
+
+    out << "\n    " << item.name << "() = default;\n";
+    if (!item.constructorArgs.empty()) {
+        out << "    " << item.name << "(";
+        std::string initializers;
+        for (size_t i = 0; i < item.constructorArgs.size(); ++i) {
+            const std::string& arg = item.constructorArgs[i];
+            std::string type;
+            for (const auto& field : item.fields) {
+                if (field.name == arg) type = field.type;
+            }
+            out << (i ? ", " : "") << (kScalars.count(type) ? cppType(type) : "const " + cppType(type) + "&") << " "
+                << arg;
+            initializers += (i ? ", " : "") + arg + "(" + arg + ")";
+        }
+        out << ") : " << initializers << " {}\n";
+    }
+
+    out << "\n    bool empty() const {\n        return ";
+    for (size_t i = 0; i < item.fields.size(); ++i) {
+        out << (i ? " && " : "") << absent(item.fields[i]);
+    }
+    out << (item.fields.empty() ? "true" : "") << ";\n    }\n";
+
+    out << "\n    void write(protocol::JsonWriter& out) const {\n        out.beginObject();\n";
+    for (const auto& field : item.fields) {
+        out << "        " << (field.optional ? "if (" + present(field) + ") " : "") << "out.field(\"" << field.name
+            << "\", " << field.name << ");\n";
+    }
+    out << "        out.endObject();\n    }\n";
+
+    out << "\n    json toJson() const {\n        json j = json::object();\n";
+    for (const auto& field : item.fields) {
+        bool structList = isList(field.type) && !kScalars.count(elementOf(field.type)) &&
+            elementOf(field.type) != "string" && elementOf(field.type) != "json";
+        bool isStruct = !isList(field.type) && !kScalars.count(field.type) && field.type != "string" &&
+            field.type != "json";
+        std::string indent = field.optional ? "            " : "        ";
+        if (field.optional) {
+            out << "        if (" << present(field) << ") {\n";
+        }
+        if (structList) {
+            out << indent << "json elements = json::array();\n"
+                << indent << "for (const auto& element : " << field.name << ") {\n"
+                << indent << "    elements.push_back(element.toJson());\n"
+                << indent << "}\n"
+                << indent << "j[\"" << field.name << "\"] = std::move(elements);\n";
+        } else {
+            out << indent << "j[\"" << field.name << "\"] = " << field.name << (isStruct ? ".toJson()" : "") << ";\n";
+        }
+        if (field.optional) {
+            out << "        }\n";
+        }
+    }
+    out << "        return j;\n    }\n";
+
+    // Missing or mistyped members keep their defaults
+    out << "\n    static " << item.name << " fromJson(const json& j) {\n"
+        << "        " << item.name << " result;\n"
+        << "        if (!j.is_object()) {\n            return result;\n        }\n";
+    for (const auto& field : item.fields) {
+        std::string test = accepts(field.type, "it->");
+        out << "        if (auto it = j.find(\"" << field.name << "\"); it != j.end()"
+            << (test.empty() ? "" : " && " + test) << ") {\n";
+        if (isList(field.type)) {
+            std::string element = elementOf(field.type);
+            std::string elementTest = element == "json" ? "" : accepts(element, "element.");
+            out << "            for (const auto& element : *it) {\n";
+            if (kScalars.count(element) || element == "string" || element == "json") {
+                std::string push = "result." + field.name + ".push_back(element" +
+                    (element == "json" ? "" : ".get<" + cppType(element) + ">()") + ");\n";
+                if (elementTest.empty()) {
+                    out << "                " << push;
+                } else {
+                    out << "                if (" << elementTest << ") {\n"
+                        << "                    " << push << "                }\n";
+                }
+            } else {
+                out << "                result." << field.name << ".push_back(" << element << "::fromJson(element));\n";
+            }
+            out << "            }\n";
+        } else if (kScalars.count(field.type) || field.type == "string") {
+            out << "            result." << field.name << " = it->get<" << cppType(field.type) << ">();\n";
+        } else if (field.type == "json") {
+            out << "            result." << field.name << " = *it;\n";
+        } else {
+            out << "            result." << field.name << " = " << field.type << "::fromJson(*it);\n";
+        }
+        out << "        }\n";
+    }
+    out << "        return result;\n    }\n};\n\n";
+}
+
+std::string enumerator(const std::string& name) {
+    std::string result;
+    for (char c : name) {
+        result += std::isalnum(static_cast<unsigned char>(c)) ? static_cast<char>(std::toupper(static_cast<unsigned char>(c))) : '_';
+    }
+    return result;
+}
+
+// Smallest table, at most half full, and the first seed that puts every
+// name in its own slot
+std::pair<uint32_t, unsigned> perfectHash(const std::vector<std::string>& names) {
+    unsigned bits = 1;
+    while ((size_t(1) << bits) < names.size() * 2) {
+        ++bits;
+    }
+    for (;; ++bits) {
+        for (uint32_t seed = 0; seed < (1u << 20); ++seed) {
+            std::set<uint32_t> slots;
+            bool distinct = true;
+            for (const auto& name : names) {
+                distinct = distinct && slots.insert(protocol::hashSlot(name, seed, bits)).second;
+            }
+            if (distinct) {
+                return {seed, bits};
+            }
+        }
+    }
+}
+
+void writeDispatch(std::ostream& out, const Dispatch& item) {
+    writeComment(out, item.comment, "");
+    out << "enum class " << item.name << " {\n    UNKNOWN";
+    for (const auto& name : item.names) {
+        out << ",\n    " << enumerator(name);
+    }
+    out << "\n};\n\n";
+
+    auto [seed, bits] = perfectHash(item.names);
+    size_t size = size_t(1) << bits;
+    std::vector<std::string> slots(size);
+    for (const auto& name : item.names) {
+        slots[protocol::hashSlot(name, seed, bits)] = name;
+    }
+    out << "// The " << item.name << " called name, or UNKNOWN\n"
+        << "inline " << item.name << " to" << item.name << "(std::string_view name) {\n"
+        << "    static constexpr std::string_view kNames[" << size << "] = {\n";
+    for (const auto& name : slots) {
+        out << "        \"" << name << "\",\n";
+    }
+    out << "    };\n    static constexpr " << item.name << " kValues[" << size << "] = {\n";
+    for (const auto& name : slots) {
+        out << "        " << item.name << "::" << (name.empty() ? "UNKNOWN" : enumerator(name)) << ",\n";
+    }
+    out << "    };\n"
+        << "    uint32_t slot = protocol::hashSlot(name, " << seed << "u, " << bits << ");\n"
+        << "    return kNames[slot] == name ? kValues[slot] : " << item.name << "::UNKNOWN;\n}\n\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc != 4) {
+        std::cerr << "Usage: protocol_gen <schema> <namespace> <output header>" << std::endl;
+        return 2;
+    }
+    std::string path = argv[1];
+    std::string space = argv[2];
+    try {
+        std::ifstream in(path);
+        if (!in) {
+            throw std::runtime_error("Cannot open " + path);
+        }
+        Schema schema = parse(in, path);
+
+        std::ostringstream out;
+        std::string file = path.substr(path.find_last_of("/\\") + 1);
+        out << "// Generated by protocol_gen from " << file << "; edit the schema instead.\n"
+            << "#pragma once\n\n"
+            << "#include \"protocol/json_writer.h\"\n"
+            << "#include \"protocol/name_hash.h\"\n"
+            << "#include <cstdint>\n#include <string>\n#include <string_view>\n#include <vector>\n"
+            << "#include <nlohmann/json.hpp>\n\n"
+            << "namespace " << space << " {\n\n"
+            << "using json = nlohmann::json;\n\n";
+        for (const auto& item : schema.items) {
+            if (item.isStruct) {
+                writeStruct(out, schema.structs[item.index]);
+            } else {
+                writeDispatch(out, schema.dispatches[item.index]);
+            }
+        }
+        out << "} // namespace " << space << "\n";
+
+        std::ofstream header(argv[3]);
+        header << out.str();
+        if (!header) {
+            throw std::runtime_error(std::string("Cannot write ") + argv[3]);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}